@@ -296,6 +296,12 @@ public:
     option::OptionBool m_ftp_enabled{INI_SECTION, "ftp_enabled", false};
     option::OptionBool m_hdd_enabled{INI_SECTION, "hdd_enabled", true};
     option::OptionBool m_hdd_write_protect{INI_SECTION, "hdd_write_protect", false};
+    option::OptionLong m_download_segments{INI_SECTION, "download_segments", 4}; // (hidden from ui)
+    option::OptionLong m_stream_buffer_size{INI_SECTION, "stream_buffer_size", 1}; // MiB (hidden from ui)
+
+    // zip mount
+    option::OptionLong m_zip_seek_span{INI_SECTION, "zip_seek_span", 4}; // MiB (hidden from ui)
+    option::OptionBool m_zip_seek_index_save{INI_SECTION, "zip_seek_index_save", false}; // (hidden from ui)
 
     option::OptionBool m_log_enabled{INI_SECTION, "log_enabled", false};
     option::OptionBool m_replace_hbmenu{INI_SECTION, "replace_hbmenu", false};
@@ -329,6 +335,14 @@ public:
     option::OptionBool m_convert_to_standard_crypto{INI_SECTION, "convert_to_standard_crypto", false};
     option::OptionBool m_lower_master_key{INI_SECTION, "lower_master_key", false};
     option::OptionBool m_lower_system_version{INI_SECTION, "lower_system_version", true};
+    option::OptionLong m_ncz_block_threads{INI_SECTION, "ncz_block_threads", 3}; // (hidden from ui)
+    option::OptionBool m_hash_thread{INI_SECTION, "hash_thread", true}; // (hidden from ui)
+    option::OptionLong m_nca_install_lanes{INI_SECTION, "nca_install_lanes", 2}; // (hidden from ui)
+    option::OptionLong m_ncz_cache_size{INI_SECTION, "ncz_cache_size", 32}; // MiB (hidden from ui)
+    option::OptionLong m_ncz_readahead_blocks{INI_SECTION, "ncz_readahead_blocks", 2}; // (hidden from ui)
+    // io budget when using file based emummc, in MiB/s and KiB (hidden from ui)
+    option::OptionLong m_emummc_throttle_rate{INI_SECTION, "emummc_throttle_rate", 48};
+    option::OptionLong m_emummc_throttle_burst{INI_SECTION, "emummc_throttle_burst", 1024};
 
     // dump options
     option::OptionBool m_dump_app_folder{"dump", "app_folder", true};
@@ -498,6 +498,8 @@ enum NcmError {
 enum class SphairaResult : Result {
     TransferCancelled,
     StreamBadSeek,
+    PipelineNoStages,
+    PipelineNotCreated,
 
     FsTooManyEntries,
     FsNewPathTooLarge,
@@ -544,6 +546,7 @@ enum class SphairaResult : Result {
     UnzLocateFile,
     UnzGoToFirstFile,
     UnzGoToNextFile,
+    UnzGoToFilePos64,
     UnzOpenCurrentFile,
     UnzGetCurrentFileInfo64,
     UnzReadCurrentFile,
@@ -551,6 +554,8 @@ enum class SphairaResult : Result {
     ZipOpen2_64,
     ZipOpenNewFileInZip,
     ZipWriteInFileInZip,
+    ZipCloseFileInZip,
+    ZipDeflate,
 
     MmzBadLocalHeaderSig,
     MmzBadLocalHeaderRead,
@@ -619,6 +624,8 @@ enum class SphairaResult : Result {
     UsbEmptyTransferSize,
     UsbOverflowTransferSize,
     UsbBadTotalSize,
+    // crc32c of the received data doesn't match the one sent by the host.
+    UsbBadCrc,
 
     UsbUploadBadMagic,
     UsbUploadExit,
@@ -654,6 +661,8 @@ enum class SphairaResult : Result {
     YatiInvalidNczBlockSizeExponent,
     // zstd error while decompressing ncz.
     YatiInvalidNczZstdError,
+    // decompressed ncz block is smaller than the block size.
+    YatiNczShortBlock,
     // nca has rights_id but matching ticket wasn't found.
     YatiTicketNotFound,
     // found ticket has missmatching rights_id from it's name.
@@ -682,6 +691,8 @@ enum class SphairaResult : Result {
 enum : Result {
     MAKE_SPHAIRA_RESULT_ENUM(TransferCancelled),
     MAKE_SPHAIRA_RESULT_ENUM(StreamBadSeek),
+    MAKE_SPHAIRA_RESULT_ENUM(PipelineNoStages),
+    MAKE_SPHAIRA_RESULT_ENUM(PipelineNotCreated),
     MAKE_SPHAIRA_RESULT_ENUM(FsTooManyEntries),
     MAKE_SPHAIRA_RESULT_ENUM(FsNewPathTooLarge),
     MAKE_SPHAIRA_RESULT_ENUM(FsInvalidType),
@@ -722,12 +733,15 @@ enum : Result {
     MAKE_SPHAIRA_RESULT_ENUM(UnzLocateFile),
     MAKE_SPHAIRA_RESULT_ENUM(UnzGoToFirstFile),
     MAKE_SPHAIRA_RESULT_ENUM(UnzGoToNextFile),
+    MAKE_SPHAIRA_RESULT_ENUM(UnzGoToFilePos64),
     MAKE_SPHAIRA_RESULT_ENUM(UnzOpenCurrentFile),
     MAKE_SPHAIRA_RESULT_ENUM(UnzGetCurrentFileInfo64),
     MAKE_SPHAIRA_RESULT_ENUM(UnzReadCurrentFile),
     MAKE_SPHAIRA_RESULT_ENUM(ZipOpen2_64),
     MAKE_SPHAIRA_RESULT_ENUM(ZipOpenNewFileInZip),
     MAKE_SPHAIRA_RESULT_ENUM(ZipWriteInFileInZip),
+    MAKE_SPHAIRA_RESULT_ENUM(ZipCloseFileInZip),
+    MAKE_SPHAIRA_RESULT_ENUM(ZipDeflate),
     MAKE_SPHAIRA_RESULT_ENUM(MmzBadLocalHeaderSig),
     MAKE_SPHAIRA_RESULT_ENUM(MmzBadLocalHeaderRead),
     MAKE_SPHAIRA_RESULT_ENUM(FileBrowserFailedUpload),
@@ -783,6 +797,7 @@ enum : Result {
     MAKE_SPHAIRA_RESULT_ENUM(UsbBadTransferSize),
     MAKE_SPHAIRA_RESULT_ENUM(UsbEmptyTransferSize),
     MAKE_SPHAIRA_RESULT_ENUM(UsbOverflowTransferSize),
+    MAKE_SPHAIRA_RESULT_ENUM(UsbBadCrc),
     MAKE_SPHAIRA_RESULT_ENUM(UsbUploadBadMagic),
     MAKE_SPHAIRA_RESULT_ENUM(UsbUploadExit),
     MAKE_SPHAIRA_RESULT_ENUM(UsbUploadBadCount),
@@ -806,6 +821,7 @@ enum : Result {
     MAKE_SPHAIRA_RESULT_ENUM(YatiInvalidNczBlockTotal),
     MAKE_SPHAIRA_RESULT_ENUM(YatiInvalidNczBlockSizeExponent),
     MAKE_SPHAIRA_RESULT_ENUM(YatiInvalidNczZstdError),
+    MAKE_SPHAIRA_RESULT_ENUM(YatiNczShortBlock),
     MAKE_SPHAIRA_RESULT_ENUM(YatiTicketNotFound),
     MAKE_SPHAIRA_RESULT_ENUM(YatiInvalidTicketBadRightsId),
     MAKE_SPHAIRA_RESULT_ENUM(YatiCertNotFound),
@@ -21,6 +21,13 @@ enum {
 
     // sets CURLOPT_NOBODY.
     Flag_NoBody = 1 << 1,
+
+    // for large files, if the server supports range requests then the file
+    // is downloaded in segments on the idle download threads.
+    // progress is saved so that a failed or cancelled download is resumed.
+    // falls back to a normal download if ranges are not supported.
+    // this api is only available on downloading to file.
+    Flag_Segmented = 1 << 2,
 };
 
 enum class Priority {
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <switch.h>
+
+// the parts of a segmented download that don't touch curl or the sd card,
+// see Flag_Segmented.
+namespace sphaira::curl::segment {
+
+// files smaller than this are not worth splitting up.
+constexpr s64 MIN_FILE_SIZE = 1024 * 1024 * 4;
+// segment sizes are picked to give around this many segments,
+// so that a slow connection doesn't hold up the rest of the file.
+constexpr s64 SEGMENT_COUNT_TARGET = 16;
+constexpr s64 SEGMENT_SIZE_MIN = 1024 * 1024;
+constexpr s64 SEGMENT_SIZE_MAX = 1024 * 1024 * 32;
+constexpr u32 RECORD_MAGIC = 0x50474553; // SEGP
+constexpr u32 RECORD_VERSION = 1;
+
+// saved next to the temp file, followed by the done size of each segment.
+struct RecordHeader {
+    u32 magic;
+    u32 version;
+    s64 total;
+    s64 segment_size;
+    u32 segment_count;
+    // crc32 of the url and the etag / last-modified, if the file changes
+    // on the server then the record no longer matches.
+    u32 validator;
+};
+
+struct Segment {
+    s64 offset{};
+    s64 size{};
+    // bytes written to the file.
+    s64 done{};
+    bool active{};
+};
+
+// what to do with the temp file once every segment has stopped.
+enum class Outcome {
+    // every byte was written, the file can be moved into place.
+    Complete,
+    // the progress can't be resumed, delete it.
+    Discard,
+    // save the progress so that the next attempt carries on from it.
+    Resume,
+};
+
+auto GetSegmentSize(s64 total) -> s64;
+auto Split(s64 total) -> std::vector<Segment>;
+
+// returns the total from a "bytes 0-0/total" content-range, 0 if unknown.
+auto ParseContentRangeTotal(const char* content_range) -> s64;
+
+auto GetRecordSize(u32 segment_count) -> u64;
+auto SaveRecord(const RecordHeader& record, std::span<const Segment> segments) -> std::vector<u8>;
+// fills in the done size of each segment from a saved record.
+// fails if the record is for another file, or the file changed on the server.
+auto LoadRecord(std::span<const u8> buf, const RecordHeader& record, std::span<Segment> segments, s64* written) -> bool;
+
+// the server must never send more than the range that was asked for.
+auto FitsInSegment(const Segment& seg, s64 pending, s64 size) -> bool;
+
+auto GetOutcome(s64 written, s64 total, bool mismatch, bool resumable) -> Outcome;
+
+// the code to report for a segment that failed with http_code.
+// a segment that got its 206 and then failed has no error code, so 0 is reported.
+auto GetFailedCode(long http_code) -> long;
+
+} // namespace sphaira::curl::segment
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <minizip/ioapi.h>
+#include <minizip/zip.h>
 #include <vector>
 #include <span>
+#include <string>
+#include <functional>
 #include <switch.h>
 #include "fs.hpp"
 
@@ -23,6 +26,58 @@ void FileFuncSpan(MzSpan* span, zlib_filefunc64_def* funcs);
 void FileFuncStdio(zlib_filefunc64_def* funcs);
 void FileFuncNative(zlib_filefunc64_def* funcs);
 
+// writes a zip front to back, so the output never has to be seeked or kept in memory.
+// each entry is written with a data descriptor after the data, the sizes and crc32
+// are only known once the entry is closed.
+// zip64 records are added when a size / offset / entry count doesn't fit.
+// writes are buffered and flushed every flush_size bytes.
+struct StreamWriter {
+    using WriteCallback = std::function<Result(const void* data, s64 off, s64 size)>;
+
+    StreamWriter(const WriteCallback& wfunc, u64 flush_size = 1024 * 1024 * 8);
+
+    // size_hint is the uncompressed size, used to decide if the entry needs zip64.
+    // compression is either mmz_Compression_None or mmz_Compression_Deflate (raw deflate).
+    Result OpenEntry(const char* name, const zip_fileinfo& info, u16 compression, s64 size_hint);
+    // writes the (already compressed) data of the entry.
+    Result WriteEntry(const void* data, s64 size);
+    Result CloseEntry(u32 crc32, s64 uncompressed_size);
+    // writes the central directory and flushes all data.
+    Result Close(const char* comment = nullptr);
+
+    // size of the zip written so far.
+    auto GetSize() const -> s64 {
+        return m_offset;
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        u16 compression;
+        u16 modtime;
+        u16 moddate;
+        u32 crc32;
+        u64 compressed_size;
+        u64 uncompressed_size;
+        u64 local_hdr_off;
+        // set if the local header has a zip64 extra field.
+        bool zip64;
+    };
+
+    Result Write(const void* data, s64 size);
+    Result Flush();
+
+private:
+    WriteCallback m_wfunc;
+    std::vector<u8> m_buf{};
+    u64 m_flush_size{};
+    // offset of the first byte in m_buf.
+    s64 m_flushed_offset{};
+    s64 m_offset{};
+    std::vector<Entry> m_entries{};
+    bool m_entry_open{};
+};
+
 // minizip takes 18ms to open a zip and 4ms to parse the first file entry.
 // this results in a dropped frame.
 // this version simply reads the local header + file name in 2 reads,
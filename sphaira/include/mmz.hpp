@@ -0,0 +1,158 @@
+#pragma once
+
+#include <switch.h>
+#include <span>
+
+// mmz is part of ftpsrv code.
+// zip structures shared between the zip devoptab and the zip writer.
+namespace sphaira::mz {
+
+constexpr u32 LOCAL_HEADER_SIG = 0x4034B50;
+constexpr u32 FILE_HEADER_SIG = 0x2014B50;
+constexpr u32 DATA_DESCRIPTOR_SIG = 0x8074B50;
+constexpr u32 END_RECORD_SIG = 0x6054B50;
+constexpr u32 ZIP64_END_RECORD_SIG = 0x6064B50;
+constexpr u32 ZIP64_END_LOCATOR_SIG = 0x7064B50;
+
+// id of the zip64 extended information extra field.
+constexpr u16 ZIP64_EXTRA_ID = 0x0001;
+// set in the 32-bit / 16-bit fields when the real value is in the zip64 records.
+constexpr u32 ZIP64_MAGIC_32 = 0xFFFFFFFF;
+constexpr u16 ZIP64_MAGIC_16 = 0xFFFF;
+// entries at or above this uncompressed size are written with zip64 sizes.
+// leaves room for the deflate overhead, so an entry that ends up slightly
+// larger than its uncompressed size still fits.
+constexpr u64 ZIP64_THRESHOLD = 0xF0000000;
+
+// version needed to extract.
+constexpr u16 VERSION_DEFLATE = 20;
+constexpr u16 VERSION_ZIP64 = 45;
+
+enum mmz_Flag {
+    mmz_Flag_Encrypted = 1 << 0,
+    mmz_Flag_DataDescriptor = 1 << 3,
+    mmz_Flag_StrongEncrypted = 1 << 6,
+};
+
+enum mmz_Compression {
+    mmz_Compression_None = 0,
+    mmz_Compression_Deflate = 8,
+};
+
+// 30 bytes (0x1E)
+#pragma pack(push,1)
+typedef struct mmz_LocalHeader {
+    uint32_t sig;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t compression;
+    uint16_t modtime;
+    uint16_t moddate;
+    uint32_t crc32;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint16_t filename_len;
+    uint16_t extrafield_len;
+} mmz_LocalHeader;
+#pragma pack(pop)
+
+#pragma pack(push,1)
+typedef struct mmz_DataDescriptor {
+    uint32_t sig;
+    uint32_t crc32;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+} mmz_DataDescriptor;
+#pragma pack(pop)
+
+// used instead of the above if the local header has a zip64 extra field.
+#pragma pack(push,1)
+typedef struct mmz_DataDescriptor64 {
+    uint32_t sig;
+    uint32_t crc32;
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+} mmz_DataDescriptor64;
+#pragma pack(pop)
+
+// 46 bytes (0x2E)
+#pragma pack(push,1)
+typedef struct mmz_FileHeader {
+    uint32_t sig;
+    uint16_t version;
+    uint16_t version_needed;
+    uint16_t flags;
+    uint16_t compression;
+    uint16_t modtime;
+    uint16_t moddate;
+    uint32_t crc32;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint16_t filename_len;
+    uint16_t extrafield_len;
+    uint16_t filecomment_len;
+    uint16_t disk_start; // wat
+    uint16_t internal_attr; // wat
+    uint32_t external_attr; // wat
+    uint32_t local_hdr_off;
+} mmz_FileHeader;
+#pragma pack(pop)
+
+#pragma pack(push,1)
+typedef struct mmz_EndRecord {
+    uint32_t sig;
+    uint16_t disk_number;
+    uint16_t disk_wcd;
+    uint16_t disk_entries;
+    uint16_t total_entries;
+    uint32_t central_directory_size;
+    uint32_t file_hdr_off;
+    uint16_t comment_len;
+} mmz_EndRecord;
+#pragma pack(pop)
+
+// 56 bytes (0x38)
+#pragma pack(push,1)
+typedef struct mmz_Zip64EndRecord {
+    uint32_t sig;
+    uint64_t record_size; // size of the record minus the first 12 bytes.
+    uint16_t version;
+    uint16_t version_needed;
+    uint32_t disk_number;
+    uint32_t disk_wcd;
+    uint64_t disk_entries;
+    uint64_t total_entries;
+    uint64_t central_directory_size;
+    uint64_t file_hdr_off;
+} mmz_Zip64EndRecord;
+#pragma pack(pop)
+
+// 20 bytes (0x14), found just before the end record.
+#pragma pack(push,1)
+typedef struct mmz_Zip64EndLocator {
+    uint32_t sig;
+    uint32_t disk_number;
+    uint64_t end_record_off;
+    uint32_t total_disks;
+} mmz_Zip64EndLocator;
+#pragma pack(pop)
+
+// header of each field in the extra field.
+#pragma pack(push,1)
+typedef struct mmz_ExtraHeader {
+    uint16_t id;
+    uint16_t size;
+} mmz_ExtraHeader;
+#pragma pack(pop)
+
+static_assert(sizeof(mmz_LocalHeader) == 0x1E);
+static_assert(sizeof(mmz_FileHeader) == 0x2E);
+static_assert(sizeof(mmz_EndRecord) == 0x16);
+static_assert(sizeof(mmz_Zip64EndRecord) == 0x38);
+static_assert(sizeof(mmz_Zip64EndLocator) == 0x14);
+
+// reads the zip64 extra field of a file header, only the values that are set
+// to ZIP64_MAGIC_32 are replaced, in the order they appear in the field.
+void ParseZip64Extra(std::span<const u8> extra, u64& uncompressed_size, u64& compressed_size, u64& local_hdr_off);
+
+} // namespace sphaira::mz
@@ -1,18 +1,24 @@
 #pragma once
 
 #include "ui/progress_box.hpp"
+#include "utils/parallel_deflate.hpp"
+#include "minizip_helper.hpp"
 #include <functional>
 #include <switch.h>
+#include <minizip/zip.h>
 
 namespace sphaira::thread {
 
 enum class Mode {
-    // default, always multi-thread.
+    // always multi-thread.
     MultiThreaded,
     // always single-thread.
     SingleThreaded,
     // check buffer size, if smaller, single thread.
     SingleThreadedIfSmaller,
+    // default, multi-thread, the chunk size and queue depth are tuned from
+    // the read / write speed measured during the first few MiB.
+    Adaptive,
 };
 
 using DecompressWriteCallback = std::function<Result(const void* data, s64 size)>;
@@ -35,12 +41,12 @@ using StartCallback = std::function<Result(PullCallback pull)>;
 using StartCallback2 = std::function<Result(StartThreadCallback start, PullCallback pull)>;
 
 // reads data from rfunc into wfunc.
-Result Transfer(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const WriteCallback& wfunc, Mode mode = Mode::MultiThreaded);
-Result Transfer(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const DecompressCallback& dfunc, const WriteCallback& wfunc, Mode mode = Mode::MultiThreaded);
+Result Transfer(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const WriteCallback& wfunc, Mode mode = Mode::Adaptive);
+Result Transfer(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const DecompressCallback& dfunc, const WriteCallback& wfunc, Mode mode = Mode::Adaptive);
 
 // reads data from rfunc, pull data from provided pull() callback.
-Result TransferPull(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const StartCallback& sfunc, Mode mode = Mode::MultiThreaded);
-Result TransferPull(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const StartCallback2& sfunc, Mode mode = Mode::MultiThreaded);
+Result TransferPull(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const StartCallback& sfunc, Mode mode = Mode::Adaptive);
+Result TransferPull(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const StartCallback2& sfunc, Mode mode = Mode::Adaptive);
 
 // helper for extract zips.
 // this will multi-thread unzip if size >= 512KiB, otherwise it'll single pass.
@@ -49,11 +55,20 @@ Result TransferUnzip(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::F
 // same as above but for zipping files.
 Result TransferZip(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::FsPath& path, u32* crc32 = nullptr, Mode mode = Mode::SingleThreadedIfSmaller);
 
+// same as above but the file is compressed on the deflate threads.
+// the file is added to the zip as name, it must not be opened beforehand as the
+// compressed data is written raw and the crc32 / sizes are set on close.
+Result TransferZip(ui::ProgressBox* pbox, utils::ParallelDeflate& deflate, void* zfile, fs::Fs* fs, const fs::FsPath& path, const char* name, const zip_fileinfo* info, int level);
+
+// same as above but the entry is streamed out with the writer.
+Result TransferZip(ui::ProgressBox* pbox, utils::ParallelDeflate& deflate, mz::StreamWriter& writer, fs::Fs* fs, const fs::FsPath& path, const char* name, const zip_fileinfo* info, int level);
+
 // passes the name inside the zip an final output path.
 using UnzipAllFilter = std::function<bool(const fs::FsPath& name, fs::FsPath& path)>;
 
 // helper all-in-one unzip function that unzips a zip (either open or path provided).
 // the filter function can be used to modify the path and filter out unwanted files.
+// if the path is provided, small files are extracted in parallel unless mode is SingleThreaded.
 Result TransferUnzipAll(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::FsPath& base_path, const UnzipAllFilter& filter = nullptr, Mode mode = Mode::SingleThreadedIfSmaller);
 Result TransferUnzipAll(ui::ProgressBox* pbox, const fs::FsPath& zip_out, fs::Fs* fs, const fs::FsPath& base_path, const UnzipAllFilter& filter = nullptr, Mode mode = Mode::SingleThreadedIfSmaller);
 
@@ -2,6 +2,7 @@
 
 #include "ui/menus/menu_base.hpp"
 #include "yati/source/stream.hpp"
+#include "utils/ring_buffer.hpp"
 
 namespace sphaira::ui::menu::stream {
 
@@ -26,6 +27,7 @@ struct Stream final : yati::source::Stream {
     Stream(const fs::FsPath& path, std::stop_token token);
 
     Result ReadChunk(void* buf, s64 size, u64* bytes_read) override;
+    Result SkipChunk(s64 size, u64* bytes_skipped) override;
     bool Push(const void* buf, s64 size);
     void Disable();
     auto& GetPath() const { return m_path; }
@@ -33,7 +35,8 @@ struct Stream final : yati::source::Stream {
 private:
     fs::FsPath m_path{};
     std::stop_token m_token{};
-    std::vector<u8> m_buffer{};
+    // written by Push() and read by ReadChunk(), the mutex is only taken to wait.
+    utils::SpscRingBuffer m_buffer;
     CondVar m_can_read{};
     CondVar m_can_write{};
 
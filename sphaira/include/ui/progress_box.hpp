@@ -28,6 +28,8 @@ struct ProgressBox final : Widget {
     auto SetActionName(const std::string& action) -> ProgressBox&;
     auto SetTitle(const std::string& title) -> ProgressBox&;
     auto NewTransfer(const std::string& transfer) -> ProgressBox&;
+    // same as above but keeps the current progress.
+    auto SetTransferName(const std::string& transfer) -> ProgressBox&;
     // zeros the saved offset.
     auto ResetTranfser() -> ProgressBox&;
     auto UpdateTransfer(s64 offset, s64 size) -> ProgressBox&;
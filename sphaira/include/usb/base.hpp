@@ -3,10 +3,51 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <new>
+#include <atomic>
 #include <switch.h>
 
 namespace sphaira::usb {
 
+// usb transfers must be from / to page aligned memory.
+constexpr u64 TRANSFER_ALIGN = 0x1000;
+
+// page aligned buffer, transfers to / from it skip the bounce buffer.
+// leased by callers so that data lands directly in the buffer that is later used.
+struct Buffer {
+    Buffer() = default;
+    explicit Buffer(u32 size)
+    : m_data{new(std::align_val_t{TRANSFER_ALIGN}) u8[size]}
+    , m_size{size} {
+    }
+
+    auto data() const -> u8* {
+        return m_data.get();
+    }
+
+    auto size() const -> u32 {
+        return m_size;
+    }
+
+private:
+    struct Deleter {
+        void operator()(u8* p) const {
+            ::operator delete[](p, std::align_val_t{TRANSFER_ALIGN});
+        }
+    };
+
+    std::unique_ptr<u8[], Deleter> m_data{};
+    u32 m_size{};
+};
+
+struct TransferStats {
+    // bytes sent / received over usb.
+    u64 transferred{};
+    // bytes that had to be copied before reaching the caller, either through
+    // the bounce buffer or out of a buffer that a transfer was received into.
+    u64 copied{};
+};
+
 struct Base {
     Base(u64 transfer_timeout);
     virtual ~Base();
@@ -23,7 +64,7 @@ struct Base {
         return TransferPacketImpl(read, page, remaining, size, out_size_transferred, m_transfer_timeout);
     }
 
-    // transfers all data.
+    // transfers all data, page aligned data is transferred in place.
     Result TransferAll(bool read, void *data, u32 size, u64 timeout);
     Result TransferAll(bool read, void *data, u32 size) {
         return TransferAll(read, data, size, m_transfer_timeout);
@@ -43,6 +84,21 @@ struct Base {
         return m_transfer_timeout;
     }
 
+    // returns a page aligned buffer of size bytes.
+    // pipeline buffers from utils::BufferPool are already page aligned.
+    static auto LeaseBuffer(u32 size) -> Buffer {
+        return Buffer{size};
+    }
+
+    // counts a copy made by the caller, ie, out of a received request.
+    void AddCopied(u64 size) {
+        m_bytes_copied += size;
+    }
+
+    auto GetTransferStats() const -> TransferStats {
+        return {m_bytes_transferred, m_bytes_copied};
+    }
+
 protected:
     enum UsbSessionEndpoint {
         UsbSessionEndpoint_In = 0,
@@ -57,7 +113,9 @@ protected:
 private:
     u64 m_transfer_timeout{};
     UEvent m_uevent{};
-    std::unique_ptr<u8*> m_aligned{};
+    Buffer m_aligned{};
+    std::atomic<u64> m_bytes_transferred{};
+    std::atomic<u64> m_bytes_copied{};
 };
 
 } // namespace sphaira::usb
@@ -26,6 +26,20 @@ enum : u32 {
     FLAG_STREAM = 1 << 0,
 };
 
+// protocol v2 allows for several data requests to be in flight at once.
+// the device sends the version in arg3 of the hello packet and the max number
+// of requests it wants in flight in arg4.
+// a v2 host replies with the number it accepts in arg4 of the hello result,
+// v1 hosts leave it as 0.
+// in v2 the device does not wait for a result after sending a data request,
+// the host replies to each request in order with a result followed by the data.
+enum : u32 {
+    PROTOCOL_VERSION_2 = 2,
+    INFLIGHT_MAX = 8,
+    // size of each pipelined data request.
+    INFLIGHT_CHUNK_SIZE = 1024 * 1024,
+};
+
 struct UsbPacket {
     u32 magic{};
     u32 arg2{};
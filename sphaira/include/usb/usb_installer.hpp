@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <deque>
 #include <switch.h>
 
 namespace sphaira::usb::install {
@@ -37,11 +38,39 @@ private:
     Result SendAndVerify(const void* data, u32 size, u64 timeout, api::ResultPacket* out = nullptr);
     Result SendAndVerify(const void* data, u32 size, api::ResultPacket* out = nullptr);
 
+    // protocol v2, see usb_api.hpp.
+    Result ReadPipelined(void* buf, u64 off, u32 size, u64* bytes_read);
+    // sends data requests until the max in flight is reached.
+    Result QueueRequests();
+    // receives the oldest request, data may be null to discard it.
+    Result ReceiveRequest(void* data);
+    // copies data from the received stream, out may be null to discard it.
+    Result Consume(u8* out, u64 size);
+    // receives and discards all requests in flight.
+    Result DrainRequests();
+
 private:
+    struct Request {
+        u64 off;
+        u32 size;
+    };
+
     std::unique_ptr<usb::UsbDs> m_usb{};
     Result m_open_result{};
     bool m_was_connected{};
     u32 m_flags{};
+
+    // max data requests in flight, 0 if the host only supports v1.
+    u32 m_inflight_max{};
+    u64 m_file_size{};
+    std::deque<Request> m_requests{};
+    // offset of the next byte of the stream and the next request to send.
+    u64 m_stream_off{};
+    u64 m_request_off{};
+    // request that has been received but not fully consumed.
+    usb::Buffer m_leftover{};
+    u64 m_leftover_size{};
+    u64 m_leftover_pos{};
 };
 
 } // namespace sphaira::usb::install
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <switch.h>
+#include <sys/types.h>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+// pipelined reads / writes for the network libraries that have an async api
+// driven by polling a socket (libsmb2, libnfs).
+// the library is wrapped by an AsyncBackend, see devoptab_smb2.cpp and devoptab_nfs.cpp.
+//
+// the contexts are not thread safe, the caller must hold the same lock
+// that is used for every other call on the context.
+namespace sphaira::utils {
+
+struct AsyncSlot {
+    using Clock = std::chrono::steady_clock;
+
+    enum class State {
+        Free,
+        Pending,
+        Ready,
+    };
+
+    // called by the backend once the request has finished,
+    // with the bytes transferred or a negative errno.
+    // an orphaned slot frees itself here.
+    void Complete(int status);
+
+    std::vector<u8> data{};
+    u32 requested{};
+    u32 size{};
+    u32 consumed{};
+    int result{};
+    State state{State::Free};
+    Clock::time_point issued{};
+    Clock::time_point completed{};
+    // set if the queue was freed whilst the request was still in flight.
+    bool orphaned{};
+};
+
+struct AsyncBackend {
+    virtual ~AsyncBackend() = default;
+
+    // sends the request, the backend must call slot->Complete() once it has finished.
+    virtual int ReadAsync(void* buf, u32 size, u64 off, AsyncSlot* slot) = 0;
+    virtual int WriteAsync(const void* buf, u32 size, u64 off, AsyncSlot* slot) = 0;
+
+    // the socket and the events to poll() it for.
+    virtual int GetFd() = 0;
+    virtual int WhichEvents() = 0;
+    // processes the replies, revents is 0 if poll() timed out.
+    virtual int Service(int revents) = 0;
+};
+
+// ring of requests in flight, oldest first.
+struct AsyncQueue {
+    AsyncQueue(std::unique_ptr<AsyncBackend>&& backend, u32 request_size, u32 max_requests);
+    virtual ~AsyncQueue();
+
+    AsyncQueue(const AsyncQueue&) = delete;
+    void operator=(const AsyncQueue&) = delete;
+
+protected:
+    auto Head() -> AsyncSlot& {
+        return *m_slots[m_head];
+    }
+
+    // the slot after the last one in flight.
+    auto Tail() -> AsyncSlot& {
+        return *m_slots[(m_head + m_count) % m_slots.size()];
+    }
+
+    void Prepare(AsyncSlot& slot, u32 size);
+    int SubmitRead(AsyncSlot& slot, u64 off);
+    int SubmitWrite(AsyncSlot& slot, u64 off);
+    void Pop();
+
+    // waits for the socket and lets the library process the replies.
+    // a timeout of 0 only processes what has already arrived.
+    int Service(int timeout_ms = 1000);
+    int WaitHead();
+    // waits for every request in flight and throws the result away.
+    int Drain();
+
+    auto HasPending() const -> bool;
+    auto Rtt(const AsyncSlot& slot) const -> u64;
+
+private:
+    int Submit(AsyncSlot& slot, int rc);
+
+protected:
+    const std::unique_ptr<AsyncBackend> m_backend;
+    const u32 m_request_size;
+    std::vector<std::unique_ptr<AsyncSlot>> m_slots;
+    u32 m_head{};
+    u32 m_count{};
+    bool m_broken{};
+};
+
+// keeps reads in flight ahead of a sequential reader and hands them back in order.
+// the number in flight is enough to cover the round-trip time at the rate the
+// reader uses the data, up to max_requests. after a seek it starts again at a
+// single request and doubles from there, so a reader that seeks around only
+// ever has one request to wait on.
+struct AsyncReadAhead final : AsyncQueue {
+    AsyncReadAhead(std::unique_ptr<AsyncBackend>&& backend, u64 file_size, u32 request_size, u32 max_requests);
+
+    // returns the number of bytes read, 0 at the end of the file or a negative errno.
+    ssize_t Read(void* buf, u64 off, size_t len);
+
+    auto GetSize() const -> u64 {
+        return m_size;
+    }
+
+private:
+    using Clock = AsyncSlot::Clock;
+
+    ssize_t ReadInternal(u8* buf, u64 off, size_t len);
+    void UpdateReaderRate();
+    void UpdateWindow(const AsyncSlot& slot);
+    // issues requests for the free slots, up to the current window.
+    int Fill();
+
+private:
+    u64 m_size;
+    // offset the reader is at, and the offset of the next request.
+    u64 m_read_off{};
+    u64 m_next_off{};
+    u32 m_window{1};
+
+    // smoothed rtt in microseconds, and bytes per microsecond the reader uses.
+    double m_srtt{};
+    double m_reader_rate{};
+    // records when the reader returned, the time until the next read is how
+    // long the reader took to use the data.
+    size_t m_last_read_len{};
+    Clock::time_point m_last_read_end{};
+};
+
+// buffers sequential writes into requests of request_size and keeps up to
+// max_requests of them in flight.
+// as the write returns before the server has replied, an error is reported on
+// the next Write() or Flush().
+struct AsyncWriteBehind final : AsyncQueue {
+    using AsyncQueue::AsyncQueue;
+    ~AsyncWriteBehind();
+
+    // returns len or a negative errno.
+    ssize_t Write(const void* buf, u64 off, size_t len);
+
+    // sends what has been buffered and waits for every write to finish.
+    // returns the first error since the last flush.
+    int Flush();
+
+private:
+    int Submit();
+    // frees the finished writes at the head, waiting for the first one if wait is set.
+    int Reap(bool wait);
+
+private:
+    // offset of the slot being filled, and the offset the next write should be at.
+    u64 m_slot_off{};
+    u64 m_write_off{};
+    bool m_filling{};
+};
+
+} // namespace sphaira::utils
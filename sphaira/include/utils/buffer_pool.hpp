@@ -0,0 +1,108 @@
+#pragma once
+
+#include <switch.h>
+#include <vector>
+#include <new>
+#include <cstddef>
+
+namespace sphaira::utils {
+
+// pool buffers are page aligned so that usb transfers land straight in them,
+// rather than going through the bounce buffer, see usb::Base::TransferAll().
+constexpr u64 BUFFER_POOL_ALIGN = 0x1000;
+
+template<typename T>
+struct PageAlignedAllocator {
+    using value_type = T;
+
+    PageAlignedAllocator() = default;
+    template<typename U>
+    PageAlignedAllocator(const PageAlignedAllocator<U>&) {}
+
+    auto allocate(std::size_t n) -> T* {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{BUFFER_POOL_ALIGN}));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t{BUFFER_POOL_ALIGN});
+    }
+
+    template<typename U>
+    auto operator==(const PageAlignedAllocator<U>&) const -> bool {
+        return true;
+    }
+};
+
+using PoolVector = std::vector<u8, PageAlignedAllocator<u8>>;
+
+struct BufferPoolStats {
+    // bytes currently leased out / the most that was leased out at once.
+    u64 leased{};
+    u64 peak_leased{};
+    // bytes sitting in the pool waiting to be reused.
+    u64 cached{};
+    u64 peak_cached{};
+    // number of leases served from the pool vs newly allocated.
+    u64 hits{};
+    u64 misses{};
+};
+
+// process-wide pool of transfer buffers, bucketed into power of 2 size classes.
+// buffers are kept around once released so that a bulk copy or a multi-nca
+// install reuses the same few allocations rather than hitting the allocator
+// for every file.
+struct BufferPool final {
+    // returns an empty vector with a capacity of at least size.
+    static auto Acquire(u64 size) -> PoolVector;
+    // returns the vector to the pool, it is freed if the pool is full.
+    static void Release(PoolVector&& buf);
+
+    // max bytes that are kept cached, lower this for applet mode.
+    static void SetMaxCachedSize(u64 size);
+    // frees all cached buffers.
+    static void Trim();
+
+    static auto GetStats() -> BufferPoolStats;
+    // logs the current and peak usage.
+    static void LogStats();
+};
+
+// RAII lease of a pool buffer, the buffer is released back to the pool on destruction.
+// the vector can be swapped with other leased vectors (ie, pipeline queues).
+struct PooledBuffer final {
+    PooledBuffer() = default;
+    explicit PooledBuffer(u64 size) : m_buf{BufferPool::Acquire(size)} {}
+
+    ~PooledBuffer() {
+        BufferPool::Release(std::move(m_buf));
+    }
+
+    PooledBuffer(PooledBuffer&& rhs) : m_buf{std::move(rhs.m_buf)} {}
+    PooledBuffer& operator=(PooledBuffer&& rhs) {
+        if (this != &rhs) {
+            BufferPool::Release(std::move(m_buf));
+            m_buf = std::move(rhs.m_buf);
+        }
+        return *this;
+    }
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    void operator=(const PooledBuffer&) = delete;
+
+    auto Get() -> PoolVector& {
+        return m_buf;
+    }
+
+    auto operator*() -> PoolVector& {
+        return m_buf;
+    }
+
+    auto operator->() -> PoolVector* {
+        return &m_buf;
+    }
+
+private:
+    PoolVector m_buf{};
+};
+
+} // namespace sphaira::utils
@@ -8,6 +8,8 @@
 #include <span>
 #include <functional>
 #include <unordered_map>
+#include <vector>
+#include <cerrno>
 #include <curl/curl.h>
 
 namespace sphaira::devoptab::common {
@@ -68,6 +70,10 @@ struct BufferedFileData {
 
 constexpr u64 CACHE_LARGE_ALLOC_SIZE = 1024 * 512;
 constexpr u64 CACHE_LARGE_SIZE = 1024 * 16;
+// granularity of the block index for each cache, entries are indexed
+// by every block that they overlap.
+constexpr u64 CACHE_SMALL_INDEX_BLOCK_SIZE = 1024 * 4;
+constexpr u64 CACHE_LARGE_INDEX_BLOCK_SIZE = 1024 * 64;
 
 struct LruBufferedData : BufferedDataBase {
     LruBufferedData(const std::shared_ptr<yati::source::Base>& _source, u64 _size, u32 small = 1024, u32 large = 2)
@@ -76,12 +82,23 @@ struct LruBufferedData : BufferedDataBase {
         buffered_large.resize(large);
         lru_cache[0].Init(buffered_small);
         lru_cache[1].Init(buffered_large);
+        // each entry overlaps a few blocks.
+        lru_index[0].reserve(small * 4);
+        lru_index[1].reserve(large * 8);
     }
 
     virtual Result Read(void* buf, s64 off, s64 size, u64* bytes_read) override;
 
+private:
+    // returns the entry that contains off, or nullptr if not cached.
+    auto IndexFind(u32 cache, u64 off) const -> BufferedFileData*;
+    void IndexAdd(u32 cache, BufferedFileData* entry);
+    void IndexRemove(u32 cache, BufferedFileData* entry);
+
 private:
     utils::Lru<BufferedFileData> lru_cache[2]{};
+    // aligned block offset -> entries that overlap that block.
+    std::unordered_multimap<u64, BufferedFileData*> lru_index[2]{};
     std::vector<BufferedFileData> buffered_small{}; // 1MiB (usually).
     std::vector<BufferedFileData> buffered_large{}; // 1MiB
 };
@@ -162,6 +179,14 @@ struct MountDevice {
     }
 
     virtual bool Mount() = 0;
+
+    // return true if each open file / dir has its own session, in which case
+    // calls on that file / dir only lock the file / dir and not the whole device.
+    // path based calls (open, stat, rename etc) always lock the device.
+    // the curl mounts give each file its own curl handle, smb2, nfs and sftp
+    // give each file its own session from a SessionPool.
+    virtual bool IsFileConcurrent() const { return false; }
+
     virtual int devoptab_open(void *fileStruct, const char *path, int flags, int mode) { return -EIO; }
     virtual int devoptab_close(void *fd) { return -EIO; }
     virtual ssize_t devoptab_read(void *fd, char *ptr, size_t len) { return -EIO; }
@@ -185,6 +210,72 @@ struct MountDevice {
     const MountConfig config;
 };
 
+// sessions of a mount whose session can't be shared between threads (smb2, nfs, sftp).
+// each open file takes a session for itself and gives it back on close, so that
+// files can be used at the same time, a new session (with its own login) is only
+// created when none are idle.
+// T must have a bool Connect(const MountConfig&) and disconnect when destroyed.
+// open / close hold the device lock, which also guards the pool.
+template<typename T>
+struct SessionPool {
+    // number of unused sessions kept, the rest are disconnected.
+    static constexpr size_t MAX_IDLE_SESSIONS = 2;
+
+    // calls open on an idle session, or on a new one if there are none.
+    // as the server may have dropped an idle session, open is tried again
+    // on a new session if it fails with a connection error, any other error
+    // (ie, ENOENT) is returned as is and the idle session is kept.
+    // returns 0 and sets out to the session open succeeded on, or a negative errno.
+    template<typename F>
+    int Acquire(const MountConfig& config, T** out, F&& open) {
+        if (!m_idle.empty()) {
+            auto session = std::move(m_idle.back());
+            m_idle.pop_back();
+
+            const auto ret = open(session.get());
+            if (!ret) {
+                *out = session.release();
+                return 0;
+            }
+
+            if (!IsConnectionError(ret)) {
+                Release(session.release());
+                return ret;
+            }
+        }
+
+        auto session = std::make_unique<T>();
+        if (!session->Connect(config)) {
+            return -EIO;
+        }
+
+        if (const auto ret = open(session.get())) {
+            // keep the session as it connected fine, its likely the open that failed.
+            Release(session.release());
+            return ret;
+        }
+
+        *out = session.release();
+        return 0;
+    }
+
+    void Release(T* session) {
+        if (m_idle.size() < MAX_IDLE_SESSIONS) {
+            m_idle.emplace_back(session);
+        } else {
+            delete session;
+        }
+    }
+
+private:
+    static bool IsConnectionError(int ret) {
+        return ret == -EIO || ret == -ENOTCONN || ret == -ECONNRESET || ret == -EPIPE;
+    }
+
+private:
+    std::vector<std::unique_ptr<T>> m_idle{};
+};
+
 struct MountCurlDevice : MountDevice {
     using MountDevice::MountDevice;
     virtual ~MountCurlDevice();
@@ -193,6 +284,7 @@ struct MountCurlDevice : MountDevice {
     PullThreadData* CreatePullData(CURL* curl, const std::string& url, bool append = false);
 
     virtual bool Mount();
+    bool IsFileConcurrent() const override { return true; }
     virtual void curl_set_common_options(CURL* curl,  const std::string& url);
     static size_t write_memory_callback(char *ptr, size_t size, size_t nmemb, void *userdata);
     static size_t write_data_callback(char *ptr, size_t size, size_t nmemb, void *userdata);
@@ -201,14 +293,23 @@ struct MountCurlDevice : MountDevice {
     static std::string url_decode(const std::string& str);
     std::string build_url(const std::string& path, bool is_dir);
 
+protected:
+    // each open file transfers on its own handle, idle handles are kept so
+    // that they can be reused, the connections are shared with m_curl_share.
+    CURL* AcquireTransferCurl();
+    void ReleaseTransferCurl(CURL* curl);
+
 protected:
     CURL* curl{};
-    CURL* transfer_curl{};
 
 private:
     // path extracted from the url.
     std::string m_url_path{};
     CURLU* curlu{};
+    // build_url() is called from open files, which don't hold the device lock.
+    Mutex m_url_mutex{};
+    Mutex m_transfer_mutex{};
+    std::vector<CURL*> m_transfer_curls{};
     CURLSH* m_curl_share{};
     RwLock m_rwlocks[CURL_LOCK_DATA_LAST]{};
     bool m_mounted{};
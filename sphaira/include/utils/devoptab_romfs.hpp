@@ -4,7 +4,9 @@
 #include <memory>
 #include <span>
 #include <vector>
+#include <string>
 #include <string_view>
+#include <unordered_map>
 #include <sys/stat.h>
 
 namespace sphaira::devoptab::romfs {
@@ -13,7 +15,14 @@ struct RomfsCollection {
     romfs_header header;
     std::vector<u8> dir_table;
     std::vector<u8> file_table;
+    // hash buckets, empty if missing or invalid, in which case the sibling chains are walked.
+    std::vector<u32> dir_hash_table;
+    std::vector<u32> file_hash_table;
     u64 offset;
+
+    // recently resolved parent directories, path -> dir table offset.
+    // access is serialised by the devoptab mutex.
+    mutable std::unordered_map<std::string, u32> parent_cache;
 };
 
 struct FileEntry {
@@ -35,6 +35,8 @@ struct Lru {
             }
         }
 
+        data_base = data.data();
+
         list_tail = list_entry->prev->next;
     }
 
@@ -58,6 +60,11 @@ struct Lru {
         }
     }
 
+    // moves the entry that holds data to the front of the list.
+    void Update(T* data) {
+        Update(&list_flat_array[data - data_base]);
+    }
+
     // moves last entry (tail) to the front of the list.
     auto GetNextFree() {
         Update(list_tail);
@@ -71,6 +78,7 @@ private:
     ListEntry* list_head{};
     ListEntry* list_tail{};
     std::vector<ListEntry> list_flat_array{};
+    T* data_base{};
 };
 
 } // namespace sphaira::utils
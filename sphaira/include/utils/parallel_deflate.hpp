@@ -0,0 +1,93 @@
+#pragma once
+
+#include "utils/buffer_pool.hpp"
+#include <switch.h>
+#include <functional>
+#include <vector>
+
+namespace sphaira::utils {
+
+// pigz style parallel deflate.
+// the input is split into blocks which are compressed on their own thread,
+// each block is primed with the last 32KiB of the previous block and ends with
+// a sync flush, so the blocks can be joined into a single raw deflate stream.
+// the crc32 of each block is combined with crc32_combine().
+// the output is written in order as soon as each block is done, so the memory
+// used is bounded by the number of blocks in flight.
+struct ParallelDeflate {
+    using ReadCallback = std::function<Result(void* data, s64 off, s64 size, u64* bytes_read)>;
+    using WriteCallback = std::function<Result(const void* data, s64 size)>;
+
+    ParallelDeflate();
+    ~ParallelDeflate();
+
+    // the switch only gives us 3 cores, so there's no point going above that.
+    // block_size is clamped to 128KiB - 1MiB.
+    Result Start(u32 thread_count = 3, u64 block_size = 1024 * 512);
+    void Close();
+
+    auto IsRunning() const -> bool {
+        return m_thread_count > 0;
+    }
+
+    // compresses size bytes read from rfunc into a raw deflate stream written to wfunc.
+    // if the threads are not running, the blocks are compressed on the calling thread.
+    Result Compress(s64 size, int level, const ReadCallback& rfunc, const WriteCallback& wfunc, u32* crc32, s64* compressed_size);
+
+private:
+    enum class JobState {
+        Free,
+        Pending,
+        Busy,
+        Done,
+    };
+
+    struct Job {
+        PooledBuffer in{};
+        PooledBuffer out{};
+        // tail of the previous block, used as the dictionary.
+        std::vector<u8> dict{};
+        int level{};
+        bool last{};
+        u32 crc32{};
+        Result result{};
+        JobState state{JobState::Free};
+    };
+
+    Result CompressInline(s64 size, int level, const ReadCallback& rfunc, const WriteCallback& wfunc, u32* crc32, s64* compressed_size);
+    // reads the next block into the job and updates the dictionary for the block after it.
+    static Result ReadBlock(Job& job, u64 block_size, s64 size, int level, const ReadCallback& rfunc, s64& off, std::vector<u8>& dict);
+    Result GetFreeJob(Job** out, const WriteCallback& wfunc);
+    void Submit(Job* job);
+    Result Collect(const WriteCallback& wfunc);
+    // waits for all jobs to finish and frees them, so the next stream starts with every job free.
+    void Drain();
+    auto GetPendingJob() -> Job*;
+    void WorkerFunc();
+
+    static Result DeflateJob(void* strm, int* strm_level, Job& job);
+
+    static void worker_func(void* d) {
+        static_cast<ParallelDeflate*>(d)->WorkerFunc();
+    }
+
+private:
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+    CondVar m_can_collect{};
+
+    std::vector<Job> m_jobs{};
+    u32 m_submit_index{};
+    u32 m_collect_index{};
+    u64 m_block_size{};
+
+    // running totals of the stream being compressed.
+    u32 m_crc32{};
+    s64 m_compressed_size{};
+
+    std::vector<Thread> m_threads{};
+    u32 m_thread_count{};
+    bool m_quit{};
+};
+
+} // namespace sphaira::utils
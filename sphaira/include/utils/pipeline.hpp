@@ -0,0 +1,203 @@
+#pragma once
+
+#include "ui/progress_box.hpp"
+#include "utils/profile.hpp"
+#include "utils/buffer_pool.hpp"
+#include "defines.hpp"
+
+#include <switch.h>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+
+namespace sphaira::utils {
+
+// bounded fifo of buffers that connects two pipeline stages.
+// buffers are swapped in / out rather than copied, so the vectors (and their
+// allocations) circulate between the stages.
+// spare buffers are leased from the buffer pool and returned once the queue is destroyed.
+struct PipelineQueue final {
+    // the depth can later be changed with SetDepth(), up to max_depth.
+    PipelineQueue(u32 depth, u32 max_depth);
+    ~PipelineQueue();
+
+    // blocks whilst the queue is full.
+    // if the consumer has already finished, the buffer is dropped.
+    Result Push(PoolVector& buf, s64 off, StageProfile* profile);
+    // blocks whilst the queue is empty.
+    // returns an empty buffer once the producer has finished and the queue is drained.
+    Result Pop(PoolVector& buf, s64& off, StageProfile* profile);
+
+    // called once the producer has no more data.
+    void CloseProducer();
+    // called once the consumer no longer wants any data.
+    void CloseConsumer();
+    // wakes up and fails all pending / future calls with rc.
+    void Cancel(Result rc);
+
+    // sets the number of buffers that can be queued, clamped to max_depth.
+    void SetDepth(u32 depth);
+
+private:
+    struct Entry {
+        PoolVector buf{};
+        s64 off{};
+    };
+
+    Mutex m_mutex{};
+    CondVar m_can_push{};
+    CondVar m_can_pop{};
+
+    // ring of queued entries, sized to the max depth.
+    std::vector<Entry> m_entries;
+    // buffers given back by the consumer, handed out to the producer on push.
+    std::vector<PoolVector> m_spare{};
+    u32 m_depth{};
+    u32 m_read_index{};
+    u32 m_count{};
+
+    bool m_producer_closed{};
+    bool m_consumer_closed{};
+    Result m_cancel_result{};
+};
+
+struct Pipeline;
+
+// passed to each stage function, used to receive / send buffers to the neighbouring stages.
+struct PipelineStage final {
+    // pops the next buffer from the previous stage.
+    // the buffer will be empty if the previous stage has finished.
+    Result Pop(PoolVector& buf, s64& off);
+    Result Pop(PoolVector& buf) {
+        s64 off;
+        return Pop(buf, off);
+    }
+
+    // pushes the buffer onto the next stage, buf is swapped with a free buffer.
+    Result Push(PoolVector& buf, s64 off = 0);
+
+    // returns the first error of any stage, or if the transfer was cancelled.
+    Result GetResults() const;
+
+    // wakes up the thread waiting on the pipeline to update the progress.
+    void SignalProgress();
+
+    auto GetBufferSize() const -> u64;
+
+    auto GetProfile() -> StageProfile& {
+        return m_profile;
+    }
+
+    auto GetName() const -> const char* {
+        return m_name;
+    }
+
+private:
+    friend Pipeline;
+    using StageFunc = std::function<Result(PipelineStage& stage)>;
+
+    PipelineStage(Pipeline* pipeline, const char* name, const StageFunc& func)
+    : m_pipeline{pipeline}, m_name{name}, m_func{func} {}
+
+    Pipeline* const m_pipeline;
+    const char* const m_name;
+    const StageFunc m_func;
+
+    PipelineQueue* m_input{};
+    PipelineQueue* m_output{};
+    StageProfile m_profile{};
+
+    Thread m_thread{};
+    bool m_created{};
+    bool m_started{};
+};
+
+struct PipelineConfig {
+    // number of buffers that can be queued between each stage.
+    // deeper queues absorb bursty sources (network, usb) at the cost of memory.
+    u32 queue_depth{4};
+    // max depth that SetQueueDepth() can set, defaults to queue_depth.
+    u32 max_queue_depth{};
+    // max size of the buffer each stage works on.
+    u64 buffer_size{1024*1024*4};
+    // stack size of each stage thread.
+    u64 stack_size{1024*128};
+};
+
+// runs each stage on its own thread, with each stage connected to the next by a queue.
+// this replaces the read / decompress / write threads that used to be duplicated
+// in thread::Transfer and yati.
+//
+// usage:
+// - AddStage() for every stage, in order (ie, read, decompress, write).
+// - Create() to create the threads.
+// - Start() to start the threads.
+// - Wait() to wait for all stages to finish, or Pull() the output of the last stage.
+struct Pipeline final {
+    using StageFunc = PipelineStage::StageFunc;
+    using ProgressCallback = std::function<void()>;
+
+    Pipeline(ui::ProgressBox* pbox, const PipelineConfig& config);
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    void operator=(const Pipeline&) = delete;
+
+    // stages are connected in the order they are added.
+    void AddStage(const char* name, const StageFunc& func);
+
+    // creates all stage threads and queues.
+    // if pull is set, the output of the last stage is read via Pull().
+    Result Create(bool pull = false);
+    // starts all stage threads.
+    Result Start();
+
+    // waits for all stages to finish, calling the callback whenever a stage signals progress.
+    // returns the first error of any stage.
+    Result Wait(const ProgressCallback& callback);
+    // waits for all stage threads to exit, returns the first error of any stage.
+    Result Join();
+
+    // reads the output of the last stage, only valid if created with pull.
+    // bytes_read will be 0 once the last stage has finished.
+    Result Pull(void* data, s64 size, u64* bytes_read);
+
+    // fails all stages with rc, this will cause all stages to exit.
+    void Cancel(Result rc);
+    // changes the depth of every queue, can be called whilst running.
+    void SetQueueDepth(u32 depth);
+    Result GetResults() const;
+
+    auto GetConfig() const -> const PipelineConfig& {
+        return m_config;
+    }
+
+    // logs how long each stage was busy vs idle, along with the buffer pool usage.
+    void LogProfile() const;
+
+private:
+    friend PipelineStage;
+
+    void OnStageExit(PipelineStage& stage, Result rc);
+    static void thread_func(void* arg);
+
+private:
+    ui::ProgressBox* const m_pbox;
+    const PipelineConfig m_config;
+
+    std::vector<std::unique_ptr<PipelineStage>> m_stages{};
+    std::vector<std::unique_ptr<PipelineQueue>> m_queues{};
+    PipelineQueue* m_pull_queue{};
+
+    PooledBuffer m_pull_buf{};
+    u64 m_pull_offset{};
+
+    UEvent m_uevent_done{};
+    UEvent m_uevent_progress{};
+
+    std::atomic<Result> m_result{};
+    std::atomic<u32> m_running{};
+};
+
+} // namespace sphaira::utils
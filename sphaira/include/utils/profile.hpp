@@ -2,6 +2,7 @@
 
 #include "ui/types.hpp"
 #include "log.hpp"
+#include <algorithm>
 
 namespace sphaira::utils {
 
@@ -25,4 +26,43 @@ private:
 
 #define SCOPED_TIMESTAMP(name) sphaira::utils::ScopedTimestampProfile ANONYMOUS_VARIABLE(SCOPE_PROFILE_STATE_){name};
 
+// tracks how long a threaded stage (read, decompress, write etc) spent working
+// vs waiting on another stage, used to find which stage limits the transfer speed.
+// only the stage thread updates this, it's safe to read once the thread has exited.
+struct StageProfile final {
+    void Start() {
+        m_ts.Update();
+        m_idle_ns = 0;
+        m_total_ns = 0;
+    }
+
+    void Stop() {
+        m_total_ns = m_ts.GetNs();
+    }
+
+    void AddIdle(u64 ns) {
+        m_idle_ns += ns;
+    }
+
+    auto GetIdleMsD() const -> double {
+        return m_idle_ns / 1000.0 / 1000.0;
+    }
+
+    auto GetBusyMsD() const -> double {
+        return (m_total_ns - std::min(m_idle_ns, m_total_ns)) / 1000.0 / 1000.0;
+    }
+
+    void Log(const char* name) const {
+        const auto busy = GetBusyMsD();
+        const auto idle = GetIdleMsD();
+        const auto total = busy + idle;
+        log_write("\t[%s] busy: %.2fms idle: %.2fms (%.1f%% busy)\n", name, busy, idle, total ? busy / total * 100.0 : 0.0);
+    }
+
+private:
+    TimeStamp m_ts{};
+    u64 m_idle_ns{};
+    u64 m_total_ns{};
+};
+
 } // namespace sphaira::utils
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+
+namespace sphaira::utils {
+
+// fixed capacity lock-free single-producer / single-consumer byte ring buffer.
+// one thread may write and one thread may read at the same time without a lock.
+// the peek / commit apis hand out the contiguous region directly, so data can be
+// produced into or consumed from the buffer without an extra copy.
+// blocking (waiting for data / space) is left to the caller.
+struct SpscRingBuffer final {
+    using u8 = std::uint8_t;
+
+    // capacity is rounded up to a power of 2.
+    explicit SpscRingBuffer(std::size_t capacity) {
+        m_capacity = std::bit_ceil(std::max<std::size_t>(capacity, 1));
+        m_mask = m_capacity - 1;
+        m_data = std::make_unique<u8[]>(m_capacity);
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    void operator=(const SpscRingBuffer&) = delete;
+
+    auto Capacity() const -> std::size_t {
+        return m_capacity;
+    }
+
+    // only exact when called from the producer or consumer thread.
+    auto Size() const -> std::size_t {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    auto IsEmpty() const -> bool {
+        return !Size();
+    }
+
+    auto IsFull() const -> bool {
+        return Size() == m_capacity;
+    }
+
+    // producer: returns the contiguous free region, may be smaller than the total free space
+    // if the region wraps around the end of the buffer.
+    auto PeekWrite() -> std::span<u8> {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        const auto tail = m_tail.load(std::memory_order_acquire);
+        const auto offset = head & m_mask;
+        const auto size = std::min(m_capacity - (head - tail), m_capacity - offset);
+        return {m_data.get() + offset, size};
+    }
+
+    // producer: publishes size bytes written to the region returned by PeekWrite().
+    void CommitWrite(std::size_t size) {
+        m_head.store(m_head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+
+    // consumer: returns the contiguous readable region.
+    auto PeekRead() const -> std::span<const u8> {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        const auto head = m_head.load(std::memory_order_acquire);
+        const auto offset = tail & m_mask;
+        const auto size = std::min(head - tail, m_capacity - offset);
+        return {m_data.get() + offset, size};
+    }
+
+    // consumer: releases size bytes of the region returned by PeekRead().
+    void CommitRead(std::size_t size) {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+
+    // producer: copies in as much as fits, returns the number of bytes written.
+    auto Write(const void* _buf, std::size_t size) -> std::size_t {
+        auto buf = static_cast<const u8*>(_buf);
+        std::size_t written{};
+
+        // at most 2 regions, before and after the wrap.
+        for (int i = 0; i < 2 && size; i++) {
+            const auto region = PeekWrite();
+            const auto wsize = std::min(size, region.size());
+            if (!wsize) {
+                break;
+            }
+
+            std::memcpy(region.data(), buf + written, wsize);
+            CommitWrite(wsize);
+            written += wsize;
+            size -= wsize;
+        }
+
+        return written;
+    }
+
+    // consumer: copies out as much as is available, returns the number of bytes read.
+    auto Read(void* _buf, std::size_t size) -> std::size_t {
+        auto buf = static_cast<u8*>(_buf);
+        std::size_t read{};
+
+        for (int i = 0; i < 2 && size; i++) {
+            const auto region = PeekRead();
+            const auto rsize = std::min(size, region.size());
+            if (!rsize) {
+                break;
+            }
+
+            std::memcpy(buf + read, region.data(), rsize);
+            CommitRead(rsize);
+            read += rsize;
+            size -= rsize;
+        }
+
+        return read;
+    }
+
+    // consumer: discards up to size bytes without copying, returns the number of bytes skipped.
+    auto Skip(std::size_t size) -> std::size_t {
+        const auto skipped = std::min(size, Size());
+        CommitRead(skipped);
+        return skipped;
+    }
+
+private:
+    std::unique_ptr<u8[]> m_data{};
+    std::size_t m_capacity{};
+    std::size_t m_mask{};
+    // head is only written by the producer, tail only by the consumer.
+    // kept on separate cache lines so that the two threads don't false share.
+    alignas(64) std::atomic<std::size_t> m_head{};
+    alignas(64) std::atomic<std::size_t> m_tail{};
+};
+
+} // namespace sphaira::utils
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <switch.h>
+#include <sys/types.h>
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <vector>
+
+namespace sphaira::utils {
+
+// pipelined reads / writes for a libssh2 sftp handle.
+// libssh2 has no api to queue sftp requests directly, however it already
+// pipelines inside of a single call:
+// - a read splits the size asked for into ~30KiB requests and keeps up to 4x
+//   that size in flight, the requests are carried over to the next read and
+//   are thrown away on seek.
+// - a write sends every ~30KiB request for the buffer before waiting on the
+//   replies.
+// so the number of requests in flight is set by how large each call is.
+// small reads are served from a read_size buffer which is refilled with a
+// single large read, and small writes are joined into write_size requests.
+// reads that aren't sequential throw away the buffer and seek, which also
+// throws away the requests libssh2 has in flight.
+// the session is not thread safe, the caller must hold the same lock
+// that is used for every other call on the session.
+struct SftpPipeline final {
+    SftpPipeline(LIBSSH2_SFTP_HANDLE* fd, size_t read_size, size_t write_size);
+
+    SftpPipeline(const SftpPipeline&) = delete;
+    void operator=(const SftpPipeline&) = delete;
+
+    // returns the number of bytes read, 0 at the end of the file or a negative errno.
+    ssize_t Read(void* buf, u64 off, size_t len);
+    // returns len or a negative errno.
+    ssize_t Write(const void* buf, u64 off, size_t len);
+    // sends the joined writes, returns 0 or a negative errno.
+    int Flush();
+
+private:
+    void Seek(u64 off);
+    ssize_t WriteAll(const u8* buf, size_t len);
+
+private:
+    LIBSSH2_SFTP_HANDLE* const m_fd;
+    const size_t m_read_size;
+    const size_t m_write_size;
+    // offset of the libssh2 handle.
+    u64 m_handle_off{};
+
+    std::vector<u8> m_read_buf{};
+    u64 m_read_off{};
+    std::vector<u8> m_write_buf{};
+    u64 m_write_off{};
+};
+
+} // namespace sphaira::utils
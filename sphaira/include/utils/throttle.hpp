@@ -0,0 +1,42 @@
+#pragma once
+
+#include <switch.h>
+
+namespace sphaira::utils {
+
+// token bucket rate limiter.
+// tokens (bytes) refill at rate bytes per second, up to burst bytes.
+// each io charges the number of bytes it transferred, if the bucket runs dry
+// the caller sleeps until enough tokens have refilled.
+// as tokens refill whilst the io is in progress, slow io is not slept further,
+// and small io (ie, nca headers) only sleeps for as long as its size costs.
+struct TokenBucket final {
+    TokenBucket(u64 rate, u64 burst);
+
+    // rate of 0 disables throttling.
+    void SetBudget(u64 rate, u64 burst);
+    // blocks until the budget allows for bytes.
+    void Charge(u64 bytes);
+
+    // total time that callers have been slept for.
+    auto GetThrottledNs() const -> u64 {
+        return m_throttled_ns;
+    }
+
+private:
+    Mutex m_mutex{};
+    u64 m_rate{};
+    u64 m_burst{};
+    double m_tokens{};
+    u64 m_last_tick{};
+    u64 m_throttled_ns{};
+};
+
+// shared budget for all io to the sd card when using file based emummc,
+// as the emummc lives on the same sd card, hammering it starves the system.
+void SetEmummcThrottleBudget(u64 rate, u64 burst);
+// charges the emummc budget whilst using file based emummc.
+// a copy charges each chunk once, rather than for both the read and the write.
+void ThrottleEmummc(u64 bytes);
+
+} // namespace sphaira::utils
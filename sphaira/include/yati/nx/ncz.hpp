@@ -7,6 +7,8 @@
 #include <switch.h>
 #include <vector>
 #include <memory>
+#include <deque>
+#include <unordered_map>
 #include <zstd.h>
 
 namespace sphaira::ncz {
@@ -73,22 +75,38 @@ struct Section {
 };
 using Sections = std::vector<Section>;
 
+struct NczBlockReaderConfig {
+    // max size of the decompressed block cache.
+    u64 cache_size{1024*1024*32};
+    // number of blocks to decompress ahead of time once sequential reads are detected.
+    u32 readahead_blocks{2};
+};
+
 struct NczBlockReader final : yati::source::Base {
-    explicit NczBlockReader(const Header& header, const Sections& sections, const BlockHeader& block_header, const Blocks& blocks, u64 offset, const std::shared_ptr<yati::source::Base>& source);
+    explicit NczBlockReader(const Header& header, const Sections& sections, const BlockHeader& block_header, const Blocks& blocks, u64 offset, const std::shared_ptr<yati::source::Base>& source, const NczBlockReaderConfig& config = {});
+    ~NczBlockReader();
+
     Result Read(void *_buf, s64 off, s64 size, u64* bytes_read) override;
 
 private:
     struct LruData {
-        s64 offset{};
+        u32 block_id{};
         std::vector<u8> data{};
-
-        auto InRange(u64 off) const -> bool {
-            return off < offset + data.size() && off >= offset;
-        }
     };
 
 private:
-    Result ReadInternal(void *_buf, s64 off, s64 size, u64* bytes_read, bool decrypt);
+    // reads and decompresses the block into out.
+    Result ReadBlock(u32 block_id, std::vector<u8>& out);
+    // swaps the data into the oldest cache entry, must be called with the mutex held.
+    auto CacheInsert(u32 block_id, std::vector<u8>& data) -> LruData*;
+    auto IsInFlight(u32 block_id) const -> bool;
+    // queues the next blocks onto the readahead thread, must be called with the mutex held.
+    void QueueReadahead(u32 block_id);
+
+    void ThreadFunc();
+    static void thread_func(void* arg) {
+        static_cast<NczBlockReader*>(arg)->ThreadFunc();
+    }
 
 private:
     const Header m_header;
@@ -101,9 +119,30 @@ private:
     u32 m_block_size{};
     std::vector<BlockInfo> m_block_infos{};
 
-    // lru cache of blocks
+    // lru cache of blocks, indexed by block id.
     std::vector<LruData> m_lru_data{};
     utils::Lru<LruData> m_lru{};
+    std::unordered_map<u32, LruData*> m_lru_index{};
+
+    // protects the cache and readahead queue.
+    Mutex m_mutex{};
+    // serialises reads from the source as it may not be thread safe.
+    Mutex m_source_mutex{};
+    CondVar m_can_readahead{};
+    CondVar m_block_ready{};
+
+    // sequential access detection.
+    u32 m_readahead_blocks{};
+    s64 m_last_block_id{-1};
+    u32 m_sequential_count{};
+
+    // blocks waiting to be read ahead, and the block being read ahead.
+    std::deque<u32> m_readahead_queue{};
+    s64 m_readahead_block_id{-1};
+
+    Thread m_thread{};
+    bool m_thread_started{};
+    bool m_quit{};
 };
 
 } // namespace sphaira::ncz
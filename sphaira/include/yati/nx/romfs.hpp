@@ -0,0 +1,20 @@
+#pragma once
+
+#include <switch.h>
+#include <string_view>
+
+namespace sphaira::romfs {
+
+// hash of a dir / file name within its parent dir, used to index the romfs hash tables.
+// used both when building a romfs and when looking up paths in one, so they must match.
+inline auto CalcPathHash(u32 parent, std::string_view name) -> u32 {
+    u32 hash = parent ^ 123456789;
+    for (const auto c : name) {
+        hash = (hash >> 5) | (hash << 27);
+        hash ^= (u8)c;
+    }
+
+    return hash;
+}
+
+} // namespace sphaira::romfs
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "defines.hpp"
 #include <vector>
+#include <algorithm>
 #include <switch.h>
 
 namespace sphaira::yati::source {
@@ -15,10 +17,29 @@ struct Base {
         return Read(buf, off, size, &bytes_read);
     }
 
+    // discards size bytes at off, used to step over data that isn't needed
+    // on stream sources. the default reads the data in chunks and drops it.
+    virtual Result Skip(s64 off, s64 size) {
+        std::vector<u8> temp_buf(std::min<s64>(size, 1024 * 1024));
+        while (size > 0) {
+            const auto rsize = std::min<s64>(size, temp_buf.size());
+            R_TRY(Read2(temp_buf.data(), off, rsize));
+            off += rsize;
+            size -= rsize;
+        }
+        R_SUCCEED();
+    }
+
     virtual bool IsStream() const {
         return false;
     }
 
+    // set if reads at any offset are cheap, in which case the ncas
+    // are installed on several lanes at once.
+    virtual bool HasCheapRandomAccess() const {
+        return !IsStream();
+    }
+
     virtual void SignalCancel() {
 
     }
@@ -12,6 +12,12 @@ struct File final : Base {
     Result Read(void* buf, s64 off, s64 size, u64* bytes_read) override;
     Result GetSize(s64* out);
 
+    // only native storage, devoptab mounts are usually network backed, where
+    // each seek drops the read ahead and the device lock serialises reads anyway.
+    bool HasCheapRandomAccess() const override {
+        return m_fs->IsNative();
+    }
+
 private:
     fs::Fs* m_fs{};
     fs::File m_file{};
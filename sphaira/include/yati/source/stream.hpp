@@ -11,8 +11,11 @@ namespace sphaira::yati::source {
 struct Stream : Base {
     virtual ~Stream() = default;
     virtual Result ReadChunk(void* buf, s64 size, u64* bytes_read) = 0;
+    // discards size bytes, defaults to reading into a temp buffer.
+    virtual Result SkipChunk(s64 size, u64* bytes_skipped);
 
     Result Read(void* buf, s64 off, s64 size, u64* bytes_read) override;
+    Result Skip(s64 off, s64 size) override;
 
     bool IsStream() const override {
         return true;
@@ -23,6 +23,11 @@ struct Usb final : Base {
         return m_usb->GetFlags() & usb::api::FLAG_STREAM;
     }
 
+    // a read away from the last offset drains and restarts the in-flight window.
+    bool HasCheapRandomAccess() const override {
+        return false;
+    }
+
     Result Read(void* buf, s64 off, s64 size, u64* bytes_read) override {
         return m_usb->Read(buf, off, size, bytes_read);
     }
@@ -13,6 +13,8 @@
 #include "ui/progress_box.hpp"
 #include <memory>
 #include <optional>
+#include <functional>
+#include <span>
 
 namespace sphaira::yati {
 
@@ -63,6 +65,18 @@ struct Config {
     // if mkey is higher than fw version, the game still won't launch
     // as the fw won't have the key to decrypt keak.
     bool lower_system_version{};
+
+    // number of threads used to decompress block compressed ncz.
+    // each block is an independent zstd frame, so they can be decompressed in parallel.
+    // set to 0 to decompress on the decompress thread.
+    u32 ncz_block_threads{};
+
+    // calculates the nca sha256 on its own thread, rather than on the decompress thread.
+    bool hash_thread{};
+
+    // number of ncas installed at once for random access sources.
+    // set to 1 to install them one after another.
+    u32 nca_install_lanes{};
 };
 
 // overridable options, set to avoid
@@ -78,7 +92,12 @@ struct ConfigOverride {
     std::optional<bool> lower_system_version{};
 };
 
+using OnFileInstalled = std::function<void(const fs::FsPath& path)>;
+
 Result InstallFromFile(ui::ProgressBox* pbox, fs::Fs* fs, const fs::FsPath& path, const ConfigOverride& override = {});
+// installs the files one after another sharing the same install context, so the keys
+// and services are only setup once. the next file is opened and parsed whilst the current one installs.
+Result InstallFromFiles(ui::ProgressBox* pbox, fs::Fs* fs, std::span<const fs::FsPath> paths, const OnFileInstalled& on_installed = {}, const ConfigOverride& override = {});
 Result InstallFromSource(ui::ProgressBox* pbox, source::Base* source, const fs::FsPath& path, const ConfigOverride& override = {});
 Result InstallFromContainer(ui::ProgressBox* pbox, container::Base* container, const ConfigOverride& override = {});
 Result InstallFromCollections(ui::ProgressBox* pbox, source::Base* source, const container::Collections& collections, const ConfigOverride& override = {});
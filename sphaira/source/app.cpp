@@ -27,6 +27,8 @@
 #include "utils/profile.hpp"
 #include "utils/thread.hpp"
 #include "utils/devoptab.hpp"
+#include "utils/buffer_pool.hpp"
+#include "utils/throttle.hpp"
 
 #include <nanovg_dk.h>
 #include <minIni.h>
@@ -1500,6 +1502,10 @@ App::App(const char* argv0) {
             else if (app->m_ftp_enabled.LoadFrom(Key, Value)) {}
             else if (app->m_hdd_enabled.LoadFrom(Key, Value)) {}
             else if (app->m_hdd_write_protect.LoadFrom(Key, Value)) {}
+            else if (app->m_download_segments.LoadFrom(Key, Value)) {}
+            else if (app->m_stream_buffer_size.LoadFrom(Key, Value)) {}
+            else if (app->m_zip_seek_span.LoadFrom(Key, Value)) {}
+            else if (app->m_zip_seek_index_save.LoadFrom(Key, Value)) {}
             else if (app->m_log_enabled.LoadFrom(Key, Value)) {}
             else if (app->m_replace_hbmenu.LoadFrom(Key, Value)) {}
             else if (app->m_default_music.LoadFrom(Key, Value)) {}
@@ -1530,6 +1536,13 @@ App::App(const char* argv0) {
             else if (app->m_convert_to_standard_crypto.LoadFrom(Key, Value)) {}
             else if (app->m_lower_master_key.LoadFrom(Key, Value)) {}
             else if (app->m_lower_system_version.LoadFrom(Key, Value)) {}
+            else if (app->m_ncz_block_threads.LoadFrom(Key, Value)) {}
+            else if (app->m_hash_thread.LoadFrom(Key, Value)) {}
+            else if (app->m_nca_install_lanes.LoadFrom(Key, Value)) {}
+            else if (app->m_ncz_cache_size.LoadFrom(Key, Value)) {}
+            else if (app->m_ncz_readahead_blocks.LoadFrom(Key, Value)) {}
+            else if (app->m_emummc_throttle_rate.LoadFrom(Key, Value)) {}
+            else if (app->m_emummc_throttle_burst.LoadFrom(Key, Value)) {}
         } else if (!std::strcmp(Section, "accessibility")) {
             if (app->m_text_scroll_speed.LoadFrom(Key, Value)) {}
         } else if (!std::strcmp(Section, "dump")) {
@@ -1591,6 +1604,11 @@ App::App(const char* argv0) {
         log_write("hello world v%s\n", APP_DISPLAY_VERSION);
     }
 
+    // applet mode has far less memory, so keep fewer transfer buffers cached.
+    if (IsApplet()) {
+        utils::BufferPool::SetMaxCachedSize(1024 * 1024 * 16);
+    }
+
     // anything that can be async loaded should be placed in here in order
     // to halve load times.
     // rules:
@@ -1662,6 +1680,13 @@ App::App(const char* argv0) {
                 log_write("[emummc] file based path: %s\n", m_emummc_paths.file_based_path);
                 log_write("[emummc] nintendo path: %s\n", m_emummc_paths.nintendo);
             }
+
+            if (App::IsFileBaseEmummc()) {
+                const auto rate = std::max(0L, m_emummc_throttle_rate.Get()) * 1024 * 1024;
+                const auto burst = std::max(0L, m_emummc_throttle_burst.Get()) * 1024;
+                log_write("[emummc] throttle rate: %ld MiB/s burst: %ld KiB\n", m_emummc_throttle_rate.Get(), m_emummc_throttle_burst.Get());
+                utils::SetEmummcThrottleBudget(rate, burst);
+            }
         }
 
         devoptab::FixDkpBug();
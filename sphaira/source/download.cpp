@@ -1,10 +1,12 @@
 #include "download.hpp"
+#include "download_segment.hpp"
 #include "log.hpp"
 #include "defines.hpp"
 #include "evman.hpp"
 #include "fs.hpp"
 #include "app.hpp"
 #include "utils/thread.hpp"
+#include "utils/buffer_pool.hpp"
 
 #include <switch.h>
 #include <cstring>
@@ -261,6 +263,9 @@ private:
     u32 m_init_ref_count{};
 };
 
+struct SegmentedDownload;
+void SegmentWorker(CURL* curl, SegmentedDownload* job);
+
 struct ThreadEntry {
     auto Create() -> Result {
         m_curl = curl_easy_init();
@@ -305,12 +310,33 @@ struct ThreadEntry {
         return true;
     }
 
+    // claims the thread to help download segments, fails if the thread is busy.
+    auto SetupSegmented(SegmentedDownload* job) -> bool {
+        SCOPED_MUTEX(&m_mutex);
+
+        if (!g_running || m_closed || m_in_progress) {
+            return false;
+        }
+
+        m_segmented = job;
+        m_in_progress = true;
+        ueventSignal(&m_uevent);
+        return true;
+    }
+
+    auto TakeSegmented() -> SegmentedDownload* {
+        SCOPED_MUTEX(&m_mutex);
+        return std::exchange(m_segmented, nullptr);
+    }
+
     static void ThreadFunc(void* p);
 
     CURL* m_curl{};
     Thread m_thread{};
     Api m_api{};
+    SegmentedDownload* m_segmented{};
     std::atomic_bool m_in_progress{};
+    bool m_closed{};
     Mutex m_mutex{};
     UEvent m_uevent{};
 };
@@ -611,6 +637,30 @@ auto EncodeUrl(const std::string& url) -> std::string {
     return out;
 }
 
+auto CreateHeaderList(const Header& header) -> curl_slist* {
+    struct curl_slist* list = NULL;
+
+    for (const auto& [key, value] : header.m_map) {
+        if (value.empty()) {
+            continue;
+        }
+
+        // create header key value pair.
+        const auto header_str = key + ": " + value;
+
+        // try to append header chunk.
+        auto temp = curl_slist_append(list, header_str.c_str());
+        if (temp) {
+            log_write("adding header: %s\n", header_str.c_str());
+            list = temp;
+        } else {
+            log_write("failed to append header\n");
+        }
+    }
+
+    return list;
+}
+
 void SetCommonCurlOptions(CURL* curl, const Api& e) {
     CURL_EASY_SETOPT_LOG(curl, CURLOPT_USERAGENT, API_AGENT);
     CURL_EASY_SETOPT_LOG(curl, CURLOPT_FOLLOWLOCATION, 1L);
@@ -680,6 +730,520 @@ void SetCommonCurlOptions(CURL* curl, const Api& e) {
     }
 
 }
+
+using segment::Segment;
+
+// progress is saved every N bytes, so that little is lost on a crash.
+constexpr s64 SEGMENT_SAVE_INTERVAL = 1024 * 1024 * 16;
+// a dropped connection is retried from where it left off.
+constexpr u32 SEGMENT_RETRY_MAX = 3;
+
+struct SegmentedDownload {
+    auto Claim() -> Segment* {
+        SCOPED_MUTEX(&mutex);
+
+        if (!g_running || failed) {
+            return nullptr;
+        }
+
+        for (auto& seg : segments) {
+            if (!seg.active && seg.done < seg.size) {
+                seg.active = true;
+                return &seg;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void Release(Segment& seg, bool ok, long code) {
+        SCOPED_MUTEX(&mutex);
+        seg.active = false;
+        if (!ok && !failed) {
+            failed = true;
+            http_code = segment::GetFailedCode(code);
+        }
+    }
+
+    void OnWritten(Segment& seg, s64 size) {
+        SCOPED_MUTEX(&mutex);
+        seg.done += size;
+        written += size;
+
+        if (written - saved >= SEGMENT_SAVE_INTERVAL) {
+            SaveRecord();
+        }
+    }
+
+    // must be called with the mutex locked.
+    void SaveRecord() {
+        if (!resumable) {
+            return;
+        }
+
+        const auto buf = segment::SaveRecord(record, segments);
+        if (R_FAILED(record_file.Write(0, buf.data(), buf.size(), FsWriteOption_None))) {
+            log_write("[CURL] failed to save segment record\n");
+        }
+
+        saved = written;
+    }
+
+    const Api* api{};
+    // the url after redirects, so that each segment skips them.
+    std::string url{};
+    Header header{};
+    fs::File f{};
+    fs::File record_file{};
+    segment::RecordHeader record{};
+    std::vector<Segment> segments{};
+    bool resumable{};
+
+    Mutex mutex{};
+    CondVar cond{};
+    // number of helper threads still running.
+    u32 workers{};
+    s64 written{};
+    s64 saved{};
+    // includes data that is buffered but not yet written, used for progress.
+    std::atomic<s64> received{};
+    std::atomic_bool failed{};
+    // response code of the first segment that failed, see segment::GetFailedCode().
+    long http_code{};
+    // the server replied with something other than the requested range.
+    std::atomic_bool mismatch{};
+    Mutex progress_mutex{};
+};
+
+struct SegmentTransfer {
+    SegmentedDownload* job{};
+    Segment* seg{};
+    CURL* curl{};
+    utils::PooledBuffer buf{};
+    s64 buffered{};
+    bool checked{};
+};
+
+auto SegmentWrite(SegmentTransfer* t, const void* data, s64 size) -> bool {
+    auto& seg = *t->seg;
+    if (R_FAILED(t->job->f.Write(seg.offset + seg.done, data, size, FsWriteOption_None))) {
+        log_write("[CURL] failed to write segment at: %zd\n", seg.offset + seg.done);
+        return false;
+    }
+
+    t->job->OnWritten(seg, size);
+    return true;
+}
+
+auto SegmentFlush(SegmentTransfer* t) -> bool {
+    if (!t->buffered) {
+        return true;
+    }
+
+    if (!SegmentWrite(t, t->buf->data(), t->buffered)) {
+        return false;
+    }
+
+    t->buffered = 0;
+    return true;
+}
+
+auto SegmentWriteCallback(void *contents, size_t size, size_t num_files, void *userp) -> size_t {
+    if (!g_running) {
+        return 0;
+    }
+
+    auto t = static_cast<SegmentTransfer*>(userp);
+    const auto realsize = size * num_files;
+
+    // the server must reply with the range, otherwise the file changed
+    // on the server (if-range failed) or the range was ignored.
+    if (!t->checked) {
+        long http_code = 0;
+        curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_code);
+        if (http_code != 206) {
+            log_write("[CURL] segment expected 206, got: %ld\n", http_code);
+            t->job->mismatch = true;
+            return 0;
+        }
+        t->checked = true;
+    }
+
+    // never write past the end of the segment.
+    if (!segment::FitsInSegment(*t->seg, t->buffered, realsize)) {
+        log_write("[CURL] segment received more data than requested\n");
+        t->job->mismatch = true;
+        return 0;
+    }
+
+    // flush data if incomming data would overflow the buffer
+    if (t->buffered && t->buffered + realsize > t->buf->size()) {
+        if (!SegmentFlush(t)) {
+            return 0;
+        }
+    }
+
+    // we have a huge chunk! write it directly to file
+    if (t->buf->size() < realsize) {
+        if (!SegmentWrite(t, contents, realsize)) {
+            return 0;
+        }
+    } else {
+        std::memcpy(t->buf->data() + t->buffered, contents, realsize);
+        t->buffered += realsize;
+    }
+
+    t->job->received += realsize;
+    Yield();
+    return realsize;
+}
+
+auto SegmentProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) -> int {
+    auto t = static_cast<SegmentTransfer*>(clientp);
+    auto job = t->job;
+
+    if (!g_running || job->failed || job->mismatch || job->api->GetToken().stop_requested()) {
+        return 1;
+    }
+
+    // report the progress of the whole file rather than the segment.
+    if (job->api->GetOnProgress()) {
+        SCOPED_MUTEX(&job->progress_mutex);
+        if (!job->api->GetOnProgress()(job->record.total, job->received, 0, 0)) {
+            job->failed = true;
+            return 1;
+        }
+    }
+
+    Yield();
+    return 0;
+}
+
+auto DownloadSegment(CURL* curl, SegmentedDownload* job, Segment& seg, long* http_code) -> bool {
+    auto list = CreateHeaderList(job->header);
+    ON_SCOPE_EXIT(if (list) { curl_slist_free_all(list); } );
+
+    for (u32 attempt = 0;; attempt++) {
+        SegmentTransfer t{job, &seg, curl, utils::PooledBuffer{CHUNK_SIZE}};
+        t.buf->resize(CHUNK_SIZE);
+
+        char range[64];
+        std::snprintf(range, sizeof(range), "%ld-%ld", seg.offset + seg.done, seg.offset + seg.size - 1);
+
+        curl_easy_reset(curl);
+        SetCommonCurlOptions(curl, *job->api);
+
+        // the range is an offset into the file, so it must not be compressed.
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_ACCEPT_ENCODING, nullptr);
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_URL, job->url.c_str());
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_RANGE, range);
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_XFERINFODATA, &t);
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_XFERINFOFUNCTION, SegmentProgressCallback);
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_WRITEFUNCTION, SegmentWriteCallback);
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_WRITEDATA, &t);
+
+        if (list) {
+            CURL_EASY_SETOPT_LOG(curl, CURLOPT_HTTPHEADER, list);
+        }
+
+        const auto res = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_code);
+
+        // keep what was received on failure, the retry / resume continues from there.
+        const auto flushed = SegmentFlush(&t);
+        if (res == CURLE_OK && flushed && seg.done == seg.size) {
+            return true;
+        }
+
+        if (!flushed || !g_running || job->failed || job->mismatch || res == CURLE_ABORTED_BY_CALLBACK || attempt + 1 >= SEGMENT_RETRY_MAX) {
+            log_write("[CURL] segment failed at: %zd msg: %s\n", seg.offset + seg.done, curl_easy_strerror(res));
+            return false;
+        }
+
+        log_write("[CURL] retrying segment at: %zd msg: %s\n", seg.offset + seg.done, curl_easy_strerror(res));
+    }
+}
+
+void RunSegments(CURL* curl, SegmentedDownload* job) {
+    while (auto seg = job->Claim()) {
+        long http_code{};
+        const auto ok = DownloadSegment(curl, job, *seg, &http_code);
+        job->Release(*seg, ok, http_code);
+    }
+}
+
+void SegmentWorker(CURL* curl, SegmentedDownload* job) {
+    RunSegments(curl, job);
+
+    // this must be the last access to the job, as the owner frees it
+    // once all the helpers are done.
+    SCOPED_MUTEX(&job->mutex);
+    job->workers--;
+    condvarWakeAll(&job->cond);
+}
+
+auto ProbeWriteCallback(void *contents, size_t size, size_t num_files, void *userp) -> size_t {
+    auto received = static_cast<s64*>(userp);
+    const auto realsize = size * num_files;
+
+    // a server that ignores the range sends the whole file, stop it early.
+    *received += realsize;
+    if (*received > 1) {
+        return 0;
+    }
+
+    return realsize;
+}
+
+auto ProbeProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) -> int {
+    auto api = static_cast<const Api*>(clientp);
+    if (!g_running || api->GetToken().stop_requested()) {
+        return 1;
+    }
+
+    Yield();
+    return 0;
+}
+
+auto LoadSegmentRecord(fs::FsNativeSd& fs, const fs::FsPath& record_path, const fs::FsPath& tmp_path, SegmentedDownload& job) -> bool {
+    fs::File f;
+    if (R_FAILED(fs.OpenFile(record_path, FsOpenMode_Read, &f))) {
+        return false;
+    }
+
+    std::vector<u8> buf(segment::GetRecordSize(job.segments.size()));
+    u64 bytes_read;
+    if (R_FAILED(f.Read(0, buf.data(), buf.size(), FsReadOption_None, &bytes_read)) || bytes_read != buf.size()) {
+        return false;
+    }
+
+    fs::File tmp;
+    s64 tmp_size;
+    if (R_FAILED(fs.OpenFile(tmp_path, FsOpenMode_Read, &tmp)) || R_FAILED(tmp.GetSize(&tmp_size)) || tmp_size != job.record.total) {
+        return false;
+    }
+
+    if (!segment::LoadRecord(buf, job.record, job.segments, &job.written)) {
+        log_write("[CURL] segment record does not match, restarting\n");
+        return false;
+    }
+
+    return true;
+}
+
+// returns false if the server does not support ranges, in which case
+// the file should be downloaded normally.
+auto DownloadSegmented(CURL* curl, const Api& e, const std::string& encoded_url, ApiResult& out) -> bool {
+    fs::FsNativeSd fs;
+    Header header_in = e.GetHeader();
+    Header header_out;
+
+    // only add etag if the dst file still exists.
+    if ((e.GetFlags() & Flag_Cache) && fs::FileExists(&fs.m_fs, e.GetPath())) {
+        g_cache.get(e.GetPath(), header_in);
+    }
+
+    // 1. probe for range support by requesting the first byte.
+    s64 probe_received{};
+    curl_easy_reset(curl);
+    SetCommonCurlOptions(curl, e);
+
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_ACCEPT_ENCODING, nullptr);
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_URL, encoded_url.c_str());
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_RANGE, "0-0");
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_HEADERFUNCTION, header_callback);
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_HEADERDATA, &header_out);
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_XFERINFODATA, &e);
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_XFERINFOFUNCTION, ProbeProgressCallback);
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_WRITEFUNCTION, ProbeWriteCallback);
+    CURL_EASY_SETOPT_LOG(curl, CURLOPT_WRITEDATA, &probe_received);
+
+    auto probe_list = CreateHeaderList(header_in);
+    ON_SCOPE_EXIT(if (probe_list) { curl_slist_free_all(probe_list); } );
+    if (probe_list) {
+        CURL_EASY_SETOPT_LOG(curl, CURLOPT_HTTPHEADER, probe_list);
+    }
+
+    const auto probe_res = curl_easy_perform(curl);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    if (!g_running || e.GetToken().stop_requested()) {
+        out = {};
+        return true;
+    }
+
+    if (probe_res == CURLE_OK && http_code == 304) {
+        log_write("cached download: %s\n", e.GetUrl().c_str());
+        out = {true, http_code, header_out, {}, e.GetPath()};
+        return true;
+    }
+
+    if (probe_res != CURLE_OK || http_code != 206) {
+        log_write("[CURL] range not supported: %s code: %ld %s\n", e.GetUrl().c_str(), http_code, curl_easy_strerror(probe_res));
+        return false;
+    }
+
+    // Content-Range: bytes 0-0/total
+    s64 total{};
+    if (auto it = header_out.Find("content-range"); it != header_out.m_map.end()) {
+        total = segment::ParseContentRangeTotal(it->second.c_str());
+    }
+
+    if (total < segment::MIN_FILE_SIZE) {
+        log_write("[CURL] not using segments for size: %zd\n", total);
+        return false;
+    }
+
+    char* effective_url{};
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+
+    std::string etag, last_modified;
+    if (auto it = header_out.Find("etag"); it != header_out.m_map.end()) {
+        etag = it->second;
+    }
+    if (auto it = header_out.Find("last-modified"); it != header_out.m_map.end()) {
+        last_modified = it->second;
+    }
+
+    // 2. split the file into segments and resume from the record if it matches.
+    SegmentedDownload job{};
+    job.api = &e;
+    job.url = effective_url ? effective_url : encoded_url;
+    job.header = e.GetHeader();
+    // without a validator there's no way to tell if the file changed between resumes.
+    job.resumable = !etag.empty() || !last_modified.empty();
+
+    // if the file changes mid download, the server replies with 200 rather than 206.
+    // weak etags are not allowed for if-range.
+    if (!etag.empty() && !etag.starts_with("W/")) {
+        job.header.m_map.insert_or_assign("If-Range", etag);
+    } else if (!last_modified.empty()) {
+        job.header.m_map.insert_or_assign("If-Range", last_modified);
+    }
+
+    job.segments = segment::Split(total);
+
+    const auto validator = e.GetUrl() + etag + last_modified;
+    job.record = {
+        .magic = segment::RECORD_MAGIC,
+        .version = segment::RECORD_VERSION,
+        .total = total,
+        .segment_size = segment::GetSegmentSize(total),
+        .segment_count = u32(job.segments.size()),
+        .validator = crc32Calculate(validator.data(), validator.size()),
+    };
+
+    // the temp path is tied to the dst path so that it can be found again on resume.
+    const auto key = generate_key_from_path(e.GetPath());
+    fs::FsPath tmp_path, record_path;
+    std::snprintf(tmp_path, sizeof(tmp_path), "/switch/sphaira/cache/segmented_%s", key.c_str());
+    std::snprintf(record_path, sizeof(record_path), "/switch/sphaira/cache/segmented_%s.progress", key.c_str());
+
+    const auto resumed = job.resumable && LoadSegmentRecord(fs, record_path, tmp_path, job);
+    const auto resumed_size = job.written;
+
+    if (!resumed) {
+        fs.DeleteFile(tmp_path);
+        fs.DeleteFile(record_path);
+        fs.CreateDirectoryRecursivelyWithPath(tmp_path);
+
+        if (R_FAILED(fs.CreateFile(tmp_path, total, 0))) {
+            log_write("failed to create file: %s\n", tmp_path.s);
+            out = {};
+            return true;
+        }
+    }
+
+    if (R_FAILED(fs.OpenFile(tmp_path, FsOpenMode_Write, &job.f))) {
+        log_write("failed to open file: %s\n", tmp_path.s);
+        out = {};
+        return true;
+    }
+
+    if (job.resumable) {
+        fs.CreateFile(record_path, segment::GetRecordSize(job.segments.size()), 0);
+        if (R_FAILED(fs.OpenFile(record_path, FsOpenMode_Write, &job.record_file))) {
+            log_write("failed to open file: %s\n", record_path.s);
+            job.resumable = false;
+        }
+    }
+
+    job.saved = job.written;
+    job.received = job.written;
+
+    // 3. fetch the segments on this thread and any idle download threads.
+    // one thread is left free so that the async queue keeps moving.
+    const auto max_workers = std::clamp<s64>(App::GetApp()->m_download_segments.Get(), 1, MAX_THREADS);
+    const auto idle = std::ranges::count_if(g_threads, [](auto& thread) { return !thread.InProgress(); });
+    const auto max_helpers = std::min<s64>(max_workers - 1, idle - 1);
+
+    u32 helpers{};
+    for (auto& thread : g_threads) {
+        if (helpers >= max_helpers) {
+            break;
+        }
+
+        SCOPED_MUTEX(&job.mutex);
+        job.workers++;
+        if (thread.SetupSegmented(&job)) {
+            helpers++;
+        } else {
+            job.workers--;
+        }
+    }
+
+    log_write("[CURL] segmented download: %s size: %zd segments: %zu helpers: %u resumed: %zd\n", e.GetUrl().c_str(), total, job.segments.size(), helpers, resumed_size);
+
+    const auto start = armGetSystemTick();
+    RunSegments(curl, &job);
+
+    {
+        SCOPED_MUTEX(&job.mutex);
+        while (job.workers) {
+            condvarWait(&job.cond, &job.mutex);
+        }
+    }
+
+    const auto outcome = segment::GetOutcome(job.written, total, job.mismatch, job.resumable);
+    job.f.Close();
+
+    bool success{};
+    if (outcome == segment::Outcome::Complete) {
+        job.record_file.Close();
+        fs.DeleteFile(record_path);
+
+        const auto ns = armTicksToNs(armGetSystemTick() - start);
+        log_write("[CURL] segmented download done: %.2f MiB in %.2fs (%.2f MiB/s)\n",
+            (total - resumed_size) / 1024.0 / 1024.0, ns / 1e+9, (total - resumed_size) / 1024.0 / 1024.0 / (ns / 1e+9));
+
+        if (e.GetFlags() & Flag_Cache) {
+            g_cache.set(e.GetPath(), header_out);
+        }
+
+        fs.DeleteFile(e.GetPath());
+        fs.CreateDirectoryRecursivelyWithPath(e.GetPath());
+        success = R_SUCCEEDED(fs.RenameFile(tmp_path, e.GetPath()));
+        if (!success) {
+            fs.DeleteFile(tmp_path);
+        }
+    } else if (outcome == segment::Outcome::Discard) {
+        log_write("[CURL] segmented download failed, discarding progress\n");
+        job.record_file.Close();
+        fs.DeleteFile(record_path);
+        fs.DeleteFile(tmp_path);
+    } else {
+        SCOPED_MUTEX(&job.mutex);
+        job.SaveRecord();
+        job.record_file.Close();
+        log_write("[CURL] segmented download stopped at: %zd / %zd, saved for resume\n", job.written, total);
+    }
+
+    // the probe's 206 says nothing about how the segments went.
+    out = {success, success ? 200 : job.http_code, header_out, {}, e.GetPath()};
+    return true;
+}
+
 auto DownloadInternal(CURL* curl, const Api& e) -> ApiResult {
     App::SetAutoSleepDisabled(true);
     ON_SCOPE_EXIT(App::SetAutoSleepDisabled(false));
@@ -694,6 +1258,13 @@ auto DownloadInternal(CURL* curl, const Api& e) -> ApiResult {
     const bool has_post = !e.GetFields().empty() && e.GetFields() != "";
     const auto encoded_url = EncodeUrl(e.GetUrl());
 
+    if (has_file && !has_post && (e.GetFlags() & Flag_Segmented) && e.GetCustomRequest().empty()) {
+        ApiResult result{};
+        if (DownloadSegmented(curl, e, encoded_url, result)) {
+            return result;
+        }
+    }
+
     DataStruct chunk;
     Header header_in = e.GetHeader();
     Header header_out;
@@ -734,27 +1305,9 @@ auto DownloadInternal(CURL* curl, const Api& e) -> ApiResult {
         log_write("setting post field: %s\n", e.GetFields().c_str());
     }
 
-    struct curl_slist* list = NULL;
+    auto list = CreateHeaderList(header_in);
     ON_SCOPE_EXIT(if (list) { curl_slist_free_all(list); } );
 
-    for (const auto& [key, value] : header_in.m_map) {
-        if (value.empty()) {
-            continue;
-        }
-
-        // create header key value pair.
-        const auto header_str = key + ": " + value;
-
-        // try to append header chunk.
-        auto temp = curl_slist_append(list, header_str.c_str());
-        if (temp) {
-            log_write("adding header: %s\n", header_str.c_str());
-            list = temp;
-        } else {
-            log_write("failed to append header\n");
-        }
-    }
-
     if (list) {
         CURL_EASY_SETOPT_LOG(curl, CURLOPT_HTTPHEADER, list);
     }
@@ -876,27 +1429,9 @@ auto UploadInternal(CURL* curl, const Api& e) -> ApiResult {
     // instruct libcurl to create ftp folders if they don't yet exist.
     CURL_EASY_SETOPT_LOG(curl, CURLOPT_FTP_CREATE_MISSING_DIRS, CURLFTP_CREATE_DIR_RETRY);
 
-    struct curl_slist* list = NULL;
+    auto list = CreateHeaderList(header_in);
     ON_SCOPE_EXIT(if (list) { curl_slist_free_all(list); } );
 
-    for (const auto& [key, value] : header_in.m_map) {
-        if (value.empty()) {
-            continue;
-        }
-
-        // create header key value pair.
-        const auto header_str = key + ": " + value;
-
-        // try to append header chunk.
-        auto temp = curl_slist_append(list, header_str.c_str());
-        if (temp) {
-            log_write("adding header: %s\n", header_str.c_str());
-            list = temp;
-        } else {
-            log_write("failed to append header\n");
-        }
-    }
-
     if (list) {
         CURL_EASY_SETOPT_LOG(curl, CURLOPT_HTTPHEADER, list);
     }
@@ -959,6 +1494,15 @@ void ThreadEntry::ThreadFunc(void* p) {
     while (g_running) {
         auto rc = waitSingle(waiterForUEvent(&data->m_uevent), UINT64_MAX);
         // log_write("woke up\n");
+
+        // always ran, even on exit, as the owner is waiting for the worker to finish.
+        if (auto job = data->TakeSegmented()) {
+            SegmentWorker(data->m_curl, job);
+            data->m_in_progress = false;
+            ueventSignal(&g_thread_queue.m_uevent);
+            continue;
+        }
+
         if (!g_running) {
             break;
         }
@@ -979,6 +1523,19 @@ void ThreadEntry::ThreadFunc(void* p) {
         // notify the queue that there's a space free
         ueventSignal(&g_thread_queue.m_uevent);
     }
+
+    // handle a job that was claimed whilst exiting.
+    SegmentedDownload* job;
+    {
+        SCOPED_MUTEX(&data->m_mutex);
+        data->m_closed = true;
+        job = std::exchange(data->m_segmented, nullptr);
+    }
+
+    if (job) {
+        SegmentWorker(data->m_curl, job);
+    }
+
     log_write("exited download thread\n");
 }
 
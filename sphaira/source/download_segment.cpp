@@ -0,0 +1,90 @@
+#include "download_segment.hpp"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <bit>
+
+namespace sphaira::curl::segment {
+
+auto GetSegmentSize(s64 total) -> s64 {
+    return std::clamp<s64>(std::bit_ceil<u64>(total / SEGMENT_COUNT_TARGET), SEGMENT_SIZE_MIN, SEGMENT_SIZE_MAX);
+}
+
+auto Split(s64 total) -> std::vector<Segment> {
+    std::vector<Segment> segments;
+    const auto segment_size = GetSegmentSize(total);
+
+    for (s64 off = 0; off < total; off += segment_size) {
+        segments.emplace_back(off, std::min(segment_size, total - off));
+    }
+
+    return segments;
+}
+
+auto ParseContentRangeTotal(const char* content_range) -> s64 {
+    const auto slash = std::strrchr(content_range, '/');
+    if (!slash) {
+        return 0;
+    }
+
+    // "*" is sent when the size isn't known.
+    return std::max<s64>(std::strtoll(slash + 1, nullptr, 10), 0);
+}
+
+auto GetRecordSize(u32 segment_count) -> u64 {
+    return sizeof(RecordHeader) + segment_count * sizeof(s64);
+}
+
+auto SaveRecord(const RecordHeader& record, std::span<const Segment> segments) -> std::vector<u8> {
+    std::vector<u8> buf(GetRecordSize(segments.size()));
+    std::memcpy(buf.data(), &record, sizeof(record));
+
+    for (u32 i = 0; i < segments.size(); i++) {
+        std::memcpy(buf.data() + sizeof(record) + i * sizeof(s64), &segments[i].done, sizeof(s64));
+    }
+
+    return buf;
+}
+
+auto LoadRecord(std::span<const u8> buf, const RecordHeader& record, std::span<Segment> segments, s64* written) -> bool {
+    if (buf.size() != GetRecordSize(segments.size()) || std::memcmp(buf.data(), &record, sizeof(record))) {
+        return false;
+    }
+
+    *written = 0;
+    for (u32 i = 0; i < segments.size(); i++) {
+        auto& seg = segments[i];
+        std::memcpy(&seg.done, buf.data() + sizeof(record) + i * sizeof(s64), sizeof(s64));
+        seg.done = std::clamp<s64>(seg.done, 0, seg.size);
+        *written += seg.done;
+    }
+
+    return true;
+}
+
+auto FitsInSegment(const Segment& seg, s64 pending, s64 size) -> bool {
+    return seg.done + pending + size <= seg.size;
+}
+
+auto GetOutcome(s64 written, s64 total, bool mismatch, bool resumable) -> Outcome {
+    if (written == total) {
+        return Outcome::Complete;
+    }
+
+    if (mismatch || !resumable) {
+        return Outcome::Discard;
+    }
+
+    return Outcome::Resume;
+}
+
+auto GetFailedCode(long http_code) -> long {
+    if (http_code >= 200 && http_code < 300) {
+        return 0;
+    }
+
+    return http_code;
+}
+
+} // namespace sphaira::curl::segment
@@ -7,6 +7,7 @@
 #include "i18n.hpp"
 #include "location.hpp"
 #include "threaded_file_transfer.hpp"
+#include "utils/throttle.hpp"
 
 #include "ui/sidebar.hpp"
 #include "ui/error_box.hpp"
@@ -349,7 +350,7 @@ Result DumpToFile(ui::ProgressBox* pbox, fs::Fs* fs, const fs::FsPath& root, Bas
                     [&](const void* data, s64 off, s64 size) -> Result {
                         const auto rc = write_source->Write(data, off, size);
                         if (is_file_based_emummc) {
-                            svcSleepThread(2e+6); // 2ms
+                            utils::ThrottleEmummc(size);
                         }
                         return rc;
                     }
@@ -1,6 +1,7 @@
 #include "hasher.hpp"
 #include "app.hpp"
 #include "threaded_file_transfer.hpp"
+#include "utils/throttle.hpp"
 #include <mbedtls/md5.h>
 #include <utility>
 
@@ -25,8 +26,8 @@ struct FileSource final : BaseSource {
     Result Read(void* buf, s64 off, s64 size, u64* bytes_read) override {
         R_TRY(m_open_result);
         const auto rc = m_file.Read(off, buf, size, 0, bytes_read);
-        if (m_fs->IsNative() && m_is_file_based_emummc) {
-            svcSleepThread(2e+6); // 2ms
+        if (R_SUCCEEDED(rc) && m_fs->IsNative() && m_is_file_based_emummc) {
+            utils::ThrottleEmummc(*bytes_read);
         }
         return rc;
     }
@@ -1,75 +1,30 @@
 #include "minizip_helper.hpp"
+#include "mmz.hpp"
+#include "defines.hpp"
 #include <minizip/unzip.h>
 #include <minizip/zip.h>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
 
 #include "log.hpp"
 
 namespace sphaira::mz {
 namespace {
 
-// mmz is part of ftpsrv code.
-#define LOCAL_HEADER_SIG 0x4034B50
-#define FILE_HEADER_SIG 0x2014B50
-#define END_RECORD_SIG 0x6054B50
-
-// 30 bytes (0x1E)
-#pragma pack(push,1)
-typedef struct mmz_LocalHeader {
-    uint32_t sig;
-    uint16_t version;
-    uint16_t flags;
-    uint16_t compression;
-    uint16_t modtime;
-    uint16_t moddate;
-    uint32_t crc32;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    uint16_t filename_len;
-    uint16_t extrafield_len;
-} mmz_LocalHeader;
-#pragma pack(pop)
-
-// 46 bytes (0x2E)
-#pragma pack(push,1)
-typedef struct mmz_FileHeader {
-    uint32_t sig;
-    uint16_t version;
-    uint16_t version_needed;
-    uint16_t flags;
-    uint16_t compression;
-    uint16_t modtime;
-    uint16_t moddate;
-    uint32_t crc32;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    uint16_t filename_len;
-    uint16_t extrafield_len;
-    uint16_t filecomment_len;
-    uint16_t disk_start; // wat
-    uint16_t internal_attr; // wat
-    uint32_t external_attr; // wat
-    uint32_t local_hdr_off;
-} mmz_FileHeader;
-#pragma pack(pop)
-
-#pragma pack(push,1)
-typedef struct mmz_EndRecord {
-    uint32_t sig;
-    uint16_t disk_number;
-    uint16_t disk_wcd;
-    uint16_t disk_entries;
-    uint16_t total_entries;
-    uint32_t central_directory_size;
-    uint32_t file_hdr_off;
-    uint16_t comment_len;
-} mmz_EndRecord;
-#pragma pack(pop)
-
-static_assert(sizeof(mmz_LocalHeader) == 0x1E);
-static_assert(sizeof(mmz_FileHeader) == 0x2E);
-static_assert(sizeof(mmz_EndRecord) == 0x16);
+// minizip accepts the year since 1900 or since 1980.
+void GetDosTime(const zip_fileinfo& info, u16& time, u16& date) {
+    const auto& tm = info.tmz_date;
+    auto year = tm.tm_year;
+    if (year >= 1980) {
+        year -= 1980;
+    } else if (year >= 80) {
+        year -= 80;
+    }
+
+    time = (tm.tm_sec / 2) | (tm.tm_min << 5) | (tm.tm_hour << 11);
+    date = tm.tm_mday | ((tm.tm_mon + 1) << 5) | (year << 9);
+}
 
 voidpf minizip_open_file_func_mem(voidpf opaque, const void* filename, int mode) {
     return opaque;
@@ -370,6 +325,229 @@ void FileFuncNative(zlib_filefunc64_def* funcs) {
     *funcs = zlib_filefunc_native;
 }
 
+void ParseZip64Extra(std::span<const u8> extra, u64& uncompressed_size, u64& compressed_size, u64& local_hdr_off) {
+    for (u64 off = 0; off + sizeof(mmz_ExtraHeader) <= extra.size();) {
+        mmz_ExtraHeader field;
+        std::memcpy(&field, extra.data() + off, sizeof(field));
+        off += sizeof(field);
+
+        if (field.id != ZIP64_EXTRA_ID) {
+            off += field.size;
+            continue;
+        }
+
+        const auto end = std::min<u64>(off + field.size, extra.size());
+        const auto read = [&](u64& value) {
+            if (value == ZIP64_MAGIC_32 && off + sizeof(u64) <= end) {
+                std::memcpy(&value, extra.data() + off, sizeof(u64));
+                off += sizeof(u64);
+            }
+        };
+
+        read(uncompressed_size);
+        read(compressed_size);
+        read(local_hdr_off);
+        return;
+    }
+}
+
+StreamWriter::StreamWriter(const WriteCallback& wfunc, u64 flush_size)
+: m_wfunc{wfunc}
+, m_flush_size{flush_size} {
+    m_buf.reserve(m_flush_size);
+}
+
+Result StreamWriter::OpenEntry(const char* name, const zip_fileinfo& info, u16 compression, s64 size_hint) {
+    R_UNLESS(!m_entry_open, Result_ZipOpenNewFileInZip);
+
+    auto& entry = m_entries.emplace_back();
+    entry.name = name;
+    entry.compression = compression;
+    entry.local_hdr_off = m_offset;
+    entry.zip64 = u64(size_hint) >= ZIP64_THRESHOLD;
+    GetDosTime(info, entry.modtime, entry.moddate);
+
+    // the sizes are in the data descriptor, for zip64 the extra field must still
+    // be present so that the reader knows the descriptor uses 64-bit sizes.
+    const mmz_ExtraHeader extra_hdr{ZIP64_EXTRA_ID, sizeof(u64) * 2};
+    const u64 extra[2]{};
+
+    mmz_LocalHeader local_hdr{};
+    local_hdr.sig = LOCAL_HEADER_SIG;
+    local_hdr.version = entry.zip64 ? VERSION_ZIP64 : VERSION_DEFLATE;
+    local_hdr.flags = mmz_Flag_DataDescriptor;
+    local_hdr.compression = compression;
+    local_hdr.modtime = entry.modtime;
+    local_hdr.moddate = entry.moddate;
+    local_hdr.filename_len = entry.name.length();
+    if (entry.zip64) {
+        local_hdr.compressed_size = ZIP64_MAGIC_32;
+        local_hdr.uncompressed_size = ZIP64_MAGIC_32;
+        local_hdr.extrafield_len = sizeof(extra_hdr) + sizeof(extra);
+    }
+
+    R_TRY(Write(&local_hdr, sizeof(local_hdr)));
+    R_TRY(Write(entry.name.data(), entry.name.length()));
+    if (entry.zip64) {
+        R_TRY(Write(&extra_hdr, sizeof(extra_hdr)));
+        R_TRY(Write(extra, sizeof(extra)));
+    }
+
+    m_entry_open = true;
+    R_SUCCEED();
+}
+
+Result StreamWriter::WriteEntry(const void* data, s64 size) {
+    R_UNLESS(m_entry_open, Result_ZipWriteInFileInZip);
+    return Write(data, size);
+}
+
+Result StreamWriter::CloseEntry(u32 crc32, s64 uncompressed_size) {
+    R_UNLESS(m_entry_open, Result_ZipCloseFileInZip);
+    m_entry_open = false;
+
+    auto& entry = m_entries.back();
+    entry.crc32 = crc32;
+    entry.uncompressed_size = uncompressed_size;
+    entry.compressed_size = m_offset - entry.local_hdr_off - sizeof(mmz_LocalHeader) - entry.name.length();
+    if (entry.zip64) {
+        entry.compressed_size -= sizeof(mmz_ExtraHeader) + sizeof(u64) * 2;
+        const mmz_DataDescriptor64 desc{DATA_DESCRIPTOR_SIG, crc32, entry.compressed_size, entry.uncompressed_size};
+        return Write(&desc, sizeof(desc));
+    }
+
+    // the size hint was wrong, the local header can't be changed after the fact.
+    R_UNLESS(entry.compressed_size < ZIP64_MAGIC_32 && entry.uncompressed_size < ZIP64_MAGIC_32, Result_ZipCloseFileInZip);
+    const mmz_DataDescriptor desc{DATA_DESCRIPTOR_SIG, crc32, u32(entry.compressed_size), u32(entry.uncompressed_size)};
+    return Write(&desc, sizeof(desc));
+}
+
+Result StreamWriter::Close(const char* comment) {
+    R_UNLESS(!m_entry_open, Result_ZipCloseFileInZip);
+
+    const u64 central_dir_off = m_offset;
+    for (const auto& entry : m_entries) {
+        // only the values that don't fit are moved to the extra field.
+        u64 extra[3];
+        u16 extra_count{};
+
+        mmz_FileHeader file_hdr{};
+        file_hdr.sig = FILE_HEADER_SIG;
+        file_hdr.flags = mmz_Flag_DataDescriptor;
+        file_hdr.compression = entry.compression;
+        file_hdr.modtime = entry.modtime;
+        file_hdr.moddate = entry.moddate;
+        file_hdr.crc32 = entry.crc32;
+        file_hdr.filename_len = entry.name.length();
+
+        // the sizes of a zip64 entry always go in the extra field, to match the local header.
+        const auto set = [&](u32& field, u64 value, bool force) {
+            if (force || value >= ZIP64_MAGIC_32) {
+                field = ZIP64_MAGIC_32;
+                extra[extra_count++] = value;
+            } else {
+                field = value;
+            }
+        };
+
+        set(file_hdr.uncompressed_size, entry.uncompressed_size, entry.zip64);
+        set(file_hdr.compressed_size, entry.compressed_size, entry.zip64);
+        set(file_hdr.local_hdr_off, entry.local_hdr_off, false);
+
+        const mmz_ExtraHeader extra_hdr{ZIP64_EXTRA_ID, u16(extra_count * sizeof(u64))};
+        if (extra_count) {
+            file_hdr.extrafield_len = sizeof(extra_hdr) + extra_hdr.size;
+        }
+
+        file_hdr.version_needed = extra_count ? VERSION_ZIP64 : VERSION_DEFLATE;
+        file_hdr.version = file_hdr.version_needed;
+
+        R_TRY(Write(&file_hdr, sizeof(file_hdr)));
+        R_TRY(Write(entry.name.data(), entry.name.length()));
+        if (extra_count) {
+            R_TRY(Write(&extra_hdr, sizeof(extra_hdr)));
+            R_TRY(Write(extra, extra_hdr.size));
+        }
+    }
+
+    const u64 central_dir_size = m_offset - central_dir_off;
+    const auto needs_zip64 = m_entries.size() >= ZIP64_MAGIC_16 || central_dir_off >= ZIP64_MAGIC_32 || central_dir_size >= ZIP64_MAGIC_32;
+
+    if (needs_zip64) {
+        const u64 end_record_off = m_offset;
+
+        mmz_Zip64EndRecord end64{};
+        end64.sig = ZIP64_END_RECORD_SIG;
+        end64.record_size = sizeof(end64) - 12;
+        end64.version = VERSION_ZIP64;
+        end64.version_needed = VERSION_ZIP64;
+        end64.disk_entries = m_entries.size();
+        end64.total_entries = m_entries.size();
+        end64.central_directory_size = central_dir_size;
+        end64.file_hdr_off = central_dir_off;
+        R_TRY(Write(&end64, sizeof(end64)));
+
+        mmz_Zip64EndLocator locator{};
+        locator.sig = ZIP64_END_LOCATOR_SIG;
+        locator.end_record_off = end_record_off;
+        locator.total_disks = 1;
+        R_TRY(Write(&locator, sizeof(locator)));
+    }
+
+    const auto comment_len = comment ? std::strlen(comment) : 0;
+
+    mmz_EndRecord end{};
+    end.sig = END_RECORD_SIG;
+    end.disk_entries = std::min<u64>(m_entries.size(), ZIP64_MAGIC_16);
+    end.total_entries = end.disk_entries;
+    end.central_directory_size = std::min<u64>(central_dir_size, ZIP64_MAGIC_32);
+    end.file_hdr_off = std::min<u64>(central_dir_off, ZIP64_MAGIC_32);
+    end.comment_len = comment_len;
+    R_TRY(Write(&end, sizeof(end)));
+    R_TRY(Write(comment, comment_len));
+
+    return Flush();
+}
+
+Result StreamWriter::Write(const void* data, s64 size) {
+    if (!size) {
+        R_SUCCEED();
+    }
+
+    // large writes skip the buffer.
+    if (m_buf.empty() && u64(size) >= m_flush_size) {
+        R_TRY(m_wfunc(data, m_offset, size));
+        m_offset += size;
+        m_flushed_offset = m_offset;
+        R_SUCCEED();
+    }
+
+    auto buf = static_cast<const u8*>(data);
+    while (size) {
+        const auto wsize = std::min<s64>(size, m_flush_size - m_buf.size());
+        m_buf.insert(m_buf.end(), buf, buf + wsize);
+        m_offset += wsize;
+        buf += wsize;
+        size -= wsize;
+
+        if (m_buf.size() >= m_flush_size) {
+            R_TRY(Flush());
+        }
+    }
+
+    R_SUCCEED();
+}
+
+Result StreamWriter::Flush() {
+    if (!m_buf.empty()) {
+        R_TRY(m_wfunc(m_buf.data(), m_flushed_offset, m_buf.size()));
+        m_flushed_offset += m_buf.size();
+        m_buf.clear();
+    }
+
+    R_SUCCEED();
+}
+
 Result PeekFirstFileName(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& name) {
     fs::File file;
     R_TRY(fs->OpenFile(path, fs::OpenMode_ReadBuffered, &file));
@@ -14,6 +14,7 @@
 #include "yati/nx/es.hpp"
 #include "yati/nx/keys.hpp"
 #include "yati/nx/crypto.hpp"
+#include "yati/nx/romfs.hpp"
 
 #include "owo.hpp"
 #include "defines.hpp"
@@ -196,16 +197,6 @@ auto romfs_get_fentry(romfs_file *files, u32 offset) -> romfs_file* {
     return (romfs_file*)((u8*)files + offset);
 }
 
-auto calc_path_hash(u32 parent, const u8 *path, u32 start, u32 path_len) -> u32 {
-    u32 hash = parent ^ 123456789;
-    for (u32 i = 0; i < path_len; i++) {
-        hash = (hash >> 5) | (hash << 27);
-        hash ^= path[start + i];
-    }
-
-    return hash;
-}
-
 auto align(u32 offset, u32 alignment) -> u32 {
     const u32 mask = ~(alignment - 1);
     return (offset + (alignment - 1)) & mask;
@@ -330,7 +321,7 @@ void build_romfs_into_file(const FileEntries& entries, BufHelper& buf) {
         cur_entry->dataSize = (cur_file->size);
 
         const u32 name_size = e.name.length() - 1;
-        const u32 hash = calc_path_hash(cur_file->parent->entry_offset, (const u8 *)e.name.c_str(), 1, name_size);
+        const u32 hash = romfs::CalcPathHash(cur_file->parent->entry_offset, std::string_view{e.name}.substr(1, name_size));
         cur_entry->nextHash = file_hash_table[hash % file_hash_table_entry_count];
         file_hash_table[hash % file_hash_table_entry_count] = (cur_file->entry_offset);
 
@@ -350,7 +341,7 @@ void build_romfs_into_file(const FileEntries& entries, BufHelper& buf) {
         cur_entry->childDir = cur_dir->child == NULL ? ROMFS_ENTRY_EMPTY : cur_dir->child->entry_offset;
         cur_entry->childFile = cur_dir->file == NULL ? ROMFS_ENTRY_EMPTY : cur_dir->file->entry_offset;
 
-        const auto hash = calc_path_hash(0, 0, 0, 0);
+        const auto hash = romfs::CalcPathHash(0, {});
         cur_entry->nextHash = dir_hash_table[hash % dir_hash_table_entry_count];
         dir_hash_table[hash % dir_hash_table_entry_count] = (cur_dir->entry_offset);
 
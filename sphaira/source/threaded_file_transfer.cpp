@@ -3,12 +3,19 @@
 #include "defines.hpp"
 #include "app.hpp"
 #include "minizip_helper.hpp"
+#include "mmz.hpp"
+#include "utils/pipeline.hpp"
 #include "utils/thread.hpp"
 
 #include <vector>
+#include <array>
+#include <string>
+#include <unordered_set>
 #include <algorithm>
 #include <cstring>
 #include <atomic>
+#include <bit>
+#include <cmath>
 #include <minizip/unzip.h>
 #include <minizip/zip.h>
 
@@ -20,634 +27,579 @@ constexpr u64 SMALL_BUFFER_SIZE = 1024 * 512;
 // used for everything else.
 constexpr u64 NORMAL_BUFFER_SIZE = 1024*1024*4;
 
-struct ThreadBuffer {
-    ThreadBuffer() {
-        buf.reserve(NORMAL_BUFFER_SIZE);
-    }
-
-    std::vector<u8> buf;
-    s64 off;
-};
-
-template<std::size_t Size>
-struct RingBuf {
-private:
-    ThreadBuffer buf[Size]{};
-    unsigned r_index{};
-    unsigned w_index{};
-
-    static_assert((sizeof(RingBuf::buf) & (sizeof(RingBuf::buf) - 1)) == 0, "Must be power of 2!");
+// number of buffers that can be queued between each stage.
+constexpr u32 QUEUE_DEPTH = 4;
+
+// chunk size used whilst measuring the speed of each stage in adaptive mode.
+constexpr u64 PROBE_CHUNK_SIZE = 1024 * 512;
+// amount of data to read before tuning.
+constexpr u64 PROBE_SIZE = 1024 * 1024 * 4;
+// min number of timings needed from each stage before tuning.
+constexpr u64 PROBE_MIN_SAMPLES = 4;
+// aim for each chunk to take this long on the slowest stage.
+constexpr u64 TARGET_CHUNK_NS = 1e+8; // 100ms
+constexpr u64 MIN_CHUNK_SIZE = 1024 * 256;
+constexpr u64 MAX_CHUNK_SIZE = 1024 * 1024 * 16;
+constexpr u32 MIN_QUEUE_DEPTH = 2;
+constexpr u32 MAX_QUEUE_DEPTH = 8;
+// max memory used by a transfer, both queued and held by each stage.
+constexpr u64 MAX_INFLIGHT_SIZE = 1024 * 1024 * 64;
+// applet mode has far less memory, the buffer pool is also capped at 16MiB.
+constexpr u64 APPLET_MAX_CHUNK_SIZE = 1024 * 1024 * 4;
+constexpr u64 APPLET_MAX_INFLIGHT_SIZE = 1024 * 1024 * 16;
+
+// files smaller than SMALL_BUFFER_SIZE are extracted on their own thread, each
+// with its own zip handle, so that the open / close of each file overlaps.
+constexpr u32 UNZIP_THREADS = 3;
+// not worth starting the threads for less files than this.
+constexpr u64 UNZIP_PARALLEL_MIN_FILES = 16;
+constexpr u64 UNZIP_PROGRESS_NS = 1e+8 * 2.5; // 250ms
+
+// per-call timings of a stage.
+struct StageTimings {
+    void Add(u64 bytes, u64 ns) {
+        // the first call usually includes opening / seeking, so skip it.
+        if (!skipped_first) {
+            skipped_first = true;
+            return;
+        }
 
-public:
-    void ringbuf_reset() {
-        this->r_index = this->w_index;
+        count++;
+        total_bytes += bytes;
+        total_ns += ns;
+        max_ns = std::max(max_ns, ns);
     }
 
-    unsigned ringbuf_capacity() const {
-        return sizeof(this->buf) / sizeof(this->buf[0]);
+    auto GetBytesPerSecond() const -> double {
+        return total_ns ? total_bytes * 1e+9 / total_ns : 0;
     }
 
-    unsigned ringbuf_size() const {
-        return (this->w_index - this->r_index) % (ringbuf_capacity() * 2U);
+    // how much slower the worst call was compared to the average.
+    auto GetJitter() const -> double {
+        return total_ns ? double(max_ns) * count / total_ns : 1;
     }
 
-    unsigned ringbuf_free() const {
-        return ringbuf_capacity() - ringbuf_size();
-    }
+    u64 count{};
+    u64 total_bytes{};
+    u64 total_ns{};
+    u64 max_ns{};
+    bool skipped_first{};
+};
 
-    void ringbuf_push(std::vector<u8>& buf_in, s64 off_in) {
-        auto& value = this->buf[this->w_index % ringbuf_capacity()];
-        value.off = off_in;
-        std::swap(value.buf, buf_in);
+// measures the read and write speed at the start of a transfer, then picks
+// the chunk size and queue depth to use for the rest of it.
+// - the chunk size is sized so that each chunk takes ~100ms on the slowest stage,
+//   so a fast sd card gets large chunks whereas a slow ftp / smb mount gets small ones.
+// - the queue depth is based on how bursty each stage is, so a network source
+//   with the odd slow request gets a deeper queue to keep the write stage busy.
+struct AdaptiveTuner {
+    AdaptiveTuner(utils::Pipeline& pipeline, bool enabled, bool has_write, u32 queue_count, u32 stage_buffer_count, u64 chunk_size)
+    : m_pipeline{pipeline}
+    , m_queue_count{std::max<u32>(1, queue_count)}
+    , m_stage_buffer_count{stage_buffer_count}
+    , m_has_write{has_write}
+    , m_done{!enabled}
+    , m_chunk_size{enabled ? PROBE_CHUNK_SIZE : chunk_size} {
+        mutexInit(std::addressof(m_mutex));
+    }
+
+    auto GetChunkSize() const -> u64 {
+        return m_chunk_size;
+    }
+
+    void AddRead(u64 bytes, u64 ns) {
+        if (m_done) {
+            return;
+        }
 
-        this->w_index = (this->w_index + 1U) % (ringbuf_capacity() * 2U);
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        m_read.Add(bytes, ns);
+        TryTune();
     }
 
-    void ringbuf_pop(std::vector<u8>& buf_out, s64& off_out) {
-        auto& value = this->buf[this->r_index % ringbuf_capacity()];
-        off_out = value.off;
-        std::swap(value.buf, buf_out);
+    void AddWrite(u64 bytes, u64 ns) {
+        if (m_done) {
+            return;
+        }
 
-        this->r_index = (this->r_index + 1U) % (ringbuf_capacity() * 2U);
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        m_write.Add(bytes, ns);
+        TryTune();
     }
-};
-
-struct ThreadData {
-    ThreadData(ui::ProgressBox* _pbox, s64 size, const ReadCallback& _rfunc, const DecompressCallback& _dfunc, const WriteCallback& _wfunc, u64 buffer_size);
 
-    auto GetResults() volatile -> Result;
-    void WakeAllThreads();
+private:
+    void TryTune() {
+        if (m_done || m_read.total_bytes < PROBE_SIZE || m_read.count < PROBE_MIN_SAMPLES) {
+            return;
+        }
 
-    auto IsAnyRunning() volatile const -> bool {
-        return read_running || decompress_running || write_running;
-    }
+        if (m_has_write && m_write.count < PROBE_MIN_SAMPLES) {
+            return;
+        }
 
-    auto GetReadOffset() volatile const -> s64 {
-        return read_offset;
-    }
+        m_done = true;
 
-    auto GetDecompressOffset() volatile const -> s64 {
-        return decompress_offset;
-    }
+        auto speed = m_read.GetBytesPerSecond();
+        auto jitter = m_read.GetJitter();
+        if (m_has_write) {
+            speed = std::min(speed, m_write.GetBytesPerSecond());
+            jitter = std::max(jitter, m_write.GetJitter());
+        }
 
-    auto GetWriteOffset() volatile const -> s64 {
-        return write_offset;
-    }
+        const auto is_applet = App::IsApplet();
+        const auto max_chunk_size = is_applet ? APPLET_MAX_CHUNK_SIZE : MAX_CHUNK_SIZE;
+        const auto max_inflight_size = is_applet ? APPLET_MAX_INFLIGHT_SIZE : MAX_INFLIGHT_SIZE;
 
-    auto GetWriteSize() const {
-        return write_size;
-    }
+        u64 chunk_size = std::bit_floor(std::max<u64>(1, speed * TARGET_CHUNK_NS / 1e+9));
+        chunk_size = std::clamp(chunk_size, MIN_CHUNK_SIZE, max_chunk_size);
 
-    auto GetDoneEvent() {
-        return &m_uevent_done;
-    }
+        u32 depth = std::clamp<u32>(std::ceil(jitter) + 1, MIN_QUEUE_DEPTH, MAX_QUEUE_DEPTH);
 
-    auto GetReadProgressEvent() {
-        return &m_uevent_read_progress;
-    }
+        // keep the memory in use bounded, trading depth before chunk size.
+        // each stage also holds a chunk whilst working on it, on top of the queued ones.
+        while (chunk_size * (depth * m_queue_count + m_stage_buffer_count) > max_inflight_size) {
+            if (depth > MIN_QUEUE_DEPTH) {
+                depth--;
+            } else if (chunk_size > MIN_CHUNK_SIZE) {
+                chunk_size /= 2;
+            } else {
+                break;
+            }
+        }
 
-    auto GetDecompressProgressEvent() {
-        return &m_uevent_decompress_progress;
-    }
+        log_write("[TRANSFER] adaptive read: %.2f MiB/s jitter: %.2f write: %.2f MiB/s jitter: %.2f\n",
+            m_read.GetBytesPerSecond() / 1024.0 / 1024.0, m_read.GetJitter(),
+            m_write.GetBytesPerSecond() / 1024.0 / 1024.0, m_write.GetJitter());
+        log_write("[TRANSFER] adaptive chunk: %zu KiB depth: %u\n", chunk_size / 1024, depth);
 
-    auto GetWriteProgressEvent() {
-        return &m_uevent_write_progress;
+        m_chunk_size = chunk_size;
+        m_pipeline.SetQueueDepth(depth);
     }
 
-    void SetReadResult(Result result) {
-        read_result = result;
+private:
+    utils::Pipeline& m_pipeline;
+    const u32 m_queue_count;
+    const u32 m_stage_buffer_count;
+    const bool m_has_write;
+
+    Mutex m_mutex{};
+    StageTimings m_read{};
+    StageTimings m_write{};
+    std::atomic_bool m_done;
+    std::atomic<u64> m_chunk_size;
+};
 
-        // wake up decompress thread as it may be waiting on data that never comes.
-        condvarWakeOne(std::addressof(can_decompress));
+Result TransferInternal(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const DecompressCallback& dfunc, const WriteCallback& wfunc, const StartCallback2& sfunc, Mode mode, u64 buffer_size = NORMAL_BUFFER_SIZE) {
+    const auto is_file_based_emummc = App::IsFileBaseEmummc();
 
-        if (R_FAILED(result)) {
-            ueventSignal(GetDoneEvent());
-        }
+    if (is_file_based_emummc) {
+        buffer_size = SMALL_BUFFER_SIZE;
     }
 
-    void SetDecompressResult(Result result) {
-        decompress_result = result;
-
-        // wake up write thread as it may be waiting on data that never comes.
-        condvarWakeOne(std::addressof(can_write));
+    // file based emummc needs small buffers, so don't tune.
+    if (mode == Mode::Adaptive && is_file_based_emummc) {
+        mode = Mode::MultiThreaded;
+    }
 
-        if (R_FAILED(result)) {
-            ueventSignal(GetDoneEvent());
+    if (mode == Mode::Adaptive) {
+        // not worth spinning up threads for a single probe chunk.
+        if (size <= s64(PROBE_CHUNK_SIZE) && !sfunc) {
+            mode = Mode::SingleThreaded;
+        }
+    } else if (mode == Mode::SingleThreadedIfSmaller) {
+        if (size <= buffer_size) {
+            mode = Mode::SingleThreaded;
+        } else {
+            mode = Mode::MultiThreaded;
         }
     }
 
-    void SetWriteResult(Result result) {
-        write_result = result;
+    // single threaded pull buffer is not supported.
+    log_write("checking invalid transfer mode: %u %u\n", mode == Mode::MultiThreaded, !sfunc);
+    R_UNLESS(mode != Mode::SingleThreaded || !sfunc, 0x1);
+    log_write("valid transfer mode\n");
 
-        // wake up decompress thread as it may be waiting on data that never comes.
-        condvarWakeOne(std::addressof(can_decompress_write));
+    // todo: support single threaded pull buffer.
+    if (mode == Mode::SingleThreaded) {
+        utils::PooledBuffer lease{buffer_size};
+        auto& buf = lease.Get();
+        buf.resize(buffer_size);
 
-        ueventSignal(GetDoneEvent());
-    }
+        s64 offset{};
+        while (offset < size) {
+            R_TRY(pbox->ShouldExitResult());
+
+            u64 bytes_read;
+            const auto rsize = std::min<s64>(buf.size(), size - offset);
+            R_TRY(rfunc(buf.data(), offset, rsize, &bytes_read));
+            if (!bytes_read) {
+                break;
+            }
+
+            R_TRY(wfunc(buf.data(), offset, bytes_read));
 
-    void SetPullResult(Result result) {
-        pull_result = result;
-        if (R_FAILED(result)) {
-            ueventSignal(GetDoneEvent());
+            offset += bytes_read;
+            pbox->UpdateTransfer(offset, size);
         }
+
+        R_SUCCEED();
     }
+    else {
+        const auto adaptive = mode == Mode::Adaptive;
+
+        utils::Pipeline pipeline{pbox, {
+            .queue_depth = QUEUE_DEPTH,
+            .max_queue_depth = adaptive ? MAX_QUEUE_DEPTH : QUEUE_DEPTH,
+            .buffer_size = adaptive ? PROBE_CHUNK_SIZE : buffer_size,
+        }};
+
+        // one queue between each stage (the last being the pull queue if set).
+        // the read stage and the writer (or puller) hold a buffer each, decompress holds two.
+        AdaptiveTuner tuner{pipeline, adaptive, !sfunc, dfunc ? 2U : 1U, dfunc ? 4U : 2U, buffer_size};
+        std::atomic<s64> write_offset{};
+
+        // read stage reads all data from the source.
+        pipeline.AddStage("read", [&](utils::PipelineStage& stage) -> Result {
+            utils::PooledBuffer lease{tuner.GetChunkSize()};
+            auto& buf = lease.Get();
+
+            s64 read_offset{};
+            while (read_offset < size && R_SUCCEEDED(stage.GetResults())) {
+                const auto read_size = std::min<s64>(tuner.GetChunkSize(), size - read_offset);
+
+                u64 bytes_read{};
+                buf.resize(read_size);
+                const TimeStamp ts{};
+                R_TRY(rfunc(buf.data(), read_offset, read_size, std::addressof(bytes_read)));
+                if (!bytes_read) {
+                    break;
+                }
 
-    Result Pull(void* data, s64 size, u64* bytes_read);
-    Result readFuncInternal();
-    Result decompressFuncInternal();
-    Result writeFuncInternal();
+                tuner.AddRead(bytes_read, ts.GetNs());
 
-private:
-    Result SetDecompressBuf(std::vector<u8>& buf, s64 off, s64 size);
-    Result GetDecompressBuf(std::vector<u8>& buf_out, s64& off_out);
-    Result SetWriteBuf(std::vector<u8>& buf, s64 size);
-    Result GetWriteBuf(std::vector<u8>& buf_out, s64& off_out);
-    Result SetPullBuf(std::vector<u8>& buf, s64 size);
-    Result GetPullBuf(void* data, s64 size, u64* bytes_read);
+                buf.resize(bytes_read);
+                const auto buffer_offset = read_offset;
+                read_offset += bytes_read;
+                R_TRY(stage.Push(buf, buffer_offset));
+            }
 
-    Result Read(void* buf, s64 size, u64* bytes_read);
+            log_write("finished read thread success!\n");
+            R_SUCCEED();
+        });
+
+        // decompress stage passes the data through dfunc, buffering the output.
+        if (dfunc) {
+            pipeline.AddStage("decompress", [&](utils::PipelineStage& stage) -> Result {
+                utils::PooledBuffer lease{tuner.GetChunkSize()};
+                utils::PooledBuffer temp_lease{tuner.GetChunkSize()};
+                auto& buf = lease.Get();
+                auto& temp_buf = temp_lease.Get();
+
+                while (R_SUCCEEDED(stage.GetResults())) {
+                    s64 decompress_buf_off{};
+                    R_TRY(stage.Pop(buf, decompress_buf_off));
+                    if (buf.empty()) {
+                        break;
+                    }
 
-private:
-    // these need to be copied
-    ui::ProgressBox* const pbox;
-    const ReadCallback& rfunc;
-    const DecompressCallback& dfunc;
-    const WriteCallback& wfunc;
+                    R_TRY(dfunc(buf.data(), decompress_buf_off, buf.size(), [&](const void* _data, s64 size) -> Result {
+                        auto data = (const u8*)_data;
 
-    // these need to be created
-    Mutex read_mutex{};
-    Mutex write_mutex{};
+                        while (size) {
+                            const auto temp_buf_flush_max = std::max<u64>(temp_buf.size(), tuner.GetChunkSize() / 2);
+                            const auto block_off = temp_buf.size();
+                            const auto rsize = std::min<s64>(size, temp_buf_flush_max - block_off);
 
-    Mutex pull_mutex{};
+                            temp_buf.resize(block_off + rsize);
+                            std::memcpy(temp_buf.data() + block_off, data, rsize);
 
-    CondVar can_read{};
-    CondVar can_write{};
-    CondVar can_decompress{};
-    CondVar can_decompress_write{};
+                            if (temp_buf.size() == temp_buf_flush_max) {
+                                R_TRY(stage.Push(temp_buf));
+                                temp_buf.resize(0);
+                            }
 
-    // only used when pull is active.
-    CondVar can_pull{};
-    CondVar can_pull_write{};
+                            size -= rsize;
+                            data += rsize;
+                        }
 
-    UEvent m_uevent_done{};
-    UEvent m_uevent_read_progress{};
-    UEvent m_uevent_decompress_progress{};
-    UEvent m_uevent_write_progress{};
+                        R_SUCCEED();
+                    }));
+                }
 
-    RingBuf<2> read_buffers{};
-    RingBuf<2> write_buffers{};
+                // flush buffer.
+                if (!temp_buf.empty()) {
+                    log_write("flushing data: %zu\n", temp_buf.size());
+                    R_TRY(stage.Push(temp_buf));
+                }
 
-    std::vector<u8> pull_buffer{};
-    s64 pull_buffer_offset{};
+                log_write("finished decompress thread success!\n");
+                R_SUCCEED();
+            });
+        }
 
-    const u64 read_buffer_size;
-    const s64 write_size;
+        // write stage writes data to wfunc, in pull mode the output is instead read by sfunc.
+        if (!sfunc) {
+            pipeline.AddStage("write", [&](utils::PipelineStage& stage) -> Result {
+                utils::PooledBuffer lease{tuner.GetChunkSize()};
+                auto& buf = lease.Get();
 
-    // these are shared between threads
-    std::atomic<s64> read_offset{};
-    std::atomic<s64> decompress_offset{};
-    std::atomic<s64> write_offset{};
+                while (R_SUCCEEDED(stage.GetResults())) {
+                    R_TRY(stage.Pop(buf));
+                    if (buf.empty()) {
+                        break;
+                    }
 
-    std::atomic<Result> read_result{};
-    std::atomic<Result> decompress_result{};
-    std::atomic<Result> write_result{};
-    std::atomic<Result> pull_result{};
+                    const TimeStamp ts{};
+                    R_TRY(wfunc(buf.data(), write_offset, buf.size()));
+                    tuner.AddWrite(buf.size(), ts.GetNs());
 
-    std::atomic_bool read_running{true};
-    std::atomic_bool decompress_running{true};
-    std::atomic_bool write_running{true};
-};
+                    write_offset += buf.size();
+                    stage.SignalProgress();
+                }
 
-ThreadData::ThreadData(ui::ProgressBox* _pbox, s64 size, const ReadCallback& _rfunc, const DecompressCallback& _dfunc, const WriteCallback& _wfunc, u64 buffer_size)
-: pbox{_pbox}
-, rfunc{_rfunc}
-, dfunc{_dfunc}
-, wfunc{_wfunc}
-, read_buffer_size{buffer_size}
-, write_size{size} {
-    mutexInit(std::addressof(read_mutex));
-    mutexInit(std::addressof(write_mutex));
-    mutexInit(std::addressof(pull_mutex));
-
-    condvarInit(std::addressof(can_read));
-    condvarInit(std::addressof(can_decompress));
-    condvarInit(std::addressof(can_decompress_write));
-    condvarInit(std::addressof(can_write));
-
-    condvarInit(std::addressof(can_pull));
-    condvarInit(std::addressof(can_pull_write));
-
-    ueventCreate(GetDoneEvent(), false);
-    ueventCreate(GetReadProgressEvent(), true);
-    ueventCreate(GetDecompressProgressEvent(), true);
-    ueventCreate(GetWriteProgressEvent(), true);
-}
+                log_write("finished write thread success!\n");
+                R_SUCCEED();
+            });
+        }
 
-auto ThreadData::GetResults() volatile -> Result {
-    R_TRY(pbox->ShouldExitResult());
-    R_TRY(read_result.load());
-    R_TRY(decompress_result.load());
-    R_TRY(write_result.load());
-    R_TRY(pull_result.load());
-    R_SUCCEED();
-}
+        R_TRY(pipeline.Create(!!sfunc));
 
-void ThreadData::WakeAllThreads() {
-    condvarWakeAll(std::addressof(can_read));
-    condvarWakeAll(std::addressof(can_write));
-    condvarWakeAll(std::addressof(can_decompress));
-    condvarWakeAll(std::addressof(can_decompress_write));
-    condvarWakeAll(std::addressof(can_pull));
-    condvarWakeAll(std::addressof(can_pull_write));
-
-    mutexUnlock(std::addressof(read_mutex));
-    mutexUnlock(std::addressof(write_mutex));
-    mutexUnlock(std::addressof(pull_mutex));
-}
+        if (sfunc) {
+            log_write("[THREAD] doing sfuncn\n");
+            const auto rc = sfunc([&]() -> Result {
+                return pipeline.Start();
+            }, [&](void* data, s64 size, u64* bytes_read) -> Result {
+                return pipeline.Pull(data, size, bytes_read);
+            });
+
+            if (R_FAILED(rc)) {
+                pipeline.Cancel(rc);
+            }
 
-Result ThreadData::SetDecompressBuf(std::vector<u8>& buf, s64 off, s64 size) {
-    buf.resize(size);
+            R_TRY(pipeline.Join());
+        } else {
+            log_write("[THREAD] doing normal\n");
+            R_TRY(pipeline.Start());
+            log_write("[THREAD] started threads\n");
 
-    mutexLock(std::addressof(read_mutex));
-    if (!read_buffers.ringbuf_free()) {
-        if (!write_running) {
-            R_SUCCEED();
+            // use the write progress as the read output may be larger due to compressing.
+            R_TRY(pipeline.Wait([&]() {
+                pbox->UpdateTransfer(write_offset, size);
+            }));
         }
-        R_TRY(condvarWait(std::addressof(can_read), std::addressof(read_mutex)));
-    }
-
-    ON_SCOPE_EXIT(mutexUnlock(std::addressof(read_mutex)));
-    R_TRY(GetResults());
-    read_buffers.ringbuf_push(buf, off);
-    return condvarWakeOne(std::addressof(can_decompress));
-}
 
-Result ThreadData::GetDecompressBuf(std::vector<u8>& buf_out, s64& off_out) {
-    mutexLock(std::addressof(read_mutex));
-    if (!read_buffers.ringbuf_size()) {
-        if (!read_running) {
-            buf_out.resize(0);
-            R_SUCCEED();
-        }
-        R_TRY(condvarWait(std::addressof(can_decompress), std::addressof(read_mutex)));
+        pipeline.LogProfile();
+        log_write("returning from thread func\n");
+        R_SUCCEED();
     }
-
-    ON_SCOPE_EXIT(mutexUnlock(std::addressof(read_mutex)));
-    R_TRY(GetResults());
-    read_buffers.ringbuf_pop(buf_out, off_out);
-    return condvarWakeOne(std::addressof(can_read));
 }
 
-Result ThreadData::SetWriteBuf(std::vector<u8>& buf, s64 size) {
-    buf.resize(size);
-
-    mutexLock(std::addressof(write_mutex));
-    if (!write_buffers.ringbuf_free()) {
-        if (!decompress_running) {
-            R_SUCCEED();
-        }
-        R_TRY(condvarWait(std::addressof(can_decompress_write), std::addressof(write_mutex)));
+// creates the file an entry is extracted to, existing files are resized.
+Result OpenUnzipFile(fs::Fs* fs, const fs::FsPath& path, s64 size, fs::File* f) {
+    Result rc;
+    if (R_FAILED(rc = fs->CreateFile(path, size, 0)) && rc != FsError_PathAlreadyExists) {
+        log_write("failed to create file: %s 0x%04X\n", path.s, rc);
+        R_THROW(rc);
     }
 
-    ON_SCOPE_EXIT(mutexUnlock(std::addressof(write_mutex)));
-    R_TRY(GetResults());
-    write_buffers.ringbuf_push(buf, 0);
-    return condvarWakeOne(std::addressof(can_write));
-}
+    R_TRY(fs->OpenFile(path, FsOpenMode_Write, f));
 
-Result ThreadData::GetWriteBuf(std::vector<u8>& buf_out, s64& off_out) {
-    mutexLock(std::addressof(write_mutex));
-    if (!write_buffers.ringbuf_size()) {
-        if (!decompress_running) {
-            buf_out.resize(0);
-            R_SUCCEED();
-        }
-        R_TRY(condvarWait(std::addressof(can_write), std::addressof(write_mutex)));
+    // only update the size if this is an existing file.
+    if (rc == FsError_PathAlreadyExists) {
+        R_TRY(f->SetSize(size));
     }
 
-    ON_SCOPE_EXIT(mutexUnlock(std::addressof(write_mutex)));
-    R_TRY(GetResults());
-    write_buffers.ringbuf_pop(buf_out, off_out);
-    return condvarWakeOne(std::addressof(can_decompress_write));
+    R_SUCCEED();
 }
 
-Result ThreadData::SetPullBuf(std::vector<u8>& buf, s64 size) {
-    buf.resize(size);
+struct UnzipEntry {
+    unz64_file_pos pos;
+    // strings rather than FsPath as there may be thousands of entries.
+    std::string name;
+    std::string path;
+    s64 size;
+    u32 crc32;
+    bool is_dir;
+};
 
-    mutexLock(std::addressof(pull_mutex));
-    if (!pull_buffer.empty()) {
-        R_TRY(condvarWait(std::addressof(can_pull_write), std::addressof(pull_mutex)));
+// extracts a list of small files on UNZIP_THREADS threads.
+// the directories must already exist as the order that files are created in is random.
+struct ParallelUnzip {
+    ParallelUnzip(ui::ProgressBox* pbox, const fs::FsPath& zip_path, fs::Fs* fs, std::span<const UnzipEntry* const> entries)
+    : m_pbox{pbox}
+    , m_zip_path{zip_path}
+    , m_fs{fs}
+    , m_entries{entries} {
+        ueventCreate(std::addressof(m_uevent_done), false);
+        for (const auto e : m_entries) {
+            m_total_size += e->size;
+        }
     }
 
-    ON_SCOPE_EXIT(mutexUnlock(std::addressof(pull_mutex)));
-    R_TRY(GetResults());
+    Result Run();
 
-    pull_buffer.swap(buf);
-    return condvarWakeOne(std::addressof(can_pull));
-}
+private:
+    void WorkerFunc();
+    Result ExtractEntry(unzFile zfile, std::vector<u8>& buf, const UnzipEntry& e);
+    void UpdateProgress(const TimeStamp& ts);
 
-Result ThreadData::GetPullBuf(void* data, s64 size, u64* bytes_read) {
-    mutexLock(std::addressof(pull_mutex));
-    if (pull_buffer.empty()) {
-        R_TRY(condvarWait(std::addressof(can_pull), std::addressof(pull_mutex)));
+    void Cancel(Result rc) {
+        Result expected = 0;
+        m_result.compare_exchange_strong(expected, rc);
     }
 
-    ON_SCOPE_EXIT(mutexUnlock(std::addressof(pull_mutex)));
-    R_TRY(GetResults());
-
-    *bytes_read = size = std::min<s64>(size, pull_buffer.size() - pull_buffer_offset);
-    std::memcpy(data, pull_buffer.data() + pull_buffer_offset, size);
-    pull_buffer_offset += size;
-
-    if (pull_buffer_offset == pull_buffer.size()) {
-        pull_buffer_offset = 0;
-        pull_buffer.clear();
-        return condvarWakeOne(std::addressof(can_pull_write));
-    } else {
-        R_SUCCEED();
+    static void worker_func(void* d) {
+        static_cast<ParallelUnzip*>(d)->WorkerFunc();
     }
-}
-
-Result ThreadData::Read(void* buf, s64 size, u64* bytes_read) {
-    size = std::min<s64>(size, write_size - read_offset);
-    const auto rc = rfunc(buf, read_offset, size, bytes_read);
-    read_offset += *bytes_read;
-    return rc;
-}
 
-Result ThreadData::Pull(void* data, s64 size, u64* bytes_read) {
-    return GetPullBuf(data, size, bytes_read);
-}
+private:
+    ui::ProgressBox* const m_pbox;
+    const fs::FsPath m_zip_path;
+    fs::Fs* const m_fs;
+    const std::span<const UnzipEntry* const> m_entries;
+    s64 m_total_size{};
 
-// read thread reads all data from the source
-Result ThreadData::readFuncInternal() {
-    ON_SCOPE_EXIT( read_running = false; );
+    UEvent m_uevent_done{};
+    std::atomic<Result> m_result{};
+    std::atomic<u32> m_running{};
+    std::atomic<u32> m_next{};
+    std::atomic<u32> m_files_done{};
+    std::atomic<s64> m_bytes_done{};
+};
 
-    // the main buffer which data is read into.
-    std::vector<u8> buf;
-    buf.reserve(this->read_buffer_size);
+Result ParallelUnzip::Run() {
+    const TimeStamp ts{};
+    m_pbox->NewTransfer("");
+    UpdateProgress(ts);
 
-    while (this->read_offset < this->write_size && R_SUCCEEDED(this->GetResults())) {
-        // read more data
-        const auto buffer_offset = this->read_offset.load();
-        s64 read_size = this->read_buffer_size;
+    std::array<Thread, UNZIP_THREADS> threads{};
+    u32 thread_count{};
 
-        u64 bytes_read{};
-        buf.resize(read_size);
-        R_TRY(this->Read(buf.data(), read_size, std::addressof(bytes_read)));
-        if (!bytes_read) {
+    for (u32 i = 0; i < std::min<u64>(threads.size(), m_entries.size()); i++) {
+        auto t = std::addressof(threads[thread_count]);
+        if (const auto rc = utils::CreateThread(t, worker_func, this, 1024*64); R_FAILED(rc)) {
+            Cancel(rc);
             break;
         }
 
-        ueventSignal(GetReadProgressEvent());
-        auto buf_size = bytes_read;
-        R_TRY(this->SetDecompressBuf(buf, buffer_offset, buf_size));
-    }
-
-    log_write("finished read thread success!\n");
-    R_SUCCEED();
-}
-
-// read thread reads all data from the source
-Result ThreadData::decompressFuncInternal() {
-    ON_SCOPE_EXIT( decompress_running = false; );
-
-    std::vector<u8> buf{};
-    std::vector<u8> temp_buf{};
-    buf.reserve(this->read_buffer_size);
-    temp_buf.reserve(this->read_buffer_size);
-    const auto temp_buf_flush_max = this->read_buffer_size / 2;
-
-    while (this->decompress_offset < this->write_size && R_SUCCEEDED(this->GetResults())) {
-        s64 decompress_buf_off{};
-        R_TRY(this->GetDecompressBuf(buf, decompress_buf_off));
-        if (buf.empty()) {
-            log_write("exiting decompress func early because no data was received\n");
+        m_running++;
+        if (const auto rc = threadStart(t); R_FAILED(rc)) {
+            m_running--;
+            threadClose(t);
+            Cancel(rc);
             break;
         }
 
-        if (this->dfunc) {
-            R_TRY(this->dfunc(buf.data(), decompress_buf_off, buf.size(), [&](const void* _data, s64 size) -> Result {
-                auto data = (const u8*)_data;
-
-                while (size) {
-                    const auto block_off = temp_buf.size();
-                    const auto rsize = std::min<s64>(size, temp_buf_flush_max - block_off);
+        thread_count++;
+    }
 
-                    temp_buf.resize(block_off + rsize);
-                    std::memcpy(temp_buf.data() + block_off, data, rsize);
+    const auto waiter_cancel = waiterForUEvent(m_pbox->GetCancelEvent());
+    const auto waiter_done = waiterForUEvent(std::addressof(m_uevent_done));
 
-                    if (temp_buf.size() == temp_buf_flush_max) {
-                        // log_write("flushing data: %zu %.2f MiB\n", temp_buf.size(), temp_buf.size() / 1024.0 / 1024.0);
-                        R_TRY(this->SetWriteBuf(temp_buf, temp_buf.size()));
-                        temp_buf.resize(0);
-                    }
-
-                    size -= rsize;
-                    data += rsize;
-                    this->decompress_offset += rsize;
-                    ueventSignal(GetDecompressProgressEvent());
-                }
+    while (m_running) {
+        s32 idx;
+        const auto rc = waitMulti(&idx, UNZIP_PROGRESS_NS, waiter_cancel, waiter_done);
+        UpdateProgress(ts);
 
-                R_SUCCEED();
-            }));
-        } else {
-            this->decompress_offset += buf.size();
-            ueventSignal(GetDecompressProgressEvent());
-
-            R_TRY(this->SetWriteBuf(buf, buf.size()));
+        if (R_SUCCEEDED(rc) && idx == 0) {
+            Cancel(Result_TransferCancelled);
+            break;
+        } else if (R_SUCCEEDED(rc) || rc != KERNELRESULT(TimedOut)) {
+            break;
         }
     }
 
-    // flush buffer.
-    if (!temp_buf.empty()) {
-        log_write("flushing data: %zu\n", temp_buf.size());
-        R_TRY(this->SetWriteBuf(temp_buf, temp_buf.size()));
+    // workers finish the file they are on and then exit.
+    for (u32 i = 0; i < thread_count; i++) {
+        threadWaitForExit(std::addressof(threads[i]));
+        threadClose(std::addressof(threads[i]));
     }
 
-    log_write("finished decompress thread success!\n");
-    R_SUCCEED();
+    const auto seconds = ts.GetSecondsD();
+    log_write("[UNZIP] extracted %u files in %.2fs, %.1f files/s %.2f MiB/s\n", m_files_done.load(), seconds, m_files_done / seconds, m_bytes_done / seconds / 1024.0 / 1024.0);
+
+    R_TRY(m_pbox->ShouldExitResult());
+    return m_result.load();
 }
 
-// write thread writes data to wfunc.
-Result ThreadData::writeFuncInternal() {
-    ON_SCOPE_EXIT( write_running = false; );
+void ParallelUnzip::WorkerFunc() {
+    ON_SCOPE_EXIT(
+        if (!--m_running) {
+            ueventSignal(std::addressof(m_uevent_done));
+        }
+    );
 
-    std::vector<u8> buf;
-    buf.reserve(this->read_buffer_size);
+    zlib_filefunc64_def file_func;
+    mz::FileFuncStdio(&file_func);
+
+    auto zfile = unzOpen2_64(m_zip_path, &file_func);
+    if (!zfile) {
+        Cancel(Result_UnzOpen2_64);
+        return;
+    }
+    ON_SCOPE_EXIT(unzClose(zfile));
 
-    while (this->write_offset < this->write_size && R_SUCCEEDED(this->GetResults())) {
-        s64 dummy_off;
-        R_TRY(this->GetWriteBuf(buf, dummy_off));
-        const auto size = buf.size();
-        if (!size) {
-            log_write("exiting write func early because no data was received\n");
+    std::vector<u8> buf(SMALL_BUFFER_SIZE);
+    while (!m_result) {
+        const auto i = m_next++;
+        if (i >= m_entries.size()) {
             break;
         }
 
-        if (!this->wfunc) {
-            R_TRY(this->SetPullBuf(buf, buf.size()));
-        } else {
-            R_TRY(this->wfunc(buf.data(), this->write_offset, buf.size()));
+        if (const auto rc = ExtractEntry(zfile, buf, *m_entries[i]); R_FAILED(rc)) {
+            Cancel(rc);
+            break;
         }
 
-        this->write_offset += size;
-        ueventSignal(GetWriteProgressEvent());
+        m_files_done++;
     }
-
-    log_write("finished write thread success!\n");
-    R_SUCCEED();
 }
 
-void readFunc(void* d) {
-    auto t = static_cast<ThreadData*>(d);
-    t->SetReadResult(t->readFuncInternal());
-    log_write("read thread returned now\n");
-}
-
-void decompressFunc(void* d) {
-    log_write("hello decomp thread func\n");
-    auto t = static_cast<ThreadData*>(d);
-    t->SetDecompressResult(t->decompressFuncInternal());
-    log_write("decompress thread returned now\n");
-}
-
-void writeFunc(void* d) {
-    auto t = static_cast<ThreadData*>(d);
-    t->SetWriteResult(t->writeFuncInternal());
-    log_write("write thread returned now\n");
-}
-
-Result TransferInternal(ui::ProgressBox* pbox, s64 size, const ReadCallback& rfunc, const DecompressCallback& dfunc, const WriteCallback& wfunc, const StartCallback2& sfunc, Mode mode, u64 buffer_size = NORMAL_BUFFER_SIZE) {
-    const auto is_file_based_emummc = App::IsFileBaseEmummc();
-
-    if (is_file_based_emummc) {
-        buffer_size = SMALL_BUFFER_SIZE;
+Result ParallelUnzip::ExtractEntry(unzFile zfile, std::vector<u8>& buf, const UnzipEntry& e) {
+    if (UNZ_OK != unzGoToFilePos64(zfile, &e.pos)) {
+        log_write("failed to go to file: %s\n", e.name.c_str());
+        R_THROW(Result_UnzGoToFilePos64);
     }
 
-    if (mode == Mode::SingleThreadedIfSmaller) {
-        if (size <= buffer_size) {
-            mode = Mode::SingleThreaded;
-        } else {
-            mode = Mode::MultiThreaded;
-        }
+    if (UNZ_OK != unzOpenCurrentFile(zfile)) {
+        log_write("failed to open current file\n");
+        R_THROW(Result_UnzOpenCurrentFile);
     }
+    ON_SCOPE_EXIT(unzCloseCurrentFile(zfile));
 
-    // single threaded pull buffer is not supported.
-    log_write("checking invalid transfer mode: %u %u\n", mode == Mode::MultiThreaded, !sfunc);
-    R_UNLESS(mode == Mode::MultiThreaded || !sfunc, 0x1);
-    log_write("valid transfer mode\n");
-
-    // todo: support single threaded pull buffer.
-    if (mode == Mode::SingleThreaded) {
-        std::vector<u8> buf(buffer_size);
-
-        s64 offset{};
-        while (offset < size) {
-            R_TRY(pbox->ShouldExitResult());
-
-            u64 bytes_read;
-            const auto rsize = std::min<s64>(buf.size(), size - offset);
-            R_TRY(rfunc(buf.data(), offset, rsize, &bytes_read));
-            if (!bytes_read) {
-                break;
-            }
-
-            R_TRY(wfunc(buf.data(), offset, bytes_read));
-
-            offset += bytes_read;
-            pbox->UpdateTransfer(offset, size);
+    const fs::FsPath path{e.path};
+    fs::File f;
+    R_TRY(OpenUnzipFile(m_fs, path, e.size, &f));
+
+    u32 crc32{};
+    for (s64 off = 0; off < e.size;) {
+        const auto result = unzReadCurrentFile(zfile, buf.data(), std::min<s64>(buf.size(), e.size - off));
+        if (result <= 0) {
+            log_write("failed to read zip file: %s %d\n", path.s, result);
+            R_THROW(Result_UnzReadCurrentFile);
         }
 
-        R_SUCCEED();
-    }
-    else {
-        ThreadData t_data{pbox, size, rfunc, dfunc, wfunc, buffer_size};
-
-        Thread t_read{};
-        R_TRY(utils::CreateThread(&t_read, readFunc, std::addressof(t_data)));
-        ON_SCOPE_EXIT(threadClose(&t_read));
-
-        Thread t_decompress{};
-        R_TRY(utils::CreateThread(&t_decompress, decompressFunc, std::addressof(t_data)));
-        ON_SCOPE_EXIT(threadClose(&t_decompress));
-
-        Thread t_write{};
-        R_TRY(utils::CreateThread(&t_write, writeFunc, std::addressof(t_data)));
-        ON_SCOPE_EXIT(threadClose(&t_write));
-
-        const auto start_threads = [&]() -> Result {
-            log_write("starting threads\n");
-            R_TRY(threadStart(std::addressof(t_read)));
-            R_TRY(threadStart(std::addressof(t_decompress)));
-            R_TRY(threadStart(std::addressof(t_write)));
-            R_SUCCEED();
-        };
-
-        ON_SCOPE_EXIT(threadWaitForExit(std::addressof(t_read)));
-        ON_SCOPE_EXIT(threadWaitForExit(std::addressof(t_decompress)));
-        ON_SCOPE_EXIT(threadWaitForExit(std::addressof(t_write)));
-
-        if (sfunc) {
-            log_write("[THREAD] doing sfuncn\n");
-            t_data.SetPullResult(sfunc(start_threads, [&](void* data, s64 size, u64* bytes_read) -> Result {
-                R_TRY(t_data.GetResults());
-                return t_data.Pull(data, size, bytes_read);
-            }));
-        } else {
-            log_write("[THREAD] doing normal\n");
-            R_TRY(start_threads());
-            log_write("[THREAD] started threads\n");
-
-            // use the read progress as the write output may be smaller due to compressing
-            // so read will show a more accurate progress.
-            // TODO: show progress bar for all 3 threads.
-            // NOTE: went back to using write progress for now.
-            const auto waiter_progress = waiterForUEvent(t_data.GetWriteProgressEvent());
-            const auto waiter_cancel = waiterForUEvent(pbox->GetCancelEvent());
-            const auto waiter_done = waiterForUEvent(t_data.GetDoneEvent());
-
-            for (;;) {
-                s32 idx;
-                if (R_FAILED(waitMulti(&idx, UINT64_MAX, waiter_progress, waiter_cancel, waiter_done))) {
-                    break;
-                }
+        crc32 = crc32CalculateWithSeed(crc32, buf.data(), result);
+        R_TRY(f.Write(off, buf.data(), result, FsWriteOption_None));
 
-                if (!idx) {
-                    pbox->UpdateTransfer(t_data.GetWriteOffset(), t_data.GetWriteSize());
-                } else {
-                    break;
-                }
-            }
-        }
+        off += result;
+        m_bytes_done += result;
+    }
 
-        // wait for all threads to close.
-        log_write("waiting for threads to close\n");
-        while (t_data.IsAnyRunning()) {
-            t_data.WakeAllThreads();
-            pbox->Yield();
+    // validate crc32 (if set in the info).
+    R_UNLESS(!e.crc32 || e.crc32 == crc32, 0x8);
+    R_SUCCEED();
+}
 
-            if (R_FAILED(waitSingleHandle(t_read.handle, 1000))) {
-                continue;
-            } else if (R_FAILED(waitSingleHandle(t_decompress.handle, 1000))) {
-                continue;
-            } else if (R_FAILED(waitSingleHandle(t_write.handle, 1000))) {
-                continue;
-            }
-            break;
-        }
-        log_write("threads closed\n");
+void ParallelUnzip::UpdateProgress(const TimeStamp& ts) {
+    const auto files_done = m_files_done.load();
+    const auto seconds = ts.GetSecondsD();
 
-        // if any of the threads failed, wake up all threads so they can exit.
-        if (R_FAILED(t_data.GetResults())) {
-            log_write("some reads failed, waking threads\n");
-            log_write("returning due to fail\n");
-            return t_data.GetResults();
-        }
+    char transfer[128];
+    std::snprintf(transfer, sizeof(transfer), "%u / %zu files (%.1f files/s)", files_done, m_entries.size(), seconds ? files_done / seconds : 0.0);
 
-        log_write("returning from thread func\n");
-        return t_data.GetResults();
-    }
+    m_pbox->SetTransferName(transfer);
+    m_pbox->UpdateTransfer(m_bytes_done, m_total_size);
 }
 
 } // namespace
@@ -678,18 +630,8 @@ Result TransferUnzip(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::F
         R_THROW(rc);
     }
 
-    if (R_FAILED(rc = fs->CreateFile(path, size, 0)) && rc != FsError_PathAlreadyExists) {
-        log_write("failed to create file: %s 0x%04X\n", path.s, rc);
-        R_THROW(rc);
-    }
-
     fs::File f;
-    R_TRY(fs->OpenFile(path, FsOpenMode_Write, &f));
-
-    // only update the size if this is an existing file.
-    if (rc == FsError_PathAlreadyExists) {
-        R_TRY(f.SetSize(size));
-    }
+    R_TRY(OpenUnzipFile(fs, path, size, &f));
 
     // NOTES: do not use temp file with rename / delete after as it massively slows
     // down small file transfers (RA 21s -> 50s).
@@ -753,7 +695,74 @@ Result TransferZip(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::FsP
     );
 }
 
-Result TransferUnzipAll(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::FsPath& base_path, const UnzipAllFilter& filter, Mode mode) {
+Result TransferZip(ui::ProgressBox* pbox, utils::ParallelDeflate& deflate, void* zfile, fs::Fs* fs, const fs::FsPath& path, const char* name, const zip_fileinfo* info, int level) {
+    fs::File f;
+    R_TRY(fs->OpenFile(path, FsOpenMode_Read, &f));
+
+    s64 file_size;
+    R_TRY(f.GetSize(&file_size));
+
+    // zip64 is only needed if the file (plus the deflate overhead) doesn't fit in 32-bits.
+    const auto zip64 = u64(file_size) >= mz::ZIP64_THRESHOLD;
+    if (ZIP_OK != zipOpenNewFileInZip2_64(zfile, name, info, NULL, 0, NULL, 0, NULL, Z_DEFLATED, level, 1, zip64)) {
+        log_write("failed to add zip for %s\n", path.s);
+        R_THROW(Result_ZipOpenNewFileInZip);
+    }
+
+    u32 crc32{};
+    const auto rc = deflate.Compress(file_size, level,
+        [&](void* data, s64 off, s64 size, u64* bytes_read) -> Result {
+            R_TRY(pbox->ShouldExitResult());
+            R_TRY(f.Read(off, data, size, FsReadOption_None, bytes_read));
+            pbox->UpdateTransfer(off + *bytes_read, file_size);
+            R_SUCCEED();
+        },
+        [&](const void* data, s64 size) -> Result {
+            if (ZIP_OK != zipWriteInFileInZip(zfile, data, size)) {
+                log_write("failed to write zip file: %s\n", path.s);
+                R_THROW(Result_ZipWriteInFileInZip);
+            }
+            R_SUCCEED();
+        },
+        &crc32, nullptr
+    );
+
+    // always close the entry so that the zip is left in a valid state.
+    const auto close_rc = zipCloseFileInZipRaw64(zfile, file_size, crc32);
+    R_TRY(rc);
+    R_UNLESS(ZIP_OK == close_rc, Result_ZipCloseFileInZip);
+    R_SUCCEED();
+}
+
+Result TransferZip(ui::ProgressBox* pbox, utils::ParallelDeflate& deflate, mz::StreamWriter& writer, fs::Fs* fs, const fs::FsPath& path, const char* name, const zip_fileinfo* info, int level) {
+    fs::File f;
+    R_TRY(fs->OpenFile(path, FsOpenMode_Read, &f));
+
+    s64 file_size;
+    R_TRY(f.GetSize(&file_size));
+
+    R_TRY(writer.OpenEntry(name, *info, mz::mmz_Compression_Deflate, file_size));
+
+    u32 crc32{};
+    R_TRY(deflate.Compress(file_size, level,
+        [&](void* data, s64 off, s64 size, u64* bytes_read) -> Result {
+            R_TRY(pbox->ShouldExitResult());
+            R_TRY(f.Read(off, data, size, FsReadOption_None, bytes_read));
+            pbox->UpdateTransfer(off + *bytes_read, file_size);
+            R_SUCCEED();
+        },
+        [&](const void* data, s64 size) -> Result {
+            return writer.WriteEntry(data, size);
+        },
+        &crc32, nullptr
+    ));
+
+    return writer.CloseEntry(crc32, file_size);
+}
+
+// the central directory is read once up front, small files are then extracted
+// in parallel if the zip path is known, the rest one by one.
+Result TransferUnzipAllInternal(ui::ProgressBox* pbox, void* zfile, const fs::FsPath* zip_path, fs::Fs* fs, const fs::FsPath& base_path, const UnzipAllFilter& filter, Mode mode) {
     unz_global_info64 ginfo;
     if (UNZ_OK != unzGetGlobalInfo64(zfile, &ginfo)) {
         R_THROW(Result_UnzGetGlobalInfo64);
@@ -763,6 +772,9 @@ Result TransferUnzipAll(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs
         R_THROW(Result_UnzGoToFirstFile);
     }
 
+    std::vector<UnzipEntry> entries;
+    entries.reserve(ginfo.number_entry);
+
     for (s64 i = 0; i < ginfo.number_entry; i++) {
         R_TRY(pbox->ShouldExitResult());
 
@@ -773,12 +785,6 @@ Result TransferUnzipAll(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs
             }
         }
 
-        if (UNZ_OK != unzOpenCurrentFile(zfile)) {
-            log_write("failed to open current file\n");
-            R_THROW(Result_UnzOpenCurrentFile);
-        }
-        ON_SCOPE_EXIT(unzCloseCurrentFile(zfile));
-
         unz_file_info64 info;
         fs::FsPath name;
         if (UNZ_OK != unzGetCurrentFileInfo64(zfile, &info, name, sizeof(name), 0, 0, 0, 0)) {
@@ -799,22 +805,90 @@ Result TransferUnzipAll(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs
             continue;
         }
 
-        pbox->NewTransfer(name);
+        auto& e = entries.emplace_back();
+        if (UNZ_OK != unzGetFilePos64(zfile, &e.pos)) {
+            R_THROW(Result_UnzGoToFilePos64);
+        }
+
+        e.name = name;
+        e.path = path;
+        e.size = info.uncompressed_size;
+        e.crc32 = info.crc;
+        e.is_dir = path[path_len - 1] == '/';
+    }
+
+    std::vector<const UnzipEntry*> small_files;
+    if (zip_path && mode != Mode::SingleThreaded) {
+        for (const auto& e : entries) {
+            if (!e.is_dir && e.size < (s64)SMALL_BUFFER_SIZE) {
+                small_files.emplace_back(&e);
+            }
+        }
+
+        if (small_files.size() < UNZIP_PARALLEL_MIN_FILES) {
+            small_files.clear();
+        }
+    }
+
+    if (!small_files.empty()) {
+        // create the folders in the order they appear in the zip, as the files
+        // below are created in any order.
+        std::unordered_set<std::string> created;
+        for (const auto& e : entries) {
+            const auto dir = e.is_dir ? e.path : e.path.substr(0, e.path.find_last_of('/') + 1);
+            if (dir.empty() || !created.emplace(dir).second) {
+                continue;
+            }
 
-        if (path[path_len -1] == '/') {
+            Result rc;
+            if (R_FAILED(rc = fs->CreateDirectoryRecursively(fs::FsPath{dir})) && rc != FsError_PathAlreadyExists) {
+                log_write("failed to create folder: %s 0x%04X\n", dir.c_str(), rc);
+                R_THROW(rc);
+            }
+        }
+
+        ParallelUnzip parallel_unzip{pbox, *zip_path, fs, small_files};
+        R_TRY(parallel_unzip.Run());
+    }
+
+    for (const auto& e : entries) {
+        R_TRY(pbox->ShouldExitResult());
+
+        if (!small_files.empty() && (e.is_dir || e.size < (s64)SMALL_BUFFER_SIZE)) {
+            continue;
+        }
+
+        const fs::FsPath path{e.path};
+        pbox->NewTransfer(e.name);
+
+        if (e.is_dir) {
             Result rc;
             if (R_FAILED(rc = fs->CreateDirectoryRecursively(path)) && rc != FsError_PathAlreadyExists) {
                 log_write("failed to create folder: %s 0x%04X\n", path.s, rc);
                 R_THROW(rc);
             }
         } else {
-            R_TRY(TransferUnzip(pbox, zfile, fs, path, info.uncompressed_size, info.crc, mode));
+            if (UNZ_OK != unzGoToFilePos64(zfile, &e.pos)) {
+                R_THROW(Result_UnzGoToFilePos64);
+            }
+
+            if (UNZ_OK != unzOpenCurrentFile(zfile)) {
+                log_write("failed to open current file\n");
+                R_THROW(Result_UnzOpenCurrentFile);
+            }
+            ON_SCOPE_EXIT(unzCloseCurrentFile(zfile));
+
+            R_TRY(TransferUnzip(pbox, zfile, fs, path, e.size, e.crc32, mode));
         }
     }
 
     R_SUCCEED();
 }
 
+Result TransferUnzipAll(ui::ProgressBox* pbox, void* zfile, fs::Fs* fs, const fs::FsPath& base_path, const UnzipAllFilter& filter, Mode mode) {
+    return TransferUnzipAllInternal(pbox, zfile, nullptr, fs, base_path, filter, mode);
+}
+
 Result TransferUnzipAll(ui::ProgressBox* pbox, const fs::FsPath& zip_out, fs::Fs* fs, const fs::FsPath& base_path, const UnzipAllFilter& filter, Mode mode) {
     zlib_filefunc64_def file_func;
     mz::FileFuncStdio(&file_func);
@@ -823,7 +897,7 @@ Result TransferUnzipAll(ui::ProgressBox* pbox, const fs::FsPath& zip_out, fs::Fs
     R_UNLESS(zfile, Result_UnzOpen2_64);
     ON_SCOPE_EXIT(unzClose(zfile));
 
-    return TransferUnzipAll(pbox, zfile, fs, base_path, filter, mode);
+    return TransferUnzipAllInternal(pbox, zfile, &zip_out, fs, base_path, filter, mode);
 }
 
 } // namespace::thread
@@ -134,6 +134,7 @@ auto GetCodeMessage(Result rc) -> const char* {
         case Result_UsbBadTransferSize: return "SphairaError_UsbBadTransferSize";
         case Result_UsbEmptyTransferSize: return "SphairaError_UsbEmptyTransferSize";
         case Result_UsbOverflowTransferSize: return "SphairaError_UsbOverflowTransferSize";
+        case Result_UsbBadCrc: return "SphairaError_UsbBadCrc";
         case Result_UsbUploadBadMagic: return "SphairaError_UsbUploadBadMagic";
         case Result_UsbUploadExit: return "SphairaError_UsbUploadExit";
         case Result_UsbUploadBadCount: return "SphairaError_UsbUploadBadCount";
@@ -156,6 +157,7 @@ auto GetCodeMessage(Result rc) -> const char* {
         case Result_YatiInvalidNczBlockTotal: return "SphairaError_YatiInvalidNczBlockTotal";
         case Result_YatiInvalidNczBlockSizeExponent: return "SphairaError_YatiInvalidNczBlockSizeExponent";
         case Result_YatiInvalidNczZstdError: return "SphairaError_YatiInvalidNczZstdError";
+        case Result_YatiNczShortBlock: return "SphairaError_YatiNczShortBlock";
         case Result_YatiTicketNotFound: return "SphairaError_YatiTicketNotFound";
         case Result_YatiInvalidTicketBadRightsId: return "SphairaError_YatiInvalidTicketBadRightsId";
         case Result_YatiCertNotFound: return "SphairaError_YatiCertNotFound";
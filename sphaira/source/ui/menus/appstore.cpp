@@ -390,7 +390,8 @@ auto InstallApp(ProgressBox* pbox, const Entry& entry) -> Result {
         const auto url = BuildZipUrl(entry);
         curl::Api api{
             curl::Url{url},
-            curl::OnProgress{pbox->OnDownloadProgressCallback()}
+            curl::OnProgress{pbox->OnDownloadProgressCallback()},
+            curl::Flags{curl::Flag_Segmented}
         };
 
         if (file_download) {
@@ -506,7 +507,9 @@ auto InstallApp(ProgressBox* pbox, const Entry& entry) -> Result {
         R_TRY(unzip_to("manifest.install", BuildManifestCachePath(entry)));
         #endif
 
-        R_TRY(thread::TransferUnzipAll(pbox, zfile, &fs, "/", [&](const fs::FsPath& name, fs::FsPath& path) -> bool {
+        // the filter is called once per entry whilst the central directory is read,
+        // before anything is extracted, the transfer name is set by the extract.
+        const auto filter = [&](const fs::FsPath& name, fs::FsPath& path) -> bool {
             const auto it = std::ranges::find_if(new_manifest, [&name](auto& e){
                 return !strcasecmp(name, e.path);
             });
@@ -515,8 +518,6 @@ auto InstallApp(ProgressBox* pbox, const Entry& entry) -> Result {
                 return false;
             }
 
-            pbox->NewTransfer(it->path);
-
             switch (it->command) {
                 case 'E': // both are the same?
                 case 'U':
@@ -529,7 +530,14 @@ auto InstallApp(ProgressBox* pbox, const Entry& entry) -> Result {
                     log_write("bad command: %c\n", it->command);
                     return false;
             }
-        }));
+        };
+
+        // the zip can only be reopened by the parallel extract if it was downloaded to a file.
+        if (file_download) {
+            R_TRY(thread::TransferUnzipAll(pbox, zip_out, &fs, "/", filter));
+        } else {
+            R_TRY(thread::TransferUnzipAll(pbox, zfile, &fs, "/", filter));
+        }
 
         log_write("\n\t[APPSTORE] finished extract new, time taken: %.2fs %zums\n\n", ts.GetSecondsD(), ts.GetMs());
 
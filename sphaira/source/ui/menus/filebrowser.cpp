@@ -870,12 +870,16 @@ void FsView::InstallFiles() {
             App::PopToMenu();
 
             App::Push<ui::ProgressBox>(0, "Installing "_i18n, "", [this, targets](auto pbox) -> Result {
+                std::vector<fs::FsPath> paths;
                 for (auto& e : targets) {
-                    R_TRY(yati::InstallFromFile(pbox, m_fs.get(), GetNewPath(e)));
-                    App::Notify(i18n::Reorder("Installed ", e.GetName()));
+                    paths.emplace_back(GetNewPath(e));
                 }
 
-                R_SUCCEED();
+                // files are installed in order.
+                size_t installed{};
+                return yati::InstallFromFiles(pbox, m_fs.get(), paths, [&targets, &installed](const fs::FsPath&) {
+                    App::Notify(i18n::Reorder("Installed ", targets[installed++].GetName()));
+                });
             }, [this](Result rc){
                 App::PushErrorBox(rc, "File install failed!"_i18n);
             });
@@ -952,7 +956,6 @@ void FsView::ZipFiles(fs::FsPath zip_out) {
     App::Push<ui::ProgressBox>(0, "Compressing "_i18n, "", [this, zip_out, targets](auto pbox) -> Result {
         const auto t = std::time(NULL);
         const auto tm = std::localtime(&t);
-        const auto is_hdd_fs = m_fs->Root().starts_with("ums");
 
         // pre-calculate the time rather than calculate it in the loop.
         zip_fileinfo zip_info{};
@@ -970,6 +973,12 @@ void FsView::ZipFiles(fs::FsPath zip_out) {
         R_UNLESS(zfile, Result_ZipOpen2_64);
         ON_SCOPE_EXIT(zipClose(zfile, "sphaira v" APP_DISPLAY_VERSION));
 
+        // compresses on the calling thread if the threads fail to start.
+        utils::ParallelDeflate deflate;
+        if (R_FAILED(deflate.Start())) {
+            deflate.Close();
+        }
+
         const auto zip_add = [&](const fs::FsPath& file_path) -> Result {
             // the file name needs to be relative to the current directory.
             const char* file_name_in_zip = file_path.s + std::strlen(m_path);
@@ -986,13 +995,8 @@ void FsView::ZipFiles(fs::FsPath zip_out) {
 
             pbox->NewTransfer(file_name_in_zip);
 
-            if (ZIP_OK != zipOpenNewFileInZip(zfile, file_name_in_zip, &zip_info, NULL, 0, NULL, 0, NULL, Z_DEFLATED, Z_DEFAULT_COMPRESSION)) {
-                log_write("failed to add zip for %s\n", file_path.s);
-                R_THROW(Result_ZipOpenNewFileInZip);
-            }
-            ON_SCOPE_EXIT(zipCloseFileInZip(zfile));
-
-            return thread::TransferZip(pbox, zfile, m_fs.get(), file_path, nullptr, is_hdd_fs ? thread::Mode::SingleThreaded : thread::Mode::SingleThreadedIfSmaller);
+            // the entry is opened as zip64 if the file doesn't fit in 32-bits.
+            return thread::TransferZip(pbox, deflate, zfile, m_fs.get(), file_path, file_name_in_zip, &zip_info, Z_DEFAULT_COMPRESSION);
         };
 
         for (auto& e : targets) {
@@ -9,6 +9,7 @@
 
 #include "utils/utils.hpp"
 #include "utils/nsz_dumper.hpp"
+#include "utils/throttle.hpp"
 
 #include "ui/menus/game_menu.hpp"
 #include "ui/menus/game_meta_menu.hpp"
@@ -53,8 +54,8 @@ struct NspSource final : dump::BaseSource {
         R_UNLESS(it != m_entries.end(), Result_GameBadReadForDump);
 
         const auto rc = it->Read(buf, off, size, bytes_read);
-        if (m_is_file_based_emummc) {
-            svcSleepThread(2e+6); // 2ms
+        if (R_SUCCEEDED(rc) && m_is_file_based_emummc) {
+            utils::ThrottleEmummc(*bytes_read);
         }
         return rc;
     }
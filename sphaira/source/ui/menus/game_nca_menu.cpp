@@ -13,6 +13,7 @@
 
 #include "utils/utils.hpp"
 #include "utils/devoptab.hpp"
+#include "utils/throttle.hpp"
 
 #include "title_info.hpp"
 #include "app.hpp"
@@ -67,8 +68,8 @@ struct NcaSource final : dump::BaseSource {
             *bytes_read = size;
         }
 
-        if (m_is_file_based_emummc) {
-            svcSleepThread(2e+6); // 2ms
+        if (R_SUCCEEDED(rc) && m_is_file_based_emummc) {
+            utils::ThrottleEmummc(size);
         }
 
         return rc;
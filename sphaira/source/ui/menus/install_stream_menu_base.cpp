@@ -6,6 +6,7 @@
 #include "ui/nvg_util.hpp"
 #include "i18n.hpp"
 #include <cstring>
+#include <algorithm>
 
 namespace sphaira::ui::menu::stream {
 namespace {
@@ -16,16 +17,20 @@ enum class InstallState {
     Finished,
 };
 
-constexpr u64 MAX_BUFFER_SIZE = 1024ULL*1024ULL*1ULL;
+constexpr u64 MAX_BUFFER_SIZE_MB = 16;
 std::atomic<InstallState> INSTALL_STATE{InstallState::None};
 
+auto GetBufferSize() -> u64 {
+    const auto size_mb = std::clamp<long>(App::GetApp()->m_stream_buffer_size.Get(), 1, MAX_BUFFER_SIZE_MB);
+    return size_mb * 1024ULL * 1024ULL;
+}
+
 } // namespace
 
-Stream::Stream(const fs::FsPath& path, std::stop_token token) {
+Stream::Stream(const fs::FsPath& path, std::stop_token token) : m_buffer{GetBufferSize()} {
     m_path = path;
     m_token = token;
     m_active = true;
-    m_buffer.reserve(MAX_BUFFER_SIZE);
 
     mutexInit(&m_mutex);
     condvarInit(&m_can_read);
@@ -42,19 +47,30 @@ Result Stream::ReadChunk(void* _buf, s64 size, u64* bytes_read) {
     );
 
     while (!m_token.stop_requested()) {
-        SCOPED_MUTEX(&m_mutex);
-        if (m_active && m_buffer.empty()) {
-            R_TRY(condvarWait(std::addressof(m_can_read), std::addressof(m_mutex)));
-        }
+        const auto region = m_buffer.PeekRead();
+        if (region.empty()) {
+            SCOPED_MUTEX(&m_mutex);
+            if (m_active && m_buffer.IsEmpty()) {
+                R_TRY(condvarWait(std::addressof(m_can_read), std::addressof(m_mutex)));
+            }
 
-        if ((!m_active && m_buffer.empty()) || m_token.stop_requested()) {
-            break;
+            if (!m_active && m_buffer.IsEmpty()) {
+                break;
+            }
+
+            continue;
         }
 
-        const auto rsize = std::min<s64>(size, m_buffer.size());
-        std::memcpy(buf, m_buffer.data(), rsize);
-        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + rsize);
-        condvarWakeOne(&m_can_write);
+        const auto rsize = std::min<s64>(size, region.size());
+        std::memcpy(buf, region.data(), rsize);
+        m_buffer.CommitRead(rsize);
+
+        // the lock is only taken so that the wake can't be lost between
+        // the writer seeing a full buffer and waiting.
+        {
+            SCOPED_MUTEX(&m_mutex);
+            condvarWakeOne(&m_can_write);
+        }
 
         size -= rsize;
         buf += rsize;
@@ -69,6 +85,42 @@ Result Stream::ReadChunk(void* _buf, s64 size, u64* bytes_read) {
     R_THROW(Result_TransferCancelled);
 }
 
+Result Stream::SkipChunk(s64 size, u64* bytes_skipped) {
+    *bytes_skipped = 0;
+
+    // data is discarded in place rather than copied out.
+    while (!m_token.stop_requested()) {
+        const auto skipped = m_buffer.Skip(size);
+        if (!skipped) {
+            SCOPED_MUTEX(&m_mutex);
+            if (m_active && m_buffer.IsEmpty()) {
+                R_TRY(condvarWait(std::addressof(m_can_read), std::addressof(m_mutex)));
+            }
+
+            if (!m_active && m_buffer.IsEmpty()) {
+                break;
+            }
+
+            continue;
+        }
+
+        {
+            SCOPED_MUTEX(&m_mutex);
+            condvarWakeOne(&m_can_write);
+        }
+
+        size -= skipped;
+        *bytes_skipped += skipped;
+
+        if (!size) {
+            R_SUCCEED();
+        }
+    }
+
+    log_write("[Stream::SkipChunk] failed to skip\n");
+    R_THROW(Result_TransferCancelled);
+}
+
 bool Stream::Push(const void* _buf, s64 size) {
     auto buf = static_cast<const u8*>(_buf);
     if (!size) {
@@ -86,22 +138,29 @@ bool Stream::Push(const void* _buf, s64 size) {
             return true;
         }
 
-        SCOPED_MUTEX(&m_mutex);
-        if (m_active && m_buffer.size() >= MAX_BUFFER_SIZE) {
-            R_TRY(condvarWait(std::addressof(m_can_write), std::addressof(m_mutex)));
-        }
-
         if (!m_active) {
             log_write("[Stream::Push] file not active\n");
             break;
         }
 
-        const auto wsize = std::min<s64>(size, MAX_BUFFER_SIZE - m_buffer.size());
-        const auto offset = m_buffer.size();
-        m_buffer.resize(offset + wsize);
+        const auto region = m_buffer.PeekWrite();
+        if (region.empty()) {
+            SCOPED_MUTEX(&m_mutex);
+            if (m_active && m_buffer.IsFull()) {
+                R_TRY(condvarWait(std::addressof(m_can_write), std::addressof(m_mutex)));
+            }
 
-        std::memcpy(m_buffer.data() + offset, buf, wsize);
-        condvarWakeOne(&m_can_read);
+            continue;
+        }
+
+        const auto wsize = std::min<s64>(size, region.size());
+        std::memcpy(region.data(), buf, wsize);
+        m_buffer.CommitWrite(wsize);
+
+        {
+            SCOPED_MUTEX(&m_mutex);
+            condvarWakeOne(&m_can_read);
+        }
 
         size -= wsize;
         buf += wsize;
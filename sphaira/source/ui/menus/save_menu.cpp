@@ -8,6 +8,7 @@
 #include "image.hpp"
 #include "threaded_file_transfer.hpp"
 #include "minizip_helper.hpp"
+#include "mmz.hpp"
 #include "dumper.hpp"
 #include "swkbd.hpp"
 
@@ -1067,97 +1068,69 @@ Result Menu::BackupSaveInternal(ProgressBox* pbox, const dump::DumpLocation& loc
         zip_info_default.tmz_date.tm_mon = tm->tm_mon;
         zip_info_default.tmz_date.tm_year = tm->tm_year;
 
-        // zip to memory if less than 1GB and not applet mode.
-        // TODO: use my mmz code from ftpsrv to stream zip creation.
-        // this will allow for zipping to memory and flushing every X bytes
-        // such as flushing every 8MB.
-        const auto file_download = App::IsApplet() || e.size >= 1024ULL * 1024ULL * 1024ULL;
-
-        mz::MzMem mz_mem{};
-        zlib_filefunc64_def file_func;
-        if (!file_download) {
-            mz::FileFuncMem(&mz_mem, &file_func);
-        } else {
-            dump::FileFuncWriter(writer, &file_func);
-        }
+        // the zip is streamed out to the writer as it's created, flushing every 8MiB.
+        mz::StreamWriter zip_writer{[&](const void* data, s64 off, s64 size) -> Result {
+            return writer->Write(data, off, size);
+        }};
 
+        // add save meta.
         {
-            auto zfile = zipOpen2_64(path, APPEND_STATUS_CREATE, nullptr, &file_func);
-            R_UNLESS(zfile, Result_ZipOpen2_64);
-            ON_SCOPE_EXIT(zipClose(zfile, "sphaira v" APP_DISPLAY_VERSION));
-
-            // add save meta.
-            {
-                const NXSaveMeta meta{
-                    .magic = NX_SAVE_META_MAGIC,
-                    .version = NX_SAVE_META_VERSION,
-                    .attr = extra.attr,
-                    .owner_id = extra.owner_id,
-                    .timestamp = extra.timestamp,
-                    .flags = extra.flags,
-                    .unk_x54 = extra.unk_x54,
-                    .data_size = extra.data_size,
-                    .journal_size = extra.journal_size,
-                    .commit_id = extra.commit_id,
-                    .raw_size = e.size,
-                };
-
-                R_UNLESS(ZIP_OK == zipOpenNewFileInZip(zfile, NX_SAVE_META_NAME, &zip_info_default, NULL, 0, NULL, 0, NULL, Z_DEFLATED, Z_NO_COMPRESSION), Result_ZipOpenNewFileInZip);
-                ON_SCOPE_EXIT(zipCloseFileInZip(zfile));
-                R_UNLESS(ZIP_OK == zipWriteInFileInZip(zfile, &meta, sizeof(meta)), Result_ZipWriteInFileInZip);
-            }
+            const NXSaveMeta meta{
+                .magic = NX_SAVE_META_MAGIC,
+                .version = NX_SAVE_META_VERSION,
+                .attr = extra.attr,
+                .owner_id = extra.owner_id,
+                .timestamp = extra.timestamp,
+                .flags = extra.flags,
+                .unk_x54 = extra.unk_x54,
+                .data_size = extra.data_size,
+                .journal_size = extra.journal_size,
+                .commit_id = extra.commit_id,
+                .raw_size = e.size,
+            };
 
-            const auto zip_add = [&](const fs::FsPath& file_path) -> Result {
-                const char* file_name_in_zip = file_path.s;
+            R_TRY(zip_writer.OpenEntry(NX_SAVE_META_NAME, zip_info_default, mz::mmz_Compression_None, sizeof(meta)));
+            R_TRY(zip_writer.WriteEntry(&meta, sizeof(meta)));
+            R_TRY(zip_writer.CloseEntry(crc32CalculateWithSeed(0, &meta, sizeof(meta)), sizeof(meta)));
+        }
 
-                // strip root path (/ or ums0:)
-                if (!std::strncmp(file_name_in_zip, save_fs.Root(), std::strlen(save_fs.Root()))) {
-                    file_name_in_zip += std::strlen(save_fs.Root());
-                }
+        // compresses on the calling thread if the threads fail to start.
+        utils::ParallelDeflate deflate;
+        if (R_FAILED(deflate.Start())) {
+            deflate.Close();
+        }
 
-                // root paths are banned in zips, they will warn when extracting otherwise.
-                while (file_name_in_zip[0] == '/') {
-                    file_name_in_zip++;
-                }
+        const auto zip_add = [&](const fs::FsPath& file_path) -> Result {
+            const char* file_name_in_zip = file_path.s;
 
-                pbox->NewTransfer(file_name_in_zip);
+            // strip root path (/ or ums0:)
+            if (!std::strncmp(file_name_in_zip, save_fs.Root(), std::strlen(save_fs.Root()))) {
+                file_name_in_zip += std::strlen(save_fs.Root());
+            }
 
-                const auto level = compressed ? Z_DEFAULT_COMPRESSION : Z_NO_COMPRESSION;
-                if (ZIP_OK != zipOpenNewFileInZip(zfile, file_name_in_zip, &zip_info_default, NULL, 0, NULL, 0, NULL, Z_DEFLATED, level)) {
-                    log_write("failed to add zip for %s\n", file_path.s);
-                    R_THROW(Result_ZipOpenNewFileInZip);
-                }
-                ON_SCOPE_EXIT(zipCloseFileInZip(zfile));
+            // root paths are banned in zips, they will warn when extracting otherwise.
+            while (file_name_in_zip[0] == '/') {
+                file_name_in_zip++;
+            }
 
-                return thread::TransferZip(pbox, zfile, &save_fs, file_path);
-            };
+            pbox->NewTransfer(file_name_in_zip);
 
-            // loop through every save file and store to zip.
-            for (const auto& collection : collections) {
-                for (const auto& file : collection.files) {
-                    const auto file_path = fs::AppendPath(collection.path, file.name);
-                    R_TRY(zip_add(file_path));
-                }
+            const auto level = compressed ? Z_DEFAULT_COMPRESSION : Z_NO_COMPRESSION;
+            return thread::TransferZip(pbox, deflate, zip_writer, &save_fs, file_path, file_name_in_zip, &zip_info_default, level);
+        };
+
+        // loop through every save file and store to zip.
+        for (const auto& collection : collections) {
+            for (const auto& file : collection.files) {
+                const auto file_path = fs::AppendPath(collection.path, file.name);
+                R_TRY(zip_add(file_path));
             }
         }
 
-        // if we dumped the save to ram, flush the data to file.
-        if (!file_download) {
-            pbox->NewTransfer("Flushing zip to file"_i18n);
-            R_TRY(writer->SetSize(mz_mem.buf.size()));
-
-            R_TRY(thread::Transfer(pbox, mz_mem.buf.size(),
-                [&](void* data, s64 off, s64 size, u64* bytes_read) -> Result {
-                    size = std::min<s64>(size, mz_mem.buf.size() - off);
-                    std::memcpy(data, mz_mem.buf.data() + off, size);
-                    *bytes_read = size;
-                    R_SUCCEED();
-                },
-                [&](const void* data, s64 off, s64 size) -> Result {
-                    return writer->Write(data, off, size);
-                }
-            ));
-        }
+        R_TRY(zip_writer.Close("sphaira v" APP_DISPLAY_VERSION));
+
+        // the output was created with the size of the save, set it to the size of the zip.
+        R_TRY(writer->SetSize(zip_writer.GetSize()));
 
         R_SUCCEED();
     });
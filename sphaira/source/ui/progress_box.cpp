@@ -9,6 +9,8 @@
 
 #include "utils/utils.hpp"
 #include "utils/thread.hpp"
+#include "utils/buffer_pool.hpp"
+#include "utils/throttle.hpp"
 
 #include <cstring>
 #include <cmath>
@@ -77,6 +79,11 @@ ProgressBox::~ProgressBox() {
         m_done(m_thread_data.result);
     }
 
+    // the transfer buffers are only reused for the lifetime of the box
+    // (ie, a bulk copy or install), free them now that it's done.
+    utils::BufferPool::LogStats();
+    utils::BufferPool::Trim();
+
     App::SetBoostMode(false);
     App::SetAutoSleepDisabled(false);
 }
@@ -214,6 +221,12 @@ auto ProgressBox::NewTransfer(const std::string& transfer)  -> ProgressBox& {
     return *this;
 }
 
+auto ProgressBox::SetTransferName(const std::string& transfer) -> ProgressBox& {
+    SCOPED_MUTEX(&m_mutex);
+    m_transfer = transfer;
+    return *this;
+}
+
 auto ProgressBox::ResetTranfser() -> ProgressBox& {
     SCOPED_MUTEX(&m_mutex);
     m_size = 0;
@@ -313,23 +326,18 @@ auto ProgressBox::CopyFile(fs::Fs* fs_src, fs::Fs* fs_dst, const fs::FsPath& src
 
     R_TRY(thread::Transfer(this, src_size,
         [&](void* data, s64 off, s64 size, u64* bytes_read) -> Result {
-            const auto rc = src_file.Read(off, data, size, 0, bytes_read);
-
-            if (is_both_native && is_file_based_emummc) {
-                svcSleepThread(2e+6); // 2ms
-            }
-
-            return rc;
+            return src_file.Read(off, data, size, 0, bytes_read);
         },
         [&](const void* data, s64 off, s64 size) -> Result {
             const auto rc = dst_file.Write(off, data, size, 0);
 
+            // the bucket is only charged here, as each chunk is read and then written.
             if (is_both_native && is_file_based_emummc) {
-                svcSleepThread(2e+6); // 2ms
+                utils::ThrottleEmummc(size);
             }
 
             return rc;
-        }, single_threaded ? thread::Mode::SingleThreaded : thread::Mode::MultiThreaded
+        }, single_threaded ? thread::Mode::SingleThreaded : thread::Mode::Adaptive
     ));
 
     R_SUCCEED();
@@ -26,7 +26,6 @@
 namespace sphaira::usb {
 namespace {
 
-constexpr u64 TRANSFER_ALIGN = 0x1000;
 constexpr u64 TRANSFER_MAX = 1024*1024*16;
 static_assert(!(TRANSFER_MAX % TRANSFER_ALIGN));
 
@@ -37,11 +36,15 @@ Base::Base(u64 transfer_timeout) {
 
     m_transfer_timeout = transfer_timeout;
     ueventCreate(GetCancelEvent(), false);
-    m_aligned = std::make_unique<u8*>(new(std::align_val_t{TRANSFER_ALIGN}) u8[TRANSFER_MAX]);
+    m_aligned = LeaseBuffer(TRANSFER_MAX);
 }
 
 Base::~Base() {
     App::SetAutoSleepDisabled(false);
+
+    if (m_bytes_transferred) {
+        log_write("[USB] transferred: %.2f MiB copied: %.2f MiB\n", m_bytes_transferred / 1024.0 / 1024.0, m_bytes_copied / 1024.0 / 1024.0);
+    }
 }
 
 Result Base::TransferPacketImpl(bool read, void *page, u32 remaining, u32 size, u32 *out_size_transferred, u64 timeout) {
@@ -61,35 +64,41 @@ Result Base::TransferPacketImpl(bool read, void *page, u32 remaining, u32 size,
     return GetTransferResult(ep, xfer_id, nullptr, out_size_transferred);
 }
 
-// while it may seem like a bad idea to transfer data to a buffer and copy it
-// in practice, this has no impact on performance.
-// the switch is *massively* bottlenecked by slow io (nand and sd).
-// so making usb transfers zero-copy provides no benefit other than increased
-// code complexity and the increase of future bugs if/when sphaira is forked
-// an changes are made.
-// yati already goes to great lengths to be zero-copy during installing
-// by swapping buffers and inflating in-place.
+// page aligned data is transferred in place, anything else goes through the bounce buffer.
+// reads only transfer whole pages in place as the transfer may touch the rest
+// of the last page, which could belong to something else.
+// the pipeline buffers come from utils::BufferPool which are page aligned, so
+// yati and thread::Transfer reads land in place.
 Result Base::TransferAll(bool read, void *data, u32 size, u64 timeout) {
     auto buf = static_cast<u8*>(data);
-    auto transfer_buf = *m_aligned;
+    auto transfer_buf = m_aligned.data();
 
-    R_UNLESS(!((u64)transfer_buf & 0xFFF), Result_UsbBadBufferAlign);
+    R_UNLESS(!((u64)transfer_buf & (TRANSFER_ALIGN - 1)), Result_UsbBadBufferAlign);
     R_UNLESS(size <= TRANSFER_MAX, Result_UsbBadTransferSize);
 
     while (size) {
-        if (!read) {
-            std::memcpy(transfer_buf, buf, size);
+        const auto aligned = !((u64)buf & (TRANSFER_ALIGN - 1));
+        const u32 direct_size = read ? size & ~(TRANSFER_ALIGN - 1) : size;
+        const auto direct = aligned && direct_size;
+        const u32 xfer_size = direct ? direct_size : size;
+
+        if (!direct && !read) {
+            std::memcpy(transfer_buf, buf, xfer_size);
         }
 
         u32 out_size_transferred;
-        R_TRY(TransferPacketImpl(read, transfer_buf, size, size, &out_size_transferred, timeout));
+        R_TRY(TransferPacketImpl(read, direct ? buf : transfer_buf, xfer_size, xfer_size, &out_size_transferred, timeout));
         R_UNLESS(out_size_transferred > 0, Result_UsbEmptyTransferSize);
-        R_UNLESS(out_size_transferred <= size, Result_UsbOverflowTransferSize);
+        R_UNLESS(out_size_transferred <= xfer_size, Result_UsbOverflowTransferSize);
 
-        if (read) {
-            std::memcpy(buf, transfer_buf, out_size_transferred);
+        if (!direct) {
+            if (read) {
+                std::memcpy(buf, transfer_buf, out_size_transferred);
+            }
+            m_bytes_copied += out_size_transferred;
         }
 
+        m_bytes_transferred += out_size_transferred;
         buf += out_size_transferred;
         size -= out_size_transferred;
     }
@@ -4,6 +4,8 @@
 #include "log.hpp"
 
 #include <ranges>
+#include <algorithm>
+#include <cstring>
 
 namespace sphaira::usb::install {
 namespace {
@@ -35,10 +37,18 @@ Result Usb::WaitForConnection(u64 timeout, std::vector<std::string>& out_names)
     R_TRY(m_open_result);
     R_TRY(m_usb->IsUsbConnected(timeout));
 
-    const auto send_header = SendPacket::Build(RESULT_OK);
+    const auto send_header = SendPacket::Build(RESULT_OK, PROTOCOL_VERSION_2, INFLIGHT_MAX);
     ResultPacket recv_header;
     R_TRY(SendAndVerify(&send_header, sizeof(send_header), timeout, &recv_header))
 
+    // v1 hosts reply with 0.
+    m_inflight_max = std::min<u32>(recv_header.arg4, INFLIGHT_MAX);
+    log_write("[USB] max requests in flight: %u\n", m_inflight_max);
+    if (m_inflight_max && !m_leftover.data()) {
+        // requests are received straight into this, so it skips the bounce buffer.
+        m_leftover = m_usb->LeaseBuffer(INFLIGHT_CHUNK_SIZE);
+    }
+
     std::vector<char> names(recv_header.arg3);
     R_TRY(m_usb->TransferAll(true, names.data(), names.size(), timeout));
 
@@ -67,10 +77,17 @@ Result Usb::OpenFile(u32 index, s64& file_size) {
 
     m_flags = flags;
     file_size = ((u64)file_size_msb << 32) | file_size_lsb;
+
+    m_file_size = file_size;
+    m_requests.clear();
+    m_leftover_size = m_leftover_pos = 0;
+    m_stream_off = m_request_off = 0;
     R_SUCCEED();
 }
 
 Result Usb::CloseFile() {
+    // the host replies to every request before it reads the close.
+    R_TRY(DrainRequests());
     const auto send_header = SendDataPacket::Build(0, 0, 0);
 
     return SendAndVerify(&send_header, sizeof(send_header));
@@ -85,6 +102,10 @@ u32 Usb::GetFlags() const {
 }
 
 Result Usb::Read(void* buf, u64 off, u32 size, u64* bytes_read) {
+    if (m_inflight_max > 1) {
+        return ReadPipelined(buf, off, size, bytes_read);
+    }
+
     const auto send_header = SendDataPacket::Build(off, size, 0);
     ResultPacket recv_header;
     R_TRY(SendAndVerify(&send_header, sizeof(send_header), &recv_header))
@@ -94,12 +115,120 @@ Result Usb::Read(void* buf, u64 off, u32 size, u64* bytes_read) {
     R_TRY(m_usb->TransferAll(true, buf, size));
 
     // verify crc32c.
-    R_UNLESS(crc32cCalculate(buf, size) == recv_header.arg4, 3);
+    R_UNLESS(crc32cCalculate(buf, size) == recv_header.arg4, Result_UsbBadCrc);
+
+    *bytes_read = size;
+    R_SUCCEED();
+}
+
+// reads are served from a stream of fixed size requests, so that several requests
+// can be in flight regardless of the size of each read.
+// requests are only sent ahead of the current offset, a read outside of the
+// requests in flight drains them and starts a new stream.
+Result Usb::ReadPipelined(void* buf, u64 off, u32 size, u64* bytes_read) {
+    *bytes_read = 0;
+    if (off >= m_file_size) {
+        R_SUCCEED();
+    }
 
+    size = std::min<u64>(size, m_file_size - off);
+
+    if (off < m_stream_off || off > m_request_off) {
+        R_TRY(DrainRequests());
+        m_stream_off = m_request_off = off;
+    } else if (off > m_stream_off) {
+        // skipping forwards, the data is already on its way so read past it.
+        R_TRY(Consume(nullptr, off - m_stream_off));
+    }
+
+    R_TRY(Consume(static_cast<u8*>(buf), size));
     *bytes_read = size;
     R_SUCCEED();
 }
 
+Result Usb::QueueRequests() {
+    while (m_requests.size() < m_inflight_max && m_request_off < m_file_size) {
+        const auto size = std::min<u64>(INFLIGHT_CHUNK_SIZE, m_file_size - m_request_off);
+
+        // no result is sent back until the data is sent.
+        const auto send_header = SendDataPacket::Build(m_request_off, size, 0);
+        R_TRY(m_usb->TransferAll(false, const_cast<SendDataPacket*>(&send_header), sizeof(send_header)));
+
+        m_requests.emplace_back(m_request_off, size);
+        m_request_off += size;
+    }
+
+    R_SUCCEED();
+}
+
+Result Usb::ReceiveRequest(void* data) {
+    R_UNLESS(!m_requests.empty(), Result_UsbBadTransferSize);
+    const auto request = m_requests.front();
+    m_requests.pop_front();
+
+    ResultPacket recv_header;
+    R_TRY(m_usb->TransferAll(true, &recv_header, sizeof(recv_header)));
+    R_TRY(recv_header.Verify());
+
+    // the request is clipped to the file size, so the host always sends all of it.
+    const auto size = recv_header.arg3;
+    R_UNLESS(size == request.size, Result_UsbBadTransferSize);
+
+    if (!data) {
+        m_leftover_size = size;
+        data = m_leftover.data();
+    }
+
+    R_TRY(m_usb->TransferAll(true, data, size));
+    R_UNLESS(crc32cCalculate(data, size) == recv_header.arg4, Result_UsbBadCrc);
+    R_SUCCEED();
+}
+
+Result Usb::Consume(u8* out, u64 size) {
+    while (size) {
+        // use up the previously received request first.
+        if (m_leftover_pos < m_leftover_size) {
+            const auto csize = std::min<u64>(size, m_leftover_size - m_leftover_pos);
+            if (out) {
+                std::memcpy(out, m_leftover.data() + m_leftover_pos, csize);
+                m_usb->AddCopied(csize);
+                out += csize;
+            }
+
+            m_leftover_pos += csize;
+            m_stream_off += csize;
+            size -= csize;
+            continue;
+        }
+
+        R_TRY(QueueRequests());
+        const auto request_size = m_requests.empty() ? 0 : m_requests.front().size;
+
+        // receive straight into the output if the whole request is wanted,
+        // this is zero-copy if the output is page aligned.
+        if (out && size >= request_size) {
+            R_TRY(ReceiveRequest(out));
+            out += request_size;
+            m_stream_off += request_size;
+            size -= request_size;
+        } else {
+            R_TRY(ReceiveRequest(nullptr));
+            m_leftover_pos = 0;
+        }
+    }
+
+    R_SUCCEED();
+}
+
+Result Usb::DrainRequests() {
+    while (!m_requests.empty()) {
+        R_TRY(ReceiveRequest(nullptr));
+    }
+
+    m_leftover_size = m_leftover_pos = 0;
+    R_SUCCEED();
+}
+
 // casts away const, but it does not modify the buffer!
 Result Usb::SendAndVerify(const void* data, u32 size, u64 timeout, ResultPacket* out) {
     R_TRY(m_usb->TransferAll(false, const_cast<void*>(data), size, timeout));
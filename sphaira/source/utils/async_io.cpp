@@ -0,0 +1,362 @@
+#include "utils/async_io.hpp"
+
+#include <poll.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+namespace sphaira::utils {
+
+void AsyncSlot::Complete(int status) {
+    // the library has finished with the buffer, nobody else is left to free it.
+    if (orphaned) {
+        delete this;
+        return;
+    }
+
+    if (status < 0) {
+        result = status;
+    } else {
+        size = std::min<u32>(status, requested);
+    }
+
+    completed = Clock::now();
+    state = State::Ready;
+}
+
+AsyncQueue::AsyncQueue(std::unique_ptr<AsyncBackend>&& backend, u32 request_size, u32 max_requests)
+: m_backend{std::move(backend)}
+, m_request_size{std::max<u32>(request_size, 1)}
+, m_slots(std::max<u32>(max_requests, 1)) {
+    for (auto& slot : m_slots) {
+        slot = std::make_unique<AsyncSlot>();
+    }
+}
+
+AsyncQueue::~AsyncQueue() {
+    // waits for the requests in flight through the service loop.
+    // if the connection failed, the library still owns the pending requests
+    // and calls them back once they time out or the context is destroyed,
+    // so those slots are handed over and free themselves in Complete().
+    if (Drain() < 0) {
+        for (auto& slot : m_slots) {
+            if (slot->state == AsyncSlot::State::Pending) {
+                slot.release()->orphaned = true;
+            }
+        }
+    }
+}
+
+void AsyncQueue::Prepare(AsyncSlot& slot, u32 size) {
+    slot.data.resize(size);
+    slot.requested = size;
+    slot.size = 0;
+    slot.consumed = 0;
+    slot.result = 0;
+}
+
+int AsyncQueue::SubmitRead(AsyncSlot& slot, u64 off) {
+    return Submit(slot, m_backend->ReadAsync(slot.data.data(), slot.requested, off, &slot));
+}
+
+int AsyncQueue::SubmitWrite(AsyncSlot& slot, u64 off) {
+    return Submit(slot, m_backend->WriteAsync(slot.data.data(), slot.requested, off, &slot));
+}
+
+void AsyncQueue::Pop() {
+    Head().state = AsyncSlot::State::Free;
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+}
+
+int AsyncQueue::Service(int timeout_ms) {
+    if (m_broken) {
+        return -EIO;
+    }
+
+    pollfd pfd{};
+    pfd.fd = m_backend->GetFd();
+    pfd.events = m_backend->WhichEvents();
+
+    const auto rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0) {
+        m_broken = true;
+        return -errno;
+    }
+
+    // called on timeout as well, so that the library can time out requests.
+    if ((rc || timeout_ms) && m_backend->Service(rc ? pfd.revents : 0) < 0) {
+        m_broken = true;
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int AsyncQueue::WaitHead() {
+    while (Head().state == AsyncSlot::State::Pending) {
+        if (const auto rc = Service(); rc < 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+int AsyncQueue::Drain() {
+    while (!m_broken && HasPending()) {
+        if (const auto rc = Service(); rc < 0) {
+            return rc;
+        }
+    }
+
+    if (m_broken) {
+        return -EIO;
+    }
+
+    for (auto& slot : m_slots) {
+        slot->state = AsyncSlot::State::Free;
+    }
+
+    m_count = 0;
+    return 0;
+}
+
+auto AsyncQueue::HasPending() const -> bool {
+    return std::ranges::any_of(m_slots, [](const auto& slot) {
+        return slot->state == AsyncSlot::State::Pending;
+    });
+}
+
+auto AsyncQueue::Rtt(const AsyncSlot& slot) const -> u64 {
+    return std::chrono::duration_cast<std::chrono::microseconds>(slot.completed - slot.issued).count();
+}
+
+int AsyncQueue::Submit(AsyncSlot& slot, int rc) {
+    if (rc < 0) {
+        slot.state = AsyncSlot::State::Free;
+        return rc;
+    }
+
+    m_count++;
+    return 0;
+}
+
+AsyncReadAhead::AsyncReadAhead(std::unique_ptr<AsyncBackend>&& backend, u64 file_size, u32 request_size, u32 max_requests)
+: AsyncQueue{std::move(backend), request_size, max_requests}
+, m_size{file_size} {
+}
+
+ssize_t AsyncReadAhead::Read(void* buf, u64 off, size_t len) {
+    UpdateReaderRate();
+    const auto ret = ReadInternal(static_cast<u8*>(buf), off, len);
+
+    m_last_read_len = std::max<ssize_t>(ret, 0);
+    m_last_read_end = Clock::now();
+    return ret;
+}
+
+ssize_t AsyncReadAhead::ReadInternal(u8* buf, u64 off, size_t len) {
+    // not sequential, everything in flight is for the wrong offset.
+    if (off != m_read_off) {
+        if (const auto rc = Drain(); rc < 0) {
+            return rc;
+        }
+
+        m_read_off = m_next_off = off;
+        m_window = 1;
+    }
+
+    // pick up the replies that have already arrived, so their rtt is accurate.
+    if (const auto rc = Service(0); rc < 0) {
+        return rc;
+    }
+
+    size_t done{};
+    while (done < len && m_read_off < m_size) {
+        if (const auto rc = Fill(); rc < 0) {
+            return done ? done : rc;
+        }
+
+        auto& slot = Head();
+        if (const auto rc = WaitHead(); rc < 0) {
+            return done ? done : rc;
+        }
+
+        if (slot.result < 0) {
+            const auto rc = slot.result;
+            // start again from here on the next read.
+            Drain();
+            m_next_off = m_read_off;
+            m_window = 1;
+            return done ? done : rc;
+        }
+
+        const auto size = std::min<size_t>(len - done, slot.size - slot.consumed);
+        std::memcpy(buf + done, slot.data.data() + slot.consumed, size);
+        slot.consumed += size;
+        done += size;
+        m_read_off += size;
+
+        if (slot.consumed == slot.size) {
+            const auto short_read = slot.size < slot.requested;
+            UpdateWindow(slot);
+            Pop();
+
+            // the file got smaller since it was opened.
+            if (short_read) {
+                Drain();
+                m_size = m_next_off = m_read_off;
+                break;
+            }
+        }
+    }
+
+    return done;
+}
+
+void AsyncReadAhead::UpdateReaderRate() {
+    if (!m_last_read_len) {
+        return;
+    }
+
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_last_read_end).count();
+    const auto rate = static_cast<double>(m_last_read_len) / std::max<s64>(us, 1);
+    m_reader_rate = m_reader_rate ? (m_reader_rate * 7 + rate) / 8 : rate;
+}
+
+void AsyncReadAhead::UpdateWindow(const AsyncSlot& slot) {
+    const auto rtt = Rtt(slot);
+    m_srtt = m_srtt ? (m_srtt * 7 + rtt) / 8 : rtt;
+
+    // requests needed to cover one rtt at the rate the reader uses the data,
+    // plus the one being read.
+    auto target = static_cast<u32>(m_slots.size());
+    if (m_reader_rate) {
+        const auto bytes = m_srtt * m_reader_rate;
+        target = std::clamp<u32>(bytes / m_request_size + 2, 1, m_slots.size());
+    }
+
+    m_window = std::min<u32>(m_window * 2, target);
+}
+
+int AsyncReadAhead::Fill() {
+    while (m_count < m_window && m_next_off < m_size) {
+        auto& slot = Tail();
+        Prepare(slot, std::min<u64>(m_request_size, m_size - m_next_off));
+        slot.state = AsyncSlot::State::Pending;
+        slot.issued = Clock::now();
+
+        if (const auto rc = SubmitRead(slot, m_next_off); rc < 0) {
+            return rc;
+        }
+
+        m_next_off += slot.requested;
+    }
+
+    return 0;
+}
+
+AsyncWriteBehind::~AsyncWriteBehind() {
+    Flush();
+}
+
+ssize_t AsyncWriteBehind::Write(const void* _buf, u64 off, size_t len) {
+    auto buf = static_cast<const u8*>(_buf);
+
+    if (const auto rc = Reap(false); rc < 0) {
+        return rc;
+    }
+
+    // not sequential, send what has been buffered so far.
+    if (m_filling && off != m_write_off) {
+        if (const auto rc = Submit(); rc < 0) {
+            return rc;
+        }
+    }
+
+    size_t done{};
+    while (done < len) {
+        if (!m_filling) {
+            // wait for a free slot.
+            while (m_count == m_slots.size()) {
+                if (const auto rc = Reap(true); rc < 0) {
+                    return rc;
+                }
+            }
+
+            auto& slot = Tail();
+            Prepare(slot, 0);
+            slot.data.reserve(m_request_size);
+            m_slot_off = m_write_off = off + done;
+            m_filling = true;
+        }
+
+        auto& slot = Tail();
+        const auto size = std::min<size_t>(len - done, m_request_size - slot.data.size());
+        slot.data.insert(slot.data.end(), buf + done, buf + done + size);
+        done += size;
+        m_write_off += size;
+
+        if (slot.data.size() == m_request_size) {
+            if (const auto rc = Submit(); rc < 0) {
+                return rc;
+            }
+        }
+    }
+
+    return done;
+}
+
+int AsyncWriteBehind::Flush() {
+    if (m_filling) {
+        if (const auto rc = Submit(); rc < 0) {
+            return rc;
+        }
+    }
+
+    while (m_count) {
+        if (const auto rc = Reap(true); rc < 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+int AsyncWriteBehind::Submit() {
+    auto& slot = Tail();
+    m_filling = false;
+    slot.requested = slot.data.size();
+    slot.state = AsyncSlot::State::Pending;
+    slot.issued = AsyncSlot::Clock::now();
+
+    // the data is dropped, same as a failed write.
+    return SubmitWrite(slot, m_slot_off);
+}
+
+int AsyncWriteBehind::Reap(bool wait) {
+    if (wait && m_count) {
+        if (const auto rc = WaitHead(); rc < 0) {
+            return rc;
+        }
+    } else if (const auto rc = Service(0); rc < 0) {
+        return rc;
+    }
+
+    int error{};
+    while (m_count && Head().state == AsyncSlot::State::Ready) {
+        auto& slot = Head();
+        if (slot.result < 0) {
+            error = error ? error : slot.result;
+        } else if (slot.size < slot.requested) {
+            error = error ? error : -EIO;
+        }
+
+        Pop();
+    }
+
+    return error;
+}
+
+} // namespace sphaira::utils
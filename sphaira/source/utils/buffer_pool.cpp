@@ -0,0 +1,138 @@
+#include "utils/buffer_pool.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+
+#include <array>
+#include <algorithm>
+#include <bit>
+
+namespace sphaira::utils {
+namespace {
+
+// smallest buffer worth pooling, anything smaller is left to the allocator.
+constexpr u64 MIN_CLASS_SIZE = 1024 * 64;
+// 64KiB, 128KiB ... 16MiB.
+constexpr u64 CLASS_COUNT = 9;
+constexpr u64 MAX_CLASS_SIZE = MIN_CLASS_SIZE << (CLASS_COUNT - 1);
+// enough for a few transfers worth of 4MiB buffers.
+constexpr u64 DEFAULT_MAX_CACHED = 1024 * 1024 * 48;
+
+Mutex g_mutex{};
+std::array<std::vector<PoolVector>, CLASS_COUNT> g_free{};
+BufferPoolStats g_stats{};
+u64 g_max_cached{DEFAULT_MAX_CACHED};
+
+// returns the smallest class that can hold size.
+auto GetClassForAcquire(u64 size) -> u32 {
+    size = std::bit_ceil(std::max(size, MIN_CLASS_SIZE));
+    return std::countr_zero(size) - std::countr_zero(MIN_CLASS_SIZE);
+}
+
+// returns the largest class that the capacity can satisfy.
+auto GetClassForRelease(u64 capacity) -> u32 {
+    capacity = std::bit_floor(capacity);
+    return std::countr_zero(capacity) - std::countr_zero(MIN_CLASS_SIZE);
+}
+
+auto GetClassSize(u32 index) -> u64 {
+    return MIN_CLASS_SIZE << index;
+}
+
+void FreeCachedUntil(u64 max) {
+    for (s32 i = CLASS_COUNT - 1; i >= 0 && g_stats.cached > max; i--) {
+        auto& list = g_free[i];
+        while (!list.empty() && g_stats.cached > max) {
+            g_stats.cached -= list.back().capacity();
+            list.pop_back();
+        }
+    }
+}
+
+} // namespace
+
+auto BufferPool::Acquire(u64 size) -> PoolVector {
+    PoolVector buf{};
+
+    // too big to pool, allocate exactly what was asked for.
+    if (size > MAX_CLASS_SIZE) {
+        buf.reserve(size);
+    } else {
+        SCOPED_MUTEX(&g_mutex);
+        const auto index = GetClassForAcquire(size);
+
+        // search the class and the next class up for a free buffer.
+        for (u32 i = index; i < std::min<u32>(index + 2, CLASS_COUNT); i++) {
+            auto& list = g_free[i];
+            if (!list.empty()) {
+                std::swap(buf, list.back());
+                list.pop_back();
+                g_stats.cached -= buf.capacity();
+                g_stats.hits++;
+                break;
+            }
+        }
+
+        if (!buf.capacity()) {
+            g_stats.misses++;
+        }
+    }
+
+    // allocate outside of the lock.
+    if (!buf.capacity()) {
+        buf.reserve(GetClassSize(GetClassForAcquire(size)));
+    }
+
+    SCOPED_MUTEX(&g_mutex);
+    g_stats.leased += buf.capacity();
+    g_stats.peak_leased = std::max(g_stats.peak_leased, g_stats.leased);
+    return buf;
+}
+
+void BufferPool::Release(PoolVector&& buf) {
+    const auto capacity = buf.capacity();
+    if (!capacity) {
+        return;
+    }
+
+    // take ownership so that the buffer is freed outside of the lock.
+    PoolVector old{std::move(buf)};
+    old.clear();
+
+    SCOPED_MUTEX(&g_mutex);
+    // the buffer may have grown whilst it was leased.
+    g_stats.leased -= std::min(g_stats.leased, capacity);
+
+    if (capacity < MIN_CLASS_SIZE || capacity > MAX_CLASS_SIZE || g_stats.cached + capacity > g_max_cached) {
+        return;
+    }
+
+    g_stats.cached += capacity;
+    g_stats.peak_cached = std::max(g_stats.peak_cached, g_stats.cached);
+    g_free[GetClassForRelease(capacity)].emplace_back(std::move(old));
+}
+
+void BufferPool::SetMaxCachedSize(u64 size) {
+    SCOPED_MUTEX(&g_mutex);
+    g_max_cached = size;
+    FreeCachedUntil(g_max_cached);
+}
+
+void BufferPool::Trim() {
+    SCOPED_MUTEX(&g_mutex);
+    FreeCachedUntil(0);
+}
+
+auto BufferPool::GetStats() -> BufferPoolStats {
+    SCOPED_MUTEX(&g_mutex);
+    return g_stats;
+}
+
+void BufferPool::LogStats() {
+    const auto stats = GetStats();
+    log_write("[POOL] leased: %.2f MiB (peak %.2f MiB) cached: %.2f MiB (peak %.2f MiB) hits: %zu misses: %zu\n",
+        stats.leased / 1024.0 / 1024.0, stats.peak_leased / 1024.0 / 1024.0,
+        stats.cached / 1024.0 / 1024.0, stats.peak_cached / 1024.0 / 1024.0,
+        stats.hits, stats.misses);
+}
+
+} // namespace sphaira::utils
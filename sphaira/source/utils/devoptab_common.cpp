@@ -21,6 +21,9 @@ namespace {
 
 RwLock g_rwlock{};
 
+// number of unused transfer handles kept by each curl device.
+constexpr size_t MAX_IDLE_TRANSFER_CURLS = 4;
+
 // curl_url_strerror doesn't exist in the switch version of libcurl as its so old.
 // todo: update libcurl and send patches to dkp.
 const char* curl_url_strerror_wrap(CURLUcode code) {
@@ -59,13 +62,24 @@ struct Device {
 struct File {
     Device* device;
     void* fd;
+    Mutex mutex;
 };
 
 struct Dir {
     Device* device;
     void* fd;
+    Mutex mutex;
 };
 
+// calls on an open file / dir only need to lock that file / dir
+// if the device gives each of them their own session.
+Mutex* get_handle_mutex(Device* device, Mutex* handle_mutex) {
+    if (device->mount_device->IsFileConcurrent()) {
+        return handle_mutex;
+    }
+    return &device->mutex;
+}
+
 int set_errno(struct _reent *r, int err) {
     r->_errno = err;
     return -1;
@@ -110,21 +124,32 @@ int devoptab_open(struct _reent *r, void *fileStruct, const char *_path, int fla
 int devoptab_close(struct _reent *r, void *fd) {
     auto file = static_cast<File*>(fd);
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&file->device->mutex);
 
-    if (file->fd) {
-        file->device->mount_device->devoptab_close(file->fd);
-        free(file->fd);
+    // the device is locked as closing may update state shared with other files.
+    int ret{};
+    {
+        SCOPED_MUTEX(&file->mutex);
+        SCOPED_MUTEX(&file->device->mutex);
+
+        // the file is closed even if this fails, ie, buffered writes failed to flush.
+        if (file->fd) {
+            ret = file->device->mount_device->devoptab_close(file->fd);
+            free(file->fd);
+        }
     }
 
     std::memset(file, 0, sizeof(*file));
+    if (ret < 0) {
+        return set_errno(r, -ret);
+    }
+
     return r->_errno = 0;
 }
 
 ssize_t devoptab_read(struct _reent *r, void *fd, char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&file->device->mutex);
+    SCOPED_MUTEX(get_handle_mutex(file->device, &file->mutex));
 
     const auto ret = file->device->mount_device->devoptab_read(file->fd, ptr, len);
     if (ret < 0) {
@@ -137,7 +162,7 @@ ssize_t devoptab_read(struct _reent *r, void *fd, char *ptr, size_t len) {
 ssize_t devoptab_write(struct _reent *r, void *fd, const char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&file->device->mutex);
+    SCOPED_MUTEX(get_handle_mutex(file->device, &file->mutex));
 
     const auto ret = file->device->mount_device->devoptab_write(file->fd, ptr, len);
     if (ret < 0) {
@@ -150,7 +175,7 @@ ssize_t devoptab_write(struct _reent *r, void *fd, const char *ptr, size_t len)
 off_t devoptab_seek(struct _reent *r, void *fd, off_t pos, int dir) {
     auto file = static_cast<File*>(fd);
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&file->device->mutex);
+    SCOPED_MUTEX(get_handle_mutex(file->device, &file->mutex));
 
     const auto ret = file->device->mount_device->devoptab_seek(file->fd, pos, dir);
     if (ret < 0) {
@@ -166,7 +191,7 @@ int devoptab_fstat(struct _reent *r, void *fd, struct stat *st) {
     auto file = static_cast<File*>(fd);
     std::memset(st, 0, sizeof(*st));
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&file->device->mutex);
+    SCOPED_MUTEX(get_handle_mutex(file->device, &file->mutex));
 
     const auto ret = file->device->mount_device->devoptab_fstat(file->fd, st);
     if (ret) {
@@ -340,7 +365,7 @@ DIR_ITER* devoptab_diropen(struct _reent *r, DIR_ITER *dirState, const char *_pa
 int devoptab_dirreset(struct _reent *r, DIR_ITER *dirState) {
     auto dir = static_cast<Dir*>(dirState->dirStruct);
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&dir->device->mutex);
+    SCOPED_MUTEX(get_handle_mutex(dir->device, &dir->mutex));
 
     const auto ret = dir->device->mount_device->devoptab_dirreset(dir->fd);
     if (ret) {
@@ -354,7 +379,7 @@ int devoptab_dirnext(struct _reent *r, DIR_ITER *dirState, char *filename, struc
     auto dir = static_cast<Dir*>(dirState->dirStruct);
     std::memset(filestat, 0, sizeof(*filestat));
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&dir->device->mutex);
+    SCOPED_MUTEX(get_handle_mutex(dir->device, &dir->mutex));
 
     const auto ret = dir->device->mount_device->devoptab_dirnext(dir->fd, filename, filestat);
     if (ret) {
@@ -367,11 +392,15 @@ int devoptab_dirnext(struct _reent *r, DIR_ITER *dirState, char *filename, struc
 int devoptab_dirclose(struct _reent *r, DIR_ITER *dirState) {
     auto dir = static_cast<Dir*>(dirState->dirStruct);
     SCOPED_RWLOCK(&g_rwlock, false);
-    SCOPED_MUTEX(&dir->device->mutex);
 
-    if (dir->fd) {
-        dir->device->mount_device->devoptab_dirclose(dir->fd);
-        free(dir->fd);
+    {
+        SCOPED_MUTEX(&dir->mutex);
+        SCOPED_MUTEX(&dir->device->mutex);
+
+        if (dir->fd) {
+            dir->device->mount_device->devoptab_dirclose(dir->fd);
+            free(dir->fd);
+        }
     }
 
     std::memset(dir, 0, sizeof(*dir));
@@ -411,12 +440,14 @@ int devoptab_lstat(struct _reent *r, const char *_path, struct stat *st) {
 
 int devoptab_ftruncate(struct _reent *r, void *fd, off_t len) {
     auto file = static_cast<File*>(fd);
-    SCOPED_MUTEX(&file->device->mutex);
+    SCOPED_RWLOCK(&g_rwlock, false);
 
     if (!file || !file->fd) {
         return set_errno(r, EBADF);
     }
 
+    SCOPED_MUTEX(get_handle_mutex(file->device, &file->mutex));
+
     if (file->device->config.read_only) {
         return set_errno(r, EROFS);
     }
@@ -454,12 +485,14 @@ int devoptab_statvfs(struct _reent *r, const char *_path, struct statvfs *buf) {
 
 int devoptab_fsync(struct _reent *r, void *fd) {
     auto file = static_cast<File*>(fd);
-    SCOPED_MUTEX(&file->device->mutex);
+    SCOPED_RWLOCK(&g_rwlock, false);
 
     if (!file || !file->fd) {
         return set_errno(r, EBADF);
     }
 
+    SCOPED_MUTEX(get_handle_mutex(file->device, &file->mutex));
+
     if (file->device->config.read_only) {
         return set_errno(r, EROFS);
     }
@@ -608,6 +641,54 @@ Result BufferedData::Read(void *_buffer, s64 file_off, s64 read_size, u64* bytes
     R_SUCCEED();
 }
 
+auto LruBufferedData::IndexFind(u32 cache, u64 off) const -> BufferedFileData* {
+    const auto block_size = cache ? CACHE_LARGE_INDEX_BLOCK_SIZE : CACHE_SMALL_INDEX_BLOCK_SIZE;
+    const auto [begin, end] = lru_index[cache].equal_range(off / block_size);
+
+    for (auto it = begin; it != end; it++) {
+        const auto entry = it->second;
+        if (off >= entry->off && off < entry->off + entry->size) {
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+void LruBufferedData::IndexAdd(u32 cache, BufferedFileData* entry) {
+    if (!entry->size) {
+        return;
+    }
+
+    const auto block_size = cache ? CACHE_LARGE_INDEX_BLOCK_SIZE : CACHE_SMALL_INDEX_BLOCK_SIZE;
+    const auto first = entry->off / block_size;
+    const auto last = (entry->off + entry->size - 1) / block_size;
+
+    for (auto block = first; block <= last; block++) {
+        lru_index[cache].emplace(block, entry);
+    }
+}
+
+void LruBufferedData::IndexRemove(u32 cache, BufferedFileData* entry) {
+    if (!entry->size) {
+        return;
+    }
+
+    const auto block_size = cache ? CACHE_LARGE_INDEX_BLOCK_SIZE : CACHE_SMALL_INDEX_BLOCK_SIZE;
+    const auto first = entry->off / block_size;
+    const auto last = (entry->off + entry->size - 1) / block_size;
+
+    for (auto block = first; block <= last; block++) {
+        const auto [begin, end] = lru_index[cache].equal_range(block);
+        for (auto it = begin; it != end; it++) {
+            if (it->second == entry) {
+                lru_index[cache].erase(it);
+                break;
+            }
+        }
+    }
+}
+
 Result LruBufferedData::Read(void *_buffer, s64 file_off, s64 read_size, u64* bytes_read) {
     // log_write("[FATFS] read offset: %zu size: %zu\n", file_off, read_size);
     auto dst = static_cast<u8*>(_buffer);
@@ -624,28 +705,23 @@ Result LruBufferedData::Read(void *_buffer, s64 file_off, s64 read_size, u64* by
     // the fix was to have 2 LRU caches, one for large data and the other for small (anything below 16k).
     // the results in file reads 32MB -> 184MB and directory listing is instant.
     const auto large_read = read_size >= 1024 * 16;
-    auto& lru = large_read ? lru_cache[1] : lru_cache[0];
-
-    for (auto list = lru.begin(); list; list = list->next) {
-        const auto& m_buffered = list->data;
-        if (m_buffered->size) {
-            // check if we can read this data into the beginning of dst.
-            if (file_off < m_buffered->off + m_buffered->size && file_off >= m_buffered->off) {
-                const auto off = file_off - m_buffered->off;
-                const auto size = std::min<s64>(read_size, m_buffered->size - off);
-                if (size) {
-                    // log_write("[FAT] cache HIT at: %zu\n", file_off);
-                    std::memcpy(dst, m_buffered->data + off, size);
-
-                    read_size -= size;
-                    file_off += size;
-                    amount += size;
-                    dst += size;
-
-                    lru.Update(list);
-                    break;
-                }
-            }
+    const u32 cache = large_read ? 1 : 0;
+    auto& lru = lru_cache[cache];
+
+    // check if we can read this data into the beginning of dst.
+    if (auto m_buffered = IndexFind(cache, file_off)) {
+        const auto off = file_off - m_buffered->off;
+        const auto size = std::min<s64>(read_size, m_buffered->size - off);
+        if (size) {
+            // log_write("[FAT] cache HIT at: %zu\n", file_off);
+            std::memcpy(dst, m_buffered->data + off, size);
+
+            read_size -= size;
+            file_off += size;
+            amount += size;
+            dst += size;
+
+            lru.Update(m_buffered);
         }
     }
 
@@ -657,6 +733,7 @@ Result LruBufferedData::Read(void *_buffer, s64 file_off, s64 read_size, u64* by
         u64 bytes_read;
 
         auto m_buffered = lru.GetNextFree();
+        IndexRemove(cache, m_buffered);
         m_buffered->Allocate(alloc_size);
 
         // if the dst is big enough, read data in place.
@@ -687,6 +764,8 @@ Result LruBufferedData::Read(void *_buffer, s64 file_off, s64 read_size, u64* by
             amount += max_advance;
             dst += max_advance;
         }
+
+        IndexAdd(cache, m_buffered);
     }
 
     *bytes_read = amount;
@@ -1182,7 +1261,7 @@ MountCurlDevice::~MountCurlDevice() {
         curl_easy_cleanup(curl);
     }
 
-    if (transfer_curl) {
+    for (auto transfer_curl : m_transfer_curls) {
         curl_easy_cleanup(transfer_curl);
     }
 
@@ -1205,14 +1284,6 @@ bool MountCurlDevice::Mount() {
         }
     }
 
-    if (!transfer_curl) {
-        transfer_curl = curl_easy_init();
-        if (!transfer_curl) {
-            log_write("[CURL] transfer curl_easy_init() failed\n");
-            return false;
-        }
-    }
-
     // setup url, only the path is updated at runtime.
     if (!curlu) {
         curlu = curl_url();
@@ -1273,7 +1344,7 @@ bool MountCurlDevice::Mount() {
         }
     }
 
-    // create share handle, used to share info between curl and transfer_curl.
+    // create share handle, used to share info between curl and the transfer handles.
     if (!m_curl_share) {
         m_curl_share = curl_share_init();
         if (!m_curl_share) {
@@ -1319,6 +1390,39 @@ bool MountCurlDevice::Mount() {
     return m_mounted = true;
 }
 
+CURL* MountCurlDevice::AcquireTransferCurl() {
+    {
+        SCOPED_MUTEX(&m_transfer_mutex);
+        if (!m_transfer_curls.empty()) {
+            const auto transfer_curl = m_transfer_curls.back();
+            m_transfer_curls.pop_back();
+            return transfer_curl;
+        }
+    }
+
+    const auto transfer_curl = curl_easy_init();
+    if (!transfer_curl) {
+        log_write("[CURL] transfer curl_easy_init() failed\n");
+    }
+
+    return transfer_curl;
+}
+
+void MountCurlDevice::ReleaseTransferCurl(CURL* transfer_curl) {
+    if (!transfer_curl) {
+        return;
+    }
+
+    SCOPED_MUTEX(&m_transfer_mutex);
+
+    // only keep a few idle handles around.
+    if (m_transfer_curls.size() >= MAX_IDLE_TRANSFER_CURLS) {
+        curl_easy_cleanup(transfer_curl);
+    } else {
+        m_transfer_curls.emplace_back(transfer_curl);
+    }
+}
+
 PushThreadData* MountCurlDevice::CreatePushData(CURL* curl, const std::string& url, size_t offset) {
     auto data = new PushThreadData{curl};
     if (!data) {
@@ -1510,6 +1614,8 @@ std::string MountCurlDevice::build_url(const std::string& _path, bool is_dir) {
         path += '/'; // append trailing slash for folder.
     }
 
+    SCOPED_MUTEX(&m_url_mutex);
+
     if (!m_url_path.empty()) {
         if (path.starts_with('/') || m_url_path.ends_with('/')) {
             path = m_url_path + path;
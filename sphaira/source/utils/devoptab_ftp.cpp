@@ -74,6 +74,7 @@ private:
 struct File {
     FileEntry* entry;
     common::PushPullThreadData* push_pull_thread_data;
+    CURL* transfer_curl;
     size_t off;
     size_t last_off;
     bool write_mode;
@@ -467,6 +468,11 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
         }
     }
 
+    file->transfer_curl = AcquireTransferCurl();
+    if (!file->transfer_curl) {
+        return -ENOMEM;
+    }
+
     file->entry = new FileEntry{path, st};
     file->write_mode = (flags & (O_WRONLY | O_RDWR));
     file->append_mode = (flags & O_APPEND);
@@ -483,6 +489,7 @@ int Device::devoptab_close(void *fd) {
     auto file = static_cast<File*>(fd);
 
     delete file->push_pull_thread_data;
+    ReleaseTransferCurl(file->transfer_curl);
     delete file->entry;
     return 0;
 }
@@ -509,7 +516,7 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 
     if (!file->push_pull_thread_data) {
         log_write("[FTP] Creating download thread data for file: %s\n", file->entry->path.c_str());
-        file->push_pull_thread_data = CreatePushData(this->transfer_curl, build_url(file->entry->path, false), file->off);
+        file->push_pull_thread_data = CreatePushData(file->transfer_curl, build_url(file->entry->path, false), file->off);
         if (!file->push_pull_thread_data) {
             log_write("[FTP] Failed to create download thread data for file: %s\n", file->entry->path.c_str());
             return -EIO;
@@ -537,7 +544,7 @@ ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
 
     if (!file->push_pull_thread_data) {
         log_write("[FTP] Creating upload thread data for file: %s\n", file->entry->path.c_str());
-        file->push_pull_thread_data = CreatePullData(this->transfer_curl, build_url(file->entry->path, false), file->append_mode);
+        file->push_pull_thread_data = CreatePullData(file->transfer_curl, build_url(file->entry->path, false), file->append_mode);
         if (!file->push_pull_thread_data) {
             log_write("[FTP] Failed to create upload thread data for file: %s\n", file->entry->path.c_str());
             return -EIO;
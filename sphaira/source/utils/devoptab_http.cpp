@@ -36,6 +36,7 @@ struct FileEntry {
 struct File {
     FileEntry* entry;
     common::PushPullThreadData* push_pull_thread_data;
+    CURL* transfer_curl;
     size_t off;
     size_t last_off;
 };
@@ -298,6 +299,11 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
         return -EISDIR;
     }
 
+    file->transfer_curl = AcquireTransferCurl();
+    if (!file->transfer_curl) {
+        return -ENOMEM;
+    }
+
     file->entry = new FileEntry{path, st};
     return 0;
 }
@@ -306,6 +312,7 @@ int Device::devoptab_close(void *fd) {
     auto file = static_cast<File*>(fd);
 
     delete file->push_pull_thread_data;
+    ReleaseTransferCurl(file->transfer_curl);
     delete file->entry;
     return 0;
 }
@@ -327,7 +334,7 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 
     if (!file->push_pull_thread_data) {
         log_write("[HTTP] Creating download thread data for file: %s\n", file->entry->path.c_str());
-        file->push_pull_thread_data = CreatePushData(this->transfer_curl, build_url(file->entry->path, false), file->off);
+        file->push_pull_thread_data = CreatePushData(file->transfer_curl, build_url(file->entry->path, false), file->off);
         if (!file->push_pull_thread_data) {
             log_write("[HTTP] Failed to create download thread data for file: %s\n", file->entry->path.c_str());
             return -EIO;
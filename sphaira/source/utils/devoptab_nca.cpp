@@ -3,6 +3,7 @@
 #include "utils/devoptab_romfs.hpp"
 #include "utils/utils.hpp"
 
+#include "app.hpp"
 #include "defines.hpp"
 #include "log.hpp"
 
@@ -366,8 +367,13 @@ Result MountNcaInternal(fs::Fs* fs, const std::shared_ptr<yati::source::Base>& s
         R_TRY(source->Read2(ncz_blocks.data(), ncz_offset, ncz_blocks.size() * sizeof(ncz::Block)));
 
         ncz_offset += ncz_blocks.size() * sizeof(ncz::Block);
+        const ncz::NczBlockReaderConfig ncz_config{
+            .cache_size = u64(std::max(1L, App::GetApp()->m_ncz_cache_size.Get())) * 1024 * 1024,
+            .readahead_blocks = u32(std::clamp(App::GetApp()->m_ncz_readahead_blocks.Get(), 0L, 16L)),
+        };
+
         nca_reader = std::make_unique<ncz::NczBlockReader>(
-            ncz_header, ncz_sections, ncz_block_header, ncz_blocks, ncz_offset, source
+            ncz_header, ncz_sections, ncz_block_header, ncz_blocks, ncz_offset, source, ncz_config
         );
     } else {
         keys::KeyEntry title_key;
@@ -1,4 +1,5 @@
 #include "utils/devoptab_common.hpp"
+#include "utils/async_io.hpp"
 #include "defines.hpp"
 #include "log.hpp"
 
@@ -13,12 +14,63 @@
 namespace sphaira::devoptab {
 namespace {
 
+// size of the read ahead / write behind window of each file, can be changed
+// per mount with "read_ahead" and "write_behind" (KiB, 0 to disable).
+constexpr u32 READ_AHEAD_SIZE_DEFAULT = 1024 * 1024 * 4;
+constexpr u32 WRITE_BEHIND_SIZE_DEFAULT = 1024 * 1024 * 4;
+constexpr u32 ASYNC_REQUESTS_MAX = 16;
+
+struct AsyncBackend final : utils::AsyncBackend {
+    AsyncBackend(nfs_context* _nfs, nfsfh* _fh) : nfs{_nfs}, fh{_fh} {}
+
+    int ReadAsync(void* buf, u32 size, u64 off, utils::AsyncSlot* slot) override {
+        return nfs_pread_async(nfs, fh, buf, size, off, callback, slot);
+    }
+
+    int WriteAsync(const void* buf, u32 size, u64 off, utils::AsyncSlot* slot) override {
+        return nfs_pwrite_async(nfs, fh, buf, size, off, callback, slot);
+    }
+
+    int GetFd() override {
+        return nfs_get_fd(nfs);
+    }
+
+    int WhichEvents() override {
+        return nfs_which_events(nfs);
+    }
+
+    int Service(int revents) override {
+        return nfs_service(nfs, revents);
+    }
+
+private:
+    // err is the number of bytes transferred or a negative errno.
+    static void callback(int err, nfs_context* nfs, void* data, void* private_data) {
+        static_cast<utils::AsyncSlot*>(private_data)->Complete(err);
+    }
+
+private:
+    nfs_context* const nfs;
+    nfsfh* const fh;
+};
+
+struct File;
+
+// a mount of the export, the context isn't thread safe so each open file has its own.
+struct Session {
+    ~Session();
+    bool Connect(const common::MountConfig& config);
+
+    nfs_context* nfs{};
+    bool mounted{};
+};
+
 struct Device final : common::MountDevice {
-    using MountDevice::MountDevice;
-    ~Device();
+    Device(const common::MountConfig& _config);
 
 private:
     bool Mount() override;
+    bool IsFileConcurrent() const override { return true; }
     int devoptab_open(void *fileStruct, const char *path, int flags, int mode) override;
     int devoptab_close(void *fd) override;
     ssize_t devoptab_read(void *fd, char *ptr, size_t len) override;
@@ -39,20 +91,52 @@ private:
     int devoptab_fsync(void *fd) override;
     int devoptab_utimes(const char *path, const struct timeval times[2]) override;
 
+    // sends the buffered writes and waits for them, if the file has write behind.
+    int flush_write_behind(File* file);
+
 private:
+    // used for the path based calls and dirs, which hold the device lock.
+    std::unique_ptr<Session> session{};
+    common::SessionPool<Session> pool{};
+    // context of the session above, set once mounted.
     nfs_context* nfs{};
-    bool mounted{};
+    u32 read_ahead_size{READ_AHEAD_SIZE_DEFAULT};
+    u32 write_behind_size{WRITE_BEHIND_SIZE_DEFAULT};
 };
 
 struct File {
+    // only used by this file, so its calls don't need the device lock.
+    Session* session;
     nfsfh* fd;
+    // files opened read only / write only, which then track their own offset.
+    utils::AsyncReadAhead* readahead;
+    utils::AsyncWriteBehind* writebehind;
+    u64 off;
 };
 
+// returns the size in bytes of a KiB value in the extra config, or def if not set.
+u32 get_window_size(const common::MountConfig& config, const char* key, u32 def) {
+    const auto it = config.extra.find(key);
+    if (it == config.extra.end()) {
+        return def;
+    }
+
+    const auto val = ini_parse_getl(it->second.c_str(), -1);
+    if (val < 0) {
+        log_write("[NFS] Invalid %s value: %s\n", key, it->second.c_str());
+        return def;
+    }
+
+    log_write("[NFS] Setting %s: %ld KiB\n", key, val);
+    return val * 1024;
+}
+
+// the whole dir is read on open, so reading the entries doesn't use the context.
 struct Dir {
     nfsdir* dir;
 };
 
-Device::~Device() {
+Session::~Session() {
     if (nfs) {
         if (mounted) {
             nfs_umount(nfs);
@@ -62,62 +146,56 @@ Device::~Device() {
     }
 }
 
-bool Device::Mount() {
-    if (mounted) {
-        return true;
-    }
-
-    log_write("[NFS] Mounting %s\n", this->config.url.c_str());
+bool Session::Connect(const common::MountConfig& config) {
+    log_write("[NFS] Mounting %s\n", config.url.c_str());
 
+    nfs = nfs_init_context();
     if (!nfs) {
-        nfs = nfs_init_context();
-        if (!nfs) {
-            log_write("[NFS] nfs_init_context() failed\n");
-            return false;
-        }
+        log_write("[NFS] nfs_init_context() failed\n");
+        return false;
+    }
 
-        const auto uid = this->config.extra.find("uid");
-        if (uid != this->config.extra.end()) {
-            const auto uid_val = ini_parse_getl(uid->second.c_str(), -1);
-            if (uid_val < 0) {
-                log_write("[NFS] Invalid uid value: %s\n", uid->second.c_str());
-            } else {
-                log_write("[NFS] Setting uid: %ld\n", uid_val);
-                nfs_set_uid(nfs, uid_val);
-            }
+    const auto uid = config.extra.find("uid");
+    if (uid != config.extra.end()) {
+        const auto uid_val = ini_parse_getl(uid->second.c_str(), -1);
+        if (uid_val < 0) {
+            log_write("[NFS] Invalid uid value: %s\n", uid->second.c_str());
+        } else {
+            log_write("[NFS] Setting uid: %ld\n", uid_val);
+            nfs_set_uid(nfs, uid_val);
         }
+    }
 
-        const auto gid = this->config.extra.find("gid");
-        if (gid != this->config.extra.end()) {
-            const auto gid_val = ini_parse_getl(gid->second.c_str(), -1);
-            if (gid_val < 0) {
-                log_write("[NFS] Invalid gid value: %s\n", gid->second.c_str());
-            } else {
-                log_write("[NFS] Setting gid: %ld\n", gid_val);
-                nfs_set_gid(nfs, gid_val);
-            }
+    const auto gid = config.extra.find("gid");
+    if (gid != config.extra.end()) {
+        const auto gid_val = ini_parse_getl(gid->second.c_str(), -1);
+        if (gid_val < 0) {
+            log_write("[NFS] Invalid gid value: %s\n", gid->second.c_str());
+        } else {
+            log_write("[NFS] Setting gid: %ld\n", gid_val);
+            nfs_set_gid(nfs, gid_val);
         }
+    }
 
-        const auto version = this->config.extra.find("version");
-        if (version != this->config.extra.end()) {
-            const auto version_val = ini_parse_getl(version->second.c_str(), -1);
-            if (version_val != 3 && version_val != 4) {
-                log_write("[NFS] Invalid version value: %s\n", version->second.c_str());
-            } else {
-                log_write("[NFS] Setting version: %ld\n", version_val);
-                nfs_set_version(nfs, version_val);
-            }
+    const auto version = config.extra.find("version");
+    if (version != config.extra.end()) {
+        const auto version_val = ini_parse_getl(version->second.c_str(), -1);
+        if (version_val != 3 && version_val != 4) {
+            log_write("[NFS] Invalid version value: %s\n", version->second.c_str());
+        } else {
+            log_write("[NFS] Setting version: %ld\n", version_val);
+            nfs_set_version(nfs, version_val);
         }
+    }
 
-        if (this->config.timeout > 0) {
-            nfs_set_timeout(nfs, this->config.timeout);
-            nfs_set_readonly(nfs, this->config.read_only);
-        }
-        // nfs_set_mountport(nfs, url->port);
+    if (config.timeout > 0) {
+        nfs_set_timeout(nfs, config.timeout);
+        nfs_set_readonly(nfs, config.read_only);
     }
+    // nfs_set_mountport(nfs, url->port);
 
     // fix the url if needed.
-    auto url = this->config.url;
+    auto url = config.url;
     if (!url.starts_with("nfs://")) {
         log_write("[NFS] Prepending nfs:// to url: %s\n", url.c_str());
         url = "nfs://" + url;
@@ -136,31 +214,116 @@ bool Device::Mount() {
         return false;
     }
 
-    log_write("[NFS] Mounted %s\n", this->config.url.c_str());
+    log_write("[NFS] Mounted %s\n", config.url.c_str());
     return mounted = true;
 }
 
+Device::Device(const common::MountConfig& _config) : MountDevice{_config} {
+    this->read_ahead_size = get_window_size(this->config, "read_ahead", READ_AHEAD_SIZE_DEFAULT);
+    this->write_behind_size = get_window_size(this->config, "write_behind", WRITE_BEHIND_SIZE_DEFAULT);
+}
+
+bool Device::Mount() {
+    if (this->session) {
+        return true;
+    }
+
+    auto session = std::make_unique<Session>();
+    if (!session->Connect(this->config)) {
+        return false;
+    }
+
+    this->session = std::move(session);
+    this->nfs = this->session->nfs;
+    return true;
+}
+
 int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mode) {
     auto file = static_cast<File*>(fileStruct);
 
-    const auto ret = nfs_open(nfs, path, flags, &file->fd);
+    const auto ret = this->pool.Acquire(this->config, &file->session, [&](Session* session) -> int {
+        const auto rc = nfs_open(session->nfs, path, flags, &file->fd);
+        if (rc) {
+            log_write("[NFS] nfs_open() failed: %s errno: %s\n", nfs_get_error(session->nfs), std::strerror(-rc));
+        }
+
+        return rc;
+    });
+
     if (ret) {
-        log_write("[NFS] nfs_open() failed: %s errno: %s\n", nfs_get_error(nfs), std::strerror(-ret));
         return ret;
     }
 
+    const auto nfs = file->session->nfs;
+
+    // keep several rpcs in flight for sequential readers / writers, such as copies and installs.
+    // append writes are left as is, as the offset is picked by the server.
+    if (this->read_ahead_size && (flags & O_ACCMODE) == O_RDONLY) {
+        struct stat st{};
+        const auto ret = nfs_fstat(nfs, file->fd, &st);
+        if (ret) {
+            log_write("[NFS] nfs_fstat() failed: %s errno: %s\n", nfs_get_error(nfs), std::strerror(-ret));
+        } else {
+            const auto request_size = nfs_get_readmax(nfs);
+            const auto max_requests = std::clamp<u32>(this->read_ahead_size / request_size, 1, ASYNC_REQUESTS_MAX);
+            auto backend = std::make_unique<AsyncBackend>(nfs, file->fd);
+            file->readahead = new utils::AsyncReadAhead{std::move(backend), (u64)st.st_size, request_size, max_requests};
+        }
+    } else if (this->write_behind_size && (flags & O_ACCMODE) == O_WRONLY && !(flags & O_APPEND)) {
+        const auto request_size = nfs_get_writemax(nfs);
+        const auto max_requests = std::clamp<u32>(this->write_behind_size / request_size, 1, ASYNC_REQUESTS_MAX);
+        auto backend = std::make_unique<AsyncBackend>(nfs, file->fd);
+        file->writebehind = new utils::AsyncWriteBehind{std::move(backend), request_size, max_requests};
+    }
+
     return 0;
 }
 
 int Device::devoptab_close(void *fd) {
     auto file = static_cast<File*>(fd);
 
-    nfs_close(nfs, file->fd);
+    // the file is still closed if the flush failed, the error is returned
+    // so that the caller knows the data didn't make it.
+    const auto ret = flush_write_behind(file);
+
+    // waits for the rpcs still in flight.
+    delete file->readahead;
+    delete file->writebehind;
+    nfs_close(file->session->nfs, file->fd);
+    this->pool.Release(file->session);
+    return ret;
+}
+
+int Device::flush_write_behind(File* file) {
+    const auto nfs = file->session->nfs;
+
+    if (!file->writebehind) {
+        return 0;
+    }
+
+    const auto ret = file->writebehind->Flush();
+    if (ret < 0) {
+        log_write("[NFS] nfs_pwrite_async() failed: %s errno: %s\n", nfs_get_error(nfs), std::strerror(-ret));
+        return ret;
+    }
+
     return 0;
 }
 
 ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
+    const auto nfs = file->session->nfs;
+
+    if (file->readahead) {
+        const auto ret = file->readahead->Read(ptr, file->off, len);
+        if (ret < 0) {
+            log_write("[NFS] nfs_pread_async() failed: %s errno: %s\n", nfs_get_error(nfs), std::strerror(-ret));
+            return ret;
+        }
+
+        file->off += ret;
+        return ret;
+    }
 
     // todo: uncomment this when it's fixed upstream.
     #if 0
@@ -200,6 +363,18 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 
 ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
+    const auto nfs = file->session->nfs;
+
+    if (file->writebehind) {
+        const auto ret = file->writebehind->Write(ptr, file->off, len);
+        if (ret < 0) {
+            log_write("[NFS] nfs_pwrite_async() failed: %s errno: %s\n", nfs_get_error(nfs), std::strerror(-ret));
+            return ret;
+        }
+
+        file->off += ret;
+        return ret;
+    }
 
     // unlike read, writing the max size seems to work fine.
     const auto max_write = nfs_get_writemax(nfs);
@@ -227,6 +402,26 @@ ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
 
 ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
     auto file = static_cast<File*>(fd);
+    const auto nfs = file->session->nfs;
+
+    // the async rpcs don't use the handle offset.
+    if (file->readahead || file->writebehind) {
+        if (dir == SEEK_CUR) {
+            pos += file->off;
+        } else if (dir == SEEK_END) {
+            struct stat st{};
+            if (const auto ret = devoptab_fstat(fd, &st); ret) {
+                return ret;
+            }
+            pos += st.st_size;
+        }
+
+        if (pos < 0) {
+            return -EINVAL;
+        }
+
+        return file->off = pos;
+    }
 
     u64 current_offset = 0;
     const auto ret = nfs_lseek(nfs, file->fd, pos, dir, &current_offset);
@@ -240,6 +435,11 @@ ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
 
 int Device::devoptab_fstat(void *fd, struct stat *st) {
     auto file = static_cast<File*>(fd);
+    const auto nfs = file->session->nfs;
+
+    if (const auto ret = flush_write_behind(file); ret < 0) {
+        return ret;
+    }
 
     const auto ret = nfs_fstat(nfs, file->fd, st);
     if (ret) {
@@ -356,6 +556,11 @@ int Device::devoptab_lstat(const char *path, struct stat *st) {
 
 int Device::devoptab_ftruncate(void *fd, off_t len) {
     auto file = static_cast<File*>(fd);
+    const auto nfs = file->session->nfs;
+
+    if (const auto ret = flush_write_behind(file); ret < 0) {
+        return ret;
+    }
 
     const auto ret = nfs_ftruncate(nfs, file->fd, len);
     if (ret) {
@@ -378,6 +583,11 @@ int Device::devoptab_statvfs(const char *path, struct statvfs *buf) {
 
 int Device::devoptab_fsync(void *fd) {
     auto file = static_cast<File*>(fd);
+    const auto nfs = file->session->nfs;
+
+    if (const auto ret = flush_write_behind(file); ret < 0) {
+        return ret;
+    }
 
     const auto ret = nfs_fsync(nfs, file->fd);
     if (ret) {
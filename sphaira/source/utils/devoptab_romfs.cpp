@@ -1,4 +1,5 @@
 #include "utils/devoptab_romfs.hpp"
+#include "yati/nx/romfs.hpp"
 #include "defines.hpp"
 #include "log.hpp"
 
@@ -10,37 +11,147 @@
 namespace sphaira::devoptab::romfs {
 namespace {
 
+constexpr u32 ROMFS_ENTRY_EMPTY = 0xFFFFFFFF;
+// max number of parent directories to cache before the cache is reset.
+constexpr u32 PARENT_CACHE_MAX = 1024;
+// number of entries checked against the hash table when loading.
+constexpr u32 HASH_VALIDATE_COUNT = 64;
+
+template<typename T>
+auto get_entry(const std::vector<u8>& table, u32 off) -> const T* {
+    if (off == ROMFS_ENTRY_EMPTY || off + sizeof(T) > table.size()) {
+        return nullptr;
+    }
+
+    const auto entry = (const T*)(table.data() + off);
+    if (off + sizeof(T) + entry->nameLen > table.size()) {
+        return nullptr;
+    }
+
+    return entry;
+}
+
+template<typename T>
+auto is_name(const T* entry, std::string_view name) -> bool {
+    return entry->nameLen == name.length() && !std::memcmp(name.data(), entry->name, entry->nameLen);
+}
+
+// finds the child entry of the parent using the hash table, or the sibling chain if there's no hash table.
+template<typename T>
+auto find_child(const std::vector<u8>& table, const std::vector<u32>& hash_table, u32 parent_off, u32 first_child, std::string_view name) -> const T* {
+    // guards against loops in corrupt tables.
+    const auto max_steps = table.size() / sizeof(T) + 1;
+
+    if (!hash_table.empty()) {
+        const auto hash = sphaira::romfs::CalcPathHash(parent_off, name);
+        auto off = hash_table[hash % hash_table.size()];
+
+        for (size_t i = 0; i < max_steps; i++) {
+            const auto entry = get_entry<T>(table, off);
+            if (!entry) {
+                break;
+            }
+
+            if (entry->parent == parent_off && is_name(entry, name)) {
+                return entry;
+            }
+
+            off = entry->nextHash;
+        }
+
+        return nullptr;
+    }
+
+    auto off = first_child;
+    for (size_t i = 0; i < max_steps; i++) {
+        const auto entry = get_entry<T>(table, off);
+        if (!entry) {
+            break;
+        }
+
+        if (is_name(entry, name)) {
+            return entry;
+        }
+
+        off = entry->sibling;
+    }
+
+    return nullptr;
+}
+
+auto find_child_dir(const RomfsCollection& romfs, const romfs_dir* parent, std::string_view name) -> const romfs_dir* {
+    const u32 parent_off = (const u8*)parent - romfs.dir_table.data();
+    return find_child<romfs_dir>(romfs.dir_table, romfs.dir_hash_table, parent_off, parent->childDir, name);
+}
+
+auto find_child_file(const RomfsCollection& romfs, const romfs_dir* parent, std::string_view name) -> const romfs_file* {
+    const u32 parent_off = (const u8*)parent - romfs.dir_table.data();
+    return find_child<romfs_file>(romfs.file_table, romfs.file_hash_table, parent_off, parent->childFile, name);
+}
+
+// checks the first few entries can be found via the hash table, clearing it if not.
+template<typename T>
+void validate_hash_table(const std::vector<u8>& table, std::vector<u32>& hash_table, bool skip_root) {
+    if (hash_table.empty()) {
+        return;
+    }
+
+    u32 off = 0;
+    for (u32 i = 0; i < HASH_VALIDATE_COUNT; i++) {
+        const auto entry = get_entry<T>(table, off);
+        if (!entry) {
+            break;
+        }
+
+        if (!skip_root || off) {
+            const auto name = std::string_view{(const char*)entry->name, entry->nameLen};
+            if (find_child<T>(table, hash_table, entry->parent, ROMFS_ENTRY_EMPTY, name) != entry) {
+                log_write("[RomFS] hash table invalid, falling back to sibling lookup\n");
+                hash_table.clear();
+                return;
+            }
+        }
+
+        // entries are 4 byte aligned.
+        off += sizeof(T) + ((entry->nameLen + 3) & ~3);
+    }
+}
+
 auto find_romfs_relative_dir(const RomfsCollection& romfs, std::string_view path) -> const romfs_dir* {
     if (path.starts_with('/')) {
         path = path.substr(1);
     }
 
-    const auto root = (const romfs_dir*)romfs.dir_table.data();
+    const auto root = get_entry<romfs_dir>(romfs.dir_table, 0);
     const auto rel_index = path.find_last_of('/');
     path = path.substr(0, rel_index);
 
-    if (rel_index == path.npos) {
+    if (!root || rel_index == path.npos) {
         return root;
     }
 
-    u32 childDir = root->childDir;
-    while (path.length() && (childDir != ~0)) {
+    // check if the parent was recently resolved, ie, stat'ing every file in a dir.
+    auto& cache = romfs.parent_cache;
+    const std::string key{path};
+    if (const auto it = cache.find(key); it != cache.end()) {
+        return get_entry<romfs_dir>(romfs.dir_table, it->second);
+    }
+
+    auto dir = root;
+    while (dir && path.length()) {
         const auto sub = path.substr(0, path.find_first_of('/'));
-        const auto dir = (const romfs_dir*)(romfs.dir_table.data() + childDir);
-
-        if (dir->nameLen == sub.length() && !std::memcmp(sub.data(), dir->name, dir->nameLen)) {
-            if (path == sub) {
-                return dir; // bingo
-            } else {
-                childDir = dir->childDir;
-                path = path.substr(sub.length() + 1);
-            }
-        } else {
-            childDir = dir->sibling;
+        dir = find_child_dir(romfs, dir, sub);
+        path = path.substr(std::min(path.length(), sub.length() + 1));
+    }
+
+    if (dir) {
+        if (cache.size() >= PARENT_CACHE_MAX) {
+            cache.clear();
         }
+        cache.emplace(key, (const u8*)dir - romfs.dir_table.data());
     }
 
-    return nullptr;
+    return dir;
 }
 
 auto find_romfs_dir(const romfs_dir* parent, const RomfsCollection& romfs, std::string_view path) -> const romfs_dir* {
@@ -56,18 +167,11 @@ auto find_romfs_dir(const romfs_dir* parent, const RomfsCollection& romfs, std::
         path = path.substr(idx + 1);
     }
 
-    u32 childDir = parent->childDir;
-    while (path.length() && (childDir != ~0)) {
-        const auto dir = (const romfs_dir*)(romfs.dir_table.data() + childDir);
-
-        if (dir->nameLen == path.length() && !std::memcmp(path.data(), dir->name, dir->nameLen)) {
-            return dir; // bingo
-        } else {
-            childDir = dir->sibling;
-        }
+    if (!path.length()) {
+        return nullptr;
     }
 
-    return nullptr;
+    return find_child_dir(romfs, parent, path);
 }
 
 auto find_romfs_file(const romfs_dir* parent, const RomfsCollection& romfs, std::string_view path) -> const romfs_file* {
@@ -79,18 +183,11 @@ auto find_romfs_file(const romfs_dir* parent, const RomfsCollection& romfs, std:
         path = path.substr(idx + 1);
     }
 
-    u32 childFile = parent->childFile;
-    while (path.length() && (childFile != ~0)) {
-        const auto file = (const romfs_file*)(romfs.file_table.data() + childFile);
-
-        if (file->nameLen == path.length() && !std::memcmp(path.data(), file->name, file->nameLen)) {
-            return file; // bingo
-        } else {
-            childFile = file->sibling;
-        }
+    if (!path.length()) {
+        return nullptr;
     }
 
-    return nullptr;
+    return find_child_file(romfs, parent, path);
 }
 
 } // namespace
@@ -186,6 +283,23 @@ Result LoadRomfsCollection(yati::source::Base* source, u64 offset, RomfsCollecti
 
     log_write("read romfs file\n");
 
+    // the hash tables are optional, lookups fall back to walking the sibling chains.
+    out.dir_hash_table.resize(out.header.dirHashTableSize / sizeof(u32));
+    if (R_FAILED(source->Read2(out.dir_hash_table.data(), out.offset + out.header.dirHashTableOff, out.dir_hash_table.size() * sizeof(u32)))) {
+        out.dir_hash_table.clear();
+    }
+
+    out.file_hash_table.resize(out.header.fileHashTableSize / sizeof(u32));
+    if (R_FAILED(source->Read2(out.file_hash_table.data(), out.offset + out.header.fileHashTableOff, out.file_hash_table.size() * sizeof(u32)))) {
+        out.file_hash_table.clear();
+    }
+
+    validate_hash_table<romfs_dir>(out.dir_table, out.dir_hash_table, true);
+    validate_hash_table<romfs_file>(out.file_table, out.file_hash_table, false);
+    out.parent_cache.clear();
+
+    log_write("read romfs hash tables, dir: %zu file: %zu\n", out.dir_hash_table.size(), out.file_hash_table.size());
+
     R_SUCCEED();
 }
 
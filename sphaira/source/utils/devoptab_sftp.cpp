@@ -10,6 +10,7 @@
 // disabling buffering fixed the issue, and i have disabled buffering by default.
 // buffering is now enabled only when requested.
 #include "utils/devoptab_common.hpp"
+#include "utils/sftp_pipeline.hpp"
 #include "utils/profile.hpp"
 #include "defines.hpp"
 #include "log.hpp"
@@ -26,16 +27,37 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <minIni.h>
 
 namespace sphaira::devoptab {
 namespace {
 
+// bytes kept in flight for each file, can be changed per mount with
+// "read_ahead" and "write_behind" (KiB, 0 to disable).
+// libssh2 keeps up to 4x the size of a read in flight, so reads are a quarter
+// of the window, which is ~64 requests of 30000 bytes by default.
+constexpr u32 READ_AHEAD_SIZE_DEFAULT = 1024 * 1024 * 2;
+constexpr u32 WRITE_BEHIND_SIZE_DEFAULT = 1024 * 1024;
+
+struct File;
+
+// a logged in ssh connection, the session isn't thread safe so each open file / dir has its own.
+struct Session {
+    ~Session();
+    bool Connect(const common::MountConfig& config);
+
+    LIBSSH2_SESSION* m_session{};
+    LIBSSH2_SFTP* m_sftp_session{};
+    int m_socket{-1};
+    bool m_is_ssh2_init{}; // set if libssh2_init() was successful.
+};
+
 struct Device final : common::MountDevice {
-    using MountDevice::MountDevice;
-    ~Device();
+    Device(const common::MountConfig& _config);
 
 private:
     bool Mount() override;
+    bool IsFileConcurrent() const override { return true; }
     int devoptab_open(void *fileStruct, const char *path, int flags, int mode) override;
     int devoptab_close(void *fd) override;
     ssize_t devoptab_read(void *fd, char *ptr, size_t len) override;
@@ -55,21 +77,31 @@ private:
     int devoptab_statvfs(const char *path, struct statvfs *buf) override;
     int devoptab_fsync(void *fd) override;
 
+    // sends the joined writes, if the file has a pipeline.
+    int flush_pipeline(File* file);
+
 private:
-    LIBSSH2_SESSION* m_session{};
+    // used for the path based calls, which hold the device lock.
+    std::unique_ptr<Session> m_session{};
+    common::SessionPool<Session> m_pool{};
+    // sftp session of the session above, set once mounted.
     LIBSSH2_SFTP* m_sftp_session{};
-    int m_socket{};
-    bool m_is_ssh2_init{}; // set if libssh2_init() was successful.
-    bool m_is_handshake_done{}; // set if handshake was successful.
-    bool m_is_auth_done{}; // set if auth was successful.
-    bool mounted{};
+    u32 m_read_ahead_size{READ_AHEAD_SIZE_DEFAULT};
+    u32 m_write_behind_size{WRITE_BEHIND_SIZE_DEFAULT};
 };
 
+// files and dirs are only used by themselves, so their calls don't need the device lock.
 struct File {
+    Session* session{};
     LIBSSH2_SFTP_HANDLE* fd{};
+    // tracks its own offset, the handle offset is only moved when needed.
+    utils::SftpPipeline* pipeline{};
+    u64 off{};
 };
 
+// reading a dir is a request per batch of entries, so dirs also need their own session.
 struct Dir {
+    Session* session{};
     LIBSSH2_SFTP_HANDLE* fd{};
 };
 
@@ -159,7 +191,40 @@ void fill_stat(struct stat* st, const LIBSSH2_SFTP_ATTRIBUTES* attrs) {
     st->st_nlink = 1;
 }
 
-Device::~Device() {
+// converts the error of a failed open / opendir to an errno.
+// any error other than an sftp status means the session itself failed.
+int get_open_errno(LIBSSH2_SESSION* session, LIBSSH2_SFTP* sftp) {
+    if (libssh2_session_last_errno(session) != LIBSSH2_ERROR_SFTP_PROTOCOL) {
+        return -ECONNRESET;
+    }
+
+    switch (libssh2_sftp_last_error(sftp)) {
+        case LIBSSH2_FX_NO_SUCH_FILE: case LIBSSH2_FX_NO_SUCH_PATH: return -ENOENT;
+        case LIBSSH2_FX_PERMISSION_DENIED: case LIBSSH2_FX_WRITE_PROTECT: return -EACCES;
+        case LIBSSH2_FX_FILE_ALREADY_EXISTS: return -EEXIST;
+        case LIBSSH2_FX_NO_CONNECTION: case LIBSSH2_FX_CONNECTION_LOST: return -ENOTCONN;
+        default: return -EPERM;
+    }
+}
+
+// returns the size in bytes of a KiB value in the extra config, or def if not set.
+u32 get_window_size(const common::MountConfig& config, const char* key, u32 def) {
+    const auto it = config.extra.find(key);
+    if (it == config.extra.end()) {
+        return def;
+    }
+
+    const auto val = ini_parse_getl(it->second.c_str(), -1);
+    if (val < 0) {
+        log_write("[SFTP] Invalid %s value: %s\n", key, it->second.c_str());
+        return def;
+    }
+
+    log_write("[SFTP] Setting %s: %ld KiB\n", key, val);
+    return val * 1024;
+}
+
+Session::~Session() {
     if (m_sftp_session) {
         libssh2_sftp_shutdown(m_sftp_session);
     }
@@ -169,7 +234,7 @@ Device::~Device() {
         libssh2_session_free(m_session);
     }
 
-    if (m_socket > 0) {
+    if (m_socket >= 0) {
         shutdown(m_socket, SHUT_RDWR);
         close(m_socket);
     }
@@ -179,140 +244,154 @@ Device::~Device() {
     }
 }
 
-bool Device::Mount() {
-    if (mounted) {
-        return true;
+bool Session::Connect(const common::MountConfig& config) {
+    log_write("[SFTP] Connecting to %s version: %s\n", config.url.c_str(), LIBSSH2_VERSION);
+
+    if (config.user.empty() || config.pass.empty()) {
+        log_write("[SFTP] Missing username or password\n");
+        return false;
     }
 
-    log_write("[SFTP] Mounting %s version: %s\n", this->config.url.c_str(), LIBSSH2_VERSION);
+    // connect the socket.
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
 
-    if (!m_socket) {
-        // connect the socket.
-        addrinfo hints{};
-        hints.ai_family = AF_UNSPEC;
-        hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res{};
+    const auto port = config.port > 0 ? config.port : 22;
+    const auto port_str = std::to_string(port);
+    auto ret = getaddrinfo(config.url.c_str(), port_str.c_str(), &hints, &res);
+    if (ret != 0) {
+        log_write("[SFTP] getaddrinfo() failed: %s\n", gai_strerror(ret));
+        return false;
+    }
+    ON_SCOPE_EXIT(freeaddrinfo(res));
 
-        addrinfo* res{};
-        const auto port = this->config.port > 0 ? this->config.port : 22;
-        const auto port_str = std::to_string(port);
-        auto ret = getaddrinfo(this->config.url.c_str(), port_str.c_str(), &hints, &res);
-        if (ret != 0) {
-            log_write("[SFTP] getaddrinfo() failed: %s\n", gai_strerror(ret));
-            return false;
+    for (auto addr = res; addr != nullptr; addr = addr->ai_next) {
+        m_socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (m_socket < 0) {
+            log_write("[SFTP] socket() failed: %s\n", std::strerror(errno));
+            continue;
         }
-        ON_SCOPE_EXIT(freeaddrinfo(res));
-
-        for (auto addr = res; addr != nullptr; addr = addr->ai_next) {
-            m_socket = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-            if (m_socket < 0) {
-                log_write("[SFTP] socket() failed: %s\n", std::strerror(errno));
-                continue;
-            }
 
-            ret = connect(m_socket, addr->ai_addr, addr->ai_addrlen);
-            if (ret < 0) {
-                log_write("[SFTP] connect() failed: %s\n", std::strerror(errno));
-                close(m_socket);
-                m_socket = -1;
-                continue;
-            }
-
-            break;
+        ret = connect(m_socket, addr->ai_addr, addr->ai_addrlen);
+        if (ret < 0) {
+            log_write("[SFTP] connect() failed: %s\n", std::strerror(errno));
+            close(m_socket);
+            m_socket = -1;
+            continue;
         }
 
-        if (m_socket < 0) {
-            log_write("[SFTP] Failed to connect to %s:%ld\n", this->config.url.c_str(), port);
-            return false;
-        }
+        break;
+    }
 
-        log_write("[SFTP] Connected to %s:%ld\n", this->config.url.c_str(), port);
+    if (m_socket < 0) {
+        log_write("[SFTP] Failed to connect to %s:%ld\n", config.url.c_str(), port);
+        return false;
     }
 
-    if (!m_is_ssh2_init) {
-        auto ret = libssh2_init(0);
-        if (ret != 0) {
-            log_write("[SFTP] libssh2_init() failed: %d\n", ret);
-            return false;
-        }
+    log_write("[SFTP] Connected to %s:%ld\n", config.url.c_str(), port);
 
-        m_is_ssh2_init = true;
+    // reference counted, so each session inits / exits.
+    ret = libssh2_init(0);
+    if (ret != 0) {
+        log_write("[SFTP] libssh2_init() failed: %d\n", ret);
+        return false;
     }
 
+    m_is_ssh2_init = true;
+
+    m_session = libssh2_session_init();
     if (!m_session) {
-        m_session = libssh2_session_init();
-        if (!m_session) {
-            log_write("[SFTP] libssh2_session_init() failed\n");
-            return false;
-        }
+        log_write("[SFTP] libssh2_session_init() failed\n");
+        return false;
+    }
 
-        libssh2_session_set_blocking(m_session, 1);
-        libssh2_session_flag(m_session, LIBSSH2_FLAG_COMPRESS, 1);
+    libssh2_session_set_blocking(m_session, 1);
+    libssh2_session_flag(m_session, LIBSSH2_FLAG_COMPRESS, 1);
 
-        if (this->config.timeout > 0) {
-            libssh2_session_set_timeout(m_session, this->config.timeout);
-            // dkp libssh2 is too old for this.
-            #if LIBSSH2_VERSION_NUM >= 0x010B00
-            libssh2_session_set_read_timeout(m_session, this->config.timeout);
-            #endif
-        }
+    if (config.timeout > 0) {
+        libssh2_session_set_timeout(m_session, config.timeout);
+        // dkp libssh2 is too old for this.
+        #if LIBSSH2_VERSION_NUM >= 0x010B00
+        libssh2_session_set_read_timeout(m_session, config.timeout);
+        #endif
     }
 
-    if (this->config.user.empty() || this->config.pass.empty()) {
-        log_write("[SFTP] Missing username or password\n");
+    ret = libssh2_session_handshake(m_session, m_socket);
+    if (ret) {
+        log_write("[SFTP] libssh2_session_handshake() failed: %d\n", ret);
+        return false;
+    }
+
+    const auto userauthlist = libssh2_userauth_list(m_session, config.user.c_str(), config.user.length());
+    if (!userauthlist) {
+        log_write("[SFTP] libssh2_userauth_list() failed\n");
         return false;
     }
 
-    if (!m_is_handshake_done) {
-        const auto ret = libssh2_session_handshake(m_session, m_socket);
+    // just handle user/pass auth for now, pub/priv key is a bit overkill.
+    if (std::strstr(userauthlist, "password")) {
+        ret = libssh2_userauth_password(m_session, config.user.c_str(), config.pass.c_str());
         if (ret) {
-            log_write("[SFTP] libssh2_session_handshake() failed: %d\n", ret);
+            log_write("[SFTP] Password auth failed: %d\n", ret);
             return false;
         }
+    } else {
+        log_write("[SFTP] No supported auth methods found\n");
+        return false;
+    }
 
-        m_is_handshake_done = true;
+    m_sftp_session = libssh2_sftp_init(m_session);
+    if (!m_sftp_session) {
+        log_write("[SFTP] libssh2_sftp_init() failed\n");
+        return false;
     }
 
-    if (!m_is_auth_done) {
-        const auto userauthlist = libssh2_userauth_list(m_session, this->config.user.c_str(), this->config.user.length());
-        if (!userauthlist) {
-            log_write("[SFTP] libssh2_userauth_list() failed\n");
-            return false;
-        }
+    log_write("[SFTP] Mounted %s\n", config.url.c_str());
+    return true;
+}
 
-        // just handle user/pass auth for now, pub/priv key is a bit overkill.
-        if (std::strstr(userauthlist, "password")) {
-            auto ret = libssh2_userauth_password(m_session, this->config.user.c_str(), this->config.pass.c_str());
-            if (ret) {
-                log_write("[SFTP] Password auth failed: %d\n", ret);
-                return false;
-            }
-        } else {
-            log_write("[SFTP] No supported auth methods found\n");
-            return false;
-        }
+Device::Device(const common::MountConfig& _config) : MountDevice{_config} {
+    m_read_ahead_size = get_window_size(this->config, "read_ahead", READ_AHEAD_SIZE_DEFAULT);
+    m_write_behind_size = get_window_size(this->config, "write_behind", WRITE_BEHIND_SIZE_DEFAULT);
+}
 
-        m_is_auth_done = true;
+bool Device::Mount() {
+    if (m_session) {
+        return true;
     }
 
-    if (!m_sftp_session) {
-        m_sftp_session = libssh2_sftp_init(m_session);
-        if (!m_sftp_session) {
-            log_write("[SFTP] libssh2_sftp_init() failed\n");
-            return false;
-        }
+    auto session = std::make_unique<Session>();
+    if (!session->Connect(this->config)) {
+        return false;
     }
 
-    log_write("[SFTP] Mounted %s\n", this->config.url.c_str());
-    return mounted = true;
+    m_session = std::move(session);
+    m_sftp_session = m_session->m_sftp_session;
+    return true;
 }
 
 int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mode) {
     auto file = static_cast<File*>(fileStruct);
 
-    file->fd = libssh2_sftp_open(m_sftp_session, path, convert_flags_to_sftp(flags), convert_mode_to_sftp(mode));
-    if (!file->fd) {
-        log_write("[SFTP] libssh2_sftp_open() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
-        return -EIO;
+    const auto ret = m_pool.Acquire(this->config, &file->session, [&](Session* session) -> int {
+        file->fd = libssh2_sftp_open(session->m_sftp_session, path, convert_flags_to_sftp(flags), convert_mode_to_sftp(mode));
+        if (!file->fd) {
+            log_write("[SFTP] libssh2_sftp_open() failed: %ld\n", libssh2_sftp_last_error(session->m_sftp_session));
+            return get_open_errno(session->m_session, session->m_sftp_session);
+        }
+
+        return 0;
+    });
+
+    if (ret) {
+        return ret;
+    }
+
+    // the server writes to the end with append, so the offset can't be tracked.
+    if (!(flags & O_APPEND) && (m_read_ahead_size || m_write_behind_size)) {
+        file->pipeline = new utils::SftpPipeline{file->fd, m_read_ahead_size / 4, m_write_behind_size};
     }
 
     return 0;
@@ -321,7 +400,27 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
 int Device::devoptab_close(void *fd) {
     auto file = static_cast<File*>(fd);
 
+    // the file is still closed if the flush failed, the error is returned
+    // so that the caller knows the data didn't make it.
+    const auto ret = flush_pipeline(file);
+
+    delete file->pipeline;
     libssh2_sftp_close(file->fd);
+    m_pool.Release(file->session);
+    return ret;
+}
+
+int Device::flush_pipeline(File* file) {
+    if (!file->pipeline) {
+        return 0;
+    }
+
+    const auto ret = file->pipeline->Flush();
+    if (ret < 0) {
+        log_write("[SFTP] libssh2_sftp_write() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
+        return ret;
+    }
+
     return 0;
 }
 
@@ -335,9 +434,20 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
     SCOPED_TIMESTAMP(name);
     #endif
 
+    if (file->pipeline) {
+        const auto ret = file->pipeline->Read(ptr, file->off, len);
+        if (ret < 0) {
+            log_write("[SFTP] libssh2_sftp_read() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
+            return ret;
+        }
+
+        file->off += ret;
+        return ret;
+    }
+
     const auto ret = libssh2_sftp_read(file->fd, ptr, len);
     if (ret < 0) {
-        log_write("[SFTP] libssh2_sftp_read() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
+        log_write("[SFTP] libssh2_sftp_read() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
         return -EIO;
     }
 
@@ -347,9 +457,20 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
 
+    if (file->pipeline) {
+        const auto ret = file->pipeline->Write(ptr, file->off, len);
+        if (ret < 0) {
+            log_write("[SFTP] libssh2_sftp_write() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
+            return ret;
+        }
+
+        file->off += ret;
+        return ret;
+    }
+
     const auto ret = libssh2_sftp_write(file->fd, ptr, len);
     if (ret < 0) {
-        log_write("[SFTP] libssh2_sftp_write() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
+        log_write("[SFTP] libssh2_sftp_write() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
         return -EIO;
     }
 
@@ -358,6 +479,26 @@ ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
 
 ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
     auto file = static_cast<File*>(fd);
+
+    // the pipeline moves the handle offset on the next read / write.
+    if (file->pipeline) {
+        if (dir == SEEK_CUR) {
+            pos += file->off;
+        } else if (dir == SEEK_END) {
+            struct stat st{};
+            if (const auto ret = devoptab_fstat(fd, &st); ret) {
+                return ret;
+            }
+            pos += st.st_size;
+        }
+
+        if (pos < 0) {
+            return -EINVAL;
+        }
+
+        return file->off = pos;
+    }
+
     const auto current_pos = libssh2_sftp_tell64(file->fd);
 
     if (dir == SEEK_CUR) {
@@ -366,7 +507,7 @@ ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
         LIBSSH2_SFTP_ATTRIBUTES attrs{};
         auto ret = libssh2_sftp_fstat(file->fd, &attrs);
         if (ret || !(attrs.flags & LIBSSH2_SFTP_ATTR_SIZE)) {
-            log_write("[SFTP] libssh2_sftp_fstat() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
+            log_write("[SFTP] libssh2_sftp_fstat() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
         } else {
             pos = attrs.filesize;
         }
@@ -385,10 +526,14 @@ ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
 int Device::devoptab_fstat(void *fd, struct stat *st) {
     auto file = static_cast<File*>(fd);
 
+    if (const auto ret = flush_pipeline(file); ret < 0) {
+        return ret;
+    }
+
     LIBSSH2_SFTP_ATTRIBUTES attrs{};
     const auto ret = libssh2_sftp_fstat(file->fd, &attrs);
     if (ret) {
-        log_write("[SFTP] libssh2_sftp_fstat() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
+        log_write("[SFTP] libssh2_sftp_fstat() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
         return -EIO;
     }
 
@@ -439,13 +584,15 @@ int Device::devoptab_rmdir(const char *path) {
 int Device::devoptab_diropen(void* fd, const char *path) {
     auto dir = static_cast<Dir*>(fd);
 
-    dir->fd = libssh2_sftp_opendir(m_sftp_session, path);
-    if (!dir->fd) {
-        log_write("[SFTP] libssh2_sftp_opendir() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
-        return -EIO;
-    }
+    return m_pool.Acquire(this->config, &dir->session, [&](Session* session) -> int {
+        dir->fd = libssh2_sftp_opendir(session->m_sftp_session, path);
+        if (!dir->fd) {
+            log_write("[SFTP] libssh2_sftp_opendir() failed: %ld\n", libssh2_sftp_last_error(session->m_sftp_session));
+            return get_open_errno(session->m_session, session->m_sftp_session);
+        }
 
-    return 0;
+        return 0;
+    });
 }
 
 int Device::devoptab_dirreset(void* fd) {
@@ -472,6 +619,7 @@ int Device::devoptab_dirclose(void* fd) {
     auto dir = static_cast<Dir*>(fd);
 
     libssh2_sftp_closedir(dir->fd);
+    m_pool.Release(dir->session);
     return 0;
 }
 
@@ -520,9 +668,13 @@ int Device::devoptab_statvfs(const char *path, struct statvfs *buf) {
 int Device::devoptab_fsync(void *fd) {
     auto file = static_cast<File*>(fd);
 
+    if (const auto ret = flush_pipeline(file); ret < 0) {
+        return ret;
+    }
+
     const auto ret = libssh2_sftp_fsync(file->fd);
     if (ret) {
-        log_write("[SFTP] libssh2_sftp_fsync() failed: %ld\n", libssh2_sftp_last_error(m_sftp_session));
+        log_write("[SFTP] libssh2_sftp_fsync() failed: %ld\n", libssh2_sftp_last_error(file->session->m_sftp_session));
         return -EIO;
     }
 
@@ -1,4 +1,5 @@
 #include "utils/devoptab_common.hpp"
+#include "utils/async_io.hpp"
 #include "defines.hpp"
 #include "log.hpp"
 
@@ -14,9 +15,58 @@
 namespace sphaira::devoptab {
 namespace {
 
+// size of the read ahead window of each file opened for reading,
+// can be changed per mount with "read_ahead" (KiB, 0 to disable).
+constexpr u32 READ_AHEAD_SIZE_DEFAULT = 1024 * 1024 * 4;
+// each request is capped so that the window is split into a few requests.
+constexpr u32 READ_AHEAD_REQUEST_MAX = 1024 * 1024;
+constexpr u32 READ_AHEAD_REQUESTS_MAX = 16;
+
+struct AsyncBackend final : utils::AsyncBackend {
+    AsyncBackend(smb2_context* _smb2, smb2fh* _fh) : smb2{_smb2}, fh{_fh} {}
+
+    int ReadAsync(void* buf, u32 size, u64 off, utils::AsyncSlot* slot) override {
+        return smb2_pread_async(smb2, fh, static_cast<u8*>(buf), size, off, callback, slot);
+    }
+
+    int WriteAsync(const void* buf, u32 size, u64 off, utils::AsyncSlot* slot) override {
+        return smb2_pwrite_async(smb2, fh, static_cast<const u8*>(buf), size, off, callback, slot);
+    }
+
+    int GetFd() override {
+        return smb2_get_fd(smb2);
+    }
+
+    int WhichEvents() override {
+        return smb2_which_events(smb2);
+    }
+
+    int Service(int revents) override {
+        return smb2_service(smb2, revents);
+    }
+
+private:
+    // status is the number of bytes transferred or a negative errno.
+    static void callback(smb2_context* smb2, int status, void* command_data, void* cb_data) {
+        static_cast<utils::AsyncSlot*>(cb_data)->Complete(status);
+    }
+
+private:
+    smb2_context* const smb2;
+    smb2fh* const fh;
+};
+
+// a connection to the share, the context isn't thread safe so each open file has its own.
+struct Session {
+    ~Session();
+    bool Connect(const common::MountConfig& config);
+
+    smb2_context* smb2{};
+    bool connected{};
+};
+
 struct Device final : common::MountDevice {
-    using MountDevice::MountDevice;
-    ~Device();
+    Device(const common::MountConfig& _config);
 
 private:
     bool fix_path(const char* str, char* out, bool strip_leading_slash = false) override {
@@ -24,6 +74,7 @@ private:
     }
 
     bool Mount() override;
+    bool IsFileConcurrent() const override { return true; }
     int devoptab_open(void *fileStruct, const char *path, int flags, int mode) override;
     int devoptab_close(void *fd) override;
     ssize_t devoptab_read(void *fd, char *ptr, size_t len) override;
@@ -44,14 +95,24 @@ private:
     int devoptab_fsync(void *fd) override;
 
 private:
+    // used for the path based calls and dirs, which hold the device lock.
+    std::unique_ptr<Session> session{};
+    common::SessionPool<Session> pool{};
+    // context of the session above, set once mounted.
     smb2_context* smb2{};
-    bool mounted{};
+    u32 read_ahead_size{READ_AHEAD_SIZE_DEFAULT};
 };
 
 struct File {
+    // only used by this file, so its calls don't need the device lock.
+    Session* session;
     smb2fh* fd;
+    // only set for files opened for reading, which then track their own offset.
+    utils::AsyncReadAhead* readahead;
+    u64 off;
 };
 
+// the whole dir is read on open, so reading the entries doesn't use the context.
 struct Dir {
     smb2dir* dir;
 };
@@ -76,9 +137,9 @@ void fill_stat(struct stat* st, const smb2_stat_64* smb2_st) {
     st->st_ctime = smb2_st->smb2_ctime;
 }
 
-Device::~Device() {
+Session::~Session() {
     if (this->smb2) {
-        if (this->mounted) {
+        if (this->connected) {
             smb2_disconnect_share(this->smb2);
         }
 
@@ -86,45 +147,39 @@ Device::~Device() {
     }
 }
 
-bool Device::Mount() {
-    if (mounted) {
-        return true;
-    }
-
+bool Session::Connect(const common::MountConfig& config) {
+    this->smb2 = smb2_init_context();
     if (!this->smb2) {
-        this->smb2 = smb2_init_context();
-        if (!this->smb2) {
-            log_write("[SMB2] smb2_init_context() failed\n");
-            return false;
-        }
+        log_write("[SMB2] smb2_init_context() failed\n");
+        return false;
+    }
 
-        smb2_set_security_mode(this->smb2, SMB2_NEGOTIATE_SIGNING_ENABLED);
+    smb2_set_security_mode(this->smb2, SMB2_NEGOTIATE_SIGNING_ENABLED);
 
-        if (!this->config.user.empty()) {
-            smb2_set_user(this->smb2, this->config.user.c_str());
-        }
+    if (!config.user.empty()) {
+        smb2_set_user(this->smb2, config.user.c_str());
+    }
 
-        if (!this->config.pass.empty()) {
-            smb2_set_password(this->smb2, this->config.pass.c_str());
-        }
+    if (!config.pass.empty()) {
+        smb2_set_password(this->smb2, config.pass.c_str());
+    }
 
-        const auto domain = this->config.extra.find("domain");
-        if (domain != this->config.extra.end()) {
-            smb2_set_domain(this->smb2, domain->second.c_str());
-        }
+    const auto domain = config.extra.find("domain");
+    if (domain != config.extra.end()) {
+        smb2_set_domain(this->smb2, domain->second.c_str());
+    }
 
-        const auto workstation = this->config.extra.find("workstation");
-        if (workstation != this->config.extra.end()) {
-            smb2_set_workstation(this->smb2, workstation->second.c_str());
-        }
+    const auto workstation = config.extra.find("workstation");
+    if (workstation != config.extra.end()) {
+        smb2_set_workstation(this->smb2, workstation->second.c_str());
+    }
 
-        if (config.timeout > 0) {
-            smb2_set_timeout(this->smb2, this->config.timeout);
-        }
+    if (config.timeout > 0) {
+        smb2_set_timeout(this->smb2, config.timeout);
     }
 
     // due to a bug in old sphira, i incorrectly prepended the url with smb:// rather than smb2://
-    auto url = this->config.url;
+    auto url = config.url;
     if (!url.ends_with('/')) {
         url += '/';
     }
@@ -142,17 +197,71 @@ bool Device::Mount() {
         return false;
     }
 
-    this->mounted = true;
+    this->connected = true;
+    return true;
+}
+
+Device::Device(const common::MountConfig& _config) : MountDevice{_config} {
+    const auto read_ahead = this->config.extra.find("read_ahead");
+    if (read_ahead != this->config.extra.end()) {
+        const auto read_ahead_val = ini_parse_getl(read_ahead->second.c_str(), -1);
+        if (read_ahead_val < 0) {
+            log_write("[SMB2] Invalid read_ahead value: %s\n", read_ahead->second.c_str());
+        } else {
+            log_write("[SMB2] Setting read_ahead: %ld KiB\n", read_ahead_val);
+            this->read_ahead_size = read_ahead_val * 1024;
+        }
+    }
+}
+
+bool Device::Mount() {
+    if (this->session) {
+        return true;
+    }
+
+    auto session = std::make_unique<Session>();
+    if (!session->Connect(this->config)) {
+        return false;
+    }
+
+    this->session = std::move(session);
+    this->smb2 = this->session->smb2;
     return true;
 }
 
 int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mode) {
     auto file = static_cast<File*>(fileStruct);
 
-    file->fd = smb2_open(this->smb2, path, flags);
-    if (!file->fd) {
-        log_write("[SMB2] smb2_open() failed: %s\n", smb2_get_error(this->smb2));
-        return -EIO;
+    const auto ret = this->pool.Acquire(this->config, &file->session, [&](Session* session) -> int {
+        file->fd = smb2_open(session->smb2, path, flags);
+        if (!file->fd) {
+            log_write("[SMB2] smb2_open() failed: %s\n", smb2_get_error(session->smb2));
+            // no status is set if the request never got a reply, ie, the connection dropped.
+            const auto err = nterror_to_errno(smb2_get_nterror(session->smb2));
+            return err ? -err : -EIO;
+        }
+
+        return 0;
+    });
+
+    if (ret) {
+        return ret;
+    }
+
+    const auto smb2 = file->session->smb2;
+
+    // keep several reads in flight for sequential readers, such as copies and installs.
+    if (this->read_ahead_size && (flags & O_ACCMODE) == O_RDONLY) {
+        smb2_stat_64 smb2_st{};
+        const auto ret = smb2_fstat(smb2, file->fd, &smb2_st);
+        if (ret < 0) {
+            log_write("[SMB2] smb2_fstat() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
+        } else {
+            const auto request_size = std::min<u32>(smb2_get_max_read_size(smb2), READ_AHEAD_REQUEST_MAX);
+            const auto max_requests = std::clamp<u32>(this->read_ahead_size / request_size, 1, READ_AHEAD_REQUESTS_MAX);
+            auto backend = std::make_unique<AsyncBackend>(smb2, file->fd);
+            file->readahead = new utils::AsyncReadAhead{std::move(backend), smb2_st.smb2_size, request_size, max_requests};
+        }
     }
 
     return 0;
@@ -161,22 +270,37 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
 int Device::devoptab_close(void *fd) {
     auto file = static_cast<File*>(fd);
 
-    smb2_close(this->smb2, file->fd);
+    // waits for the reads still in flight.
+    delete file->readahead;
+    smb2_close(file->session->smb2, file->fd);
+    this->pool.Release(file->session);
     return 0;
 }
 
 ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
+    const auto smb2 = file->session->smb2;
+
+    if (file->readahead) {
+        const auto ret = file->readahead->Read(ptr, file->off, len);
+        if (ret < 0) {
+            log_write("[SMB2] smb2_pread_async() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
+            return ret;
+        }
 
-    const auto max_read = smb2_get_max_read_size(this->smb2);
+        file->off += ret;
+        return ret;
+    }
+
+    const auto max_read = smb2_get_max_read_size(smb2);
     size_t bytes_read = 0;
 
     while (bytes_read < len) {
         const auto to_read = std::min<size_t>(len - bytes_read, max_read);
-        const auto ret = smb2_read(this->smb2, file->fd, (u8*)ptr, to_read);
+        const auto ret = smb2_read(smb2, file->fd, (u8*)ptr, to_read);
 
         if (ret < 0) {
-            log_write("[SMB2] smb2_read() failed: %s errno: %s\n", smb2_get_error(this->smb2), std::strerror(-ret));
+            log_write("[SMB2] smb2_read() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
             return ret;
         }
 
@@ -193,16 +317,17 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 
 ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
     auto file = static_cast<File*>(fd);
+    const auto smb2 = file->session->smb2;
 
-    const auto max_write = smb2_get_max_write_size(this->smb2);
+    const auto max_write = smb2_get_max_write_size(smb2);
     size_t written = 0;
 
     while (written < len) {
         const auto to_write = std::min<size_t>(len - written, max_write);
-        const auto ret = smb2_write(this->smb2, file->fd, (const u8*)ptr, to_write);
+        const auto ret = smb2_write(smb2, file->fd, (const u8*)ptr, to_write);
 
         if (ret < 0) {
-            log_write("[SMB2] smb2_write() failed: %s errno: %s\n", smb2_get_error(this->smb2), std::strerror(-ret));
+            log_write("[SMB2] smb2_write() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
             return ret;
         }
 
@@ -219,11 +344,27 @@ ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
 
 ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
     auto file = static_cast<File*>(fd);
+    const auto smb2 = file->session->smb2;
+
+    // the handle offset is changed by each async read as it completes, so it can't be used.
+    if (file->readahead) {
+        if (dir == SEEK_CUR) {
+            pos += file->off;
+        } else if (dir == SEEK_END) {
+            pos += file->readahead->GetSize();
+        }
+
+        if (pos < 0) {
+            return -EINVAL;
+        }
+
+        return file->off = pos;
+    }
 
     u64 current_offset = 0;
-    const auto ret = smb2_lseek(this->smb2, file->fd, pos, dir, &current_offset);
+    const auto ret = smb2_lseek(smb2, file->fd, pos, dir, &current_offset);
     if (ret < 0) {
-        log_write("[SMB2] smb2_lseek() failed: %s errno: %s\n", smb2_get_error(this->smb2), std::strerror(-ret));
+        log_write("[SMB2] smb2_lseek() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
         return ret;
     }
 
@@ -232,11 +373,12 @@ ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
 
 int Device::devoptab_fstat(void *fd, struct stat *st) {
     auto file = static_cast<File*>(fd);
+    const auto smb2 = file->session->smb2;
 
     smb2_stat_64 smb2_st{};
-    const auto ret = smb2_fstat(this->smb2, file->fd, &smb2_st);
+    const auto ret = smb2_fstat(smb2, file->fd, &smb2_st);
     if (ret < 0) {
-        log_write("[SMB2] smb2_fstat() failed: %s errno: %s\n", smb2_get_error(this->smb2), std::strerror(-ret));
+        log_write("[SMB2] smb2_fstat() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
         return ret;
     }
 
@@ -343,10 +485,11 @@ int Device::devoptab_lstat(const char *path, struct stat *st) {
 
 int Device::devoptab_ftruncate(void *fd, off_t len) {
     auto file = static_cast<File*>(fd);
+    const auto smb2 = file->session->smb2;
 
-    const auto ret = smb2_ftruncate(this->smb2, file->fd, len);
+    const auto ret = smb2_ftruncate(smb2, file->fd, len);
     if (ret) {
-        log_write("[SMB2] smb2_ftruncate() failed: %s errno: %s\n", smb2_get_error(this->smb2), std::strerror(-ret));
+        log_write("[SMB2] smb2_ftruncate() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
         return ret;
     }
 
@@ -378,10 +521,11 @@ int Device::devoptab_statvfs(const char *path, struct statvfs *buf) {
 
 int Device::devoptab_fsync(void *fd) {
     auto file = static_cast<File*>(fd);
+    const auto smb2 = file->session->smb2;
 
-    const auto ret = smb2_fsync(this->smb2, file->fd);
+    const auto ret = smb2_fsync(smb2, file->fd);
     if (ret) {
-        log_write("[SMB2] smb2_fsync() failed: %s errno: %s\n", smb2_get_error(this->smb2), std::strerror(-ret));
+        log_write("[SMB2] smb2_fsync() failed: %s errno: %s\n", smb2_get_error(smb2), std::strerror(-ret));
         return ret;
     }
 
@@ -5,12 +5,14 @@
 #include "defines.hpp"
 #include <fcntl.h>
 #include <curl/curl.h>
+#include <minIni.h>
 
 #include <string>
 #include <vector>
 #include <memory>
 #include <cstring>
 #include <optional>
+#include <unordered_map>
 #include <sys/stat.h>
 
 // todo: try to reduce binary size by using a smaller xml parser.
@@ -25,10 +27,19 @@ constexpr const char* XPATH_PROPSTAT_PROP = ".//*[local-name()='propstat']/*[loc
 constexpr const char* XPATH_PROP          = ".//*[local-name()='prop']";
 constexpr const char* XPATH_RESOURCETYPE  = ".//*[local-name()='resourcetype']";
 constexpr const char* XPATH_COLLECTION    = ".//*[local-name()='collection']";
+constexpr const char* XPATH_CONTENTLENGTH = ".//*[local-name()='getcontentlength']";
+constexpr const char* XPATH_LASTMODIFIED  = ".//*[local-name()='getlastmodified']";
+
+// how long the stat of an entry from a dir listing or HEAD is trusted for,
+// can be changed per mount with "stat_cache_ttl" (seconds, 0 to disable).
+constexpr long STAT_CACHE_TTL_DEFAULT = 30;
+// the cache is cleared of expired entries once it reaches this size.
+constexpr size_t STAT_CACHE_MAX_ENTRIES = 1024 * 4;
 
 struct DirEntry {
     std::string name{};
     bool is_dir{};
+    struct stat st{};
 };
 using DirEntries = std::vector<DirEntry>;
 
@@ -40,6 +51,7 @@ struct FileEntry {
 struct File {
     FileEntry* entry;
     common::PushPullThreadData* push_pull_thread_data;
+    CURL* transfer_curl;
     size_t off;
     size_t last_off;
     bool write_mode;
@@ -50,8 +62,49 @@ struct Dir {
     size_t index;
 };
 
+struct CachedStat {
+    struct stat st{};
+    TimeStamp ts{};
+};
+
+void fill_stat(struct stat* st, bool is_dir, s64 size, time_t mtime) {
+    std::memset(st, 0, sizeof(*st));
+
+    if (is_dir) {
+        st->st_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH;
+    } else {
+        st->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+        st->st_size = size > 0 ? size : 0;
+    }
+
+    st->st_mtime = mtime > 0 ? mtime : 0;
+    st->st_atime = st->st_mtime;
+    st->st_ctime = st->st_mtime;
+    st->st_nlink = 1;
+}
+
+// the same entry can be reached with or without a trailing slash.
+std::string stat_cache_key(std::string path) {
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
 struct Device final : common::MountCurlDevice {
-    using MountCurlDevice::MountCurlDevice;
+    Device(const common::MountConfig& _config) : MountCurlDevice{_config} {
+        stat_cache_ttl = STAT_CACHE_TTL_DEFAULT;
+
+        const auto ttl = this->config.extra.find("stat_cache_ttl");
+        if (ttl != this->config.extra.end()) {
+            const auto ttl_val = ini_parse_getl(ttl->second.c_str(), -1);
+            if (ttl_val < 0) {
+                log_write("[WEBDAV] Invalid stat_cache_ttl value: %s\n", ttl->second.c_str());
+            } else {
+                stat_cache_ttl = ttl_val;
+            }
+        }
+    }
 
 private:
     int devoptab_open(void *fileStruct, const char *path, int flags, int mode) override;
@@ -80,8 +133,59 @@ private:
     int webdav_rename(const std::string& old_path, const std::string& new_path, bool is_dir);
     int webdav_mkdir(const std::string& path);
     int webdav_rmdir(const std::string& path);
+
+    // stats from PROPFIND / HEAD, so that dirnext -> lstat -> open doesn't
+    // need a round-trip for each entry.
+    bool stat_cache_find(const std::string& path, struct stat* st);
+    void stat_cache_add(const std::string& path, const struct stat& st);
+    void stat_cache_remove(const std::string& path);
+    void stat_cache_clear();
+
+    std::unordered_map<std::string, CachedStat> stat_cache{};
+    long stat_cache_ttl{};
 };
 
+bool Device::stat_cache_find(const std::string& path, struct stat* st) {
+    const auto it = stat_cache.find(stat_cache_key(path));
+    if (it == stat_cache.end()) {
+        return false;
+    }
+
+    if (it->second.ts.GetSeconds() >= (u64)stat_cache_ttl) {
+        stat_cache.erase(it);
+        return false;
+    }
+
+    std::memcpy(st, &it->second.st, sizeof(*st));
+    return true;
+}
+
+void Device::stat_cache_add(const std::string& path, const struct stat& st) {
+    if (!stat_cache_ttl) {
+        return;
+    }
+
+    if (stat_cache.size() >= STAT_CACHE_MAX_ENTRIES) {
+        std::erase_if(stat_cache, [this](const auto& e) {
+            return e.second.ts.GetSeconds() >= (u64)stat_cache_ttl;
+        });
+
+        if (stat_cache.size() >= STAT_CACHE_MAX_ENTRIES) {
+            stat_cache.clear();
+        }
+    }
+
+    stat_cache.insert_or_assign(stat_cache_key(path), CachedStat{st});
+}
+
+void Device::stat_cache_remove(const std::string& path) {
+    stat_cache.erase(stat_cache_key(path));
+}
+
+void Device::stat_cache_clear() {
+    stat_cache.clear();
+}
+
 size_t dummy_data_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
     return size * nmemb;
 }
@@ -131,7 +235,8 @@ int Device::webdav_dirlist(const std::string& path, DirEntries& out) {
         "<?xml version=\"1.0\" encoding=\"utf-8\" ?>"
         "<d:propfind xmlns:d=\"DAV:\">"
             "<d:prop>"
-            // "<d:getcontentlength/>"
+            "<d:getcontentlength/>"
+            "<d:getlastmodified/>"
             "<d:resourcetype/>"
         "</d:prop>"
         "</d:propfind>";
@@ -175,6 +280,11 @@ int Device::webdav_dirlist(const std::string& path, DirEntries& out) {
         requested_path.pop_back();
     }
 
+    auto dir_key = stat_cache_key(path);
+    if (dir_key.empty() || dir_key.back() != '/') {
+        dir_key += '/';
+    }
+
     const auto responses = doc.select_nodes(XPATH_RESPONSE);
 
     for (const auto& rnode : responses) {
@@ -226,7 +336,19 @@ int Device::webdav_dirlist(const std::string& path, DirEntries& out) {
             continue;
         }
 
-        out.emplace_back(name, is_dir);
+        s64 size{};
+        if (const auto length_x = prop.select_node(XPATH_CONTENTLENGTH)) {
+            size = length_x.node().text().as_llong();
+        }
+
+        time_t mtime{};
+        if (const auto modified_x = prop.select_node(XPATH_LASTMODIFIED)) {
+            mtime = curl_getdate(modified_x.node().text().as_string(), nullptr);
+        }
+
+        auto& entry = out.emplace_back(name, is_dir);
+        fill_stat(&entry.st, is_dir, size, mtime);
+        stat_cache_add(dir_key + name, entry.st);
     }
 
     log_write("[WEBDAV] Parsed %zu entries from directory listing\n", out.size());
@@ -234,8 +356,12 @@ int Device::webdav_dirlist(const std::string& path, DirEntries& out) {
     return 0;
 }
 
-// todo: use PROPFIND to get file size and time, although it is slower...
+// uses the stat from the last dir listing if there is one, otherwise a HEAD.
 int Device::webdav_stat(const std::string& path, struct stat* st, bool is_dir) {
+    if (stat_cache_find(path, st)) {
+        return 0;
+    }
+
     std::memset(st, 0, sizeof(*st));
     const auto url = build_url(path, is_dir);
 
@@ -287,22 +413,20 @@ int Device::webdav_stat(const std::string& path, struct stat* st, bool is_dir) {
         is_dir = true;
     }
 
-    if (is_dir) {
-        st->st_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH;
-    } else {
-        st->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
-        st->st_size = file_size > 0 ? file_size : 0;
-    }
-
-    st->st_mtime = file_time > 0 ? file_time : 0;
-    st->st_atime = st->st_mtime;
-    st->st_ctime = st->st_mtime;
-    st->st_nlink = 1;
+    fill_stat(st, is_dir, file_size, file_time);
+    stat_cache_add(path, *st);
 
     return 0;
 }
 
 int Device::webdav_remove_file_folder(const std::string& path, bool is_dir) {
+    // a removed folder may have had its entries cached.
+    if (is_dir) {
+        stat_cache_clear();
+    } else {
+        stat_cache_remove(path);
+    }
+
     const auto [success, response_code] = webdav_custom_command(path, "DELETE", "", {}, is_dir);
     if (!success) {
         return -EIO;
@@ -329,6 +453,7 @@ int Device::webdav_unlink(const std::string& path) {
 
 int Device::webdav_rename(const std::string& old_path, const std::string& new_path, bool is_dir) {
     log_write("[WEBDAV] Renaming %s to %s\n", old_path.c_str(), new_path.c_str());
+    stat_cache_clear();
 
     const std::string custom_headers[] = {
         "Destination: " + build_url(new_path, is_dir),
@@ -359,6 +484,8 @@ int Device::webdav_rename(const std::string& old_path, const std::string& new_pa
 }
 
 int Device::webdav_mkdir(const std::string& path) {
+    stat_cache_remove(path);
+
     const auto [success, response_code] = webdav_custom_command(path, "MKCOL", "", {}, true);
     if (!success) {
         return -EIO;
@@ -405,6 +532,11 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
     }
 
     log_write("[WEBDAV] Opening file: %s\n", path);
+    file->transfer_curl = AcquireTransferCurl();
+    if (!file->transfer_curl) {
+        return -ENOMEM;
+    }
+
     file->entry = new FileEntry{path, st};
     file->write_mode = (flags & (O_WRONLY | O_RDWR));
 
@@ -415,7 +547,14 @@ int Device::devoptab_close(void *fd) {
     auto file = static_cast<File*>(fd);
 
     log_write("[WEBDAV] Closing file: %s\n", file->entry->path.c_str());
+
+    // the size / time changed on the server.
+    if (file->write_mode) {
+        stat_cache_remove(file->entry->path);
+    }
+
     delete file->push_pull_thread_data;
+    ReleaseTransferCurl(file->transfer_curl);
     delete file->entry;
     return 0;
 }
@@ -442,7 +581,7 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 
     if (!file->push_pull_thread_data) {
         log_write("[WEBDAV] Creating download thread data for file: %s\n", file->entry->path.c_str());
-        file->push_pull_thread_data = CreatePushData(this->transfer_curl, build_url(file->entry->path, false), file->off);
+        file->push_pull_thread_data = CreatePushData(file->transfer_curl, build_url(file->entry->path, false), file->off);
         if (!file->push_pull_thread_data) {
             log_write("[WEBDAV] Failed to create download thread data for file: %s\n", file->entry->path.c_str());
             return -EIO;
@@ -470,7 +609,7 @@ ssize_t Device::devoptab_write(void *fd, const char *ptr, size_t len) {
 
     if (!file->push_pull_thread_data) {
         log_write("[WEBDAV] Creating upload thread data for file: %s\n", file->entry->path.c_str());
-        file->push_pull_thread_data = CreatePullData(this->transfer_curl, build_url(file->entry->path, false));
+        file->push_pull_thread_data = CreatePullData(file->transfer_curl, build_url(file->entry->path, false));
         if (!file->push_pull_thread_data) {
             log_write("[WEBDAV] Failed to create upload thread data for file: %s\n", file->entry->path.c_str());
             return -EIO;
@@ -583,13 +722,7 @@ int Device::devoptab_dirnext(void* fd, char *filename, struct stat *filestat) {
     }
 
     auto& entry = (*dir->entries)[dir->index];
-    if (entry.is_dir) {
-        filestat->st_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH;
-    } else {
-        filestat->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
-    }
-
-    filestat->st_nlink = 1;
+    std::memcpy(filestat, &entry.st, sizeof(*filestat));
     std::strcpy(filename, entry.name.c_str());
 
     dir->index++;
@@ -2,6 +2,8 @@
 #include "utils/devoptab_common.hpp"
 #include "defines.hpp"
 #include "log.hpp"
+#include "mmz.hpp"
+#include "app.hpp"
 
 #include "yati/source/file.hpp"
 
@@ -10,88 +12,47 @@
 #include <array>
 #include <memory>
 #include <algorithm>
+#include <unordered_map>
 #include <zlib.h>
 
 namespace sphaira::devoptab {
 namespace {
 
-#define LOCAL_HEADER_SIG 0x4034B50
-#define FILE_HEADER_SIG 0x2014B50
-#define DATA_DESCRIPTOR_SIG 0x8074B50
-#define END_RECORD_SIG 0x6054B50
+using namespace mz;
 
-enum mmz_Flag {
-    mmz_Flag_Encrypted = 1 << 0,
-    mmz_Flag_DataDescriptor = 1 << 3,
-    mmz_Flag_StrongEncrypted = 1 << 6,
+// max size of a deflate window.
+constexpr u32 WINDOW_SIZE = 1024 * 32;
+
+// the seek index is saved next to the zip as "name.zip.zidx".
+constexpr u32 INDEX_MAGIC = 0x5844495A; // ZIDX
+constexpr u32 INDEX_VERSION = 1;
+
+struct IndexHeader {
+    u32 magic;
+    u32 version;
+    u64 zip_size;
+    u32 entry_count;
+    u32 reserved;
+};
+
+struct IndexEntryHeader {
+    u64 local_file_header_off;
+    u32 crc32;
+    u32 checkpoint_count;
 };
 
-enum mmz_Compression {
-    mmz_Compression_None = 0,
-    mmz_Compression_Deflate = 8,
+struct IndexCheckpointHeader {
+    u64 out_off;
+    u64 in_off;
+    u8 bits;
+    u8 reserved;
+    u16 window_size;
+    u32 reserved2;
 };
 
-// 30 bytes (0x1E)
-#pragma pack(push,1)
-typedef struct mmz_LocalHeader {
-    uint32_t sig;
-    uint16_t version;
-    uint16_t flags;
-    uint16_t compression;
-    uint16_t modtime;
-    uint16_t moddate;
-    uint32_t crc32;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    uint16_t filename_len;
-    uint16_t extrafield_len;
-} mmz_LocalHeader;
-#pragma pack(pop)
-
-#pragma pack(push,1)
-typedef struct mmz_DataDescriptor {
-    uint32_t sig;
-    uint32_t crc32;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-} mmz_DataDescriptor;
-#pragma pack(pop)
-
-// 46 bytes (0x2E)
-#pragma pack(push,1)
-typedef struct mmz_FileHeader {
-    uint32_t sig;
-    uint16_t version;
-    uint16_t version_needed;
-    uint16_t flags;
-    uint16_t compression;
-    uint16_t modtime;
-    uint16_t moddate;
-    uint32_t crc32;
-    uint32_t compressed_size;
-    uint32_t uncompressed_size;
-    uint16_t filename_len;
-    uint16_t extrafield_len;
-    uint16_t filecomment_len;
-    uint16_t disk_start; // wat
-    uint16_t internal_attr; // wat
-    uint32_t external_attr; // wat
-    uint32_t local_hdr_off;
-} mmz_FileHeader;
-#pragma pack(pop)
-
-#pragma pack(push,1)
-typedef struct mmz_EndRecord {
-    uint32_t sig;
-    uint16_t disk_number;
-    uint16_t disk_wcd;
-    uint16_t disk_entries;
-    uint16_t total_entries;
-    uint32_t central_directory_size;
-    uint32_t file_hdr_off;
-    uint16_t comment_len;
-} mmz_EndRecord;
-#pragma pack(pop)
+static_assert(sizeof(IndexHeader) == 0x18);
+static_assert(sizeof(IndexEntryHeader) == 0x10);
+static_assert(sizeof(IndexCheckpointHeader) == 0x18);
 
 struct FileEntry {
     std::string path;
@@ -99,9 +60,10 @@ struct FileEntry {
     u16 compression_type;
     u16 modtime;
     u16 moddate;
-    u32 compressed_size; // may be zero.
-    u32 uncompressed_size; // may be zero.
-    u32 local_file_header_off;
+    u64 compressed_size; // may be zero.
+    u64 uncompressed_size; // may be zero.
+    u64 local_file_header_off;
+    u32 crc32;
 };
 
 struct DirectoryEntry {
@@ -112,11 +74,36 @@ struct DirectoryEntry {
 
 using FileTableEntries = std::vector<FileEntry>;
 
+// zran style checkpoint, taken at a deflate block boundary.
+// inflate is restored by priming the bits of the block that are in the byte
+// before in_off, then setting the window as the dictionary.
+struct DeflateCheckpoint {
+    u64 out_off; // offset in the uncompressed data.
+    u64 in_off; // offset in the compressed data.
+    u8 bits; // number of bits of the byte before in_off that belong to the next block.
+    std::vector<u8> window;
+};
+
+// checkpoints of a deflate entry, sorted by offset.
+// they are added during the first pass of reading the entry.
+struct DeflateIndex {
+    std::vector<DeflateCheckpoint> checkpoints;
+    u32 crc32;
+    // set if a checkpoint was added since the index was loaded.
+    bool dirty;
+};
+
+// key is the local file header offset of the entry.
+using DeflateIndexes = std::unordered_map<u64, DeflateIndex>;
+
 struct Zfile {
     z_stream z; // zlib stream.
     Bytef* buffer; // buffer that compressed data is read into.
     size_t buffer_size; // size of the above buffer.
     size_t compressed_off; // offset of the compressed file.
+    size_t out_off; // offset of the uncompressed data the stream is at.
+    Bytef* skip_buffer; // inflated data is discarded here when seeking forwards.
+    DeflateIndex* index; // shared between all opens of the entry.
 };
 
 struct File {
@@ -186,12 +173,129 @@ void set_stat_file(const FileEntry* entry, struct stat *st) {
     st->st_ctime = st->st_atime;
 }
 
+void LoadIndexes(fs::Fs* fs, const fs::FsPath& path, s64 zip_size, const FileTableEntries& entries, DeflateIndexes& out) {
+    std::vector<u8> data;
+    if (R_FAILED(fs->read_entire_file(path, data))) {
+        return;
+    }
+
+    u64 off{};
+    const auto read = [&](void* buf, u64 size) {
+        if (off + size > data.size()) {
+            return false;
+        }
+
+        std::memcpy(buf, data.data() + off, size);
+        off += size;
+        return true;
+    };
+
+    IndexHeader header;
+    if (!read(&header, sizeof(header)) || header.magic != INDEX_MAGIC || header.version != INDEX_VERSION || header.zip_size != (u64)zip_size) {
+        log_write("[ZIP] ignoring stale seek index: %s\n", path.s);
+        return;
+    }
+
+    std::unordered_map<u64, u32> crc32s;
+    for (const auto& e : entries) {
+        crc32s.emplace(e.local_file_header_off, e.crc32);
+    }
+
+    DeflateIndexes indexes;
+    for (u32 i = 0; i < header.entry_count; i++) {
+        IndexEntryHeader entry_header;
+        if (!read(&entry_header, sizeof(entry_header))) {
+            return;
+        }
+
+        const auto it = crc32s.find(entry_header.local_file_header_off);
+        if (it == crc32s.end() || it->second != entry_header.crc32) {
+            log_write("[ZIP] ignoring stale seek index: %s\n", path.s);
+            return;
+        }
+
+        auto& index = indexes[entry_header.local_file_header_off];
+        index.crc32 = entry_header.crc32;
+        index.checkpoints.resize(entry_header.checkpoint_count);
+
+        for (auto& cp : index.checkpoints) {
+            IndexCheckpointHeader cp_header;
+            if (!read(&cp_header, sizeof(cp_header)) || cp_header.window_size > WINDOW_SIZE || cp_header.bits > 7) {
+                return;
+            }
+
+            cp.out_off = cp_header.out_off;
+            cp.in_off = cp_header.in_off;
+            cp.bits = cp_header.bits;
+            cp.window.resize(cp_header.window_size);
+            if (!read(cp.window.data(), cp.window.size())) {
+                return;
+            }
+        }
+    }
+
+    log_write("[ZIP] loaded seek index for %zu entries\n", indexes.size());
+    out = std::move(indexes);
+}
+
+Result SaveIndexes(fs::Fs* fs, const fs::FsPath& path, s64 zip_size, const DeflateIndexes& indexes) {
+    std::vector<u8> data;
+    const auto write = [&](const void* buf, u64 size) {
+        const auto ptr = static_cast<const u8*>(buf);
+        data.insert(data.end(), ptr, ptr + size);
+    };
+
+    IndexHeader header{};
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.zip_size = zip_size;
+    for (const auto& [off, index] : indexes) {
+        header.entry_count += !index.checkpoints.empty();
+    }
+    write(&header, sizeof(header));
+
+    for (const auto& [off, index] : indexes) {
+        if (index.checkpoints.empty()) {
+            continue;
+        }
+
+        const IndexEntryHeader entry_header{off, index.crc32, (u32)index.checkpoints.size()};
+        write(&entry_header, sizeof(entry_header));
+
+        for (const auto& cp : index.checkpoints) {
+            IndexCheckpointHeader cp_header{};
+            cp_header.out_off = cp.out_off;
+            cp_header.in_off = cp.in_off;
+            cp_header.bits = cp.bits;
+            cp_header.window_size = cp.window.size();
+            write(&cp_header, sizeof(cp_header));
+            write(cp.window.data(), cp.window.size());
+        }
+    }
+
+    return fs->write_entire_file(path, data);
+}
+
 struct Device final : common::MountDevice {
-    Device(std::unique_ptr<common::LruBufferedData>&& _source, const DirectoryEntry& _root, const common::MountConfig& _config)
+    Device(std::unique_ptr<common::LruBufferedData>&& _source, const DirectoryEntry& _root, const common::MountConfig& _config, DeflateIndexes&& _indexes, u64 _index_span, fs::Fs* _fs, const fs::FsPath& _index_path, s64 _zip_size)
     : MountDevice{_config}
     , source{std::forward<decltype(_source)>(_source)}
-    , root{_root} {
+    , root{_root}
+    , indexes{std::forward<decltype(_indexes)>(_indexes)}
+    , index_span{_index_span}
+    , fs{_fs}
+    , index_path{_index_path}
+    , zip_size{_zip_size} {
+
+    }
 
+    ~Device() {
+        // only save the index if it changed.
+        if (!index_path.empty() && std::ranges::any_of(indexes, [](const auto& e) { return e.second.dirty; })) {
+            if (R_FAILED(SaveIndexes(fs, index_path, zip_size, indexes))) {
+                log_write("[ZIP] failed to save seek index: %s\n", index_path.s);
+            }
+        }
     }
 
 private:
@@ -207,9 +311,20 @@ private:
     int devoptab_dirclose(void* fd) override;
     int devoptab_lstat(const char *path, struct stat *st) override;
 
+    ssize_t inflate_file(File* file, void* buf, size_t len);
+    bool restore_checkpoint(File* file, const DeflateCheckpoint* cp);
+    bool seek_file(File* file, u64 off);
+
 private:
     std::unique_ptr<common::LruBufferedData> source;
     const DirectoryEntry root;
+    DeflateIndexes indexes;
+    // min distance between checkpoints.
+    const u64 index_span;
+    fs::Fs* fs;
+    // empty if the index isn't saved.
+    const fs::FsPath index_path;
+    const s64 zip_size;
 };
 
 int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mode) {
@@ -240,22 +355,10 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
         return -ENOENT;
     }
 
+    // the data descriptor (if any) comes after the data, the sizes are taken
+    // from the central directory so there's no need to read it.
     offset += sizeof(local_hdr) + local_hdr.filename_len + local_hdr.extrafield_len;
 
-    // todo: does a decs take prio over file header?
-    if (local_hdr.flags & mmz_Flag_DataDescriptor) {
-        mmz_DataDescriptor data_desc{};
-        if (R_FAILED(this->source->Read2(&data_desc, offset, sizeof(data_desc)))) {
-            return -ENOENT;
-        }
-
-        if (data_desc.sig != DATA_DESCRIPTOR_SIG) {
-            return -ENOENT;
-        }
-
-        offset += sizeof(data_desc);
-    }
-
     if (entry->compression_type == mmz_Compression_Deflate) {
         auto& zfile = file->zfile;
         zfile.buffer_size = 1024 * 64;
@@ -270,6 +373,9 @@ int Device::devoptab_open(void *fileStruct, const char *path, int flags, int mod
             zfile.buffer = nullptr;
             return -ENOENT;
         }
+
+        zfile.index = &this->indexes[entry->local_file_header_off];
+        zfile.index->crc32 = entry->crc32;
     }
 
     file->entry = entry;
@@ -286,6 +392,10 @@ int Device::devoptab_close(void *fd) {
         if (file->zfile.buffer) {
             std::free(file->zfile.buffer);
         }
+
+        if (file->zfile.skip_buffer) {
+            std::free(file->zfile.skip_buffer);
+        }
     }
 
     return 0;
@@ -304,34 +414,16 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
             return -ENOENT;
         }
     } else if (file->entry->compression_type == mmz_Compression_Deflate) {
-        auto& zfile = file->zfile;
-        zfile.z.next_out = (Bytef*)ptr;
-        zfile.z.avail_out = len;
-
-        // run until we have inflated enough data.
-        while (zfile.z.avail_out) {
-            // check if we need to fetch more data.
-            if (!zfile.z.next_in || !zfile.z.avail_in) {
-                const auto clen = std::min(zfile.buffer_size, file->entry->compressed_size - zfile.compressed_off);
-                if (R_FAILED(this->source->Read2(zfile.buffer, file->data_off + zfile.compressed_off, clen))) {
-                    return -ENOENT;
-                }
-
-                zfile.compressed_off += clen;
-                zfile.z.next_in = zfile.buffer;
-                zfile.z.avail_in = clen;
-            }
+        if (file->zfile.out_off != file->off && !seek_file(file, file->off)) {
+            return -ENOENT;
+        }
 
-            const auto rc = inflate(&zfile.z, Z_SYNC_FLUSH);
-            if (Z_OK != rc) {
-                if (Z_STREAM_END == rc) {
-                    len -= zfile.z.avail_out;
-                } else {
-                    log_write("[ZLIB] failed to inflate: %d %s\n", rc, zfile.z.msg);
-                    return -ENOENT;
-                }
-            }
+        const auto rc = inflate_file(file, ptr, len);
+        if (rc < 0) {
+            return rc;
         }
+
+        len = rc;
     }
 
     file->off += len;
@@ -341,35 +433,136 @@ ssize_t Device::devoptab_read(void *fd, char *ptr, size_t len) {
 ssize_t Device::devoptab_seek(void *fd, off_t pos, int dir) {
     auto file = static_cast<File*>(fd);
 
-    // seek like normal.
-    if (file->entry->compression_type == mmz_Compression_None) {
-        if (dir == SEEK_CUR) {
-            pos += file->off;
-        } else if (dir == SEEK_END) {
-            pos = file->entry->uncompressed_size;
+    // deflate entries are moved to the new offset on the next read, see seek_file().
+    if (dir == SEEK_CUR) {
+        pos += file->off;
+    } else if (dir == SEEK_END) {
+        pos += file->entry->uncompressed_size;
+    }
+
+    return file->off = std::clamp<u64>(pos, 0, file->entry->uncompressed_size);
+}
+
+// inflates up to len bytes, a checkpoint is added at each block boundary
+// that is at least a span past the last checkpoint.
+ssize_t Device::inflate_file(File* file, void* buf, size_t len) {
+    auto& zfile = file->zfile;
+    auto& index = *zfile.index;
+    zfile.z.next_out = (Bytef*)buf;
+    zfile.z.avail_out = len;
+
+    // run until we have inflated enough data.
+    while (zfile.z.avail_out) {
+        // check if we need to fetch more data.
+        if (!zfile.z.next_in || !zfile.z.avail_in) {
+            const auto clen = std::min(zfile.buffer_size, file->entry->compressed_size - zfile.compressed_off);
+            if (R_FAILED(this->source->Read2(zfile.buffer, file->data_off + zfile.compressed_off, clen))) {
+                return -ENOENT;
+            }
+
+            zfile.compressed_off += clen;
+            zfile.z.next_in = zfile.buffer;
+            zfile.z.avail_in = clen;
         }
-    } else if (file->entry->compression_type == mmz_Compression_Deflate) {
-        // limited seek options.
-        // todo: support seeking to end and then back to orig position.
-        if (dir == SEEK_SET) {
-            if (pos == 0) {
-                inflateReset(&file->zfile.z);
-            } else if (pos != file->off) {
-                // seeking to the end is fine as it may be used to calc size.
-                if (pos != file->entry->uncompressed_size) {
-                    // random access seek is not supported.
-                    pos = file->off;
+
+        // Z_BLOCK stops at the end of each block so that checkpoints can be taken.
+        const auto avail_out = zfile.z.avail_out;
+        const auto rc = inflate(&zfile.z, Z_BLOCK);
+        zfile.out_off += avail_out - zfile.z.avail_out;
+
+        if (Z_STREAM_END == rc) {
+            break;
+        } else if (Z_OK != rc) {
+            log_write("[ZLIB] failed to inflate: %d %s\n", rc, zfile.z.msg);
+            return -ENOENT;
+        }
+
+        // bit 7 is set at the end of a block, bit 6 if it was the last block.
+        if ((zfile.z.data_type & 128) && !(zfile.z.data_type & 64)) {
+            const auto last_off = index.checkpoints.empty() ? 0 : index.checkpoints.back().out_off;
+            if (zfile.out_off >= last_off + this->index_span) {
+                DeflateCheckpoint cp{};
+                cp.out_off = zfile.out_off;
+                cp.in_off = zfile.compressed_off - zfile.z.avail_in;
+                cp.bits = zfile.z.data_type & 7;
+                cp.window.resize(WINDOW_SIZE);
+
+                uInt window_size = cp.window.size();
+                if (Z_OK == inflateGetDictionary(&zfile.z, cp.window.data(), &window_size)) {
+                    cp.window.resize(window_size);
+                    index.checkpoints.emplace_back(std::move(cp));
+                    index.dirty = true;
                 }
             }
-        } else if (dir == SEEK_CUR) {
-            // random access seek is not supported.
-            pos = file->off;
-        } else if (dir == SEEK_END) {
-            pos = file->entry->uncompressed_size;
         }
     }
 
-    return file->off = std::clamp<u64>(pos, 0, file->entry->uncompressed_size);
+    return len - zfile.z.avail_out;
+}
+
+// resets the stream to the checkpoint, or to the start if nullptr.
+bool Device::restore_checkpoint(File* file, const DeflateCheckpoint* cp) {
+    auto& zfile = file->zfile;
+    if (Z_OK != inflateReset(&zfile.z)) {
+        return false;
+    }
+
+    zfile.z.next_in = nullptr;
+    zfile.z.avail_in = 0;
+    zfile.compressed_off = cp ? cp->in_off : 0;
+    zfile.out_off = cp ? cp->out_off : 0;
+
+    if (!cp) {
+        return true;
+    }
+
+    if (cp->bits) {
+        u8 byte;
+        if (R_FAILED(this->source->Read2(&byte, file->data_off + cp->in_off - 1, sizeof(byte)))) {
+            return false;
+        }
+
+        if (Z_OK != inflatePrime(&zfile.z, cp->bits, byte >> (8 - cp->bits))) {
+            return false;
+        }
+    }
+
+    return Z_OK == inflateSetDictionary(&zfile.z, cp->window.data(), cp->window.size());
+}
+
+// moves the stream to off, starting from the closest checkpoint before it,
+// unless the stream is already closer.
+// at most one span is inflated once the entry has been read through once.
+bool Device::seek_file(File* file, u64 off) {
+    auto& zfile = file->zfile;
+    const auto& checkpoints = zfile.index->checkpoints;
+
+    const auto it = std::ranges::upper_bound(checkpoints, off, {}, &DeflateCheckpoint::out_off);
+    const auto cp = it == checkpoints.begin() ? nullptr : &*std::prev(it);
+    const u64 cp_off = cp ? cp->out_off : 0;
+
+    if (off < zfile.out_off || cp_off > zfile.out_off) {
+        if (!restore_checkpoint(file, cp)) {
+            log_write("[ZIP] failed to restore checkpoint\n");
+            return false;
+        }
+    }
+
+    while (zfile.out_off < off) {
+        if (!zfile.skip_buffer) {
+            zfile.skip_buffer = (Bytef*)std::malloc(zfile.buffer_size);
+            if (!zfile.skip_buffer) {
+                return false;
+            }
+        }
+
+        const auto rc = inflate_file(file, zfile.skip_buffer, std::min<u64>(zfile.buffer_size, off - zfile.out_off));
+        if (rc <= 0) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 int Device::devoptab_fstat(void *fd, struct stat *st) {
@@ -495,12 +688,13 @@ void Parse(const FileTableEntries& entries, DirectoryEntry& out) {
     Parse(entries, index, out);
 }
 
-Result find_central_dir_offset(common::LruBufferedData* source, s64 size, mmz_EndRecord* record) {
+Result find_central_dir_offset(common::LruBufferedData* source, s64 size, mmz_EndRecord* record, s64* record_off) {
     // check if the record is at the end (no extra header).
     auto offset = size - sizeof(*record);
     R_TRY(source->Read2(record, offset, sizeof(*record)));
 
     if (record->sig == END_RECORD_SIG) {
+        *record_off = offset;
         R_SUCCEED();
     }
 
@@ -516,6 +710,7 @@ Result find_central_dir_offset(common::LruBufferedData* source, s64 size, mmz_En
         std::memcpy(&sig, data.data() + i, sizeof(sig));
         if (sig == END_RECORD_SIG) {
             std::memcpy(record, data.data() + i, sizeof(*record));
+            *record_off = offset + i;
             R_SUCCEED();
         }
     }
@@ -523,14 +718,53 @@ Result find_central_dir_offset(common::LruBufferedData* source, s64 size, mmz_En
     R_THROW(0x1);
 }
 
+// the real entry count and central directory offset are in the zip64 end record
+// if they don't fit in the end record.
+Result find_zip64_central_dir_offset(common::LruBufferedData* source, s64 record_off, u64* total_entries, u64* file_hdr_off) {
+    mmz_Zip64EndLocator locator;
+    R_UNLESS(record_off >= (s64)sizeof(locator), 0x1);
+    R_TRY(source->Read2(&locator, record_off - sizeof(locator), sizeof(locator)));
+
+    if (locator.sig != ZIP64_END_LOCATOR_SIG) {
+        log_write("[ZIP] missing zip64 end locator\n");
+        R_THROW(0x1);
+    }
+
+    mmz_Zip64EndRecord record;
+    R_TRY(source->Read2(&record, locator.end_record_off, sizeof(record)));
+
+    if (record.sig != ZIP64_END_RECORD_SIG) {
+        log_write("[ZIP] invalid zip64 end record\n");
+        R_THROW(0x1);
+    }
+
+    *total_entries = record.total_entries;
+    *file_hdr_off = record.file_hdr_off;
+    R_SUCCEED();
+}
+
 Result ParseZip(common::LruBufferedData* source, s64 size, FileTableEntries& out) {
     mmz_EndRecord end_rec;
-    R_TRY(find_central_dir_offset(source, size, &end_rec));
+    s64 end_rec_off;
+    R_TRY(find_central_dir_offset(source, size, &end_rec, &end_rec_off));
 
-    out.reserve(end_rec.total_entries);
-    auto file_header_off = end_rec.file_hdr_off;
+    u64 total_entries = end_rec.total_entries;
+    u64 file_header_off = end_rec.file_hdr_off;
+    if (end_rec.total_entries == ZIP64_MAGIC_16 || end_rec.file_hdr_off == ZIP64_MAGIC_32 || end_rec.central_directory_size == ZIP64_MAGIC_32) {
+        R_TRY(find_zip64_central_dir_offset(source, end_rec_off, &total_entries, &file_header_off));
+    }
 
-    for (u16 i = 0; i < end_rec.total_entries; i++) {
+    // every entry has a file header in the central directory, so a corrupt
+    // count can't be larger than the archive could hold.
+    if (total_entries > u64(size) / sizeof(mmz_FileHeader)) {
+        log_write("[ZIP] invalid entry count: %zu\n", total_entries);
+        R_THROW(0x1);
+    }
+
+    out.reserve(total_entries);
+    std::vector<u8> extra;
+
+    for (u64 i = 0; i < total_entries; i++) {
         // read the file header.
         mmz_FileHeader file_hdr{};
         R_TRY(source->Read2(&file_hdr, file_header_off, sizeof(file_hdr)));
@@ -549,12 +783,20 @@ Result ParseZip(common::LruBufferedData* source, s64 size, FileTableEntries& out
         new_entry.compressed_size = file_hdr.compressed_size;
         new_entry.uncompressed_size = file_hdr.uncompressed_size;
         new_entry.local_file_header_off = file_hdr.local_hdr_off;
+        new_entry.crc32 = file_hdr.crc32;
 
         // read the file name.
         const auto filename_off = file_header_off + sizeof(file_hdr);
         new_entry.path.resize(file_hdr.filename_len);
         R_TRY(source->Read2(new_entry.path.data(), filename_off, new_entry.path.size()));
 
+        // read the zip64 sizes / offset from the extra field.
+        if (file_hdr.extrafield_len) {
+            extra.resize(file_hdr.extrafield_len);
+            R_TRY(source->Read2(extra.data(), filename_off + file_hdr.filename_len, extra.size()));
+            ParseZip64Extra(extra, new_entry.uncompressed_size, new_entry.compressed_size, new_entry.local_file_header_off);
+        }
+
         // advance the offset.
         file_header_off += sizeof(file_hdr) + file_hdr.filename_len + file_hdr.extrafield_len + file_hdr.filecomment_len;
     }
@@ -578,9 +820,18 @@ Result MountZip(fs::Fs* fs, const fs::FsPath& path, fs::FsPath& out_path) {
     DirectoryEntry root;
     Parse(table_entries, root);
 
+    // checkpoints allow for random access in deflate entries, optionally saved next to the zip.
+    const auto index_span = u64(std::clamp(App::GetApp()->m_zip_seek_span.Get(), 1L, 64L)) * 1024 * 1024;
+    DeflateIndexes indexes;
+    fs::FsPath index_path;
+    if (App::GetApp()->m_zip_seek_index_save.Get()) {
+        index_path = path + ".zidx";
+        LoadIndexes(fs, index_path, size, table_entries, indexes);
+    }
+
     if (!common::MountReadOnlyIndexDevice(
-        [&buffered, &root](const common::MountConfig& config) {
-            return std::make_unique<Device>(std::move(buffered), root, config);
+        [&](const common::MountConfig& config) {
+            return std::make_unique<Device>(std::move(buffered), root, config, std::move(indexes), index_span, fs, index_path, size);
         },
         sizeof(File), sizeof(Dir),
         "ZIP", out_path
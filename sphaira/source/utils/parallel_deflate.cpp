@@ -0,0 +1,344 @@
+#include "utils/parallel_deflate.hpp"
+#include "utils/thread.hpp"
+#include "defines.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <zlib.h>
+
+namespace sphaira::utils {
+namespace {
+
+constexpr u64 BLOCK_SIZE_MIN = 1024 * 128;
+constexpr u64 BLOCK_SIZE_MAX = 1024 * 1024;
+// max size of a deflate window, used as the dictionary for the next block.
+constexpr u64 DICT_SIZE = 1024 * 32;
+// number of blocks in flight per thread, the extra block is being read / written.
+constexpr u32 JOBS_PER_THREAD = 2;
+constexpr int LEVEL_NONE = -2;
+
+} // namespace
+
+ParallelDeflate::ParallelDeflate() {
+    mutexInit(std::addressof(m_mutex));
+    condvarInit(std::addressof(m_can_work));
+    condvarInit(std::addressof(m_can_collect));
+}
+
+ParallelDeflate::~ParallelDeflate() {
+    Close();
+}
+
+Result ParallelDeflate::Start(u32 thread_count, u64 block_size) {
+    Close();
+
+    m_quit = false;
+    m_block_size = std::clamp(block_size, BLOCK_SIZE_MIN, BLOCK_SIZE_MAX);
+    m_jobs = std::vector<Job>(thread_count * JOBS_PER_THREAD);
+    m_threads.resize(thread_count);
+    m_submit_index = m_collect_index = 0;
+
+    for (auto& job : m_jobs) {
+        job.in = PooledBuffer{m_block_size};
+        job.out = PooledBuffer{m_block_size};
+    }
+
+    for (u32 i = 0; i < thread_count; i++) {
+        auto t = std::addressof(m_threads[m_thread_count]);
+        R_TRY(CreateThread(t, worker_func, this, 1024*64));
+
+        if (const auto rc = threadStart(t); R_FAILED(rc)) {
+            threadClose(t);
+            R_THROW(rc);
+        }
+
+        m_thread_count++;
+    }
+
+    log_write("[DEFLATE] started %u threads, block size: %zu\n", m_thread_count, m_block_size);
+    R_SUCCEED();
+}
+
+void ParallelDeflate::Close() {
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        m_quit = true;
+        condvarWakeAll(std::addressof(m_can_work));
+    }
+
+    for (u32 i = 0; i < m_thread_count; i++) {
+        threadWaitForExit(std::addressof(m_threads[i]));
+        threadClose(std::addressof(m_threads[i]));
+    }
+
+    m_thread_count = 0;
+    m_threads.clear();
+    m_jobs.clear();
+}
+
+Result ParallelDeflate::Compress(s64 size, int level, const ReadCallback& rfunc, const WriteCallback& wfunc, u32* crc32, s64* compressed_size) {
+    if (!IsRunning()) {
+        return CompressInline(size, level, rfunc, wfunc, crc32, compressed_size);
+    }
+
+    m_crc32 = 0;
+    m_compressed_size = 0;
+
+    // jobs may still be running if a block failed.
+    ON_SCOPE_EXIT(Drain());
+
+    std::vector<u8> dict;
+    s64 off{};
+
+    // an empty file still needs a final block.
+    do {
+        Job* job;
+        R_TRY(GetFreeJob(std::addressof(job), wfunc));
+        R_TRY(ReadBlock(*job, m_block_size, size, level, rfunc, off, dict));
+        Submit(job);
+    } while (off < size);
+
+    while (m_collect_index != m_submit_index) {
+        R_TRY(Collect(wfunc));
+    }
+
+    if (crc32) {
+        *crc32 = m_crc32;
+    }
+    if (compressed_size) {
+        *compressed_size = m_compressed_size;
+    }
+
+    R_SUCCEED();
+}
+
+Result ParallelDeflate::CompressInline(s64 size, int level, const ReadCallback& rfunc, const WriteCallback& wfunc, u32* crc32, s64* compressed_size) {
+    z_stream strm{};
+    int strm_level = LEVEL_NONE;
+    ON_SCOPE_EXIT(
+        if (strm_level != LEVEL_NONE) {
+            deflateEnd(std::addressof(strm));
+        }
+    );
+
+    const auto block_size = m_block_size ? m_block_size : BLOCK_SIZE_MAX;
+    Job job{};
+    job.in = PooledBuffer{block_size};
+    job.out = PooledBuffer{block_size};
+
+    std::vector<u8> dict;
+    s64 off{};
+    u32 crc{};
+    s64 csize{};
+
+    do {
+        R_TRY(ReadBlock(job, block_size, size, level, rfunc, off, dict));
+        R_TRY(DeflateJob(std::addressof(strm), std::addressof(strm_level), job));
+        R_TRY(wfunc(job.out->data(), job.out->size()));
+
+        crc = crc32_combine(crc, job.crc32, job.in->size());
+        csize += job.out->size();
+    } while (off < size);
+
+    if (crc32) {
+        *crc32 = crc;
+    }
+    if (compressed_size) {
+        *compressed_size = csize;
+    }
+
+    R_SUCCEED();
+}
+
+Result ParallelDeflate::ReadBlock(Job& job, u64 block_size, s64 size, int level, const ReadCallback& rfunc, s64& off, std::vector<u8>& dict) {
+    auto& in = *job.in;
+    in.resize(std::min<s64>(block_size, size - off));
+
+    for (u64 done = 0; done < in.size();) {
+        u64 bytes_read{};
+        R_TRY(rfunc(in.data() + done, off + done, in.size() - done, std::addressof(bytes_read)));
+        // the file got smaller whilst reading.
+        R_UNLESS(bytes_read, Result_ZipDeflate);
+        done += bytes_read;
+    }
+
+    off += in.size();
+    job.level = level;
+    job.last = off >= size;
+    std::swap(job.dict, dict);
+
+    // blocks are never smaller than the window, apart from the last block.
+    const auto dict_size = std::min<u64>(DICT_SIZE, in.size());
+    dict.assign(in.end() - dict_size, in.end());
+    R_SUCCEED();
+}
+
+Result ParallelDeflate::GetFreeJob(Job** out, const WriteCallback& wfunc) {
+    // write out whatever has finished so far, waiting if all jobs are in use.
+    while (m_collect_index != m_submit_index) {
+        auto& job = m_jobs[m_collect_index % m_jobs.size()];
+        bool done;
+        {
+            SCOPED_MUTEX(std::addressof(m_mutex));
+            done = job.state == JobState::Done;
+        }
+
+        if (!done && m_submit_index - m_collect_index < m_jobs.size()) {
+            break;
+        }
+
+        R_TRY(Collect(wfunc));
+    }
+
+    auto& job = m_jobs[m_submit_index % m_jobs.size()];
+    job.in->resize(0);
+    job.out->resize(0);
+    *out = std::addressof(job);
+    R_SUCCEED();
+}
+
+void ParallelDeflate::Submit(Job* job) {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    job->state = JobState::Pending;
+    m_submit_index++;
+    condvarWakeOne(std::addressof(m_can_work));
+}
+
+Result ParallelDeflate::Collect(const WriteCallback& wfunc) {
+    auto& job = m_jobs[m_collect_index % m_jobs.size()];
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        while (job.state != JobState::Done) {
+            condvarWait(std::addressof(m_can_collect), std::addressof(m_mutex));
+        }
+    }
+
+    R_TRY(job.result);
+    R_TRY(wfunc(job.out->data(), job.out->size()));
+
+    m_crc32 = crc32_combine(m_crc32, job.crc32, job.in->size());
+    m_compressed_size += job.out->size();
+
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    job.state = JobState::Free;
+    m_collect_index++;
+    R_SUCCEED();
+}
+
+void ParallelDeflate::Drain() {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+
+    // pending jobs are dropped, busy jobs are waited on.
+    for (; m_collect_index != m_submit_index; m_collect_index++) {
+        auto& job = m_jobs[m_collect_index % m_jobs.size()];
+        while (job.state == JobState::Busy) {
+            condvarWait(std::addressof(m_can_collect), std::addressof(m_mutex));
+        }
+        job.state = JobState::Free;
+    }
+}
+
+auto ParallelDeflate::GetPendingJob() -> Job* {
+    // pick the oldest pending job so that the collector waits as little as possible.
+    for (auto i = m_collect_index; i != m_submit_index; i++) {
+        auto& job = m_jobs[i % m_jobs.size()];
+        if (job.state == JobState::Pending) {
+            return std::addressof(job);
+        }
+    }
+
+    return nullptr;
+}
+
+void ParallelDeflate::WorkerFunc() {
+    z_stream strm{};
+    int strm_level = LEVEL_NONE;
+    ON_SCOPE_EXIT(
+        if (strm_level != LEVEL_NONE) {
+            deflateEnd(std::addressof(strm));
+        }
+    );
+
+    for (;;) {
+        Job* job{};
+        {
+            SCOPED_MUTEX(std::addressof(m_mutex));
+            while (!m_quit && !(job = GetPendingJob())) {
+                condvarWait(std::addressof(m_can_work), std::addressof(m_mutex));
+            }
+
+            if (m_quit) {
+                break;
+            }
+
+            job->state = JobState::Busy;
+        }
+
+        const auto result = DeflateJob(std::addressof(strm), std::addressof(strm_level), *job);
+
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        job->result = result;
+        job->state = JobState::Done;
+        condvarWakeAll(std::addressof(m_can_collect));
+    }
+}
+
+Result ParallelDeflate::DeflateJob(void* _strm, int* strm_level, Job& job) {
+    auto strm = static_cast<z_stream*>(_strm);
+
+    // the stream is reused between jobs, it only needs to be re-created if the level changed.
+    if (*strm_level != job.level) {
+        if (*strm_level != LEVEL_NONE) {
+            deflateEnd(strm);
+            *strm_level = LEVEL_NONE;
+        }
+
+        R_UNLESS(Z_OK == deflateInit2(strm, job.level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Result_ZipDeflate);
+        *strm_level = job.level;
+    } else {
+        R_UNLESS(Z_OK == deflateReset(strm), Result_ZipDeflate);
+    }
+
+    if (!job.dict.empty()) {
+        R_UNLESS(Z_OK == deflateSetDictionary(strm, job.dict.data(), job.dict.size()), Result_ZipDeflate);
+    }
+
+    auto& in = *job.in;
+    auto& out = *job.out;
+    job.crc32 = crc32CalculateWithSeed(0, in.data(), in.size());
+
+    // room for the sync flush marker.
+    out.resize(deflateBound(strm, in.size()) + 16);
+    strm->next_in = in.data();
+    strm->avail_in = in.size();
+    strm->next_out = out.data();
+    strm->avail_out = out.size();
+
+    // the sync flush ends the block on a byte boundary without marking it as the
+    // last block, so the next block can be appended straight after it.
+    const auto flush = job.last ? Z_FINISH : Z_SYNC_FLUSH;
+    for (;;) {
+        const auto rc = deflate(strm, flush);
+        if (rc == Z_STREAM_END) {
+            break;
+        }
+
+        R_UNLESS(rc == Z_OK || rc == Z_BUF_ERROR, Result_ZipDeflate);
+        if (flush == Z_SYNC_FLUSH && !strm->avail_in && strm->avail_out) {
+            break;
+        }
+
+        // ran out of space, this shouldn't happen as the output is sized to the bound.
+        if (!strm->avail_out) {
+            const auto used = out.size();
+            out.resize(used * 2);
+            strm->next_out = out.data() + used;
+            strm->avail_out = out.size() - used;
+        }
+    }
+
+    out.resize(out.size() - strm->avail_out);
+    R_SUCCEED();
+}
+
+} // namespace sphaira::utils
@@ -0,0 +1,372 @@
+#include "utils/pipeline.hpp"
+#include "utils/thread.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sphaira::utils {
+
+PipelineQueue::PipelineQueue(u32 depth, u32 max_depth) : m_entries(std::max<u32>({1, depth, max_depth})) {
+    mutexInit(std::addressof(m_mutex));
+    condvarInit(std::addressof(m_can_push));
+    condvarInit(std::addressof(m_can_pop));
+    m_depth = std::clamp<u32>(depth, 1, m_entries.size());
+}
+
+PipelineQueue::~PipelineQueue() {
+    for (auto& entry : m_entries) {
+        BufferPool::Release(std::move(entry.buf));
+    }
+
+    for (auto& buf : m_spare) {
+        BufferPool::Release(std::move(buf));
+    }
+}
+
+Result PipelineQueue::Push(PoolVector& buf, s64 off, StageProfile* profile) {
+    const auto capacity = buf.capacity();
+
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+
+        {
+            TimeStamp ts{};
+            ON_SCOPE_EXIT(if (profile) { profile->AddIdle(ts.GetNs()); });
+
+            while (m_count >= m_depth && !m_consumer_closed && !m_cancel_result) {
+                condvarWait(std::addressof(m_can_push), std::addressof(m_mutex));
+            }
+        }
+
+        R_TRY(m_cancel_result);
+
+        // nobody is left to read the data.
+        if (m_consumer_closed) {
+            R_SUCCEED();
+        }
+
+        auto& entry = m_entries[(m_read_index + m_count) % m_entries.size()];
+        entry.off = off;
+        entry.buf = std::move(buf);
+        m_count++;
+
+        // hand back a buffer that the consumer has finished with.
+        buf.clear();
+        if (!m_spare.empty()) {
+            std::swap(buf, m_spare.back());
+            m_spare.pop_back();
+        }
+
+        condvarWakeOne(std::addressof(m_can_pop));
+    }
+
+    // no spare buffer yet, lease one of the same size outside of the lock.
+    if (!buf.capacity()) {
+        buf = BufferPool::Acquire(capacity);
+    }
+
+    R_SUCCEED();
+}
+
+Result PipelineQueue::Pop(PoolVector& buf, s64& off, StageProfile* profile) {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+
+    {
+        TimeStamp ts{};
+        ON_SCOPE_EXIT(if (profile) { profile->AddIdle(ts.GetNs()); });
+
+        while (!m_count && !m_producer_closed && !m_cancel_result) {
+            condvarWait(std::addressof(m_can_pop), std::addressof(m_mutex));
+        }
+    }
+
+    R_TRY(m_cancel_result);
+
+    // producer finished and there's nothing left.
+    if (!m_count) {
+        buf.resize(0);
+        R_SUCCEED();
+    }
+
+    // keep the consumers buffer for the producer to reuse.
+    if (buf.capacity()) {
+        m_spare.emplace_back(std::move(buf));
+    }
+
+    auto& entry = m_entries[m_read_index];
+    off = entry.off;
+    buf = std::move(entry.buf);
+    entry.buf = {};
+    m_read_index = (m_read_index + 1) % m_entries.size();
+    m_count--;
+
+    condvarWakeOne(std::addressof(m_can_push));
+    R_SUCCEED();
+}
+
+void PipelineQueue::CloseProducer() {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    m_producer_closed = true;
+    condvarWakeAll(std::addressof(m_can_pop));
+}
+
+void PipelineQueue::CloseConsumer() {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    m_consumer_closed = true;
+    condvarWakeAll(std::addressof(m_can_push));
+}
+
+void PipelineQueue::Cancel(Result rc) {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    if (!m_cancel_result) {
+        m_cancel_result = rc;
+    }
+    condvarWakeAll(std::addressof(m_can_push));
+    condvarWakeAll(std::addressof(m_can_pop));
+}
+
+void PipelineQueue::SetDepth(u32 depth) {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    m_depth = std::clamp<u32>(depth, 1, m_entries.size());
+    condvarWakeAll(std::addressof(m_can_push));
+}
+
+Result PipelineStage::Pop(PoolVector& buf, s64& off) {
+    // the first stage has no input.
+    if (!m_input) {
+        buf.resize(0);
+        R_SUCCEED();
+    }
+
+    return m_input->Pop(buf, off, std::addressof(m_profile));
+}
+
+Result PipelineStage::Push(PoolVector& buf, s64 off) {
+    // the last stage has no output (unless pulling).
+    if (!m_output) {
+        R_SUCCEED();
+    }
+
+    return m_output->Push(buf, off, std::addressof(m_profile));
+}
+
+Result PipelineStage::GetResults() const {
+    return m_pipeline->GetResults();
+}
+
+void PipelineStage::SignalProgress() {
+    ueventSignal(std::addressof(m_pipeline->m_uevent_progress));
+}
+
+auto PipelineStage::GetBufferSize() const -> u64 {
+    return m_pipeline->GetConfig().buffer_size;
+}
+
+Pipeline::Pipeline(ui::ProgressBox* pbox, const PipelineConfig& config)
+: m_pbox{pbox}
+, m_config{config} {
+    ueventCreate(std::addressof(m_uevent_done), false);
+    ueventCreate(std::addressof(m_uevent_progress), true);
+}
+
+Pipeline::~Pipeline() {
+    // ensure that all threads have exited before freeing the stages.
+    if (m_running) {
+        Cancel(Result_TransferCancelled);
+    }
+
+    Join();
+
+    for (auto& stage : m_stages) {
+        if (stage->m_created) {
+            threadClose(std::addressof(stage->m_thread));
+            stage->m_created = false;
+        }
+    }
+}
+
+void Pipeline::AddStage(const char* name, const StageFunc& func) {
+    m_stages.emplace_back(new PipelineStage{this, name, func});
+}
+
+Result Pipeline::Create(bool pull) {
+    R_UNLESS(!m_stages.empty(), Result_PipelineNoStages);
+
+    // connect each stage to the next.
+    for (size_t i = 1; i < m_stages.size(); i++) {
+        auto& queue = m_queues.emplace_back(std::make_unique<PipelineQueue>(m_config.queue_depth, m_config.max_queue_depth));
+        m_stages[i - 1]->m_output = queue.get();
+        m_stages[i]->m_input = queue.get();
+    }
+
+    if (pull) {
+        auto& queue = m_queues.emplace_back(std::make_unique<PipelineQueue>(m_config.queue_depth, m_config.max_queue_depth));
+        m_stages.back()->m_output = queue.get();
+        m_pull_queue = queue.get();
+    }
+
+    for (auto& stage : m_stages) {
+        R_TRY(utils::CreateThread(std::addressof(stage->m_thread), thread_func, stage.get(), m_config.stack_size));
+        stage->m_created = true;
+    }
+
+    R_SUCCEED();
+}
+
+Result Pipeline::Start() {
+    log_write("[PIPELINE] starting %zu stages, depth: %u buffer: %zu\n", m_stages.size(), m_config.queue_depth, m_config.buffer_size);
+
+    for (auto& stage : m_stages) {
+        R_UNLESS(stage->m_created, Result_PipelineNotCreated);
+
+        m_running++;
+        if (const auto rc = threadStart(std::addressof(stage->m_thread)); R_FAILED(rc)) {
+            m_running--;
+            Cancel(rc);
+            // wait for the started stages to exit as the caller may free
+            // what they reference as soon as this returns.
+            Join();
+            R_THROW(rc);
+        }
+
+        stage->m_started = true;
+    }
+
+    R_SUCCEED();
+}
+
+Result Pipeline::Wait(const ProgressCallback& callback) {
+    const auto waiter_progress = waiterForUEvent(std::addressof(m_uevent_progress));
+    const auto waiter_cancel = waiterForUEvent(m_pbox->GetCancelEvent());
+    const auto waiter_done = waiterForUEvent(std::addressof(m_uevent_done));
+
+    while (m_running) {
+        s32 idx;
+        if (R_FAILED(waitMulti(&idx, UINT64_MAX, waiter_progress, waiter_cancel, waiter_done))) {
+            break;
+        }
+
+        if (!idx) {
+            if (callback) {
+                callback();
+            }
+        } else if (idx == 1) {
+            Cancel(Result_TransferCancelled);
+            break;
+        } else {
+            break;
+        }
+    }
+
+    return Join();
+}
+
+Result Pipeline::Join() {
+    // nothing will pull after this point, so drop any remaining output.
+    if (m_pull_queue) {
+        m_pull_queue->CloseConsumer();
+    }
+
+    log_write("[PIPELINE] waiting for stages to close\n");
+    for (auto& stage : m_stages) {
+        if (stage->m_started) {
+            threadWaitForExit(std::addressof(stage->m_thread));
+            stage->m_started = false;
+        }
+    }
+    log_write("[PIPELINE] stages closed\n");
+
+    return GetResults();
+}
+
+Result Pipeline::Pull(void* data, s64 size, u64* bytes_read) {
+    *bytes_read = 0;
+    R_UNLESS(m_pull_queue, Result_PipelineNotCreated);
+
+    if (const auto rc = GetResults(); R_FAILED(rc)) {
+        Cancel(rc);
+        R_THROW(rc);
+    }
+
+    auto& buf = m_pull_buf.Get();
+    if (m_pull_offset == buf.size()) {
+        s64 dummy_off;
+        m_pull_offset = 0;
+        R_TRY(m_pull_queue->Pop(buf, dummy_off, nullptr));
+
+        // last stage has finished.
+        if (buf.empty()) {
+            R_SUCCEED();
+        }
+    }
+
+    size = std::min<s64>(size, buf.size() - m_pull_offset);
+    std::memcpy(data, buf.data() + m_pull_offset, size);
+    m_pull_offset += size;
+    *bytes_read = size;
+
+    R_SUCCEED();
+}
+
+void Pipeline::Cancel(Result rc) {
+    Result expected = 0;
+    m_result.compare_exchange_strong(expected, rc);
+
+    for (auto& queue : m_queues) {
+        queue->Cancel(rc);
+    }
+
+    ueventSignal(std::addressof(m_uevent_done));
+}
+
+void Pipeline::SetQueueDepth(u32 depth) {
+    for (auto& queue : m_queues) {
+        queue->SetDepth(depth);
+    }
+}
+
+Result Pipeline::GetResults() const {
+    R_TRY(m_pbox->ShouldExitResult());
+    return m_result.load();
+}
+
+void Pipeline::LogProfile() const {
+    for (const auto& stage : m_stages) {
+        stage->m_profile.Log(stage->m_name);
+    }
+
+    BufferPool::LogStats();
+}
+
+void Pipeline::OnStageExit(PipelineStage& stage, Result rc) {
+    if (R_FAILED(rc)) {
+        log_write("[PIPELINE] stage: %s failed: 0x%X\n", stage.m_name, rc);
+        Cancel(rc);
+    } else {
+        // let the neighbours know that this stage is done.
+        if (stage.m_output) {
+            stage.m_output->CloseProducer();
+        }
+        if (stage.m_input) {
+            stage.m_input->CloseConsumer();
+        }
+    }
+
+    if (!--m_running) {
+        ueventSignal(std::addressof(m_uevent_done));
+    }
+}
+
+void Pipeline::thread_func(void* arg) {
+    auto stage = static_cast<PipelineStage*>(arg);
+
+    stage->m_profile.Start();
+    const auto rc = stage->m_func(*stage);
+    stage->m_profile.Stop();
+
+    stage->m_pipeline->OnStageExit(*stage, rc);
+    log_write("[PIPELINE] stage: %s returned now\n", stage->m_name);
+}
+
+} // namespace sphaira::utils
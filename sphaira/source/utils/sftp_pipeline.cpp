@@ -0,0 +1,146 @@
+#include "utils/sftp_pipeline.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+namespace sphaira::utils {
+namespace {
+
+// number of writes in a row that can send nothing before giving up,
+// so that a stalled server can't hang the caller.
+constexpr u32 WRITE_STALL_MAX = 4;
+
+} // namespace
+
+SftpPipeline::SftpPipeline(LIBSSH2_SFTP_HANDLE* fd, size_t read_size, size_t write_size)
+: m_fd{fd}
+, m_read_size{read_size}
+, m_write_size{write_size} {
+    m_handle_off = libssh2_sftp_tell64(m_fd);
+}
+
+ssize_t SftpPipeline::Read(void* _buf, u64 off, size_t len) {
+    auto buf = static_cast<u8*>(_buf);
+
+    if (const auto rc = Flush(); rc < 0) {
+        return rc;
+    }
+
+    // still in the buffer from the last read.
+    if (off >= m_read_off && off < m_read_off + m_read_buf.size()) {
+        const auto size = std::min<size_t>(len, m_read_off + m_read_buf.size() - off);
+        std::memcpy(buf, m_read_buf.data() + (off - m_read_off), size);
+        return size;
+    }
+
+    m_read_buf.clear();
+    Seek(off);
+
+    // large reads go straight to libssh2, they already keep enough in flight.
+    if (!m_read_size || len >= m_read_size) {
+        const auto ret = libssh2_sftp_read(m_fd, reinterpret_cast<char*>(buf), len);
+        if (ret < 0) {
+            return -EIO;
+        }
+
+        m_handle_off += ret;
+        return ret;
+    }
+
+    m_read_buf.resize(m_read_size);
+    const auto ret = libssh2_sftp_read(m_fd, reinterpret_cast<char*>(m_read_buf.data()), m_read_buf.size());
+    if (ret < 0) {
+        m_read_buf.clear();
+        return -EIO;
+    }
+
+    m_read_buf.resize(ret);
+    m_read_off = m_handle_off;
+    m_handle_off += ret;
+
+    const auto size = std::min<size_t>(len, m_read_buf.size());
+    std::memcpy(buf, m_read_buf.data(), size);
+    return size;
+}
+
+ssize_t SftpPipeline::Write(const void* _buf, u64 off, size_t len) {
+    auto buf = static_cast<const u8*>(_buf);
+
+    // the data in the buffer may be about to change.
+    m_read_buf.clear();
+
+    // not sequential, send what has been joined so far.
+    if (!m_write_buf.empty() && off != m_write_off + m_write_buf.size()) {
+        if (const auto rc = Flush(); rc < 0) {
+            return rc;
+        }
+    }
+
+    // nothing to join with, send it as is.
+    if (m_write_buf.empty() && len >= m_write_size) {
+        Seek(off);
+        return WriteAll(buf, len);
+    }
+
+    if (m_write_buf.empty()) {
+        m_write_off = off;
+        m_write_buf.reserve(m_write_size);
+    }
+
+    m_write_buf.insert(m_write_buf.end(), buf, buf + len);
+    if (m_write_buf.size() >= m_write_size) {
+        if (const auto rc = Flush(); rc < 0) {
+            return rc;
+        }
+    }
+
+    return len;
+}
+
+int SftpPipeline::Flush() {
+    if (m_write_buf.empty()) {
+        return 0;
+    }
+
+    Seek(m_write_off);
+    const auto rc = WriteAll(m_write_buf.data(), m_write_buf.size());
+    m_write_buf.clear();
+    return rc < 0 ? rc : 0;
+}
+
+void SftpPipeline::Seek(u64 off) {
+    // libssh2_sftp_seek64() returns void, it only sets the offset of the handle
+    // and throws away the read ahead, so there is no error to check.
+    if (off != m_handle_off) {
+        libssh2_sftp_seek64(m_fd, off);
+        m_handle_off = off;
+    }
+}
+
+ssize_t SftpPipeline::WriteAll(const u8* buf, size_t len) {
+    // libssh2 returns once some of the data has been acked, the rest is
+    // still in flight and is accounted for by the next call.
+    u32 stalls = 0;
+    for (size_t done = 0; done < len;) {
+        const auto ret = libssh2_sftp_write(m_fd, reinterpret_cast<const char*>(buf + done), len - done);
+        if (ret == 0 || ret == LIBSSH2_ERROR_EAGAIN) {
+            if (++stalls >= WRITE_STALL_MAX) {
+                return -ETIMEDOUT;
+            }
+            continue;
+        }
+
+        if (ret < 0) {
+            return -EIO;
+        }
+
+        stalls = 0;
+        done += ret;
+        m_handle_off += ret;
+    }
+
+    return len;
+}
+
+} // namespace sphaira::utils
@@ -0,0 +1,64 @@
+#include "utils/throttle.hpp"
+#include "defines.hpp"
+
+#include <algorithm>
+
+namespace sphaira::utils {
+namespace {
+
+// 48MiB/s with a 1MiB burst, overridden by the config in App.
+TokenBucket g_emummc_throttle{1024 * 1024 * 48, 1024 * 1024};
+
+} // namespace
+
+TokenBucket::TokenBucket(u64 rate, u64 burst) {
+    mutexInit(std::addressof(m_mutex));
+    SetBudget(rate, burst);
+}
+
+void TokenBucket::SetBudget(u64 rate, u64 burst) {
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    m_rate = rate;
+    m_burst = burst;
+    m_tokens = burst;
+    m_last_tick = armGetSystemTick();
+}
+
+void TokenBucket::Charge(u64 bytes) {
+    u64 sleep_ns{};
+
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        if (!m_rate) {
+            return;
+        }
+
+        // refill for the time elapsed since the last charge.
+        const auto tick = armGetSystemTick();
+        const auto elapsed_ns = armTicksToNs(tick - m_last_tick);
+        m_last_tick = tick;
+        m_tokens = std::min<double>(m_burst, m_tokens + elapsed_ns * (m_rate / 1e+9));
+
+        // the tokens are taken now, so any callers that come after
+        // this will wait for this callers debt to be paid too.
+        m_tokens -= bytes;
+        if (m_tokens < 0) {
+            sleep_ns = -m_tokens * (1e+9 / m_rate);
+            m_throttled_ns += sleep_ns;
+        }
+    }
+
+    if (sleep_ns) {
+        svcSleepThread(sleep_ns);
+    }
+}
+
+void SetEmummcThrottleBudget(u64 rate, u64 burst) {
+    g_emummc_throttle.SetBudget(rate, burst);
+}
+
+void ThrottleEmummc(u64 bytes) {
+    g_emummc_throttle.Charge(bytes);
+}
+
+} // namespace sphaira::utils
@@ -2,27 +2,37 @@
 
 #include "defines.hpp"
 #include "log.hpp"
+#include "utils/thread.hpp"
 
 #include <cstring>
+#include <algorithm>
 
 namespace sphaira::ncz {
 
-NczBlockReader::NczBlockReader(const Header& header, const Sections& sections, const BlockHeader& block_header, const Blocks& blocks, u64 offset, const std::shared_ptr<yati::source::Base>& source)
+NczBlockReader::NczBlockReader(const Header& header, const Sections& sections, const BlockHeader& block_header, const Blocks& blocks, u64 offset, const std::shared_ptr<yati::source::Base>& source, const NczBlockReaderConfig& config)
 : m_header{header}
 , m_sections{sections}
 , m_block_header{block_header}
 , m_blocks{blocks}
 , m_block_offset{offset}
 , m_source{source} {
+    mutexInit(std::addressof(m_mutex));
+    mutexInit(std::addressof(m_source_mutex));
+    condvarInit(std::addressof(m_can_readahead));
+    condvarInit(std::addressof(m_block_ready));
+
     // calculate the block size.
     m_block_size = 1UL << m_block_header.block_size_exponent;
 
     // setup lru block cache.
-    // this isn't needed in sphaira as i am usually reading in 4mb chunks.
-    const auto max_lru_total_size = 1024*1024*32;
-    const auto lru_count = std::max<s64>(1, max_lru_total_size / m_block_size);
+    const auto lru_count = std::max<s64>(1, config.cache_size / m_block_size);
     m_lru_data.resize(lru_count);
     m_lru.Init(m_lru_data);
+    m_lru_index.reserve(lru_count);
+
+    // the cache needs room for the block being read as well as the blocks ahead.
+    m_readahead_blocks = std::min<s64>(config.readahead_blocks, lru_count - 1);
+    log_write("[NCZ] block size: %u cache count: %zu readahead: %u\n", m_block_size, lru_count, m_readahead_blocks);
 
     // calculate offsets for each block.
     auto block_offset = offset;
@@ -32,6 +42,19 @@ NczBlockReader::NczBlockReader(const Header& header, const Sections& sections, c
     }
 }
 
+NczBlockReader::~NczBlockReader() {
+    if (m_thread_started) {
+        {
+            SCOPED_MUTEX(std::addressof(m_mutex));
+            m_quit = true;
+            condvarWakeAll(std::addressof(m_can_readahead));
+        }
+
+        threadWaitForExit(std::addressof(m_thread));
+        threadClose(std::addressof(m_thread));
+    }
+}
+
 Result NczBlockReader::Read(void *_buf, s64 off, s64 size, u64* bytes_read_out) {
     *bytes_read_out = 0;
     u8* buf = (u8*)_buf;
@@ -41,58 +64,46 @@ Result NczBlockReader::Read(void *_buf, s64 off, s64 size, u64* bytes_read_out)
     off -= NCZ_NORMAL_SIZE;
 
     while (size) {
-        // see if we have a cached block.
-        LruData* lru_data{};
-        for (auto list = m_lru.begin(); list; list = list->next) {
-            if (list->data->InRange(off)) {
-                lru_data = list->data;
-                m_lru.Update(list);
-                break;
-            }
+        // get block id and ensure we are in bounds.
+        const u32 block_id = off / m_block_size;
+        R_UNLESS(block_id < m_block_infos.size(), Result_YatiInvalidNczBlockTotal);
+
+        SCOPED_MUTEX(std::addressof(m_mutex));
+
+        // detect sequential reads, ie, streaming a file out of the romfs.
+        if (block_id == m_last_block_id + 1) {
+            m_sequential_count++;
+        } else if (block_id != m_last_block_id) {
+            m_sequential_count = 0;
         }
+        m_last_block_id = block_id;
 
-        // otherwise, read new block.
-        if (!lru_data) {
-            // get block id and ensure we are in bounds.
-            const auto block_id = off / m_block_size;
-            R_UNLESS(block_id < m_block_infos.size(), Result_YatiInvalidNczBlockTotal);
-            const auto& block = m_block_infos[block_id];
-
-            // read entire block.
-            std::vector<u8> temp(block.size);
-            R_TRY(m_source->Read2(temp.data(), block.offset, temp.size()));
-
-            // https://github.com/nicoboss/nsz/issues/79
-            auto decompressedBlockSize = m_block_size;
-            // special handling for the last block to check it's actually compressed
-            if (block_id == m_block_infos.size() - 1) {
-                log_write("[NCZ] last block special handling\n");
-                // https://github.com/nicoboss/nsz/issues/210
-                const auto remainder = m_block_header.decompressed_size % decompressedBlockSize;
-                if (remainder) {
-                    decompressedBlockSize = remainder;
-                }
-            }
+        // the readahead thread is already reading this block, wait for it.
+        while (m_readahead_block_id == block_id) {
+            condvarWait(std::addressof(m_block_ready), std::addressof(m_mutex));
+        }
 
-            // new block.
-            lru_data = m_lru.GetNextFree();
-            lru_data->offset = block.offset;
+        // see if we have a cached block.
+        LruData* lru_data{};
+        if (const auto it = m_lru_index.find(block_id); it != m_lru_index.end()) {
+            lru_data = it->second;
+            m_lru.Update(lru_data);
+        } else {
+            // otherwise, read new block.
+            // the lock is released whilst reading so that the readahead thread can continue.
+            std::erase(m_readahead_queue, block_id);
 
-            // check if this block is compressed.
-            const auto compressed = block.size < decompressedBlockSize;
+            std::vector<u8> data;
+            mutexUnlock(std::addressof(m_mutex));
+            const auto rc = ReadBlock(block_id, data);
+            mutexLock(std::addressof(m_mutex));
+            R_TRY(rc);
 
-            if (compressed) {
-                // decompress block.
-                lru_data->data.resize(decompressedBlockSize);
-                const auto res = ZSTD_decompress(lru_data->data.data(), lru_data->data.size(), temp.data(), temp.size());
+            lru_data = CacheInsert(block_id, data);
+        }
 
-                // the output should be exactly the size of the block.
-                R_UNLESS(!ZSTD_isError(res), Result_YatiInvalidNczZstdError);
-                R_UNLESS(res == decompressedBlockSize, 3);
-            } else {
-                // saves a copy by swapping the vector.
-                std::swap(lru_data->data, temp);
-            }
+        if (m_sequential_count) {
+            QueueReadahead(block_id);
         }
 
         const auto buf_off = off % m_block_size;
@@ -108,4 +119,154 @@ Result NczBlockReader::Read(void *_buf, s64 off, s64 size, u64* bytes_read_out)
     R_SUCCEED();
 }
 
+Result NczBlockReader::ReadBlock(u32 block_id, std::vector<u8>& out) {
+    const auto& block = m_block_infos[block_id];
+
+    // read entire block.
+    std::vector<u8> temp(block.size);
+    {
+        SCOPED_MUTEX(std::addressof(m_source_mutex));
+        R_TRY(m_source->Read2(temp.data(), block.offset, temp.size()));
+    }
+
+    // https://github.com/nicoboss/nsz/issues/79
+    auto decompressedBlockSize = m_block_size;
+    // special handling for the last block to check it's actually compressed
+    if (block_id == m_block_infos.size() - 1) {
+        log_write("[NCZ] last block special handling\n");
+        // https://github.com/nicoboss/nsz/issues/210
+        const auto remainder = m_block_header.decompressed_size % decompressedBlockSize;
+        if (remainder) {
+            decompressedBlockSize = remainder;
+        }
+    }
+
+    // check if this block is compressed.
+    const auto compressed = block.size < decompressedBlockSize;
+
+    if (compressed) {
+        // decompress block.
+        out.resize(decompressedBlockSize);
+        const auto res = ZSTD_decompress(out.data(), out.size(), temp.data(), temp.size());
+
+        // the output should be exactly the size of the block.
+        R_UNLESS(!ZSTD_isError(res), Result_YatiInvalidNczZstdError);
+        R_UNLESS(res == decompressedBlockSize, Result_YatiNczShortBlock);
+    } else {
+        // saves a copy by swapping the vector.
+        std::swap(out, temp);
+    }
+
+    R_SUCCEED();
+}
+
+auto NczBlockReader::CacheInsert(u32 block_id, std::vector<u8>& data) -> LruData* {
+    if (const auto it = m_lru_index.find(block_id); it != m_lru_index.end()) {
+        m_lru.Update(it->second);
+        return it->second;
+    }
+
+    // evict the oldest block.
+    auto lru_data = m_lru.GetNextFree();
+    if (const auto it = m_lru_index.find(lru_data->block_id); it != m_lru_index.end() && it->second == lru_data) {
+        m_lru_index.erase(it);
+    }
+
+    // the old data is swapped out so that the caller can reuse the allocation.
+    lru_data->block_id = block_id;
+    std::swap(lru_data->data, data);
+    m_lru_index.emplace(block_id, lru_data);
+    return lru_data;
+}
+
+void NczBlockReader::QueueReadahead(u32 block_id) {
+    if (!m_readahead_blocks) {
+        return;
+    }
+
+    // drop any blocks that are no longer ahead of the reader.
+    std::erase_if(m_readahead_queue, [&](u32 id) {
+        return id <= block_id || id > block_id + m_readahead_blocks;
+    });
+
+    for (u32 i = 1; i <= m_readahead_blocks; i++) {
+        const auto id = block_id + i;
+        if (id >= m_block_infos.size()) {
+            break;
+        }
+
+        if (m_lru_index.contains(id) || m_readahead_block_id == id || std::ranges::find(m_readahead_queue, id) != m_readahead_queue.end()) {
+            continue;
+        }
+
+        m_readahead_queue.emplace_back(id);
+    }
+
+    if (m_readahead_queue.empty()) {
+        return;
+    }
+
+    // start the thread on first use.
+    if (!m_thread_started) {
+        if (R_FAILED(utils::CreateThread(std::addressof(m_thread), thread_func, this, 1024*64))) {
+            log_write("[NCZ] failed to create readahead thread\n");
+            m_readahead_blocks = 0;
+            m_readahead_queue.clear();
+            return;
+        }
+
+        if (R_FAILED(threadStart(std::addressof(m_thread)))) {
+            log_write("[NCZ] failed to start readahead thread\n");
+            threadClose(std::addressof(m_thread));
+            m_readahead_blocks = 0;
+            m_readahead_queue.clear();
+            return;
+        }
+
+        m_thread_started = true;
+    }
+
+    condvarWakeOne(std::addressof(m_can_readahead));
+}
+
+void NczBlockReader::ThreadFunc() {
+    std::vector<u8> data;
+
+    while (true) {
+        u32 block_id;
+
+        {
+            SCOPED_MUTEX(std::addressof(m_mutex));
+            while (!m_quit && m_readahead_queue.empty()) {
+                condvarWait(std::addressof(m_can_readahead), std::addressof(m_mutex));
+            }
+
+            if (m_quit) {
+                break;
+            }
+
+            block_id = m_readahead_queue.front();
+            m_readahead_queue.pop_front();
+            if (m_lru_index.contains(block_id)) {
+                continue;
+            }
+
+            m_readahead_block_id = block_id;
+        }
+
+        const auto rc = ReadBlock(block_id, data);
+
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        if (R_SUCCEEDED(rc)) {
+            CacheInsert(block_id, data);
+        } else {
+            // the reader will retry the block itself and handle the error.
+            log_write("[NCZ] failed to readahead block: %u 0x%X\n", block_id, rc);
+        }
+
+        m_readahead_block_id = -1;
+        condvarWakeAll(std::addressof(m_block_ready));
+    }
+}
+
 } // namespace sphaira::ncz
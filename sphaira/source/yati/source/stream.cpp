@@ -4,6 +4,32 @@
 
 namespace sphaira::yati::source {
 
+Result Stream::SkipChunk(s64 size, u64* bytes_skipped) {
+    std::vector<u8> temp_buf(std::min<s64>(size, 1024 * 1024));
+    *bytes_skipped = 0;
+
+    while (size) {
+        u64 bytes_read;
+        R_TRY(ReadChunk(temp_buf.data(), std::min<s64>(size, temp_buf.size()), &bytes_read));
+        R_UNLESS(bytes_read, Result_StreamBadSeek);
+
+        *bytes_skipped += bytes_read;
+        size -= bytes_read;
+    }
+
+    R_SUCCEED();
+}
+
+Result Stream::Skip(s64 off, s64 size) {
+    R_UNLESS(off >= m_offset, Result_StreamBadSeek);
+
+    // skips the gap (if any) along with the requested data.
+    u64 bytes_skipped;
+    R_TRY(SkipChunk(off + size - m_offset, &bytes_skipped));
+    m_offset += bytes_skipped;
+    R_SUCCEED();
+}
+
 Result Stream::Read(void* _buf, s64 off, s64 size, u64* bytes_read_out) {
     // streams don't allow for random access (seeking backwards).
     R_UNLESS(off >= m_offset, Result_StreamBadSeek);
@@ -17,10 +43,8 @@ Result Stream::Read(void* _buf, s64 off, s64 size, u64* bytes_read_out) {
         // this can be done to skip padding, skip undeeded files etc.
         // to handle this, simply read the data into a buffer and discard it.
         if (off > m_offset) {
-            const auto skip_size = off - m_offset;
-            std::vector<u8> temp_buf(skip_size);
             u64 bytes_read;
-            R_TRY(ReadChunk(temp_buf.data(), temp_buf.size(), &bytes_read));
+            R_TRY(SkipChunk(off - m_offset, &bytes_read));
 
             m_offset += bytes_read;
         } else {
@@ -14,6 +14,9 @@
 
 #include "utils/utils.hpp"
 #include "utils/thread.hpp"
+#include "utils/pipeline.hpp"
+#include "utils/buffer_pool.hpp"
+#include "utils/throttle.hpp"
 
 #include "ui/progress_box.hpp"
 #include "ui/menus/game_menu.hpp"
@@ -26,6 +29,7 @@
 #include <minIni.h>
 #include <algorithm>
 #include <atomic>
+#include <cstdio>
 
 namespace sphaira::yati {
 namespace {
@@ -49,6 +53,8 @@ struct NcaCollection : container::CollectionEntry {
     bool modified{};
     // set if the nca was not installed.
     bool skipped{};
+    // set if the crypto conversion is waiting on the ticket to be read (stream installs).
+    bool pending_crypto{};
 };
 
 struct CnmtCollection : NcaCollection {
@@ -77,215 +83,353 @@ struct TikCollection {
     bool required{};
     // set if ticket has already been patched.
     bool patched{};
+    // set once the ticket data has been read, stream installs read it in order.
+    bool loaded{};
 };
 
 struct Yati;
 
 const u64 INFLATE_BUFFER_MAX = 1024*1024*4;
 
-struct ThreadBuffer {
-    ThreadBuffer() {
-        buf.reserve(INFLATE_BUFFER_MAX);
-    }
-
-    std::vector<u8> buf;
-    s64 off;
-};
-
-template<std::size_t Size>
-struct RingBuf {
-private:
-    ThreadBuffer buf[Size]{};
-    unsigned r_index{};
-    unsigned w_index{};
+// number of buffers that can be queued between each install stage.
+constexpr u32 QUEUE_DEPTH = 4;
+
+// max number of threads used for parallel ncz block decompression.
+// the switch only gives us 3 cores, so there's no point going above that.
+constexpr u32 NCZ_BLOCK_THREAD_MAX = 3;
+// blocks that can be in flight at once (filling, decompressing or waiting to be collected).
+constexpr u32 NCZ_BLOCK_JOB_COUNT = NCZ_BLOCK_THREAD_MAX + 1;
+
+// max number of ncas installed at once, each install runs its own pipeline.
+constexpr u32 NCA_INSTALL_LANES_MAX = 4;
+
+// decompresses ncz blocks on a small pool of worker threads.
+// every block in block mode ncz is an independent zstd frame, so they can be
+// decompressed in any order, however they are always collected in the order they were submitted.
+struct NczBlockWorkers {
+    using CollectCallback = std::function<Result(utils::PoolVector& data)>;
+
+    enum class JobState {
+        Free,
+        Pending,
+        Busy,
+        Done,
+    };
 
-    static_assert((sizeof(RingBuf::buf) & (sizeof(RingBuf::buf) - 1)) == 0, "Must be power of 2!");
+    struct Job {
+        // compressed (or stored) block data.
+        utils::PooledBuffer in{};
+        // decompressed block data.
+        utils::PooledBuffer out{};
+        u64 decompressed_size{};
+        bool compressed{};
+        Result result{};
+        JobState state{JobState::Free};
+    };
 
-public:
-    void ringbuf_reset() {
-        this->r_index = this->w_index;
+    NczBlockWorkers() {
+        mutexInit(std::addressof(m_mutex));
+        condvarInit(std::addressof(m_can_work));
+        condvarInit(std::addressof(m_can_collect));
     }
 
-    unsigned ringbuf_capacity() const {
-        return sizeof(this->buf) / sizeof(this->buf[0]);
+    ~NczBlockWorkers() {
+        Close();
     }
 
-    unsigned ringbuf_size() const {
-        return (this->w_index - this->r_index) % (ringbuf_capacity() * 2U);
-    }
+    // block_size is used to lease the job buffers from the pool.
+    Result Start(u32 thread_count, u64 block_size);
+    void Close();
 
-    unsigned ringbuf_free() const {
-        return ringbuf_capacity() - ringbuf_size();
+    auto IsRunning() const -> bool {
+        return m_thread_count > 0;
     }
 
-    void ringbuf_push(std::vector<u8>& buf_in, s64 off_in) {
-        auto& value = this->buf[this->w_index % ringbuf_capacity()];
-        value.off = off_in;
-        std::swap(value.buf, buf_in);
+    // returns the next free job, collecting the oldest job if all are in use.
+    Result GetFreeJob(Job** out, const CollectCallback& callback);
+    // queues the job returned from GetFreeJob() and collects any jobs that have finished.
+    Result Submit(Job* job, const CollectCallback& callback);
+    // waits for all jobs to finish and collects them.
+    Result Flush(const CollectCallback& callback);
 
-        this->w_index = (this->w_index + 1U) % (ringbuf_capacity() * 2U);
-    }
+private:
+    Result Collect(const CollectCallback& callback, bool wait, bool* collected);
+    auto GetPendingJob() -> Job*;
+    void WorkerFunc();
 
-    void ringbuf_pop(std::vector<u8>& buf_out, s64& off_out) {
-        auto& value = this->buf[this->r_index % ringbuf_capacity()];
-        off_out = value.off;
-        std::swap(value.buf, buf_out);
+    static Result DecompressJob(ZSTD_DCtx* dctx, Job& job);
 
-        this->r_index = (this->r_index + 1U) % (ringbuf_capacity() * 2U);
+    static void worker_func(void* d) {
+        static_cast<NczBlockWorkers*>(d)->WorkerFunc();
     }
-};
 
-struct ThreadData {
-    ThreadData(Yati* _yati, std::span<TikCollection> _tik, NcaCollection* _nca)
-    : yati{_yati}, tik{_tik}, nca{_nca} {
-        mutexInit(std::addressof(read_mutex));
-        mutexInit(std::addressof(write_mutex));
+private:
+    Mutex m_mutex{};
+    CondVar m_can_work{};
+    CondVar m_can_collect{};
 
-        condvarInit(std::addressof(can_read));
-        condvarInit(std::addressof(can_decompress));
-        condvarInit(std::addressof(can_decompress_write));
-        condvarInit(std::addressof(can_write));
+    Job m_jobs[NCZ_BLOCK_JOB_COUNT]{};
+    u32 m_submit_index{};
+    u32 m_collect_index{};
 
-        ueventCreate(&m_uevent_done, false);
-        ueventCreate(&m_uevent_progres, true);
+    Thread m_threads[NCZ_BLOCK_THREAD_MAX]{};
+    u32 m_thread_count{};
+    bool m_quit{};
+};
 
-        sha256ContextCreate(&sha256);
-        // this will be updated with the actual size from nca header.
-        write_size = nca->size;
+Result NczBlockWorkers::Start(u32 thread_count, u64 block_size) {
+    thread_count = std::min(thread_count, NCZ_BLOCK_THREAD_MAX);
 
-        // reduce buffer size to preve
-        if (App::IsFileBaseEmummc()) {
-            read_buffer_size = 1024 * 512;
-        } else {
-            read_buffer_size = 1024*1024*4;
+    for (auto& job : m_jobs) {
+        job.in = utils::PooledBuffer{block_size};
+        job.out = utils::PooledBuffer{block_size};
+    }
+
+    for (u32 i = 0; i < thread_count; i++) {
+        auto t = std::addressof(m_threads[m_thread_count]);
+        R_TRY(utils::CreateThread(t, worker_func, this, 1024*64));
+
+        if (const auto rc = threadStart(t); R_FAILED(rc)) {
+            threadClose(t);
+            R_THROW(rc);
         }
 
-        max_buffer_size = std::max(read_buffer_size, INFLATE_BUFFER_MAX);
+        m_thread_count++;
     }
 
-    auto GetResults() volatile -> Result;
-    void WakeAllThreads();
+    log_write("[NCZ] started %u block threads\n", m_thread_count);
+    R_SUCCEED();
+}
 
-    auto IsAnyRunning() volatile const -> bool {
-        return read_running || decompress_running || write_running;
+void NczBlockWorkers::Close() {
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        m_quit = true;
+        condvarWakeAll(std::addressof(m_can_work));
     }
 
-    auto GetWriteOffset() volatile const -> s64 {
-        return write_offset;
+    for (u32 i = 0; i < m_thread_count; i++) {
+        threadWaitForExit(std::addressof(m_threads[i]));
+        threadClose(std::addressof(m_threads[i]));
     }
 
-    auto GetWriteSize() volatile const -> s64 {
-        return write_size;
-    }
+    m_thread_count = 0;
+}
 
-    auto GetDoneEvent() {
-        return &m_uevent_done;
+Result NczBlockWorkers::GetFreeJob(Job** out, const CollectCallback& callback) {
+    if (m_submit_index - m_collect_index >= std::size(m_jobs)) {
+        bool collected;
+        R_TRY(Collect(callback, true, std::addressof(collected)));
     }
 
-    auto GetProgressEvent() {
-        return &m_uevent_progres;
+    auto& job = m_jobs[m_submit_index % std::size(m_jobs)];
+    job.in->resize(0);
+    job.out->resize(0);
+    *out = std::addressof(job);
+    R_SUCCEED();
+}
+
+Result NczBlockWorkers::Submit(Job* job, const CollectCallback& callback) {
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        job->state = JobState::Pending;
+        m_submit_index++;
+        condvarWakeOne(std::addressof(m_can_work));
     }
 
-    void SetReadResult(Result result) {
-        read_result = result;
+    // collect whatever has finished so far to keep the write thread busy.
+    for (bool collected = true; collected;) {
+        R_TRY(Collect(callback, false, std::addressof(collected)));
+    }
 
-        // wake up decompress thread as it may be waiting on data that never comes.
-        condvarWakeOne(std::addressof(can_decompress));
+    R_SUCCEED();
+}
 
-        if (R_FAILED(result)) {
-            ueventSignal(GetDoneEvent());
-        }
+Result NczBlockWorkers::Flush(const CollectCallback& callback) {
+    while (m_collect_index != m_submit_index) {
+        bool collected;
+        R_TRY(Collect(callback, true, std::addressof(collected)));
     }
 
-    void SetDecompressResult(Result result) {
-        decompress_result = result;
+    R_SUCCEED();
+}
+
+Result NczBlockWorkers::Collect(const CollectCallback& callback, bool wait, bool* collected) {
+    *collected = false;
+    if (m_collect_index == m_submit_index) {
+        R_SUCCEED();
+    }
 
-        // wake up write thread as it may be waiting on data that never comes.
-        condvarWakeOne(std::addressof(can_write));
+    auto& job = m_jobs[m_collect_index % std::size(m_jobs)];
+    {
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        if (job.state != JobState::Done && !wait) {
+            R_SUCCEED();
+        }
 
-        if (R_FAILED(result)) {
-            ueventSignal(GetDoneEvent());
+        while (job.state != JobState::Done) {
+            condvarWait(std::addressof(m_can_collect), std::addressof(m_mutex));
         }
     }
 
-    void SetWriteResult(Result result) {
-        write_result = result;
+    R_TRY(job.result);
+    R_TRY(callback(*job.out));
 
-        // wake up decompress thread as it may be waiting on data that never comes.
-        condvarWakeOne(std::addressof(can_decompress_write));
+    SCOPED_MUTEX(std::addressof(m_mutex));
+    job.state = JobState::Free;
+    m_collect_index++;
+    *collected = true;
+    R_SUCCEED();
+}
 
-        ueventSignal(GetDoneEvent());
+auto NczBlockWorkers::GetPendingJob() -> Job* {
+    // pick the oldest pending job so that the collector waits as little as possible.
+    for (auto i = m_collect_index; i != m_submit_index; i++) {
+        auto& job = m_jobs[i % std::size(m_jobs)];
+        if (job.state == JobState::Pending) {
+            return std::addressof(job);
+        }
     }
 
-    Result Read(void* buf, s64 size, u64* bytes_read);
+    return nullptr;
+}
 
-    Result SetDecompressBuf(std::vector<u8>& buf, s64 off, s64 size) {
-        buf.resize(size);
+void NczBlockWorkers::WorkerFunc() {
+    auto dctx = ZSTD_createDCtx();
+    ON_SCOPE_EXIT(ZSTD_freeDCtx(dctx));
 
-        mutexLock(std::addressof(read_mutex));
-        if (!read_buffers.ringbuf_free()) {
-            if (!write_running) {
-                R_SUCCEED();
+    for (;;) {
+        Job* job{};
+        {
+            SCOPED_MUTEX(std::addressof(m_mutex));
+            while (!m_quit && !(job = GetPendingJob())) {
+                condvarWait(std::addressof(m_can_work), std::addressof(m_mutex));
             }
-            R_TRY(condvarWait(std::addressof(can_read), std::addressof(read_mutex)));
+
+            if (m_quit) {
+                break;
+            }
+
+            job->state = JobState::Busy;
         }
 
-        ON_SCOPE_EXIT(mutexUnlock(std::addressof(read_mutex)));
-        R_TRY(GetResults());
-        read_buffers.ringbuf_push(buf, off);
-        return condvarWakeOne(std::addressof(can_decompress));
+        const auto result = DecompressJob(dctx, *job);
+
+        SCOPED_MUTEX(std::addressof(m_mutex));
+        job->result = result;
+        job->state = JobState::Done;
+        condvarWakeAll(std::addressof(m_can_collect));
     }
+}
 
-    Result GetDecompressBuf(std::vector<u8>& buf_out, s64& off_out) {
-        mutexLock(std::addressof(read_mutex));
-        if (!read_buffers.ringbuf_size()) {
-            if (!read_running) {
-                buf_out.resize(0);
-                R_SUCCEED();
-            }
-            R_TRY(condvarWait(std::addressof(can_decompress), std::addressof(read_mutex)));
+Result NczBlockWorkers::DecompressJob(ZSTD_DCtx* dctx, Job& job) {
+    if (!job.compressed) {
+        // saves a copy by swapping the vector.
+        std::swap(*job.in, *job.out);
+        R_SUCCEED();
+    }
+
+    R_UNLESS(dctx, Result_YatiInvalidNczZstdError);
+
+    job.out->resize(job.decompressed_size);
+    const auto res = ZSTD_decompressDCtx(dctx, job.out->data(), job.out->size(), job.in->data(), job.in->size());
+    if (ZSTD_isError(res)) {
+        log_write("[NCZ] ZSTD_decompressDCtx() size: %zu res: %zd msg: %s\n", job.in->size(), res, ZSTD_getErrorName(res));
+    }
+
+    // the output should be exactly the size of the block.
+    R_UNLESS(!ZSTD_isError(res), Result_YatiInvalidNczZstdError);
+    R_UNLESS(res == job.out->size(), Result_YatiInvalidNczZstdError);
+    R_SUCCEED();
+}
+
+// ncas of a single cnmt that are being installed at once.
+// each lane takes the next nca from the queue until it's empty,
+// if any install fails, the rest are cancelled.
+struct NcaInstallGroup {
+    // returns the next nca to install, or nullptr once empty or an install failed.
+    auto Next() -> NcaCollection* {
+        SCOPED_MUTEX(std::addressof(mutex));
+        if (R_FAILED(rc) || next >= queue.size()) {
+            return nullptr;
         }
+        return queue[next++];
+    }
 
-        ON_SCOPE_EXIT(mutexUnlock(std::addressof(read_mutex)));
-        R_TRY(GetResults());
-        read_buffers.ringbuf_pop(buf_out, off_out);
-        return condvarWakeOne(std::addressof(can_read));
+    // registers the pipeline so that it can be cancelled, fails if the group already failed.
+    Result Add(utils::Pipeline* pipeline) {
+        SCOPED_MUTEX(std::addressof(mutex));
+        R_TRY(rc);
+        pipelines.emplace_back(pipeline);
+        R_SUCCEED();
     }
 
-    Result SetWriteBuf(std::vector<u8>& buf, s64 size, bool skip_verify) {
-        buf.resize(size);
-        if (!skip_verify) {
-            sha256ContextUpdate(std::addressof(sha256), buf.data(), buf.size());
+    void Remove(utils::Pipeline* pipeline) {
+        SCOPED_MUTEX(std::addressof(mutex));
+        std::erase(pipelines, pipeline);
+    }
+
+    // stores the first error and cancels all running installs.
+    void Cancel(Result _rc) {
+        SCOPED_MUTEX(std::addressof(mutex));
+        if (R_SUCCEEDED(rc)) {
+            rc = _rc;
         }
 
-        mutexLock(std::addressof(write_mutex));
-        if (!write_buffers.ringbuf_free()) {
-            if (!decompress_running) {
-                R_SUCCEED();
-            }
-            R_TRY(condvarWait(std::addressof(can_decompress_write), std::addressof(write_mutex)));
+        for (auto pipeline : pipelines) {
+            pipeline->Cancel(rc);
+        }
+    }
+
+    Mutex mutex{};
+    // sorted largest first.
+    std::vector<NcaCollection*> queue{};
+    u32 next{};
+    std::vector<utils::Pipeline*> pipelines{};
+    Result rc{};
+
+    // progress is tracked as bytes read from the source, as the size of
+    // every nca is known upfront, unlike the decompressed size of an ncz.
+    s64 total{};
+    std::atomic<s64> read{};
+};
+
+// state shared between the install stages of a single nca.
+struct ThreadData {
+    ThreadData(Yati* _yati, std::span<TikCollection> _tik, NcaCollection* _nca, bool _hash_thread)
+    : yati{_yati}, tik{_tik}, nca{_nca}, hash_thread{_hash_thread} {
+        sha256ContextCreate(&sha256);
+        // this will be updated with the actual size from nca header.
+        write_size = nca->size;
+
+        // reduce buffer size to preve
+        if (App::IsFileBaseEmummc()) {
+            read_buffer_size = 1024 * 512;
+        } else {
+            read_buffer_size = 1024*1024*4;
         }
 
-        ON_SCOPE_EXIT(mutexUnlock(std::addressof(write_mutex)));
-        R_TRY(GetResults());
-        write_buffers.ringbuf_push(buf, 0);
-        return condvarWakeOne(std::addressof(can_write));
+        max_buffer_size = std::max(read_buffer_size, INFLATE_BUFFER_MAX);
+    }
+
+    auto GetWriteOffset() volatile const -> s64 {
+        return write_offset;
     }
 
-    Result GetWriteBuf(std::vector<u8>& buf_out, s64& off_out) {
-        mutexLock(std::addressof(write_mutex));
-        if (!write_buffers.ringbuf_size()) {
-            if (!decompress_running) {
-                buf_out.resize(0);
-                R_SUCCEED();
-            }
-            R_TRY(condvarWait(std::addressof(can_write), std::addressof(write_mutex)));
+    auto GetWriteSize() volatile const -> s64 {
+        return write_size;
+    }
+
+    Result Read(void* buf, s64 size, u64* bytes_read);
+
+    // called by the decompress stage, the hash is updated inline if the hash stage is disabled.
+    Result SetWriteBuf(utils::PipelineStage& stage, utils::PoolVector& buf, s64 size, bool skip_verify) {
+        buf.resize(size);
+        if (!hash_thread && !skip_verify) {
+            sha256ContextUpdate(std::addressof(sha256), buf.data(), buf.size());
         }
 
-        ON_SCOPE_EXIT(mutexUnlock(std::addressof(write_mutex)));
-        R_TRY(GetResults());
-        write_buffers.ringbuf_pop(buf_out, off_out);
-        return condvarWakeOne(std::addressof(can_decompress_write));
+        return stage.Push(buf);
     }
 
     // these need to be copied
@@ -293,20 +437,8 @@ struct ThreadData {
     std::span<TikCollection> tik{};
     NcaCollection* nca{};
 
-    // these need to be created
-    Mutex read_mutex{};
-    Mutex write_mutex{};
-
-    CondVar can_read{};
-    CondVar can_decompress{};
-    CondVar can_decompress_write{};
-    CondVar can_write{};
-
-    UEvent m_uevent_done{};
-    UEvent m_uevent_progres{};
-
-    RingBuf<4> read_buffers{};
-    RingBuf<4> write_buffers{};
+    // if set, the sha256 is calculated on its own stage.
+    const bool hash_thread;
 
     ncz::BlockHeader ncz_block_header{};
     std::vector<ncz::Section> ncz_sections{};
@@ -322,14 +454,6 @@ struct ThreadData {
     std::atomic<s64> decompress_offset{};
     std::atomic<s64> write_offset{};
     std::atomic<s64> write_size{};
-
-    std::atomic<Result> read_result{};
-    std::atomic<Result> decompress_result{};
-    std::atomic<Result> write_result{};
-
-    std::atomic_bool read_running{true};
-    std::atomic_bool decompress_running{true};
-    std::atomic_bool write_running{true};
 };
 
 struct Yati {
@@ -339,11 +463,22 @@ struct Yati {
     Result Setup(const ConfigOverride& override);
     Result InstallNca(std::span<TikCollection> tickets, NcaCollection& nca);
     Result InstallNcaInternal(std::span<TikCollection> tickets, NcaCollection& nca);
+    // installs the ncas, several at once if the source supports random access.
+    Result InstallNcas(std::span<TikCollection> tickets, std::span<NcaCollection> ncas);
+    Result InstallNcaLane(std::span<TikCollection> tickets);
     Result InstallCnmtNca(std::span<TikCollection> tickets, CnmtCollection& cnmt, const container::Collections& collections);
 
-    Result readFuncInternal(ThreadData* t);
-    Result decompressFuncInternal(ThreadData* t);
-    Result writeFuncInternal(ThreadData* t);
+    Result readFuncInternal(ThreadData* t, utils::PipelineStage& stage);
+    Result decompressFuncInternal(ThreadData* t, utils::PipelineStage& stage);
+    Result hashFuncInternal(ThreadData* t, utils::PipelineStage& stage);
+    Result writeFuncInternal(ThreadData* t, utils::PipelineStage& stage);
+
+    // converts to standard crypto and / or lowers the master key, based on the config.
+    Result ConvertNcaCrypto(nca::Header& header, TikCollection* ticket, bool& modified);
+    // patches the header of an nca installed before its ticket was read.
+    Result PatchPendingNcaCrypto(NcaCollection& nca, std::span<TikCollection> tickets);
+    // discards the data of a skipped nca, for stream sources that can't seek.
+    Result SkipNcaData(const NcaCollection& nca);
 
     Result ParseTicketsIntoCollection(std::vector<TikCollection>& tickets, const container::Collections& collections, bool read_data);
     Result GetLatestVersion(const CnmtCollection& cnmt, u32& version_out, bool& skip);
@@ -368,33 +503,28 @@ struct Yati {
     std::unique_ptr<container::Base> container{};
     Config config{};
     keys::Keys keys{};
-};
 
-auto ThreadData::GetResults() volatile -> Result {
-    R_TRY(yati->pbox->ShouldExitResult());
-    R_TRY(read_result.load());
-    R_TRY(decompress_result.load());
-    R_TRY(write_result.load());
-    R_SUCCEED();
-}
-
-void ThreadData::WakeAllThreads() {
-    condvarWakeAll(std::addressof(can_read));
-    condvarWakeAll(std::addressof(can_decompress));
-    condvarWakeAll(std::addressof(can_decompress_write));
-    condvarWakeAll(std::addressof(can_write));
-
-    mutexUnlock(std::addressof(read_mutex));
-    mutexUnlock(std::addressof(write_mutex));
-}
+    // set whilst installing ncas at once, see InstallNcas().
+    NcaInstallGroup* group{};
+    // the source and tickets are shared between concurrent installs.
+    Mutex source_mutex{};
+    Mutex ticket_mutex{};
+};
 
 Result ThreadData::Read(void* buf, s64 size, u64* bytes_read) {
     size = std::min<s64>(size, nca->size - read_offset);
-    const auto rc = yati->source->Read(buf, nca->offset + read_offset, size, bytes_read);
+    Result rc;
+    {
+        SCOPED_MUTEX(std::addressof(yati->source_mutex));
+        rc = yati->source->Read(buf, nca->offset + read_offset, size, bytes_read);
+    }
     R_TRY(rc);
 
     R_UNLESS(size == *bytes_read, Result_YatiInvalidNcaReadSize);
     read_offset += *bytes_read;
+    if (yati->group) {
+        yati->group->read += *bytes_read;
+    }
     return rc;
 }
 
@@ -432,19 +562,17 @@ Result HasRequiredTicket(const nca::Header& header, std::span<TikCollection> tik
 
 // read thread reads all data from the source, it also handles
 // parsing ncz headers, sections and reading ncz blocks
-Result Yati::readFuncInternal(ThreadData* t) {
-    ON_SCOPE_EXIT( t->read_running = false; );
-
+Result Yati::readFuncInternal(ThreadData* t, utils::PipelineStage& stage) {
     // the main buffer which data is read into.
-    std::vector<u8> buf;
+    utils::PooledBuffer lease{t->max_buffer_size};
+    auto& buf = lease.Get();
     // workaround ncz block reading ahead. if block isn't found, we usually
     // would seek back to the offset, however this is not possible in stream
     // mode, so we instead store the data to the temp buffer and pre-pend it.
+    // this is only ever the size of the block header, so it isn't pooled.
     std::vector<u8> temp_buf;
-    buf.reserve(t->max_buffer_size);
-    temp_buf.reserve(t->max_buffer_size);
 
-    while (t->read_offset < t->nca->size && R_SUCCEEDED(t->GetResults())) {
+    while (t->read_offset < t->nca->size && R_SUCCEEDED(stage.GetResults())) {
         const auto buffer_offset = t->read_offset.load();
 
         // read more data
@@ -455,7 +583,7 @@ Result Yati::readFuncInternal(ThreadData* t) {
 
         s64 buf_offset = 0;
         if (!temp_buf.empty()) {
-            buf = temp_buf;
+            buf.assign(temp_buf.begin(), temp_buf.end());
             read_size -= temp_buf.size();
             buf_offset = temp_buf.size();
             temp_buf.clear();
@@ -508,7 +636,8 @@ Result Yati::readFuncInternal(ThreadData* t) {
             }
         }
 
-        R_TRY(t->SetDecompressBuf(buf, buffer_offset, buf_size));
+        buf.resize(buf_size);
+        R_TRY(stage.Push(buf, buffer_offset));
     }
 
     log_write("read success\n");
@@ -517,9 +646,7 @@ Result Yati::readFuncInternal(ThreadData* t) {
 
 // decompress thread handles decrypting / modifying the nca header, decompressing ncz
 // and calculating the running sha256.
-Result Yati::decompressFuncInternal(ThreadData* t) {
-    ON_SCOPE_EXIT( t->decompress_running = false; );
-
+Result Yati::decompressFuncInternal(ThreadData* t, utils::PipelineStage& stage) {
     // only used for ncz files.
     auto dctx = ZSTD_createDCtx();
     ON_SCOPE_EXIT(ZSTD_freeDCtx(dctx));
@@ -530,13 +657,18 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
 
     s64 inflate_offset{};
     Aes128CtrContext ctx{};
-    std::vector<u8> inflate_buf{};
-    inflate_buf.reserve(t->max_buffer_size);
+    utils::PooledBuffer inflate_lease{t->max_buffer_size};
+    auto& inflate_buf = inflate_lease.Get();
 
     s64 written{};
     s64 block_offset{};
-    std::vector<u8> buf{};
-    buf.reserve(t->max_buffer_size);
+    utils::PooledBuffer lease{t->max_buffer_size};
+    auto& buf = lease.Get();
+
+    // stores the data left over after a flush, kept outside of ncz_flush
+    // so that it's not allocated on every flush.
+    utils::PooledBuffer temp_lease{chunk_size};
+    auto& temp_vector = temp_lease.Get();
 
     // encrypts the nca and passes the buffer to the write thread.
     const auto ncz_flush = [&](s64 size) -> Result {
@@ -548,7 +680,7 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
         // the remaining data.
         // rather that copying the entire vector to the write thread,
         // only copy (store) the remaining amount.
-        std::vector<u8> temp_vector{};
+        temp_vector.resize(0);
         if (size < inflate_offset) {
             temp_vector.resize(inflate_offset - size);
             std::memcpy(temp_vector.data(), inflate_buf.data() + size, temp_vector.size());
@@ -586,7 +718,7 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
             off += chunk_size;
         }
 
-        R_TRY(t->SetWriteBuf(inflate_buf, size, config.skip_nca_hash_verify));
+        R_TRY(t->SetWriteBuf(stage, inflate_buf, size, config.skip_nca_hash_verify));
         inflate_offset -= size;
 
         // restore remaining data to the swapped buffer.
@@ -598,9 +730,28 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
         R_SUCCEED();
     };
 
-    while (t->decompress_offset < t->write_size && R_SUCCEEDED(t->GetResults())) {
+    // only used for block ncz, blocks are decompressed in parallel and
+    // collected here in order before being encrypted and passed to the write thread.
+    NczBlockWorkers block_workers{};
+    NczBlockWorkers::Job* block_job{};
+
+    const auto block_collect = [&](utils::PoolVector& data) -> Result {
+        inflate_buf.resize(inflate_offset + data.size());
+        std::memcpy(inflate_buf.data() + inflate_offset, data.data(), data.size());
+
+        t->decompress_offset += data.size();
+        inflate_offset += data.size();
+        if (inflate_offset >= INFLATE_BUFFER_MAX) {
+            log_write("[NCZ] flushing block data\n");
+            R_TRY(ncz_flush(INFLATE_BUFFER_MAX));
+        }
+
+        R_SUCCEED();
+    };
+
+    while (t->decompress_offset < t->write_size && R_SUCCEEDED(stage.GetResults())) {
         s64 decompress_buf_off{};
-        R_TRY(t->GetDecompressBuf(buf, decompress_buf_off));
+        R_TRY(stage.Pop(buf, decompress_buf_off));
         if (buf.empty()) {
             break;
         }
@@ -609,6 +760,16 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
         if (!is_ncz && !t->ncz_sections.empty()) {
             log_write("YES IT FOUND NCZ\n");
             is_ncz = true;
+
+            // large blocks are streamed as normal to avoid allocating huge buffers.
+            const auto block_size = 1ULL << t->ncz_block_header.block_size_exponent;
+            if (!t->ncz_blocks.empty() && config.ncz_block_threads && block_size <= INFLATE_BUFFER_MAX) {
+                // falls back to streaming if the threads fail to start.
+                if (R_FAILED(block_workers.Start(config.ncz_block_threads, block_size))) {
+                    log_write("[NCZ] failed to start block threads\n");
+                    block_workers.Close();
+                }
+            }
         }
 
         // if we don't have a ncz or it's before the ncz header, pass buffer directly to write
@@ -643,31 +804,17 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
                 }
 
                 // try and get the ticket, if the nca requires it.
+                SCOPED_MUTEX(std::addressof(ticket_mutex));
                 auto ticket = GetTicketCollection(header, t->tik);
                 R_TRY(HasRequiredTicket(header, ticket));
 
-                if ((config.convert_to_standard_crypto && ticket) || config.lower_master_key) {
-                    t->nca->modified = true;
-                    u8 keak_generation = 0;
-
-                    if (ticket) {
-                        const auto key_gen = header.GetKeyGeneration();
-                        log_write("converting to standard crypto: 0x%X 0x%X\n", key_gen, header.GetKeyGeneration());
-
-                        keys::KeyEntry title_key;
-                        R_TRY(es::GetTitleKeyDecrypted(ticket->ticket, header.rights_id, key_gen, keys, title_key));
-
-                        std::memset(header.key_area, 0, sizeof(header.key_area));
-                        std::memcpy(&header.key_area[0x2], &title_key, sizeof(title_key));
-
-                        keak_generation = key_gen;
-                        ticket->required = false;
-                    } else if (config.lower_master_key) {
-                        R_TRY(nca::DecryptKeak(keys, header));
-                    }
-
-                    R_TRY(nca::EncryptKeak(keys, header, keak_generation));
-                    std::memset(&header.rights_id, 0, sizeof(header.rights_id));
+                // stream installs may reach the nca before the ticket, in which case the
+                // nca is installed as is and the header is patched once the ticket is read.
+                if (config.convert_to_standard_crypto && ticket && !ticket->loaded) {
+                    log_write("ticket not read yet, converting crypto later\n");
+                    t->nca->pending_crypto = true;
+                } else {
+                    R_TRY(ConvertNcaCrypto(header, ticket, t->nca->modified));
                 }
 
                 if (t->nca->modified) {
@@ -677,12 +824,13 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
 
             written += buf.size();
             t->decompress_offset += buf.size();
-            R_TRY(t->SetWriteBuf(buf, buf.size(), config.skip_nca_hash_verify));
+            R_TRY(t->SetWriteBuf(stage, buf, buf.size(), config.skip_nca_hash_verify));
         } else if (is_ncz) {
             u64 buf_off{};
             while (buf_off < buf.size()) {
                 std::span<const u8> buffer{buf.data() + buf_off, buf.size() - buf_off};
                 bool compressed = true;
+                u64 block_decompressed_size{};
 
                 // todo: blocks need to use read offset, as the offset + size is compressed range.
                 if (t->ncz_blocks.size()) {
@@ -712,17 +860,34 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
 
                     // check if this block is compressed.
                     compressed = ncz_block->size < decompressedBlockSize;
+                    block_decompressed_size = decompressedBlockSize;
 
                     // clip read size as blocks can be up to 32GB in size!
                     const auto size = std::min<u64>(buffer.size(), ncz_block->size - block_offset);
                     buffer = buffer.subspan(0, size);
                 }
 
-                if (compressed) {
+                if (block_workers.IsRunning()) {
+                    // gather the whole block and hand it off to the block threads.
+                    if (!block_job) {
+                        R_TRY(block_workers.GetFreeJob(std::addressof(block_job), block_collect));
+                        block_job->in->reserve(ncz_block->size);
+                    }
+
+                    block_job->in->insert(block_job->in->end(), buffer.begin(), buffer.end());
+
+                    if (block_offset + buffer.size() == ncz_block->size) {
+                        block_job->compressed = compressed;
+                        block_job->decompressed_size = block_decompressed_size;
+
+                        R_TRY(block_workers.Submit(block_job, block_collect));
+                        block_job = nullptr;
+                    }
+                } else if (compressed) {
                     log_write("[NCZ] COMPRESSED block\n");
                     ZSTD_inBuffer input = { buffer.data(), buffer.size(), 0 };
                     while (input.pos < input.size) {
-                        R_TRY(t->GetResults());
+                        R_TRY(stage.GetResults());
 
                         inflate_buf.resize(inflate_offset + chunk_size);
                         ZSTD_outBuffer output = { inflate_buf.data() + inflate_offset, chunk_size, 0 };
@@ -758,6 +923,12 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
         }
     }
 
+    // collect the remaining blocks.
+    if (block_workers.IsRunning()) {
+        R_UNLESS(!block_job, Result_YatiNczBlockNotFound);
+        R_TRY(block_workers.Flush(block_collect));
+    }
+
     // flush remaining data.
     if (is_ncz && inflate_offset) {
         log_write("flushing remaining\n");
@@ -766,6 +937,32 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
 
     log_write("decompress thread done!\n");
 
+    // get final hash output.
+    if (!t->hash_thread) {
+        sha256ContextGetHash(std::addressof(t->sha256), t->nca->hash);
+    }
+
+    R_SUCCEED();
+}
+
+// hash stage calculates the running sha256 of the decompressed nca.
+// this is only used if the hash stage is enabled.
+Result Yati::hashFuncInternal(ThreadData* t, utils::PipelineStage& stage) {
+    utils::PooledBuffer lease{t->max_buffer_size};
+    auto& buf = lease.Get();
+
+    while (R_SUCCEEDED(stage.GetResults())) {
+        R_TRY(stage.Pop(buf));
+        if (buf.empty()) {
+            break;
+        }
+
+        sha256ContextUpdate(std::addressof(t->sha256), buf.data(), buf.size());
+        R_TRY(stage.Push(buf));
+    }
+
+    log_write("hash thread done!\n");
+
     // get final hash output.
     sha256ContextGetHash(std::addressof(t->sha256), t->nca->hash);
 
@@ -773,34 +970,28 @@ Result Yati::decompressFuncInternal(ThreadData* t) {
 }
 
 // write thread writes data to the nca placeholder.
-Result Yati::writeFuncInternal(ThreadData* t) {
-    ON_SCOPE_EXIT( t->write_running = false; );
-
-    std::vector<u8> buf;
-    buf.reserve(t->max_buffer_size);
+Result Yati::writeFuncInternal(ThreadData* t, utils::PipelineStage& stage) {
+    utils::PooledBuffer lease{t->max_buffer_size};
+    auto& buf = lease.Get();
     const auto is_file_based_emummc = App::IsFileBaseEmummc();
 
-    while (t->write_offset < t->write_size && R_SUCCEEDED(t->GetResults())) {
-        s64 dummy_off;
-        R_TRY(t->GetWriteBuf(buf, dummy_off));
+    while (t->write_offset < t->write_size && R_SUCCEEDED(stage.GetResults())) {
+        R_TRY(stage.Pop(buf));
         if (buf.empty()) {
             break;
         }
 
         s64 off{};
-        while (off < buf.size() && t->write_offset < t->write_size && R_SUCCEEDED(t->GetResults())) {
+        while (off < buf.size() && t->write_offset < t->write_size && R_SUCCEEDED(stage.GetResults())) {
             const auto wsize = std::min<s64>(t->read_buffer_size, buf.size() - off);
             R_TRY(ncmContentStorageWritePlaceHolder(std::addressof(cs), std::addressof(t->nca->placeholder_id), t->write_offset, buf.data() + off, wsize));
 
             off += wsize;
             t->write_offset += wsize;
-            ueventSignal(t->GetProgressEvent());
+            stage.SignalProgress();
 
-            // todo: check how much time elapsed and sleep the diff
-            // rather than always sleeping a fixed amount.
-            // ie, writing a small buffer (nca header) should not sleep the full 2 ms.
             if (is_file_based_emummc) {
-                svcSleepThread(2e+6); // 2ms
+                utils::ThrottleEmummc(wsize);
             }
         }
     }
@@ -809,25 +1000,6 @@ Result Yati::writeFuncInternal(ThreadData* t) {
     R_SUCCEED();
 }
 
-void readFunc(void* d) {
-    auto t = static_cast<ThreadData*>(d);
-    t->SetReadResult(t->yati->readFuncInternal(t));
-    log_write("read thread returned now\n");
-}
-
-void decompressFunc(void* d) {
-    log_write("hello decomp thread func\n");
-    auto t = static_cast<ThreadData*>(d);
-    t->SetDecompressResult(t->yati->decompressFuncInternal(t));
-    log_write("decompress thread returned now\n");
-}
-
-void writeFunc(void* d) {
-    auto t = static_cast<ThreadData*>(d);
-    t->SetWriteResult(t->yati->writeFuncInternal(t));
-    log_write("write thread returned now\n");
-}
-
 // stdio-like wrapper for std::vector
 struct BufHelper {
     BufHelper() = default;
@@ -898,9 +1070,12 @@ Result Yati::Setup(const ConfigOverride& override) {
     config.convert_to_standard_crypto = override.convert_to_standard_crypto.value_or(App::GetApp()->m_convert_to_standard_crypto.Get());
     config.lower_master_key = override.lower_master_key.value_or(App::GetApp()->m_lower_master_key.Get());
     config.lower_system_version = override.lower_system_version.value_or(App::GetApp()->m_lower_system_version.Get());
+    config.ncz_block_threads = std::clamp<long>(App::GetApp()->m_ncz_block_threads.Get(), 0, NCZ_BLOCK_THREAD_MAX);
+    config.hash_thread = App::GetApp()->m_hash_thread.Get();
+    // each lane has its own set of buffers, so keep to one lane in applet mode.
+    config.nca_install_lanes = App::IsApplet() ? 1 : std::clamp<long>(App::GetApp()->m_nca_install_lanes.Get(), 1, NCA_INSTALL_LANES_MAX);
     storage_id = config.sd_card_install ? NcmStorageId_SdCard : NcmStorageId_BuiltInUser;
 
-    R_TRY(source->GetOpenResult());
     R_TRY(splCryptoInitialize());
     R_TRY(ns::Initialize());
     R_TRY(es::Initialize());
@@ -925,6 +1100,7 @@ Result Yati::InstallNcaInternal(std::span<TikCollection> tickets, NcaCollection&
             R_TRY(ncmContentStorageReadContentIdFile(std::addressof(cs), std::addressof(nca.header), sizeof(nca.header), std::addressof(nca.content_id), 0));
             crypto::cryptoAes128Xts(std::addressof(nca.header), std::addressof(nca.header), keys.header_key, 0, 0x200, sizeof(nca.header), false);
 
+            SCOPED_MUTEX(std::addressof(ticket_mutex));
             R_TRY(HasRequiredTicket(nca.header, tickets));
             R_SUCCEED();
         }
@@ -936,78 +1112,60 @@ Result Yati::InstallNcaInternal(std::span<TikCollection> tickets, NcaCollection&
     R_TRY(ncmContentStorageCreatePlaceHolder(std::addressof(cs), std::addressof(nca.content_id), std::addressof(nca.placeholder_id), nca.size));
 
     log_write("opening thread\n");
-    ThreadData t_data{this, tickets, std::addressof(nca)};
-
-    #define READ_THREAD_CORE 1
-    #define DECOMPRESS_THREAD_CORE 2
-    #define WRITE_THREAD_CORE 0
-    // #define READ_THREAD_CORE 2
-    // #define DECOMPRESS_THREAD_CORE 2
-    // #define WRITE_THREAD_CORE 2
-
-    Thread t_read{};
-    R_TRY(utils::CreateThread(&t_read, readFunc, std::addressof(t_data), 1024*64));
-    ON_SCOPE_EXIT(threadClose(&t_read));
-
-    Thread t_decompress{};
-    R_TRY(utils::CreateThread(&t_decompress, decompressFunc, std::addressof(t_data), 1024*64));
-    ON_SCOPE_EXIT(threadClose(&t_decompress));
+    // no point spinning up the hash thread if we are not verifying.
+    const auto hash_thread = config.hash_thread && !config.skip_nca_hash_verify;
+    ThreadData t_data{this, tickets, std::addressof(nca), hash_thread};
+
+    utils::Pipeline pipeline{pbox, {
+        .queue_depth = QUEUE_DEPTH,
+        .buffer_size = t_data.max_buffer_size,
+        .stack_size = 1024*64,
+    }};
+
+    pipeline.AddStage("read", [&](utils::PipelineStage& stage) -> Result {
+        return readFuncInternal(std::addressof(t_data), stage);
+    });
+
+    pipeline.AddStage("decompress", [&](utils::PipelineStage& stage) -> Result {
+        return decompressFuncInternal(std::addressof(t_data), stage);
+    });
+
+    if (hash_thread) {
+        pipeline.AddStage("hash", [&](utils::PipelineStage& stage) -> Result {
+            return hashFuncInternal(std::addressof(t_data), stage);
+        });
+    }
 
-    Thread t_write{};
-    R_TRY(utils::CreateThread(&t_write, writeFunc, std::addressof(t_data), 1024*64));
-    ON_SCOPE_EXIT(threadClose(&t_write));
+    pipeline.AddStage("write", [&](utils::PipelineStage& stage) -> Result {
+        return writeFuncInternal(std::addressof(t_data), stage);
+    });
 
     log_write("starting threads\n");
-    R_TRY(threadStart(std::addressof(t_read)));
-    ON_SCOPE_EXIT(threadWaitForExit(std::addressof(t_read)));
-
-    R_TRY(threadStart(std::addressof(t_decompress)));
-    ON_SCOPE_EXIT(threadWaitForExit(std::addressof(t_decompress)));
+    R_TRY(pipeline.Create());
 
-    R_TRY(threadStart(std::addressof(t_write)));
-    ON_SCOPE_EXIT(threadWaitForExit(std::addressof(t_write)));
-
-    const auto waiter_progress = waiterForUEvent(t_data.GetProgressEvent());
-    const auto waiter_cancel = waiterForUEvent(pbox->GetCancelEvent());
-    const auto waiter_done = waiterForUEvent(t_data.GetDoneEvent());
+    // allows for the other installs in the group to cancel this one.
+    if (group) {
+        R_TRY(group->Add(std::addressof(pipeline)));
+    }
+    ON_SCOPE_EXIT(if (group) { group->Remove(std::addressof(pipeline)); });
 
-    for (;;) {
-        s32 idx;
-        if (R_FAILED(waitMulti(&idx, UINT64_MAX, waiter_progress, waiter_cancel, waiter_done))) {
-            break;
-        }
+    R_TRY(pipeline.Start());
 
-        if (!idx) {
-            pbox->UpdateTransfer(t_data.GetWriteOffset(), t_data.GetWriteSize());
+    const auto rc = pipeline.Wait([&]() {
+        if (group) {
+            pbox->UpdateTransfer(group->read, group->total);
         } else {
-            break;
+            pbox->UpdateTransfer(t_data.GetWriteOffset(), t_data.GetWriteSize());
         }
-    }
-
-    // wait for all threads to close.
-    log_write("waiting for threads to close\n");
-    while (t_data.IsAnyRunning()) {
-        t_data.WakeAllThreads();
-        pbox->Yield();
+    });
 
-        if (R_FAILED(waitSingleHandle(t_read.handle, 1000))) {
-            continue;
-        } else if (R_FAILED(waitSingleHandle(t_decompress.handle, 1000))) {
-            continue;
-        } else if (R_FAILED(waitSingleHandle(t_write.handle, 1000))) {
-            continue;
-        }
-        break;
-    }
-    log_write("threads closed\n");
+    // log which stage was the bottleneck.
+    pipeline.LogProfile();
 
-    // if any of the threads failed, wake up all threads so they can exit.
-    if (R_FAILED(t_data.GetResults())) {
-        log_write("some reads failed, waking threads: %s\n", nca.name.c_str());
+    if (R_FAILED(rc)) {
         log_write("returning due to fail: %s\n", nca.name.c_str());
-        return t_data.GetResults();
+        return rc;
     }
-    R_TRY(t_data.GetResults());
 
     NcmContentId content_id{};
     std::memcpy(std::addressof(content_id), nca.hash, sizeof(content_id));
@@ -1027,15 +1185,92 @@ Result Yati::InstallNcaInternal(std::span<TikCollection> tickets, NcaCollection&
     R_SUCCEED();
 }
 
+Result Yati::ConvertNcaCrypto(nca::Header& header, TikCollection* ticket, bool& modified) {
+    if ((config.convert_to_standard_crypto && ticket) || config.lower_master_key) {
+        modified = true;
+        u8 keak_generation = 0;
+
+        if (ticket) {
+            const auto key_gen = header.GetKeyGeneration();
+            log_write("converting to standard crypto: 0x%X 0x%X\n", key_gen, header.GetKeyGeneration());
+
+            keys::KeyEntry title_key;
+            R_TRY(es::GetTitleKeyDecrypted(ticket->ticket, header.rights_id, key_gen, keys, title_key));
+
+            std::memset(header.key_area, 0, sizeof(header.key_area));
+            std::memcpy(&header.key_area[0x2], &title_key, sizeof(title_key));
+
+            keak_generation = key_gen;
+            ticket->required = false;
+        } else if (config.lower_master_key) {
+            R_TRY(nca::DecryptKeak(keys, header));
+        }
+
+        R_TRY(nca::EncryptKeak(keys, header, keak_generation));
+        std::memset(&header.rights_id, 0, sizeof(header.rights_id));
+    }
+
+    R_SUCCEED();
+}
+
+Result Yati::PatchPendingNcaCrypto(NcaCollection& nca, std::span<TikCollection> tickets) {
+    if (!nca.pending_crypto) {
+        R_SUCCEED();
+    }
+
+    // rebuild the header from the unmodified copy, same as the decompress stage does.
+    auto header = nca.header;
+    if (!config.ignore_distribution_bit && header.distribution_type == nca::DistributionType_GameCard) {
+        header.distribution_type = nca::DistributionType_System;
+    }
+
+    auto ticket = GetTicketCollection(header, tickets);
+    R_TRY(HasRequiredTicket(header, ticket));
+    R_UNLESS(ticket && ticket->loaded, Result_YatiTicketNotFound);
+
+    log_write("patching pending crypto: %s\n", nca.name.c_str());
+    R_TRY(ConvertNcaCrypto(header, ticket, nca.modified));
+    crypto::cryptoAes128Xts(std::addressof(header), std::addressof(header), keys.header_key, 0, 0x200, sizeof(header), true);
+    R_TRY(ncmContentStorageWritePlaceHolder(std::addressof(cs), std::addressof(nca.placeholder_id), 0, std::addressof(header), sizeof(header)));
+
+    nca.pending_crypto = false;
+    R_SUCCEED();
+}
+
+Result Yati::SkipNcaData(const NcaCollection& nca) {
+    // skipped in chunks to keep the progress bar moving.
+    constexpr s64 chunk_size = 1024 * 1024 * 4;
+
+    for (s64 off = 0; off < nca.size;) {
+        R_TRY(pbox->ShouldExitResult());
+
+        const auto size = std::min<s64>(nca.size - off, chunk_size);
+        R_TRY(source->Skip(nca.offset + off, size));
+        off += size;
+        pbox->UpdateTransfer(off, nca.size);
+    }
+
+    R_SUCCEED();
+}
+
 Result Yati::InstallNca(std::span<TikCollection> tickets, NcaCollection& nca) {
     log_write("in install nca\n");
-    pbox->NewTransfer(nca.name);
+    // the group shares a single transfer.
+    if (!group) {
+        pbox->NewTransfer(nca.name);
+    }
     keys::parse_hex_key(std::addressof(nca.content_id), nca.name.c_str());
 
     R_TRY(InstallNcaInternal(tickets, nca));
 
     fs::FsPath path;
     if (nca.skipped) {
+        // nothing is written, the data just needs to be read past.
+        if (source->IsStream()) {
+            log_write("draining skipped nca: %s\n", nca.name.c_str());
+            R_TRY(SkipNcaData(nca));
+        }
+
         R_TRY(ncmContentStorageGetPath(std::addressof(cs), path, sizeof(path), std::addressof(nca.content_id)));
     } else {
         R_TRY(ncmContentStorageFlushPlaceHolder(std::addressof(cs)));
@@ -1056,6 +1291,99 @@ Result Yati::InstallNca(std::span<TikCollection> tickets, NcaCollection& nca) {
     R_SUCCEED();
 }
 
+Result Yati::InstallNcaLane(std::span<TikCollection> tickets) {
+    while (auto nca = group->Next()) {
+        if (const auto rc = InstallNca(tickets, *nca); R_FAILED(rc)) {
+            group->Cancel(rc);
+            return rc;
+        }
+
+        // skipped ncas are not read, so count them here.
+        if (nca->skipped) {
+            group->read += nca->size;
+        }
+    }
+
+    R_SUCCEED();
+}
+
+Result Yati::InstallNcas(std::span<TikCollection> tickets, std::span<NcaCollection> ncas) {
+    const auto lanes = std::min<u32>(config.nca_install_lanes, ncas.size());
+
+    // stream sources can only be read in order, and usb / network files would
+    // restart their read window each time a lane reads from a different nca.
+    if (lanes <= 1 || !source->HasCheapRandomAccess()) {
+        for (auto& nca : ncas) {
+            R_TRY(InstallNca(tickets, nca));
+        }
+        R_SUCCEED();
+    }
+
+    NcaInstallGroup install_group{};
+    for (auto& nca : ncas) {
+        install_group.queue.emplace_back(std::addressof(nca));
+        install_group.total += nca.size;
+    }
+
+    // largest first, so that the program nca starts straight away and
+    // the small ncas are installed alongside it.
+    std::ranges::sort(install_group.queue, [](auto lhs, auto rhs) {
+        return lhs->size > rhs->size;
+    });
+
+    pbox->NewTransfer(install_group.queue.front()->name);
+    group = std::addressof(install_group);
+    ON_SCOPE_EXIT(group = nullptr);
+
+    struct Lane {
+        Yati* yati{};
+        std::span<TikCollection> tickets{};
+        Thread thread{};
+        bool started{};
+    };
+
+    const auto lane_func = [](void* arg) {
+        auto lane = static_cast<Lane*>(arg);
+        lane->yati->InstallNcaLane(lane->tickets);
+    };
+
+    // the vector is never resized, so the threads are never moved.
+    std::vector<Lane> helpers(lanes - 1);
+    for (auto& lane : helpers) {
+        lane.yati = this;
+        lane.tickets = tickets;
+
+        // if a lane fails to start, the remaining lanes pick up its ncas.
+        if (R_FAILED(utils::CreateThread(std::addressof(lane.thread), lane_func, std::addressof(lane)))) {
+            log_write("[YATI] failed to create install lane\n");
+            break;
+        }
+
+        if (R_FAILED(threadStart(std::addressof(lane.thread)))) {
+            log_write("[YATI] failed to start install lane\n");
+            threadClose(std::addressof(lane.thread));
+            break;
+        }
+
+        lane.started = true;
+    }
+
+    log_write("[YATI] installing %zu ncas on %u lanes\n", ncas.size(), lanes);
+
+    // this thread is also a lane.
+    InstallNcaLane(tickets);
+
+    for (auto& lane : helpers) {
+        if (lane.started) {
+            threadWaitForExit(std::addressof(lane.thread));
+            threadClose(std::addressof(lane.thread));
+        }
+    }
+
+    // the first error of any lane.
+    return install_group.rc;
+}
+
 Result Yati::InstallCnmtNca(std::span<TikCollection> tickets, CnmtCollection& cnmt, const container::Collections& collections) {
     R_TRY(InstallNca(tickets, cnmt));
 
@@ -1148,6 +1476,7 @@ Result Yati::ParseTicketsIntoCollection(std::vector<TikCollection>& tickets, con
                 u64 bytes_read;
                 R_TRY(source->Read(entry.ticket.data(), collection.offset, entry.ticket.size(), &bytes_read));
                 R_TRY(source->Read(entry.cert.data(), cert->offset, entry.cert.size(), &bytes_read));
+                entry.loaded = true;
             }
 
             tickets.emplace_back(entry);
@@ -1373,9 +1702,9 @@ Result Yati::RegisterNcasAndPushRecord(const CnmtCollection& cnmt, u32 latest_ve
     R_SUCCEED();
 }
 
-Result InstallInternal(ui::ProgressBox* pbox, source::Base* source, const container::Collections& collections, const ConfigOverride& override) {
-    auto yati = std::make_unique<Yati>(pbox, source);
-    R_TRY(yati->Setup(override));
+// installs using an already setup context, see InstallFromFiles().
+Result InstallInternal(Yati* yati, const container::Collections& collections) {
+    R_TRY(yati->source->GetOpenResult());
 
     std::vector<TikCollection> tickets{};
     R_TRY(yati->ParseTicketsIntoCollection(tickets, collections, true));
@@ -1410,9 +1739,7 @@ Result InstallInternal(ui::ProgressBox* pbox, source::Base* source, const contai
         }
 
         log_write("installing nca's\n");
-        for (auto& nca : cnmt.ncas) {
-            R_TRY(yati->InstallNca(tickets, nca));
-        }
+        R_TRY(yati->InstallNcas(tickets, cnmt.ncas));
 
         R_TRY(yati->ImportTickets(tickets));
         R_TRY(yati->RemoveInstalledNcas(cnmt));
@@ -1423,14 +1750,16 @@ Result InstallInternal(ui::ProgressBox* pbox, source::Base* source, const contai
     R_SUCCEED();
 }
 
-Result InstallInternalStream(ui::ProgressBox* pbox, source::Base* source, container::Collections collections, const ConfigOverride& override) {
+Result InstallInternal(ui::ProgressBox* pbox, source::Base* source, const container::Collections& collections, const ConfigOverride& override) {
     auto yati = std::make_unique<Yati>(pbox, source);
     R_TRY(yati->Setup(override));
+    return InstallInternal(yati.get(), collections);
+}
 
-    // not supported with stream installs (yet).
-    yati->config.skip_if_already_installed = false;
-    yati->config.convert_to_standard_crypto = false;
-    yati->config.lower_master_key = false;
+Result InstallInternalStream(ui::ProgressBox* pbox, source::Base* source, container::Collections collections, const ConfigOverride& override) {
+    auto yati = std::make_unique<Yati>(pbox, source);
+    R_TRY(yati->Setup(override));
+    R_TRY(source->GetOpenResult());
 
     std::vector<NcaCollection> ncas{};
     std::vector<CnmtCollection> cnmts{};
@@ -1481,6 +1810,7 @@ Result InstallInternalStream(ui::ProgressBox* pbox, source::Base* source, contai
             u64 bytes_read;
             if (collection.name.ends_with(".tik")) {
                 R_TRY(source->Read(entry->ticket.data(), collection.offset, entry->ticket.size(), &bytes_read));
+                entry->loaded = true;
             } else {
                 R_TRY(source->Read(entry->cert.data(), collection.offset, entry->cert.size(), &bytes_read));
             }
@@ -1510,6 +1840,11 @@ Result InstallInternalStream(ui::ProgressBox* pbox, source::Base* source, contai
             continue;
         }
 
+        // all the tickets have been read by now.
+        for (auto& nca : cnmt.ncas) {
+            R_TRY(yati->PatchPendingNcaCrypto(nca, tickets));
+        }
+
         R_TRY(yati->ImportTickets(tickets));
         R_TRY(yati->RemoveInstalledNcas(cnmt));
         R_TRY(yati->RegisterNcasAndPushRecord(cnmt, latest_version_num));
@@ -1519,6 +1854,48 @@ Result InstallInternalStream(ui::ProgressBox* pbox, source::Base* source, contai
     R_SUCCEED();
 }
 
+Result CreateContainer(source::Base* source, const fs::FsPath& path, std::unique_ptr<container::Base>& out) {
+    const auto ext = std::strrchr(path.s, '.');
+    R_UNLESS(ext, Result_YatiContainerNotFound);
+
+    if (!strcasecmp(ext, ".nsp") || !strcasecmp(ext, ".nsz")) {
+        out = std::make_unique<container::Nsp>(source);
+    } else if (!strcasecmp(ext, ".xci") || !strcasecmp(ext, ".xcz")) {
+        out = std::make_unique<container::Xci>(source);
+    }
+
+    R_UNLESS(out, Result_YatiContainerNotFound);
+    R_SUCCEED();
+}
+
+// a file opened and parsed ahead of its install, see InstallFromFiles().
+struct BatchFile {
+    fs::FsPath path{};
+    std::unique_ptr<source::File> source{};
+    std::unique_ptr<container::Base> container{};
+    container::Collections collections{};
+    Result rc{};
+    bool opened{};
+
+    void Open(fs::Fs* fs) {
+        source = std::make_unique<source::File>(fs, path);
+        rc = [this]() -> Result {
+            R_TRY(source->GetOpenResult());
+            R_TRY(CreateContainer(source.get(), path, container));
+            return container->GetCollections(collections);
+        }();
+        opened = true;
+    }
+
+    auto GetSize() const -> s64 {
+        s64 size{};
+        for (const auto& collection : collections) {
+            size += collection.size;
+        }
+        return size;
+    }
+};
+
 } // namespace
 
 Result InstallFromFile(ui::ProgressBox* pbox, fs::Fs* fs, const fs::FsPath& path, const ConfigOverride& override) {
@@ -1527,18 +1904,76 @@ Result InstallFromFile(ui::ProgressBox* pbox, fs::Fs* fs, const fs::FsPath& path
     return InstallFromSource(pbox, source.get(), path, override);
 }
 
-Result InstallFromSource(ui::ProgressBox* pbox, source::Base* source, const fs::FsPath& path, const ConfigOverride& override) {
-    const auto ext = std::strrchr(path.s, '.');
-    R_UNLESS(ext, Result_YatiContainerNotFound);
+Result InstallFromFiles(ui::ProgressBox* pbox, fs::Fs* fs, std::span<const fs::FsPath> paths, const OnFileInstalled& on_installed, const ConfigOverride& override) {
+    if (paths.empty()) {
+        R_SUCCEED();
+    }
 
-    std::unique_ptr<container::Base> container;
-    if (!strcasecmp(ext, ".nsp") || !strcasecmp(ext, ".nsz")) {
-        container = std::make_unique<container::Nsp>(source);
-    } else if (!strcasecmp(ext, ".xci") || !strcasecmp(ext, ".xcz")) {
-        container = std::make_unique<container::Xci>(source);
+    // keys are parsed and services opened once for every file.
+    auto yati = std::make_unique<Yati>(pbox, nullptr);
+    R_TRY(yati->Setup(override));
+
+    const auto start = armGetSystemTick();
+    s64 total_size{};
+    size_t count{};
+
+    auto current = std::make_unique<BatchFile>();
+    current->path = paths[0];
+    current->Open(fs);
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        R_TRY(pbox->ShouldExitResult());
+
+        // parse the next file whilst this one installs.
+        // declared after next so that the thread exits before next is freed.
+        std::unique_ptr<BatchFile> next{};
+        std::unique_ptr<utils::Async> prefetch{};
+        if (i + 1 < paths.size()) {
+            next = std::make_unique<BatchFile>();
+            next->path = paths[i + 1];
+            prefetch = std::make_unique<utils::Async>([fs, file = next.get()]() {
+                file->Open(fs);
+            });
+        }
+
+        log_write("[YATI] batch install %zu/%zu: %s\n", i + 1, paths.size(), current->path.s);
+        R_TRY(current->rc);
+
+        yati->source = current->source.get();
+        R_TRY(InstallInternal(yati.get(), current->collections));
+
+        total_size += current->GetSize();
+        count++;
+        if (on_installed) {
+            on_installed(current->path);
+        }
+
+        if (next) {
+            prefetch->WaitForExit();
+            // the thread failed to start, open it here instead.
+            if (!next->opened) {
+                next->Open(fs);
+            }
+            current = std::move(next);
+        }
     }
 
-    R_UNLESS(container, Result_YatiContainerNotFound);
+    const auto elapsed = armTicksToNs(armGetSystemTick() - start) / 1e+9;
+    const auto mib = total_size / 1024.0 / 1024.0;
+    const auto speed = elapsed ? mib / elapsed : 0.0;
+    log_write("[YATI] batch installed %zu files, %.2f MiB in %.2fs (%.2f MiB/s)\n", count, mib, elapsed, speed);
+
+    // the per file notify only has the name, so show the total for the batch.
+    char total[64];
+    std::snprintf(total, sizeof(total), "%.2f MiB (%.2f MiB/s)", mib, speed);
+    App::Notify(i18n::Reorder("Installed ", total));
+
+    R_SUCCEED();
+}
+
+Result InstallFromSource(ui::ProgressBox* pbox, source::Base* source, const fs::FsPath& path, const ConfigOverride& override) {
+    std::unique_ptr<container::Base> container;
+    R_TRY(CreateContainer(source, path, container));
     return InstallFromContainer(pbox, container.get(), override);
 }
 
@@ -0,0 +1,170 @@
+# simple http server for testing downloads, supports range requests,
+# etag / if-range and can drop connections to test resuming.
+# usage: python3 http_range_server.py [--port 8000] [--drop-after BYTES] [--no-range] directory
+import argparse
+import email.utils
+import hashlib
+import os
+import re
+import sys
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import unquote, urlparse
+
+RANGE_RE = re.compile(r"bytes=(\d*)-(\d*)$")
+
+def parse_range(value: str, size: int):
+    # returns (start, end) inclusive, None if not a single valid range.
+    m = RANGE_RE.match(value.strip())
+    if not m or (not m.group(1) and not m.group(2)):
+        return None
+
+    if not m.group(1):
+        # suffix range, last N bytes.
+        length = int(m.group(2))
+        if length == 0:
+            return None
+        return max(0, size - length), size - 1
+
+    start = int(m.group(1))
+    end = int(m.group(2)) if m.group(2) else size - 1
+    if start >= size or end < start:
+        return None
+    return start, min(end, size - 1)
+
+def make_etag(path: str) -> str:
+    st = os.stat(path)
+    key = f"{st.st_size}-{st.st_mtime_ns}".encode()
+    return '"' + hashlib.md5(key).hexdigest() + '"'
+
+class RangeRequestHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    # set by the server.
+    root: str = "."
+    # close the connection after sending this many body bytes, 0 disables.
+    drop_after: int = 0
+    no_range: bool = False
+    no_etag: bool = False
+
+    def log_message(self, format, *args):
+        if self.server.verbose:
+            super().log_message(format, *args)
+
+    def translate(self):
+        path = unquote(urlparse(self.path).path).lstrip("/")
+        full = os.path.realpath(os.path.join(self.root, path))
+        if not full.startswith(os.path.realpath(self.root)) or not os.path.isfile(full):
+            return None
+        return full
+
+    def do_HEAD(self):
+        self.handle_request(send_body=False)
+
+    def do_GET(self):
+        self.handle_request(send_body=True)
+
+    def handle_request(self, send_body: bool):
+        path = self.translate()
+        if path is None:
+            self.send_error(404)
+            return
+
+        size = os.path.getsize(path)
+        etag = make_etag(path)
+        last_modified = email.utils.formatdate(os.path.getmtime(path), usegmt=True)
+
+        if not self.no_etag and self.headers.get("If-None-Match") == etag:
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+
+        start, end = 0, size - 1
+        status = 200
+        range_value = self.headers.get("Range")
+        if range_value and not self.no_range:
+            # if-range only applies the range when the validator still matches.
+            if_range = self.headers.get("If-Range")
+            if if_range is None or if_range in (etag, last_modified):
+                r = parse_range(range_value, size)
+                if r is None:
+                    self.send_response(416)
+                    self.send_header("Content-Range", f"bytes */{size}")
+                    self.send_header("Content-Length", "0")
+                    self.end_headers()
+                    return
+                start, end = r
+                status = 206
+
+        self.server.requests.append((status, start, end))
+        length = end - start + 1 if size else 0
+
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(length))
+        self.send_header("Last-Modified", last_modified)
+        if not self.no_range:
+            self.send_header("Accept-Ranges", "bytes")
+        if not self.no_etag:
+            self.send_header("ETag", etag)
+        if status == 206:
+            self.send_header("Content-Range", f"bytes {start}-{end}/{size}")
+        self.end_headers()
+
+        if not send_body or not length:
+            return
+
+        sent = 0
+        with open(path, "rb") as f:
+            f.seek(start)
+            while sent < length:
+                chunk = f.read(min(1024 * 64, length - sent))
+                if not chunk:
+                    break
+
+                if self.drop_after and sent + len(chunk) > self.drop_after:
+                    chunk = chunk[:self.drop_after - sent]
+                    self.wfile.write(chunk)
+                    self.wfile.flush()
+                    self.close_connection = True
+                    self.connection.shutdown(2)
+                    return
+
+                self.wfile.write(chunk)
+                sent += len(chunk)
+
+def create_server(root: str, port: int = 0, drop_after: int = 0, no_range: bool = False, no_etag: bool = False, verbose: bool = False):
+    handler = type("Handler", (RangeRequestHandler,), {
+        "root": root,
+        "drop_after": drop_after,
+        "no_range": no_range,
+        "no_etag": no_etag,
+    })
+
+    server = ThreadingHTTPServer(("0.0.0.0", port), handler)
+    server.daemon_threads = True
+    server.verbose = verbose
+    # (status, start, end) of every body that was served.
+    server.requests = []
+    return server
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="http server with range support for testing downloads")
+    parser.add_argument("directory", help="directory to serve")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--drop-after", type=int, default=0, help="drop the connection after sending N bytes of each response")
+    parser.add_argument("--no-range", action="store_true", help="ignore range requests")
+    parser.add_argument("--no-etag", action="store_true", help="do not send etags")
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.directory):
+        print(f"not a directory: {args.directory}")
+        sys.exit(1)
+
+    server = create_server(args.directory, args.port, args.drop_after, args.no_range, args.no_etag, verbose=True)
+    print(f"serving {args.directory} on port {server.server_address[1]}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
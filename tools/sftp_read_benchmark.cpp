@@ -0,0 +1,245 @@
+// host benchmark of the sftp mount, compares the old direct libssh2_sftp_read()
+// / libssh2_sftp_write() calls against utils::SftpPipeline and checks both
+// read the same data.
+// start a local sshd with a test file, eg:
+//   mkdir -p /tmp/sftp && head -c 1G /dev/urandom > /tmp/sftp/test.bin
+//   docker run -d --name sshd -p 2222:2222 -e PASSWORD_ACCESS=true -e USER_NAME=user -e USER_PASSWORD=pass -v /tmp/sftp:/config/files lscr.io/linuxserver/openssh-server
+// add latency to see the difference the window makes over wifi:
+//   sudo tc qdisc add dev lo root netem delay 5ms
+// build: g++ -std=c++20 -O2 -Itests/host -I../sphaira/include sftp_read_benchmark.cpp ../sphaira/source/utils/sftp_pipeline.cpp -lssh2 -o sftp_read_benchmark
+// usage: ./sftp_read_benchmark host port user pass /config/files/test.bin [io_kib] [read_ahead_kib] [write_behind_kib]
+// the file is also uploaded to path.upload with both methods, then deleted.
+#include "utils/sftp_pipeline.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace {
+
+using sphaira::utils::SftpPipeline;
+
+struct BenchResult {
+    double seconds;
+    std::uint64_t bytes;
+    std::uint64_t hash;
+};
+
+// fnv-1a, only used to check that both methods read the same data.
+std::uint64_t hash_data(std::uint64_t hash, const std::uint8_t* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+int connect_socket(const char* host, const char* port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* res{};
+    if (const auto ret = getaddrinfo(host, port, &hints, &res); ret) {
+        std::fprintf(stderr, "getaddrinfo() failed: %s\n", gai_strerror(ret));
+        return -1;
+    }
+
+    int sock = -1;
+    for (auto addr = res; addr; addr = addr->ai_next) {
+        sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (sock >= 0 && !connect(sock, addr->ai_addr, addr->ai_addrlen)) {
+            break;
+        }
+
+        if (sock >= 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+    return sock;
+}
+
+// reads the file with io_size reads, using the pipeline if read_size is set.
+bool run_read(LIBSSH2_SFTP* sftp, const char* path, std::size_t io_size, std::size_t read_size, BenchResult& out) {
+    auto fd = libssh2_sftp_open(sftp, path, LIBSSH2_FXF_READ, 0);
+    if (!fd) {
+        std::fprintf(stderr, "libssh2_sftp_open() failed: %lu\n", libssh2_sftp_last_error(sftp));
+        return false;
+    }
+
+    std::vector<std::uint8_t> buf(io_size);
+    const auto start = std::chrono::steady_clock::now();
+    out = {0, 0, 0xCBF29CE484222325ULL};
+
+    {
+        SftpPipeline pipeline{fd, read_size, 0};
+        for (;;) {
+            ssize_t ret;
+            if (read_size) {
+                ret = pipeline.Read(buf.data(), out.bytes, buf.size());
+            } else {
+                ret = libssh2_sftp_read(fd, reinterpret_cast<char*>(buf.data()), buf.size());
+            }
+
+            if (ret < 0) {
+                std::fprintf(stderr, "read failed: %lu\n", libssh2_sftp_last_error(sftp));
+                libssh2_sftp_close(fd);
+                return false;
+            }
+
+            if (!ret) {
+                break;
+            }
+
+            out.hash = hash_data(out.hash, buf.data(), ret);
+            out.bytes += ret;
+        }
+    }
+
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    libssh2_sftp_close(fd);
+    return true;
+}
+
+// writes size bytes with io_size writes, using the pipeline if write_size is set.
+bool run_write(LIBSSH2_SFTP* sftp, const char* path, std::uint64_t size, std::size_t io_size, std::size_t write_size, BenchResult& out) {
+    const auto flags = LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC;
+    auto fd = libssh2_sftp_open(sftp, path, flags, LIBSSH2_SFTP_S_IRUSR | LIBSSH2_SFTP_S_IWUSR);
+    if (!fd) {
+        std::fprintf(stderr, "libssh2_sftp_open() failed: %lu\n", libssh2_sftp_last_error(sftp));
+        return false;
+    }
+
+    std::vector<std::uint8_t> buf(io_size);
+    for (std::size_t i = 0; i < buf.size(); i++) {
+        buf[i] = i * 31;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    out = {0, 0, 0};
+
+    {
+        SftpPipeline pipeline{fd, 0, write_size};
+        while (out.bytes < size) {
+            const auto to_write = std::min<std::uint64_t>(buf.size(), size - out.bytes);
+            ssize_t ret;
+            if (write_size) {
+                ret = pipeline.Write(buf.data(), out.bytes, to_write);
+            } else {
+                ret = libssh2_sftp_write(fd, reinterpret_cast<const char*>(buf.data()), to_write);
+            }
+
+            if (ret < 0) {
+                std::fprintf(stderr, "write failed: %lu\n", libssh2_sftp_last_error(sftp));
+                libssh2_sftp_close(fd);
+                return false;
+            }
+
+            out.bytes += ret;
+        }
+
+        if (pipeline.Flush() < 0) {
+            std::fprintf(stderr, "flush failed: %lu\n", libssh2_sftp_last_error(sftp));
+            libssh2_sftp_close(fd);
+            return false;
+        }
+    }
+
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    libssh2_sftp_close(fd);
+    return true;
+}
+
+void print_result(const char* name, const BenchResult& result) {
+    const auto mib = result.bytes / 1024.0 / 1024.0;
+    std::printf("%-16s %8.2f MiB in %6.2fs: %8.2f MiB/s hash: %016llx\n",
+        name, mib, result.seconds, mib / result.seconds, static_cast<unsigned long long>(result.hash));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        std::fprintf(stderr, "usage: %s host port user pass path [io_kib] [read_ahead_kib] [write_behind_kib]\n", argv[0]);
+        return 1;
+    }
+
+    // defaults match the sftp mount, reads are a quarter of the read ahead.
+    const std::size_t io_size = (argc > 6 ? std::atoi(argv[6]) : 32) * 1024;
+    const std::size_t read_size = (argc > 7 ? std::atoi(argv[7]) : 1024 * 2) * 1024 / 4;
+    const std::size_t write_size = (argc > 8 ? std::atoi(argv[8]) : 1024) * 1024;
+
+    const auto sock = connect_socket(argv[1], argv[2]);
+    if (sock < 0) {
+        std::fprintf(stderr, "failed to connect to %s:%s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    if (libssh2_init(0)) {
+        std::fprintf(stderr, "libssh2_init() failed\n");
+        return 1;
+    }
+
+    auto session = libssh2_session_init();
+    if (!session) {
+        std::fprintf(stderr, "libssh2_session_init() failed\n");
+        return 1;
+    }
+
+    // same as the sftp mount.
+    libssh2_session_set_blocking(session, 1);
+    libssh2_session_flag(session, LIBSSH2_FLAG_COMPRESS, 1);
+
+    if (libssh2_session_handshake(session, sock)) {
+        std::fprintf(stderr, "libssh2_session_handshake() failed\n");
+        return 1;
+    }
+
+    if (libssh2_userauth_password(session, argv[3], argv[4])) {
+        std::fprintf(stderr, "libssh2_userauth_password() failed\n");
+        return 1;
+    }
+
+    auto sftp = libssh2_sftp_init(session);
+    if (!sftp) {
+        std::fprintf(stderr, "libssh2_sftp_init() failed\n");
+        return 1;
+    }
+
+    const auto upload_path = std::string{argv[5]} + ".upload";
+    BenchResult direct_read{}, pipeline_read{}, direct_write{}, pipeline_write{};
+    if (!run_read(sftp, argv[5], io_size, 0, direct_read) ||
+        !run_read(sftp, argv[5], io_size, read_size, pipeline_read) ||
+        !run_write(sftp, upload_path.c_str(), direct_read.bytes, io_size, 0, direct_write) ||
+        !run_write(sftp, upload_path.c_str(), direct_read.bytes, io_size, write_size, pipeline_write)) {
+        return 1;
+    }
+
+    libssh2_sftp_unlink(sftp, upload_path.c_str());
+
+    std::printf("io: %zu KiB read: %zu KiB write: %zu KiB\n", io_size / 1024, read_size / 1024, write_size / 1024);
+    print_result("direct read", direct_read);
+    print_result("pipeline read", pipeline_read);
+    print_result("direct write", direct_write);
+    print_result("pipeline write", pipeline_write);
+
+    libssh2_sftp_shutdown(sftp);
+    libssh2_session_disconnect(session, "Normal Shutdown");
+    libssh2_session_free(session);
+    close(sock);
+    libssh2_exit();
+
+    if (direct_read.hash != pipeline_read.hash) {
+        std::fprintf(stderr, "data mismatch\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+// host benchmark of the smb2 mount reads, compares the old synchronous
+// smb2_read() loop against utils::AsyncReadAhead and checks both read the same data.
+// the unit tests in tests/test_async_io.py use a fake server, this is for checking
+// the speed against a real one.
+// start a local samba server (container) with a test file, eg:
+//   mkdir -p /tmp/share && head -c 1G /dev/urandom > /tmp/share/test.bin
+//   docker run -d --name samba -p 445:445 -v /tmp/share:/share dperson/samba -u "user;pass" -s "share;/share;yes;no;no;user"
+// add latency to see the difference the window makes over wifi:
+//   sudo tc qdisc add dev lo root netem delay 5ms
+// build: g++ -std=c++20 -O2 -Itests/host -I../sphaira/include smb2_read_benchmark.cpp ../sphaira/source/utils/async_io.cpp -lsmb2 -o smb2_read_benchmark
+// usage: ./smb2_read_benchmark smb://user@host/share/test.bin password [read_kib] [window_kib]
+#include "utils/async_io.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <vector>
+#include <smb2/smb2.h>
+#include <smb2/libsmb2.h>
+
+namespace {
+
+using sphaira::utils::AsyncReadAhead;
+
+// same as the backend in devoptab_smb2.cpp.
+struct AsyncBackend final : sphaira::utils::AsyncBackend {
+    AsyncBackend(smb2_context* _smb2, smb2fh* _fh) : smb2{_smb2}, fh{_fh} {}
+
+    int ReadAsync(void* buf, u32 size, u64 off, sphaira::utils::AsyncSlot* slot) override {
+        return smb2_pread_async(smb2, fh, static_cast<u8*>(buf), size, off, callback, slot);
+    }
+
+    int WriteAsync(const void* buf, u32 size, u64 off, sphaira::utils::AsyncSlot* slot) override {
+        return smb2_pwrite_async(smb2, fh, static_cast<const u8*>(buf), size, off, callback, slot);
+    }
+
+    int GetFd() override {
+        return smb2_get_fd(smb2);
+    }
+
+    int WhichEvents() override {
+        return smb2_which_events(smb2);
+    }
+
+    int Service(int revents) override {
+        return smb2_service(smb2, revents);
+    }
+
+private:
+    static void callback(smb2_context* smb2, int status, void* command_data, void* cb_data) {
+        static_cast<sphaira::utils::AsyncSlot*>(cb_data)->Complete(status);
+    }
+
+private:
+    smb2_context* const smb2;
+    smb2fh* const fh;
+};
+
+struct BenchResult {
+    double seconds;
+    std::uint64_t bytes;
+    std::uint64_t hash;
+};
+
+// fnv-1a, only used to check that both methods read the same data.
+std::uint64_t hash_data(std::uint64_t hash, const std::uint8_t* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+smb2fh* open_file(smb2_context* smb2, const char* path, std::uint64_t* size) {
+    auto fh = smb2_open(smb2, path, O_RDONLY);
+    if (!fh) {
+        std::fprintf(stderr, "smb2_open() failed: %s\n", smb2_get_error(smb2));
+        return nullptr;
+    }
+
+    smb2_stat_64 st{};
+    if (smb2_fstat(smb2, fh, &st) < 0) {
+        std::fprintf(stderr, "smb2_fstat() failed: %s\n", smb2_get_error(smb2));
+        smb2_close(smb2, fh);
+        return nullptr;
+    }
+
+    *size = st.smb2_size;
+    return fh;
+}
+
+bool run_sync(smb2_context* smb2, const char* path, std::size_t read_size, BenchResult& out) {
+    std::uint64_t size{};
+    auto fh = open_file(smb2, path, &size);
+    if (!fh) {
+        return false;
+    }
+
+    std::vector<std::uint8_t> buf(read_size);
+    const auto max_read = smb2_get_max_read_size(smb2);
+    const auto start = std::chrono::steady_clock::now();
+    out = {0, 0, 0xCBF29CE484222325ULL};
+
+    // same loop as devoptab_read() used to do.
+    for (;;) {
+        std::size_t bytes_read{};
+        while (bytes_read < buf.size()) {
+            const auto to_read = std::min<std::size_t>(buf.size() - bytes_read, max_read);
+            const auto ret = smb2_read(smb2, fh, buf.data() + bytes_read, to_read);
+            if (ret < 0) {
+                std::fprintf(stderr, "smb2_read() failed: %s\n", smb2_get_error(smb2));
+                smb2_close(smb2, fh);
+                return false;
+            }
+
+            bytes_read += ret;
+            if (static_cast<std::size_t>(ret) < to_read) {
+                break;
+            }
+        }
+
+        if (!bytes_read) {
+            break;
+        }
+
+        out.hash = hash_data(out.hash, buf.data(), bytes_read);
+        out.bytes += bytes_read;
+    }
+
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    smb2_close(smb2, fh);
+    return out.bytes == size;
+}
+
+bool run_readahead(smb2_context* smb2, const char* path, std::size_t read_size, std::uint32_t window_size, BenchResult& out) {
+    std::uint64_t size{};
+    auto fh = open_file(smb2, path, &size);
+    if (!fh) {
+        return false;
+    }
+
+    // same sizes as the smb2 mount.
+    const auto request_size = std::min<std::uint32_t>(smb2_get_max_read_size(smb2), 1024 * 1024);
+    const auto max_requests = std::clamp<std::uint32_t>(window_size / request_size, 1, 16);
+
+    std::vector<std::uint8_t> buf(read_size);
+    const auto start = std::chrono::steady_clock::now();
+    out = {0, 0, 0xCBF29CE484222325ULL};
+
+    {
+        AsyncReadAhead readahead{std::make_unique<AsyncBackend>(smb2, fh), size, request_size, max_requests};
+        for (;;) {
+            const auto ret = readahead.Read(buf.data(), out.bytes, buf.size());
+            if (ret < 0) {
+                std::fprintf(stderr, "AsyncReadAhead::Read() failed: %s\n", smb2_get_error(smb2));
+                smb2_close(smb2, fh);
+                return false;
+            }
+
+            if (!ret) {
+                break;
+            }
+
+            out.hash = hash_data(out.hash, buf.data(), ret);
+            out.bytes += ret;
+        }
+    }
+
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("readahead: %u requests of %u KiB\n", max_requests, request_size / 1024);
+    smb2_close(smb2, fh);
+    return out.bytes == size;
+}
+
+void print_result(const char* name, const BenchResult& result) {
+    const auto mib = result.bytes / 1024.0 / 1024.0;
+    std::printf("%-10s %8.2f MiB in %6.2fs: %8.2f MiB/s hash: %016llx\n",
+        name, mib, result.seconds, mib / result.seconds, static_cast<unsigned long long>(result.hash));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s smb://user@host/share/path password [read_kib] [window_kib]\n", argv[0]);
+        return 1;
+    }
+
+    const std::size_t read_size = (argc > 3 ? std::atoi(argv[3]) : 1024) * 1024;
+    const std::uint32_t window_size = (argc > 4 ? std::atoi(argv[4]) : 1024 * 4) * 1024;
+
+    auto smb2 = smb2_init_context();
+    if (!smb2) {
+        std::fprintf(stderr, "smb2_init_context() failed\n");
+        return 1;
+    }
+
+    auto url = smb2_parse_url(smb2, argv[1]);
+    if (!url) {
+        std::fprintf(stderr, "smb2_parse_url() failed: %s\n", smb2_get_error(smb2));
+        return 1;
+    }
+
+    smb2_set_security_mode(smb2, SMB2_NEGOTIATE_SIGNING_ENABLED);
+    smb2_set_password(smb2, argv[2]);
+
+    if (smb2_connect_share(smb2, url->server, url->share, url->user) < 0) {
+        std::fprintf(stderr, "smb2_connect_share() failed: %s\n", smb2_get_error(smb2));
+        return 1;
+    }
+
+    BenchResult sync{}, readahead{};
+    if (!run_sync(smb2, url->path, read_size, sync) || !run_readahead(smb2, url->path, read_size, window_size, readahead)) {
+        return 1;
+    }
+
+    print_result("sync", sync);
+    print_result("readahead", readahead);
+
+    smb2_destroy_url(url);
+    smb2_disconnect_share(smb2);
+    smb2_destroy_context(smb2);
+
+    if (sync.hash != readahead.hash) {
+        std::fprintf(stderr, "data mismatch\n");
+        return 1;
+    }
+
+    return 0;
+}
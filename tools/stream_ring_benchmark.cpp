@@ -0,0 +1,178 @@
+// host benchmark of the stream install buffer, compares the old vector
+// (erase from front) buffer against utils::SpscRingBuffer.
+// both use the same producer / consumer pattern as ui::menu::stream::Stream.
+// build: g++ -std=c++20 -O2 -pthread -I../sphaira/include stream_ring_benchmark.cpp -o stream_ring_benchmark
+// usage: ./stream_ring_benchmark [total_mib] [buffer_kib] [push_kib] [read_kib]
+#include "utils/ring_buffer.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Params {
+    std::size_t total;
+    std::size_t buffer_size;
+    std::size_t push_size;
+    std::size_t read_size;
+};
+
+struct VectorStream {
+    explicit VectorStream(std::size_t capacity) : m_capacity{capacity} {
+        m_buffer.reserve(capacity);
+    }
+
+    void Push(const std::uint8_t* buf, std::size_t size) {
+        while (size) {
+            std::unique_lock lock{m_mutex};
+            m_can_write.wait(lock, [this]{ return m_buffer.size() < m_capacity; });
+
+            const auto wsize = std::min(size, m_capacity - m_buffer.size());
+            const auto offset = m_buffer.size();
+            m_buffer.resize(offset + wsize);
+            std::memcpy(m_buffer.data() + offset, buf, wsize);
+            m_can_read.notify_one();
+
+            size -= wsize;
+            buf += wsize;
+        }
+    }
+
+    void Read(std::uint8_t* buf, std::size_t size) {
+        while (size) {
+            std::unique_lock lock{m_mutex};
+            m_can_read.wait(lock, [this]{ return !m_buffer.empty(); });
+
+            const auto rsize = std::min(size, m_buffer.size());
+            std::memcpy(buf, m_buffer.data(), rsize);
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + rsize);
+            m_can_write.notify_one();
+
+            size -= rsize;
+            buf += rsize;
+        }
+    }
+
+private:
+    const std::size_t m_capacity;
+    std::vector<std::uint8_t> m_buffer;
+    std::mutex m_mutex;
+    std::condition_variable m_can_read;
+    std::condition_variable m_can_write;
+};
+
+struct RingStream {
+    explicit RingStream(std::size_t capacity) : m_buffer{capacity} {}
+
+    void Push(const std::uint8_t* buf, std::size_t size) {
+        while (size) {
+            const auto region = m_buffer.PeekWrite();
+            if (region.empty()) {
+                std::unique_lock lock{m_mutex};
+                m_can_write.wait(lock, [this]{ return !m_buffer.IsFull(); });
+                continue;
+            }
+
+            const auto wsize = std::min(size, region.size());
+            std::memcpy(region.data(), buf, wsize);
+            m_buffer.CommitWrite(wsize);
+            {
+                std::scoped_lock lock{m_mutex};
+                m_can_read.notify_one();
+            }
+
+            size -= wsize;
+            buf += wsize;
+        }
+    }
+
+    void Read(std::uint8_t* buf, std::size_t size) {
+        while (size) {
+            const auto region = m_buffer.PeekRead();
+            if (region.empty()) {
+                std::unique_lock lock{m_mutex};
+                m_can_read.wait(lock, [this]{ return !m_buffer.IsEmpty(); });
+                continue;
+            }
+
+            const auto rsize = std::min(size, region.size());
+            std::memcpy(buf, region.data(), rsize);
+            m_buffer.CommitRead(rsize);
+            {
+                std::scoped_lock lock{m_mutex};
+                m_can_write.notify_one();
+            }
+
+            size -= rsize;
+            buf += rsize;
+        }
+    }
+
+private:
+    sphaira::utils::SpscRingBuffer m_buffer;
+    std::mutex m_mutex;
+    std::condition_variable m_can_read;
+    std::condition_variable m_can_write;
+};
+
+template<typename T>
+void Run(const char* name, const Params& p) {
+    T stream{p.buffer_size};
+
+    std::vector<std::uint8_t> in(p.push_size);
+    std::vector<std::uint8_t> out(p.read_size);
+    for (std::size_t i = 0; i < in.size(); i++) {
+        in[i] = static_cast<std::uint8_t>(i * 31 + 7);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread producer{[&]{
+        for (std::size_t off = 0; off < p.total; off += p.push_size) {
+            stream.Push(in.data(), std::min(p.push_size, p.total - off));
+        }
+    }};
+
+    // checksum so that the reads can't be optimised out and the data is verified.
+    std::uint64_t sum{}, expected{};
+    for (std::size_t off = 0; off < p.total; off += p.read_size) {
+        const auto size = std::min(p.read_size, p.total - off);
+        stream.Read(out.data(), size);
+        for (std::size_t i = 0; i < size; i += 4096) {
+            sum += out[i];
+            expected += in[(off + i) % p.push_size];
+        }
+    }
+
+    producer.join();
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-8s %8.2f MiB/s  %.3fs  %s\n", name, p.total / elapsed / 1024.0 / 1024.0, elapsed, sum == expected ? "ok" : "CORRUPT");
+}
+
+auto Arg(int argc, char** argv, int i, std::size_t def) -> std::size_t {
+    return argc > i ? std::strtoull(argv[i], nullptr, 10) : def;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Params p{};
+    p.total = Arg(argc, argv, 1, 2048) * 1024 * 1024;
+    p.buffer_size = Arg(argc, argv, 2, 1024) * 1024;
+    // ftp / mtp push in small chunks, yati reads in large chunks.
+    p.push_size = Arg(argc, argv, 3, 64) * 1024;
+    p.read_size = Arg(argc, argv, 4, 512) * 1024;
+
+    std::printf("total: %zu MiB buffer: %zu KiB push: %zu KiB read: %zu KiB\n",
+        p.total / 1024 / 1024, p.buffer_size / 1024, p.push_size / 1024, p.read_size / 1024);
+
+    Run<VectorStream>("vector", p);
+    Run<RingStream>("ring", p);
+}
@@ -0,0 +1,431 @@
+// checks the read ahead / write behind queues against a fake server,
+// see sphaira/include/utils/async_io.hpp.
+#include "test.hpp"
+#include "utils/async_io.hpp"
+
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace sphaira::utils;
+using Clock = AsyncSlot::Clock;
+
+// replies to the requests once latency has passed, in the order they were sent.
+struct FakeServer {
+    FakeServer() {
+        // always readable, so that poll() returns straight away.
+        CHECK(!pipe(fds));
+        CHECK(write(fds[1], "x", 1) == 1);
+    }
+
+    ~FakeServer() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    struct Request {
+        bool write;
+        void* buf;
+        u32 size;
+        u64 off;
+        AsyncSlot* slot;
+        Clock::time_point due;
+    };
+
+    void Reply(const Request& r) {
+        if (const auto it = fail_at.find(r.off); it != fail_at.end()) {
+            r.slot->Complete(it->second);
+        } else if (r.write) {
+            if (file.size() < r.off + r.size) {
+                file.resize(r.off + r.size);
+            }
+            std::memcpy(file.data() + r.off, r.buf, r.size);
+            r.slot->Complete(r.size);
+        } else {
+            const auto size = r.off < file.size() ? std::min<u64>(r.size, file.size() - r.off) : 0;
+            std::memcpy(r.buf, file.data() + r.off, size);
+            r.slot->Complete(size);
+        }
+    }
+
+    // replies to every request with an error, as the library does once
+    // the context is destroyed.
+    void Cancel() {
+        while (!pending.empty()) {
+            const auto r = pending.front();
+            pending.pop_front();
+            r.slot->Complete(-ECANCELED);
+        }
+    }
+
+    std::vector<u8> file{};
+    Clock::duration latency{};
+    // requests at these offsets fail with the errno.
+    std::map<u64, int> fail_at{};
+    // submits fail with this errno.
+    int submit_error{};
+    // the connection dropped, every service call fails.
+    bool broken{};
+    // requests from this offset are never replied to.
+    u64 hold_from{UINT64_MAX};
+
+    std::deque<Request> pending{};
+    u32 requests{};
+    u32 max_in_flight{};
+    int fds[2]{};
+};
+
+struct FakeBackend final : AsyncBackend {
+    explicit FakeBackend(FakeServer& _server) : server{_server} {}
+
+    int ReadAsync(void* buf, u32 size, u64 off, AsyncSlot* slot) override {
+        return Send(false, buf, size, off, slot);
+    }
+
+    int WriteAsync(const void* buf, u32 size, u64 off, AsyncSlot* slot) override {
+        return Send(true, const_cast<void*>(buf), size, off, slot);
+    }
+
+    int GetFd() override {
+        return server.fds[0];
+    }
+
+    int WhichEvents() override {
+        return POLLIN;
+    }
+
+    int Service(int revents) override {
+        if (server.broken) {
+            return -1;
+        }
+
+        const auto now = Clock::now();
+        while (!server.pending.empty() && server.pending.front().due <= now && server.pending.front().off < server.hold_from) {
+            const auto r = server.pending.front();
+            server.pending.pop_front();
+            server.Reply(r);
+        }
+
+        return 0;
+    }
+
+private:
+    int Send(bool write, void* buf, u32 size, u64 off, AsyncSlot* slot) {
+        if (server.submit_error) {
+            return server.submit_error;
+        }
+
+        server.pending.push_back({write, buf, size, off, slot, Clock::now() + server.latency});
+        server.requests++;
+        server.max_in_flight = std::max<u32>(server.max_in_flight, server.pending.size());
+        return 0;
+    }
+
+    FakeServer& server;
+};
+
+constexpr u32 REQUEST_SIZE = 1000;
+constexpr u32 MAX_REQUESTS = 8;
+
+auto MakeData(u64 size) -> std::vector<u8> {
+    std::vector<u8> data(size);
+    for (u64 i = 0; i < size; i++) {
+        data[i] = i * 31 + (i >> 8);
+    }
+    return data;
+}
+
+auto MakeReadAhead(FakeServer& server, u64 size) -> AsyncReadAhead {
+    return AsyncReadAhead{std::make_unique<FakeBackend>(server), size, REQUEST_SIZE, MAX_REQUESTS};
+}
+
+void test_read_sequential() {
+    FakeServer server{};
+    server.file = MakeData(12345);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    // reads that don't line up with the requests.
+    std::vector<u8> out;
+    u8 buf[777];
+    for (;;) {
+        const auto ret = readahead.Read(buf, out.size(), sizeof(buf));
+        CHECK(ret >= 0);
+        if (!ret) {
+            break;
+        }
+        out.insert(out.end(), buf, buf + ret);
+    }
+
+    CHECK(out == server.file);
+    // every byte was only requested once.
+    CHECK(server.requests == (server.file.size() + REQUEST_SIZE - 1) / REQUEST_SIZE);
+    CHECK(server.max_in_flight <= MAX_REQUESTS);
+
+    // past the end.
+    CHECK(readahead.Read(buf, server.file.size(), sizeof(buf)) == 0);
+}
+
+void test_read_seek() {
+    FakeServer server{};
+    server.file = MakeData(20000);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    u8 buf[1500];
+    const u64 offsets[] = {0, 5000, 100, 19000, 19999, 7777};
+    for (const auto off : offsets) {
+        const auto ret = readahead.Read(buf, off, sizeof(buf));
+        CHECK(ret == (ssize_t)std::min<u64>(sizeof(buf), server.file.size() - off));
+        CHECK(!std::memcmp(buf, server.file.data() + off, ret));
+    }
+}
+
+void test_read_error() {
+    FakeServer server{};
+    server.file = MakeData(10000);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    u8 buf[2500];
+    server.fail_at[3000] = -EIO;
+
+    // the data before the failed request is returned, then the error.
+    CHECK(readahead.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+    CHECK(readahead.Read(buf, 2500, sizeof(buf)) == 500);
+    CHECK(readahead.Read(buf, 3000, sizeof(buf)) == -EIO);
+
+    // the next read starts again from the failed offset.
+    server.fail_at.clear();
+    CHECK(readahead.Read(buf, 3000, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, server.file.data() + 3000, sizeof(buf)));
+}
+
+void test_read_submit_error() {
+    FakeServer server{};
+    server.file = MakeData(10000);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    u8 buf[100];
+    server.submit_error = -ENOMEM;
+    CHECK(readahead.Read(buf, 0, sizeof(buf)) == -ENOMEM);
+
+    server.submit_error = 0;
+    CHECK(readahead.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, server.file.data(), sizeof(buf)));
+}
+
+void test_read_file_shrank() {
+    FakeServer server{};
+    server.file = MakeData(5500);
+    // the size when the file was opened.
+    auto readahead = MakeReadAhead(server, 9000);
+
+    std::vector<u8> out;
+    u8 buf[1024];
+    for (;;) {
+        const auto ret = readahead.Read(buf, out.size(), sizeof(buf));
+        CHECK(ret >= 0);
+        if (!ret) {
+            break;
+        }
+        out.insert(out.end(), buf, buf + ret);
+    }
+
+    CHECK(out == server.file);
+    CHECK(readahead.GetSize() == server.file.size());
+}
+
+void test_read_broken() {
+    FakeServer server{};
+    server.file = MakeData(10000);
+    server.latency = std::chrono::milliseconds(1);
+
+    {
+        auto readahead = MakeReadAhead(server, server.file.size());
+
+        // leave the requests after the first two in flight.
+        u8 buf[REQUEST_SIZE];
+        server.hold_from = REQUEST_SIZE * 2;
+        CHECK(readahead.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+        CHECK(readahead.Read(buf, REQUEST_SIZE, sizeof(buf)) == sizeof(buf));
+        CHECK(!server.pending.empty());
+
+        server.broken = true;
+        CHECK(readahead.Read(buf, 100, sizeof(buf)) < 0);
+    }
+
+    // the pending requests outlive the queue, their slots are freed once
+    // the library calls them back (checked by the leak sanitizer).
+    CHECK(!server.pending.empty());
+    server.Cancel();
+}
+
+// reads the whole file in request sized reads, sleeping for delay after each one.
+auto ReadAll(AsyncReadAhead& readahead, Clock::duration delay) -> std::vector<u8> {
+    std::vector<u8> out;
+    u8 buf[REQUEST_SIZE];
+    for (;;) {
+        const auto ret = readahead.Read(buf, out.size(), sizeof(buf));
+        CHECK(ret >= 0);
+        if (!ret) {
+            break;
+        }
+        out.insert(out.end(), buf, buf + ret);
+        std::this_thread::sleep_for(delay);
+    }
+    return out;
+}
+
+void test_window_fast_reader() {
+    // a reader that is faster than the rtt opens the whole window.
+    FakeServer server{};
+    server.file = MakeData(REQUEST_SIZE * 64);
+    server.latency = std::chrono::milliseconds(5);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    const auto start = Clock::now();
+    CHECK(ReadAll(readahead, {}) == server.file);
+    const auto elapsed = Clock::now() - start;
+
+    CHECK(server.max_in_flight == MAX_REQUESTS);
+    // one request at a time would take 64 rtts.
+    CHECK(elapsed < server.latency * 64 / 2);
+}
+
+void test_window_slow_reader() {
+    // a reader that takes longer to use a request than the rtt only needs
+    // the next request in flight, more would only use up memory.
+    FakeServer server{};
+    server.file = MakeData(REQUEST_SIZE * 16);
+    server.latency = std::chrono::milliseconds(1);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    CHECK(ReadAll(readahead, std::chrono::milliseconds(20)) == server.file);
+    CHECK(server.max_in_flight <= 2);
+}
+
+void test_window_seek() {
+    // a seek starts the window again from a single request.
+    FakeServer server{};
+    server.file = MakeData(REQUEST_SIZE * 64);
+    server.latency = std::chrono::milliseconds(2);
+    auto readahead = MakeReadAhead(server, server.file.size());
+
+    u8 buf[REQUEST_SIZE];
+    for (u64 off = 0; off < REQUEST_SIZE * 16; off += sizeof(buf)) {
+        CHECK(readahead.Read(buf, off, sizeof(buf)) == sizeof(buf));
+    }
+    CHECK(server.max_in_flight == MAX_REQUESTS);
+
+    // the requests in flight are dropped, only the one being read is sent.
+    const auto off = REQUEST_SIZE * 40 + 10;
+    const auto requests = server.requests;
+    CHECK(readahead.Read(buf, off, 100) == 100);
+    CHECK(!std::memcmp(buf, server.file.data() + off, 100));
+    CHECK(server.requests == requests + 1);
+
+    // then doubles whilst reading sequentially.
+    CHECK(readahead.Read(buf, off + 100, REQUEST_SIZE - 10 - 100) == REQUEST_SIZE - 10 - 100);
+    CHECK(server.requests == requests + 1);
+    CHECK(readahead.Read(buf, REQUEST_SIZE * 41, sizeof(buf)) == sizeof(buf));
+    CHECK(server.requests == requests + 3);
+}
+
+void test_write_sequential() {
+    FakeServer server{};
+    const auto data = MakeData(12345);
+
+    {
+        AsyncWriteBehind writebehind{std::make_unique<FakeBackend>(server), REQUEST_SIZE, MAX_REQUESTS};
+        for (u64 off = 0; off < data.size();) {
+            const auto size = std::min<u64>(333, data.size() - off);
+            CHECK(writebehind.Write(data.data() + off, off, size) == (ssize_t)size);
+            off += size;
+        }
+
+        CHECK(!writebehind.Flush());
+        CHECK(server.pending.empty());
+    }
+
+    CHECK(server.file == data);
+    // the writes were merged into full requests.
+    CHECK(server.requests == (data.size() + REQUEST_SIZE - 1) / REQUEST_SIZE);
+}
+
+void test_write_non_sequential() {
+    FakeServer server{};
+    const auto data = MakeData(5000);
+
+    {
+        AsyncWriteBehind writebehind{std::make_unique<FakeBackend>(server), REQUEST_SIZE, MAX_REQUESTS};
+        CHECK(writebehind.Write(data.data() + 3000, 3000, 2000) == 2000);
+        CHECK(writebehind.Write(data.data(), 0, 1500) == 1500);
+        CHECK(writebehind.Write(data.data() + 1500, 1500, 1500) == 1500);
+        // the destructor flushes.
+    }
+
+    CHECK(server.file == data);
+}
+
+void test_write_error() {
+    FakeServer server{};
+    server.latency = std::chrono::milliseconds(1);
+    const auto data = MakeData(10000);
+
+    AsyncWriteBehind writebehind{std::make_unique<FakeBackend>(server), REQUEST_SIZE, MAX_REQUESTS};
+    server.fail_at[2000] = -ENOSPC;
+
+    // the error is only known once the server replies.
+    CHECK(writebehind.Write(data.data(), 0, 5000) == 5000);
+    CHECK(writebehind.Flush() == -ENOSPC);
+
+    // reported once.
+    server.fail_at.clear();
+    CHECK(writebehind.Write(data.data() + 5000, 5000, 5000) == 5000);
+    CHECK(!writebehind.Flush());
+}
+
+void test_write_broken() {
+    FakeServer server{};
+    server.latency = std::chrono::milliseconds(1);
+    const auto data = MakeData(10000);
+
+    AsyncWriteBehind writebehind{std::make_unique<FakeBackend>(server), REQUEST_SIZE, MAX_REQUESTS};
+    CHECK(writebehind.Write(data.data(), 0, 5000) == 5000);
+
+    server.broken = true;
+    CHECK(writebehind.Flush() < 0);
+
+    // let the fake server reply to what's left before the writer is freed.
+    server.broken = false;
+    while (!server.pending.empty()) {
+        const auto r = server.pending.front();
+        server.pending.pop_front();
+        server.Reply(r);
+    }
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(test_read_sequential);
+    RUN_TEST(test_read_seek);
+    RUN_TEST(test_read_error);
+    RUN_TEST(test_read_submit_error);
+    RUN_TEST(test_read_file_shrank);
+    RUN_TEST(test_read_broken);
+    RUN_TEST(test_window_fast_reader);
+    RUN_TEST(test_window_slow_reader);
+    RUN_TEST(test_window_seek);
+    RUN_TEST(test_write_sequential);
+    RUN_TEST(test_write_non_sequential);
+    RUN_TEST(test_write_error);
+    RUN_TEST(test_write_broken);
+    return 0;
+}
@@ -0,0 +1,176 @@
+// checks the resume and mismatch rules of the segmented downloads.
+#include "test.hpp"
+#include "download_segment.hpp"
+
+#include <cstring>
+
+namespace {
+
+using namespace sphaira::curl::segment;
+
+constexpr s64 MiB = 1024 * 1024;
+
+auto MakeRecord(s64 total, u32 validator) -> RecordHeader {
+    RecordHeader record{};
+    record.magic = RECORD_MAGIC;
+    record.version = RECORD_VERSION;
+    record.total = total;
+    record.segment_size = GetSegmentSize(total);
+    record.segment_count = Split(total).size();
+    record.validator = validator;
+    return record;
+}
+
+void test_split() {
+    // small files are clamped to the min segment size.
+    CHECK(GetSegmentSize(MIN_FILE_SIZE) == SEGMENT_SIZE_MIN);
+    CHECK(Split(MIN_FILE_SIZE).size() == 4);
+
+    // large files are clamped to the max segment size.
+    CHECK(GetSegmentSize(1024 * MiB * 4) == SEGMENT_SIZE_MAX);
+    CHECK(Split(1024 * MiB * 4).size() == 128);
+
+    // in between, a power of 2 that gives around SEGMENT_COUNT_TARGET segments.
+    CHECK(GetSegmentSize(100 * MiB) == 8 * MiB);
+
+    // the segments cover the file with no gaps, the last one is short.
+    const s64 total = 100 * MiB + 123;
+    const auto segments = Split(total);
+    s64 off{};
+    for (const auto& seg : segments) {
+        CHECK(seg.offset == off);
+        CHECK(seg.size > 0 && seg.size <= GetSegmentSize(total));
+        CHECK(!seg.done && !seg.active);
+        off += seg.size;
+    }
+    CHECK(off == total);
+    CHECK(segments.back().size == 4 * MiB + 123);
+}
+
+void test_content_range() {
+    CHECK(ParseContentRangeTotal("bytes 0-0/123456789") == 123456789);
+    CHECK(ParseContentRangeTotal("bytes 0-0/*") == 0);
+    CHECK(ParseContentRangeTotal("bytes 0-0") == 0);
+    CHECK(ParseContentRangeTotal("bytes 0-0/-5") == 0);
+}
+
+void test_record_resume() {
+    const s64 total = 100 * MiB + 123;
+    const auto record = MakeRecord(total, 0x1234);
+
+    auto segments = Split(total);
+    segments[0].done = segments[0].size;
+    segments[3].done = 4096;
+    segments.back().done = 100;
+    const auto buf = SaveRecord(record, segments);
+    CHECK(buf.size() == GetRecordSize(segments.size()));
+
+    auto resumed = Split(total);
+    s64 written = -1;
+    CHECK(LoadRecord(buf, record, resumed, &written));
+    CHECK(written == segments[0].size + 4096 + 100);
+    for (u32 i = 0; i < segments.size(); i++) {
+        CHECK(resumed[i].done == segments[i].done);
+    }
+}
+
+void test_record_clamp() {
+    const s64 total = 10 * MiB;
+    const auto record = MakeRecord(total, 0x1234);
+
+    // a corrupt done size must not resume outside of the segment.
+    auto segments = Split(total);
+    segments[0].done = -50;
+    segments[1].done = segments[1].size * 2;
+    const auto buf = SaveRecord(record, segments);
+
+    auto resumed = Split(total);
+    s64 written{};
+    CHECK(LoadRecord(buf, record, resumed, &written));
+    CHECK(resumed[0].done == 0);
+    CHECK(resumed[1].done == resumed[1].size);
+    CHECK(written == resumed[1].size);
+}
+
+void test_record_mismatch() {
+    const s64 total = 10 * MiB;
+    const auto record = MakeRecord(total, 0x1234);
+
+    auto segments = Split(total);
+    segments[0].done = 1000;
+    const auto buf = SaveRecord(record, segments);
+
+    // the file changed on the server.
+    {
+        auto resumed = Split(total);
+        s64 written{};
+        CHECK(!LoadRecord(buf, MakeRecord(total, 0x4321), resumed, &written));
+        CHECK(resumed[0].done == 0);
+    }
+
+    // the file is now a different size, so the layout changed as well.
+    {
+        const s64 new_total = 20 * MiB;
+        auto resumed = Split(new_total);
+        s64 written{};
+        CHECK(!LoadRecord(buf, MakeRecord(new_total, 0x1234), resumed, &written));
+    }
+
+    // truncated record.
+    {
+        auto resumed = Split(total);
+        s64 written{};
+        CHECK(!LoadRecord(std::span{buf}.first(buf.size() - 1), record, resumed, &written));
+    }
+
+    // record from an older version.
+    {
+        auto old = record;
+        old.version = RECORD_VERSION + 1;
+        auto resumed = Split(total);
+        s64 written{};
+        CHECK(!LoadRecord(SaveRecord(old, segments), record, resumed, &written));
+    }
+}
+
+void test_fits_in_segment() {
+    Segment seg{0, 1000, 400};
+    CHECK(FitsInSegment(seg, 0, 600));
+    CHECK(FitsInSegment(seg, 100, 500));
+    CHECK(!FitsInSegment(seg, 100, 501));
+    CHECK(!FitsInSegment(seg, 0, 601));
+}
+
+void test_outcome() {
+    CHECK(GetOutcome(100, 100, false, true) == Outcome::Complete);
+    // the last segment may finish after another flagged a mismatch.
+    CHECK(GetOutcome(100, 100, true, false) == Outcome::Complete);
+    CHECK(GetOutcome(50, 100, true, true) == Outcome::Discard);
+    CHECK(GetOutcome(50, 100, false, false) == Outcome::Discard);
+    CHECK(GetOutcome(50, 100, false, true) == Outcome::Resume);
+    CHECK(GetOutcome(0, 100, false, true) == Outcome::Resume);
+}
+
+void test_failed_code() {
+    // connection dropped mid segment, or no reply at all.
+    CHECK(GetFailedCode(206) == 0);
+    CHECK(GetFailedCode(0) == 0);
+    // if-range failed, the server sent the whole file.
+    CHECK(GetFailedCode(200) == 0);
+    CHECK(GetFailedCode(416) == 416);
+    CHECK(GetFailedCode(503) == 503);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(test_split);
+    RUN_TEST(test_content_range);
+    RUN_TEST(test_record_resume);
+    RUN_TEST(test_record_clamp);
+    RUN_TEST(test_record_mismatch);
+    RUN_TEST(test_fits_in_segment);
+    RUN_TEST(test_outcome);
+    RUN_TEST(test_failed_code);
+    return 0;
+}
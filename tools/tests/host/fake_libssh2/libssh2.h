@@ -0,0 +1,8 @@
+// stand in for libssh2, only what sftp_pipeline.cpp uses.
+#pragma once
+
+#include <cstdint>
+
+typedef std::uint64_t libssh2_uint64_t;
+
+#define LIBSSH2_ERROR_EAGAIN -37
@@ -0,0 +1,73 @@
+// stand in for libssh2 sftp, the handle is a file in memory.
+// the calls are recorded so that the tests can check what was sent.
+#pragma once
+
+#include "libssh2.h"
+#include <sys/types.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+struct _LIBSSH2_SFTP_HANDLE {
+    std::vector<unsigned char> data{};
+    libssh2_uint64_t off{};
+    // the most a single read / write returns, as libssh2 returns early.
+    size_t max_ret{SIZE_MAX};
+    bool fail_read{};
+    bool fail_write{};
+    // writes send nothing, as if the server stopped acking.
+    bool stall_write{};
+
+    int reads{};
+    int writes{};
+    // the offset of every seek.
+    std::vector<libssh2_uint64_t> seeks{};
+};
+
+typedef struct _LIBSSH2_SFTP_HANDLE LIBSSH2_SFTP_HANDLE;
+
+inline ssize_t libssh2_sftp_read(LIBSSH2_SFTP_HANDLE* h, char* buf, size_t len) {
+    h->reads++;
+    if (h->fail_read) {
+        return -1;
+    }
+
+    if (h->off >= h->data.size()) {
+        return 0;
+    }
+
+    const auto n = std::min({len, size_t(h->data.size() - h->off), h->max_ret});
+    std::memcpy(buf, h->data.data() + h->off, n);
+    h->off += n;
+    return n;
+}
+
+inline ssize_t libssh2_sftp_write(LIBSSH2_SFTP_HANDLE* h, const char* buf, size_t len) {
+    h->writes++;
+    if (h->fail_write) {
+        return -1;
+    }
+
+    if (h->stall_write) {
+        return 0;
+    }
+
+    const auto n = std::min(len, h->max_ret);
+    if (h->off + n > h->data.size()) {
+        h->data.resize(h->off + n);
+    }
+
+    std::memcpy(h->data.data() + h->off, buf, n);
+    h->off += n;
+    return n;
+}
+
+inline libssh2_uint64_t libssh2_sftp_tell64(LIBSSH2_SFTP_HANDLE* h) {
+    return h->off;
+}
+
+// returns void in libssh2 as well.
+inline void libssh2_sftp_seek64(LIBSSH2_SFTP_HANDLE* h, libssh2_uint64_t off) {
+    h->seeks.emplace_back(off);
+    h->off = off;
+}
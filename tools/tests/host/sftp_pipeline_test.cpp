@@ -0,0 +1,217 @@
+// checks the sftp read buffer / write joining against a fake libssh2 handle,
+// see sphaira/include/utils/sftp_pipeline.hpp.
+#include "test.hpp"
+#include "utils/sftp_pipeline.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+using sphaira::utils::SftpPipeline;
+
+constexpr size_t READ_SIZE = 1000;
+constexpr size_t WRITE_SIZE = 1000;
+
+auto MakeData(u64 size) -> std::vector<u8> {
+    std::vector<u8> data(size);
+    for (u64 i = 0; i < size; i++) {
+        data[i] = i * 31 + (i >> 8);
+    }
+    return data;
+}
+
+void test_read_sequential() {
+    LIBSSH2_SFTP_HANDLE h{};
+    h.data = MakeData(12345);
+    h.max_ret = 700;
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    std::vector<u8> out;
+    u8 buf[333];
+    for (;;) {
+        const auto ret = pipeline.Read(buf, out.size(), sizeof(buf));
+        CHECK(ret >= 0);
+        if (!ret) {
+            break;
+        }
+        out.insert(out.end(), buf, buf + ret);
+    }
+
+    CHECK(out == h.data);
+    // the handle is already at the offset of every read.
+    CHECK(h.seeks.empty());
+}
+
+void test_read_buffer_hit() {
+    LIBSSH2_SFTP_HANDLE h{};
+    h.data = MakeData(10000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    // fills the buffer with [5000, 6000).
+    u8 buf[100];
+    CHECK(pipeline.Read(buf, 5000, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, h.data.data() + 5000, sizeof(buf)));
+    CHECK(h.reads == 1);
+    CHECK(h.seeks == std::vector<libssh2_uint64_t>{5000});
+
+    // anywhere inside of the buffer, including before the last read.
+    const u64 offsets[] = {5500, 5050, 5000, 5899};
+    for (const auto off : offsets) {
+        CHECK(pipeline.Read(buf, off, sizeof(buf)) == sizeof(buf));
+        CHECK(!std::memcmp(buf, h.data.data() + off, sizeof(buf)));
+    }
+
+    // only returns up to the end of the buffer.
+    CHECK(pipeline.Read(buf, 5950, sizeof(buf)) == 50);
+    CHECK(!std::memcmp(buf, h.data.data() + 5950, 50));
+    CHECK(h.reads == 1);
+
+    // the end of the buffer is where the handle is, so no seek is needed.
+    CHECK(pipeline.Read(buf, 6000, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, h.data.data() + 6000, sizeof(buf)));
+    CHECK(h.reads == 2);
+    CHECK(h.seeks.size() == 1);
+}
+
+void test_read_seek() {
+    LIBSSH2_SFTP_HANDLE h{};
+    h.data = MakeData(10000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    u8 buf[100];
+    CHECK(pipeline.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+    CHECK(pipeline.Read(buf, 8000, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, h.data.data() + 8000, sizeof(buf)));
+    CHECK(pipeline.Read(buf, 10, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, h.data.data() + 10, sizeof(buf)));
+    CHECK((h.seeks == std::vector<libssh2_uint64_t>{8000, 10}));
+
+    // large reads go straight to the handle.
+    std::vector<u8> large(READ_SIZE * 3);
+    CHECK(pipeline.Read(large.data(), 2000, large.size()) == (ssize_t)large.size());
+    CHECK(!std::memcmp(large.data(), h.data.data() + 2000, large.size()));
+
+    // past the end.
+    CHECK(pipeline.Read(buf, h.data.size(), sizeof(buf)) == 0);
+}
+
+void test_read_error() {
+    LIBSSH2_SFTP_HANDLE h{};
+    h.data = MakeData(10000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    u8 buf[100];
+    h.fail_read = true;
+    CHECK(pipeline.Read(buf, 0, sizeof(buf)) == -EIO);
+
+    // nothing was kept from the failed read.
+    h.fail_read = false;
+    CHECK(pipeline.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+    CHECK(!std::memcmp(buf, h.data.data(), sizeof(buf)));
+}
+
+void test_write_sequential() {
+    LIBSSH2_SFTP_HANDLE h{};
+    h.max_ret = 300;
+    const auto data = MakeData(12345);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    for (u64 off = 0; off < data.size();) {
+        const auto size = std::min<u64>(77, data.size() - off);
+        CHECK(pipeline.Write(data.data() + off, off, size) == (ssize_t)size);
+        off += size;
+    }
+
+    CHECK(!pipeline.Flush());
+    CHECK(h.data == data);
+    CHECK(h.seeks.empty());
+}
+
+void test_write_non_sequential() {
+    LIBSSH2_SFTP_HANDLE h{};
+    const auto data = MakeData(5000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    // joined writes are sent before one at another offset.
+    CHECK(pipeline.Write(data.data() + 3000, 3000, 500) == 500);
+    CHECK(pipeline.Write(data.data() + 3500, 3500, 1500) == 1500);
+    CHECK(pipeline.Write(data.data(), 0, 100) == 100);
+    CHECK(pipeline.Write(data.data() + 100, 100, 2900) == 2900);
+    CHECK(!pipeline.Flush());
+
+    CHECK(h.data == data);
+    CHECK((h.seeks == std::vector<libssh2_uint64_t>{3000, 0}));
+}
+
+void test_read_after_write() {
+    LIBSSH2_SFTP_HANDLE h{};
+    h.data = MakeData(5000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    // fill the read buffer, then change the data under it.
+    u8 buf[100];
+    CHECK(pipeline.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+
+    const u8 changed[50] = {1, 2, 3, 4, 5};
+    CHECK(pipeline.Write(changed, 20, sizeof(changed)) == sizeof(changed));
+
+    // the write is still joined, the read sends it first and doesn't use the old buffer.
+    CHECK(h.writes == 0);
+    CHECK(pipeline.Read(buf, 0, sizeof(buf)) == sizeof(buf));
+    CHECK(h.writes == 1);
+    CHECK(!std::memcmp(buf + 20, changed, sizeof(changed)));
+    CHECK(!std::memcmp(buf, h.data.data(), sizeof(buf)));
+}
+
+void test_write_error() {
+    LIBSSH2_SFTP_HANDLE h{};
+    const auto data = MakeData(5000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    // the error is only known once the joined write is sent.
+    h.fail_write = true;
+    CHECK(pipeline.Write(data.data(), 0, 100) == 100);
+    CHECK(pipeline.Flush() == -EIO);
+
+    // the failed data is dropped, so it is reported once.
+    CHECK(!pipeline.Flush());
+
+    // large writes fail straight away.
+    CHECK(pipeline.Write(data.data(), 0, data.size()) == -EIO);
+
+    h.fail_write = false;
+    CHECK(pipeline.Write(data.data(), 0, data.size()) == (ssize_t)data.size());
+    CHECK(h.data == data);
+}
+
+void test_write_stall() {
+    LIBSSH2_SFTP_HANDLE h{};
+    const auto data = MakeData(5000);
+    SftpPipeline pipeline{&h, READ_SIZE, WRITE_SIZE};
+
+    // a write that never makes progress gives up rather than spinning.
+    h.stall_write = true;
+    CHECK(pipeline.Write(data.data(), 0, data.size()) == -ETIMEDOUT);
+    CHECK(h.writes > 0 && h.writes < 100);
+
+    h.stall_write = false;
+    CHECK(pipeline.Write(data.data(), 0, data.size()) == (ssize_t)data.size());
+    CHECK(h.data == data);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(test_read_sequential);
+    RUN_TEST(test_read_buffer_hit);
+    RUN_TEST(test_read_seek);
+    RUN_TEST(test_read_error);
+    RUN_TEST(test_write_sequential);
+    RUN_TEST(test_write_non_sequential);
+    RUN_TEST(test_read_after_write);
+    RUN_TEST(test_write_error);
+    RUN_TEST(test_write_stall);
+    return 0;
+}
@@ -0,0 +1,17 @@
+// minimal checks for the host tests, a failed check exits with the line that failed.
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(x) do { \
+    if (!(x)) { \
+        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x); \
+        std::exit(1); \
+    } \
+} while (0)
+
+#define RUN_TEST(func) do { \
+    std::printf("%s\n", #func); \
+    func(); \
+} while (0)
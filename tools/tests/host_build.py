@@ -0,0 +1,37 @@
+# builds and runs the c++ host tests in tests/host, along with the sphaira sources they test.
+# the tests are skipped if there's no c++ compiler, set CXX to pick one.
+import os
+import shutil
+import subprocess
+import tempfile
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+HOST_DIR = os.path.join(TESTS_DIR, "host")
+SPHAIRA_DIR = os.path.abspath(os.path.join(TESTS_DIR, "..", "..", "sphaira"))
+
+def find_compiler():
+	return os.environ.get("CXX") or shutil.which("g++") or shutil.which("clang++")
+
+def build_and_run(testcase, name, sources=[], libs=[], includes=[]):
+	cxx = find_compiler()
+	if not cxx:
+		testcase.skipTest("no c++ compiler found")
+
+	with tempfile.TemporaryDirectory() as tempdir:
+		exe = os.path.join(tempdir, name)
+		# the sanitizers catch leaks and use after frees, ie, of buffers still owned by a request.
+		cmd = [cxx, "-std=c++20", "-O1", "-g", "-Wall", "-pthread", "-fsanitize=address,undefined",
+			"-I", HOST_DIR, "-I", os.path.join(SPHAIRA_DIR, "include"),
+			os.path.join(HOST_DIR, name + ".cpp")]
+		# ie, the stand in headers for a library, which come before the real ones.
+		for include in includes:
+			cmd[1:1] = ["-I", os.path.join(HOST_DIR, include)]
+		cmd += [os.path.join(SPHAIRA_DIR, source) for source in sources]
+		cmd += ["-o", exe] + libs
+
+		build = subprocess.run(cmd, capture_output=True, text=True)
+		testcase.assertEqual(build.returncode, 0, build.stderr)
+
+		run = subprocess.run([exe], capture_output=True, text=True, timeout=300)
+		testcase.assertEqual(run.returncode, 0, run.stdout + run.stderr)
+		return run.stdout
@@ -0,0 +1,13 @@
+import sys, os
+sys.path.insert(0, os.path.abspath(os.path.dirname(__file__)))
+
+import unittest
+
+from host_build import build_and_run
+
+class TestAsyncIo(unittest.TestCase):
+	def test_async_io(self):
+		build_and_run(self, "async_io_test", ["source/utils/async_io.cpp"])
+
+if __name__ == "__main__":
+	unittest.main()
@@ -0,0 +1,13 @@
+import sys, os
+sys.path.insert(0, os.path.abspath(os.path.dirname(__file__)))
+
+import unittest
+
+from host_build import build_and_run
+
+class TestDownloadSegment(unittest.TestCase):
+	def test_download_segment(self):
+		build_and_run(self, "download_segment_test", ["source/download_segment.cpp"])
+
+if __name__ == "__main__":
+	unittest.main()
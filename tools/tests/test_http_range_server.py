@@ -0,0 +1,120 @@
+import sys, os
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+import unittest
+import tempfile
+import shutil
+import threading
+import http.client
+
+from http_range_server import create_server, parse_range
+
+class TestParseRange(unittest.TestCase):
+	def test_ranges(self):
+		self.assertEqual(parse_range("bytes=0-0", 100), (0, 0))
+		self.assertEqual(parse_range("bytes=10-", 100), (10, 99))
+		self.assertEqual(parse_range("bytes=90-200", 100), (90, 99))
+		self.assertEqual(parse_range("bytes=-10", 100), (90, 99))
+		self.assertIsNone(parse_range("bytes=100-", 100))
+		self.assertIsNone(parse_range("bytes=5-1", 100))
+		self.assertIsNone(parse_range("bytes=0-1,5-6", 100))
+
+class TestHttpRangeServer(unittest.TestCase):
+	def setUp(self):
+		self.tempdir = tempfile.mkdtemp()
+		self.data = os.urandom(1024 * 256 + 123)
+		with open(os.path.join(self.tempdir, "file.bin"), "wb") as f:
+			f.write(self.data)
+		self.servers = []
+
+	def tearDown(self):
+		for server in self.servers:
+			server.shutdown()
+			server.server_close()
+		shutil.rmtree(self.tempdir)
+
+	def start(self, **kwargs):
+		server = create_server(self.tempdir, 0, **kwargs)
+		threading.Thread(target=server.serve_forever, daemon=True).start()
+		self.servers.append(server)
+		return server
+
+	def get(self, server, headers={}):
+		conn = http.client.HTTPConnection("127.0.0.1", server.server_address[1])
+		conn.request("GET", "/file.bin", headers=headers)
+		resp = conn.getresponse()
+		try:
+			body = resp.read()
+		except http.client.IncompleteRead as e:
+			body = e.partial
+		conn.close()
+		return resp, body
+
+	def test_full(self):
+		server = self.start()
+		resp, body = self.get(server)
+		self.assertEqual(resp.status, 200)
+		self.assertEqual(body, self.data)
+		self.assertEqual(resp.getheader("Accept-Ranges"), "bytes")
+
+	def test_probe(self):
+		server = self.start()
+		resp, body = self.get(server, {"Range": "bytes=0-0"})
+		self.assertEqual(resp.status, 206)
+		self.assertEqual(body, self.data[:1])
+		self.assertEqual(resp.getheader("Content-Range"), f"bytes 0-0/{len(self.data)}")
+
+	def test_segments(self):
+		server = self.start()
+		segment = 1024 * 64
+		out = b""
+		for off in range(0, len(self.data), segment):
+			end = min(off + segment, len(self.data)) - 1
+			resp, body = self.get(server, {"Range": f"bytes={off}-{end}"})
+			self.assertEqual(resp.status, 206)
+			out += body
+		self.assertEqual(out, self.data)
+
+	def test_if_range(self):
+		server = self.start()
+		resp, _ = self.get(server, {"Range": "bytes=0-0"})
+		etag = resp.getheader("ETag")
+
+		resp, body = self.get(server, {"Range": "bytes=10-19", "If-Range": etag})
+		self.assertEqual(resp.status, 206)
+		self.assertEqual(body, self.data[10:20])
+
+		# a changed file ignores the range and sends everything.
+		resp, body = self.get(server, {"Range": "bytes=10-19", "If-Range": '"changed"'})
+		self.assertEqual(resp.status, 200)
+		self.assertEqual(body, self.data)
+
+	def test_if_none_match(self):
+		server = self.start()
+		resp, _ = self.get(server)
+		resp, body = self.get(server, {"If-None-Match": resp.getheader("ETag")})
+		self.assertEqual(resp.status, 304)
+		self.assertEqual(body, b"")
+
+	def test_unsatisfiable(self):
+		server = self.start()
+		resp, _ = self.get(server, {"Range": f"bytes={len(self.data)}-"})
+		self.assertEqual(resp.status, 416)
+		self.assertEqual(resp.getheader("Content-Range"), f"bytes */{len(self.data)}")
+
+	def test_no_range(self):
+		server = self.start(no_range=True)
+		resp, body = self.get(server, {"Range": "bytes=0-0"})
+		self.assertEqual(resp.status, 200)
+		self.assertEqual(body, self.data)
+		self.assertIsNone(resp.getheader("Accept-Ranges"))
+
+	def test_drop_after(self):
+		server = self.start(drop_after=1000)
+		resp, body = self.get(server, {"Range": "bytes=100-"})
+		self.assertEqual(resp.status, 206)
+		self.assertEqual(body, self.data[100:1100])
+		self.assertEqual(server.requests, [(206, 100, len(self.data) - 1)])
+
+if __name__ == "__main__":
+	unittest.main()
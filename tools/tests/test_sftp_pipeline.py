@@ -0,0 +1,13 @@
+import sys, os
+sys.path.insert(0, os.path.abspath(os.path.dirname(__file__)))
+
+import unittest
+
+from host_build import build_and_run
+
+class TestSftpPipeline(unittest.TestCase):
+	def test_sftp_pipeline(self):
+		build_and_run(self, "sftp_pipeline_test", ["source/utils/sftp_pipeline.cpp"], includes=["fake_libssh2"])
+
+if __name__ == "__main__":
+	unittest.main()
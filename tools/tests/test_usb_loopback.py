@@ -0,0 +1,84 @@
+import sys, os
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), '..')))
+
+import unittest
+import tempfile
+import hashlib
+import threading
+from unittest import mock
+
+import usb_install
+import usb_loopback
+from usb_common import INFLIGHT_MAX
+
+class TestNegotiateInflight(unittest.TestCase):
+	def test_v1_switch(self):
+		self.assertEqual(usb_install.negotiate_inflight(0, 0), 0)
+		self.assertEqual(usb_install.negotiate_inflight(0, 8), 0)
+
+	def test_v2_switch(self):
+		self.assertEqual(usb_install.negotiate_inflight(2, 4), 4)
+		self.assertEqual(usb_install.negotiate_inflight(2, INFLIGHT_MAX + 100), INFLIGHT_MAX)
+
+class TestUsbLoopback(unittest.TestCase):
+	def setUp(self):
+		self.tempdir = tempfile.mkdtemp()
+		# not a multiple of the chunk size so that the last request is short.
+		self.data = os.urandom(1024 * 1024 * 3 + 1234)
+		self.path = os.path.join(self.tempdir, "file.nsp")
+		with open(self.path, "wb") as f:
+			f.write(self.data)
+
+	def tearDown(self):
+		os.remove(self.path)
+		os.rmdir(self.tempdir)
+
+	def test_v1(self):
+		stats = usb_loopback.run(self.path, 0, latency=0, read_size=1024 * 300)
+		self.assertEqual(stats["protocol"], 1)
+		self.assertEqual(stats["size"], len(self.data))
+		self.assertEqual(stats["sha256"], hashlib.sha256(self.data).hexdigest())
+
+	def test_v2(self):
+		stats = usb_loopback.run(self.path, INFLIGHT_MAX, latency=0, read_size=1024 * 300)
+		self.assertEqual(stats["protocol"], 2)
+		self.assertEqual(stats["inflight"], INFLIGHT_MAX)
+		self.assertEqual(stats["sha256"], hashlib.sha256(self.data).hexdigest())
+
+	def test_v2_switch_v1_host(self):
+		# an older host replies with 0 in-flight, the switch must fall back to v1.
+		with mock.patch("usb_install.negotiate_inflight", return_value=0):
+			stats = usb_loopback.run(self.path, INFLIGHT_MAX, latency=0)
+		self.assertEqual(stats["protocol"], 1)
+		self.assertEqual(stats["sha256"], hashlib.sha256(self.data).hexdigest())
+
+	def test_v2_random_access(self):
+		# backwards seeks drain the pipeline, forward seeks inside the window skip the data.
+		to_host = usb_loopback.LoopbackPipe(0, 0)
+		to_device = usb_loopback.LoopbackPipe(0, 0)
+		usb_install.paths.clear()
+		usb_install.add_file_to_install_list(self.path)
+		host = threading.Thread(target=usb_install.serve, args=(usb_loopback.LoopbackHostUsb(to_host, to_device),), daemon=True)
+		host.start()
+
+		device = usb_loopback.LoopbackDevice(to_host, to_device, INFLIGHT_MAX)
+		device.connect()
+		self.assertEqual(device.open_file(0), len(self.data))
+
+		for off, size in ((0, 1000), (5000, 100), (1024 * 1024 * 2, 4096), (10, 10), (len(self.data) - 10, 100), (len(self.data), 10)):
+			self.assertEqual(device.read(off, size), self.data[off:off + size])
+
+		device.close_file()
+		device.quit()
+		host.join(timeout=5)
+		self.assertFalse(host.is_alive())
+
+	def test_v2_faster_with_latency(self):
+		# small reads are bound by the round trip in v1, v2 keeps the link busy.
+		v1 = usb_loopback.run(self.path, 0, latency=0.002, bandwidth=200 * 1024 * 1024, read_size=1024 * 256)
+		v2 = usb_loopback.run(self.path, INFLIGHT_MAX, latency=0.002, bandwidth=200 * 1024 * 1024, read_size=1024 * 256)
+		self.assertEqual(v1["sha256"], v2["sha256"])
+		self.assertLess(v2["elapsed"], v1["elapsed"])
+
+if __name__ == '__main__':
+	unittest.main()
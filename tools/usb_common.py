@@ -21,6 +21,12 @@ RESULT_ERROR = 1
 FLAG_NONE = 0
 FLAG_STREAM = 1 << 0
 
+# protocol v2, several data requests can be in flight at once.
+# the switch sends the version and the max requests in flight in the hello packet,
+# the number accepted is sent back in the hello result (0 for v1).
+PROTOCOL_VERSION_2 = 2
+INFLIGHT_MAX = 8
+
 class UsbPacket:
     STRUCT_FORMAT = "<6I"  # 6 unsigned 32-bit ints, little-endian
 
@@ -3,6 +3,8 @@ import glob
 from io import BufferedReader
 import sys
 import os
+import queue
+import threading
 from pathlib import Path
 from usb_common import *
 
@@ -25,12 +27,35 @@ def send_file_info_result(usb: Usb, result: int, file_size: int, flags: int):
     size_msb = ((file_size >> 32) & 0xFFFF) | (flags << 16)
     usb.send_result(result, size_msb, size_lsb)
 
-def file_transfer_loop(usb: Usb, file: BufferedReader, flags: int) -> None:
+def negotiate_inflight(version: int, requested: int) -> int:
+    # returns the max requests in flight, 0 for v1.
+    if version < PROTOCOL_VERSION_2:
+        return 0
+    return min(requested, INFLIGHT_MAX)
+
+def request_reader(usb: Usb, requests: queue.Queue) -> None:
+    # reads requests as soon as they're sent, so the switch never waits on us to read them.
+    while True:
+        request = usb.get_send_data_header()
+        requests.put(request)
+        if request[0] == 0 and request[1] == 0:
+            break
+
+def file_transfer_loop(usb: Usb, file: BufferedReader, flags: int, inflight: int = 0) -> None:
     print("inside file transfer loop now")
 
+    # v2, the requests are read on their own thread and replied to in order.
+    requests = None
+    if inflight:
+        requests = queue.Queue()
+        threading.Thread(target=request_reader, args=(usb, requests), daemon=True).start()
+
     while True:
         # get offset + size.
-        [off, size, _] = usb.get_send_data_header()
+        if requests:
+            [off, size, _] = requests.get()
+        else:
+            [off, size, _] = usb.get_send_data_header()
 
         # check if we should finish now.
         if (off == 0 and size == 0):
@@ -58,7 +83,7 @@ def file_transfer_loop(usb: Usb, file: BufferedReader, flags: int) -> None:
         # send the data.
         usb.write(buf)
 
-def wait_for_input(usb: Usb, file_index: int) -> None:
+def wait_for_input(usb: Usb, file_index: int, inflight: int = 0) -> None:
     print("now waiting for intput\n")
 
     # open file / rar. (todo: learn how to make a class with inheritance)
@@ -76,14 +101,14 @@ def wait_for_input(usb: Usb, file_index: int) -> None:
 
                     print("opened file: {} flags: {}".format(internal_path, flags))
                     send_file_info_result(usb, RESULT_OK, info.file_size, flags)
-                    file_transfer_loop(usb, file, flags)
+                    file_transfer_loop(usb, file, flags, inflight)
         else:
             with open(path, "rb") as file:
                 print("opened file {}".format(path))
                 file.seek(0, os.SEEK_END)
                 file_size = file.tell()
                 send_file_info_result(usb, RESULT_OK, file_size, flags)
-                file_transfer_loop(usb, file, flags)
+                file_transfer_loop(usb, file, flags, inflight)
 
     except OSError as e:
         print("Error: failed to open: {} error: {}".format(e.filename, str(e)))
@@ -107,6 +132,34 @@ def add_file_to_install_list(path: str) -> None:
         print("Adding file: {} type: FILE".format(path))
         paths.append([path, path])
 
+def serve(usb: Usb) -> None:
+    # build string table.
+    string_table = bytes()
+    for [_, path] in paths:
+        string_table += bytes(Path(path).name.__str__(), 'utf8') + b'\n'
+
+    # this reads the send header and checks the magic.
+    [_, version, requested] = usb.get_send_header()
+    inflight = negotiate_inflight(version, requested)
+    print("protocol: v{} requests in flight: {}".format(2 if inflight else 1, inflight))
+
+    # send recv and string table.
+    usb.send_result(RESULT_OK, len(string_table), inflight)
+    usb.write(string_table)
+
+    # wait for command.
+    while True:
+        [cmd, arg3, arg4] = usb.get_send_header()
+
+        if cmd == CMD_QUIT:
+            usb.send_result(RESULT_OK)
+            break
+        elif cmd == CMD_OPEN:
+            wait_for_input(usb, arg3, inflight)
+        else:
+            usb.send_result(RESULT_ERROR)
+            break
+
 if __name__ == '__main__':
     print("hello world")
 
@@ -132,31 +185,7 @@ if __name__ == '__main__':
     try:
         # get usb endpoints.
         usb.wait_for_connect()
-
-        # build string table.
-        string_table = bytes()
-        for [_, path] in paths:
-            string_table += bytes(Path(path).name.__str__(), 'utf8') + b'\n'
-
-        # this reads the send header and checks the magic.
-        usb.get_send_header()
-
-        # send recv and string table.
-        usb.send_result(RESULT_OK, len(string_table))
-        usb.write(string_table)
-
-        # wait for command.
-        while True:
-            [cmd, arg3, arg4] = usb.get_send_header()
-
-            if cmd == CMD_QUIT:
-                usb.send_result(RESULT_OK)
-                break
-            elif cmd == CMD_OPEN:
-                wait_for_input(usb, arg3)
-            else:
-                usb.send_result(RESULT_ERROR)
-                break
+        serve(usb)
 
     except Exception as inst:
         print("An exception occurred " + str(inst))
@@ -0,0 +1,244 @@
+# loopback harness for the usb install protocol, runs usb_install.py against a
+# python port of the switch side over an in-memory link and measures throughput.
+# the link adds a fixed latency to every transfer and limits the bandwidth,
+# the switch side can also take time to "install" each read.
+# usage: python3 usb_loopback.py [--size MiB] [--latency ms] [--bandwidth MiB/s] [--install-rate MiB/s] [--read-size KiB] [file]
+import argparse
+import hashlib
+import os
+import queue
+import sys
+import threading
+import time
+from collections import deque
+
+import crc32c
+
+import usb_install
+from usb_common import *
+
+# matches usb_api.hpp.
+INFLIGHT_CHUNK_SIZE = 1024 * 1024
+
+class LoopbackPipe:
+    # one direction of the link, each write is delivered as a single transfer.
+    def __init__(self, latency: float, bandwidth: float):
+        self.latency = latency
+        self.bandwidth = bandwidth
+        # usb has flow control, the writer can only get a little ahead of the reader.
+        self.transfers = queue.Queue(maxsize=1)
+
+    def write(self, buf) -> int:
+        buf = bytes(buf)
+        self.transfers.put((time.monotonic() + self.latency, buf))
+        return len(buf)
+
+    def read(self, size: int) -> bytes:
+        deliver_at, buf = self.transfers.get()
+        # data only moves once the reader is ready for it.
+        delay = deliver_at - time.monotonic()
+        if self.bandwidth:
+            delay = max(delay, 0) + len(buf) / self.bandwidth
+        if delay > 0:
+            time.sleep(delay)
+        if len(buf) > size:
+            raise ValueError("overflow, transfer of {} into {}".format(len(buf), size))
+        return buf
+
+class LoopbackHostUsb(Usb):
+    # the pc side, has the same api as usb_common.Usb.
+    def __init__(self, to_host: LoopbackPipe, to_device: LoopbackPipe):
+        super().__init__()
+        self.to_host = to_host
+        self.to_device = to_device
+
+    def wait_for_connect(self) -> None:
+        pass
+
+    def read(self, size: int, timeout: int = 0) -> bytes:
+        return self.to_host.read(size)
+
+    def write(self, buf: bytes, timeout: int = 0) -> int:
+        return self.to_device.write(buf)
+
+class LoopbackDevice:
+    # python port of usb::install::Usb (the switch side).
+    def __init__(self, to_host: LoopbackPipe, to_device: LoopbackPipe, inflight_max: int):
+        self.to_host = to_host
+        self.to_device = to_device
+        self.inflight_max_wanted = inflight_max
+        self.inflight_max = 0
+        self.file_size = 0
+        self.requests = deque()
+        self.stream_off = 0
+        self.request_off = 0
+        self.leftover = b""
+        self.leftover_pos = 0
+        self.transfers = 0
+
+    def send(self, packet: UsbPacket) -> None:
+        self.transfers += 1
+        self.to_host.write(packet.pack())
+
+    def recv(self, size: int) -> bytes:
+        self.transfers += 1
+        return self.to_device.read(size)
+
+    def recv_result(self) -> ResultPacket:
+        packet = ResultPacket.unpack(self.recv(PACKET_SIZE))
+        packet.verify()
+        return packet
+
+    def send_and_verify(self, packet: UsbPacket) -> ResultPacket:
+        self.send(packet)
+        return self.recv_result()
+
+    def connect(self) -> list[str]:
+        # v1 switch sends 0 for both.
+        version = PROTOCOL_VERSION_2 if self.inflight_max_wanted else 0
+        result = self.send_and_verify(SendPacket.build(RESULT_OK, version, self.inflight_max_wanted))
+        self.inflight_max = min(result.arg4, INFLIGHT_MAX)
+        names = bytes(self.recv(result.arg3)).decode()
+        return [name for name in names.split("\n") if name]
+
+    def open_file(self, index: int) -> int:
+        result = self.send_and_verify(SendPacket.build(CMD_OPEN, index))
+        self.file_size = ((result.arg3 & 0xFFFF) << 32) | result.arg4
+        self.requests.clear()
+        self.stream_off = self.request_off = 0
+        self.leftover = b""
+        self.leftover_pos = 0
+        return self.file_size
+
+    def close_file(self) -> None:
+        self.drain_requests()
+        self.send_and_verify(SendDataPacket.build(0, 0, 0))
+
+    def quit(self) -> None:
+        self.send_and_verify(SendPacket.build(CMD_QUIT))
+
+    def read(self, off: int, size: int) -> bytes:
+        if self.inflight_max > 1:
+            return self.read_pipelined(off, size)
+
+        result = self.send_and_verify(SendDataPacket.build(off, size, 0))
+        buf = bytes(self.recv(result.arg3))
+        if crc32c.crc32c(buf) != result.arg4:
+            raise ValueError("crc32c mismatch")
+        return buf
+
+    def read_pipelined(self, off: int, size: int) -> bytes:
+        if off >= self.file_size:
+            return b""
+
+        size = min(size, self.file_size - off)
+        if off < self.stream_off or off > self.request_off:
+            self.drain_requests()
+            self.stream_off = self.request_off = off
+        elif off > self.stream_off:
+            self.consume(off - self.stream_off)
+
+        return self.consume(size)
+
+    def queue_requests(self) -> None:
+        while len(self.requests) < self.inflight_max and self.request_off < self.file_size:
+            size = min(INFLIGHT_CHUNK_SIZE, self.file_size - self.request_off)
+            self.send(SendDataPacket.build(self.request_off, size, 0))
+            self.requests.append((self.request_off, size))
+            self.request_off += size
+
+    def receive_request(self) -> bytes:
+        _, size = self.requests.popleft()
+        result = self.recv_result()
+        if result.arg3 != size:
+            raise ValueError("bad transfer size")
+
+        buf = bytes(self.recv(size))
+        if crc32c.crc32c(buf) != result.arg4:
+            raise ValueError("crc32c mismatch")
+        return buf
+
+    def consume(self, size: int) -> bytes:
+        out = bytearray()
+        while size:
+            if self.leftover_pos < len(self.leftover):
+                chunk = self.leftover[self.leftover_pos:self.leftover_pos + size]
+                out += chunk
+                self.leftover_pos += len(chunk)
+                self.stream_off += len(chunk)
+                size -= len(chunk)
+                continue
+
+            self.queue_requests()
+            self.leftover = self.receive_request()
+            self.leftover_pos = 0
+        return bytes(out)
+
+    def drain_requests(self) -> None:
+        while self.requests:
+            self.receive_request()
+        self.leftover = b""
+        self.leftover_pos = 0
+
+def run(path: str, inflight_max: int, latency: float = 0.0005, bandwidth: float = 0, read_size: int = 1024 * 1024 * 4, install_rate: float = 0) -> dict:
+    # installs path over the loopback link, returns the stats of the transfer.
+    to_host = LoopbackPipe(latency, bandwidth)
+    to_device = LoopbackPipe(latency, bandwidth)
+
+    usb_install.paths.clear()
+    usb_install.add_file_to_install_list(path)
+    host = threading.Thread(target=usb_install.serve, args=(LoopbackHostUsb(to_host, to_device),), daemon=True)
+    host.start()
+
+    device = LoopbackDevice(to_host, to_device, inflight_max)
+    device.connect()
+
+    start = time.monotonic()
+    file_size = device.open_file(0)
+    sha256 = hashlib.sha256()
+    for off in range(0, file_size, read_size):
+        buf = device.read(off, read_size)
+        sha256.update(buf)
+        # time taken to decompress / write the data on the switch.
+        if install_rate:
+            time.sleep(len(buf) / install_rate)
+    device.close_file()
+    elapsed = time.monotonic() - start
+
+    device.quit()
+    host.join(timeout=5)
+
+    return {
+        "protocol": 2 if device.inflight_max else 1,
+        "inflight": device.inflight_max,
+        "size": file_size,
+        "elapsed": elapsed,
+        "mib_per_sec": file_size / elapsed / 1024 / 1024 if elapsed else 0,
+        "transfers": device.transfers,
+        "sha256": sha256.hexdigest(),
+    }
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="measure usb install throughput over a loopback link")
+    parser.add_argument("file", nargs="?", help="file to transfer, a random file is created if not set")
+    parser.add_argument("--size", type=int, default=64, help="size of the random file in MiB")
+    parser.add_argument("--latency", type=float, default=0.5, help="latency of each transfer in ms")
+    parser.add_argument("--bandwidth", type=float, default=0, help="link bandwidth in MiB/s, 0 for unlimited")
+    parser.add_argument("--install-rate", type=float, default=0, help="rate the switch installs at in MiB/s, 0 for instant")
+    parser.add_argument("--read-size", type=int, default=4096, help="size of each read on the switch in KiB")
+    args = parser.parse_args()
+
+    path = args.file
+    if path is None:
+        import tempfile
+        tmp = tempfile.NamedTemporaryFile(suffix=".nsp", delete=False)
+        tmp.write(os.urandom(args.size * 1024 * 1024))
+        tmp.close()
+        path = tmp.name
+
+    for inflight in (0, INFLIGHT_MAX):
+        stats = run(path, inflight, args.latency / 1000, args.bandwidth * 1024 * 1024, args.read_size * 1024, args.install_rate * 1024 * 1024)
+        print("v{} inflight: {} {:.2f} MiB/s {:.2f}s transfers: {}".format(stats["protocol"], stats["inflight"], stats["mib_per_sec"], stats["elapsed"], stats["transfers"]))
+
+    if args.file is None:
+        os.remove(path)